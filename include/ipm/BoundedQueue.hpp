@@ -0,0 +1,139 @@
+/**
+ * @file BoundedQueue.hpp A fixed-capacity lock-free queue
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_BOUNDEDQUEUE_HPP_
+#define IPM_INCLUDE_IPM_BOUNDEDQUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief A queue of at most capacity() elements which any number of threads
+ * may push to and pop from without locks (Dmitry Vyukov's bounded MPMC
+ * queue). Each slot carries a sequence number saying whether it is ready to be
+ * written or read in the current lap of the ring, so a push or pop is one
+ * compare-and-swap on its end of the queue plus one store to the slot.
+ *
+ * It never blocks or allocates after construction: a full or empty queue is
+ * reported to the caller, which decides how to wait.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  // The capacity is rounded up to a power of two, of at least 2
+  explicit BoundedQueue(size_t capacity)
+  {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+      rounded *= 2;
+    }
+    m_mask = rounded - 1;
+    m_cells = std::make_unique<Cell[]>(rounded);
+    for (size_t i = 0; i < rounded; ++i) {
+      m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // Moves from value, and returns true, only if there was room
+  bool try_push(T& value)
+  {
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    Cell* cell = nullptr;
+    for (;;) {
+      cell = &m_cells[pos & m_mask];
+      size_t sequence = cell->m_sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Full: the slot still holds an element from the previous lap
+      } else {
+        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->m_value = std::move(value);
+    cell->m_sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T& value)
+  {
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    Cell* cell = nullptr;
+    for (;;) {
+      cell = &m_cells[pos & m_mask];
+      size_t sequence = cell->m_sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // Empty
+      } else {
+        pos = m_dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->m_value);
+    cell->m_value = T();
+    cell->m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate while other threads are pushing or popping
+  size_t size() const noexcept
+  {
+    size_t dequeue_pos = m_dequeue_pos.load(std::memory_order_acquire);
+    size_t enqueue_pos = m_enqueue_pos.load(std::memory_order_acquire);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  size_t capacity() const noexcept { return m_mask + 1; }
+
+  // Whether the next try_pop would find an element, and the next try_push
+  // room; as with size(), only a hint while other threads are using the queue
+  bool can_pop() const noexcept
+  {
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    return m_cells[pos & m_mask].m_sequence.load(std::memory_order_acquire) == pos + 1;
+  }
+
+  bool can_push() const noexcept
+  {
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    return m_cells[pos & m_mask].m_sequence.load(std::memory_order_acquire) == pos;
+  }
+
+private:
+  // Each slot on its own cache line, as are the two ends, so that a producer
+  // and a consumer working on neighbouring slots don't contend
+  struct alignas(64) Cell
+  {
+    std::atomic<size_t> m_sequence{ 0 };
+    T m_value{};
+  };
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask{ 0 };
+  alignas(64) std::atomic<size_t> m_enqueue_pos{ 0 };
+  alignas(64) std::atomic<size_t> m_dequeue_pos{ 0 };
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_BOUNDEDQUEUE_HPP_
@@ -0,0 +1,99 @@
+/**
+ * @file BufferPool.hpp BufferPool Class Interface
+ *
+ * BufferPool hands out fixed-size message buffers which return to the pool
+ * automatically once they are no longer needed. Combined with
+ * Sender::send(BufferPool::Buffer&&, ...), this lets producers fill buffers
+ * that the transport sends without a copy and recycles once the IO thread is
+ * done with them.
+ *
+ * BufferPool is thread-safe: buffers may be acquired and returned from any
+ * thread. A BufferPool must be owned by a std::shared_ptr (see
+ * make_buffer_pool), as outstanding buffers keep their pool alive.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_BUFFERPOOL_HPP_
+#define IPM_INCLUDE_IPM_BUFFERPOOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dunedaq::ipm {
+
+class BufferPool : public std::enable_shared_from_this<BufferPool>
+{
+
+public:
+  class Buffer
+  {
+  public:
+    Buffer() = default;
+    ~Buffer() { reset(); }
+
+    Buffer(Buffer&& other) noexcept = default;
+    Buffer& operator=(Buffer&& other) noexcept
+    {
+      if (this != &other) {
+        reset();
+        m_pool = std::move(other.m_pool);
+        m_storage = std::move(other.m_storage);
+        m_size = other.m_size;
+      }
+      return *this;
+    }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    char* data() const noexcept { return m_storage.get(); }
+    size_t size() const noexcept { return m_size; }
+    explicit operator bool() const noexcept { return m_storage != nullptr; }
+
+    // Returns the storage to its pool; the Buffer is empty afterwards
+    void reset();
+
+  private:
+    friend class BufferPool;
+
+    std::shared_ptr<BufferPool> m_pool{};
+    std::unique_ptr<char[]> m_storage{};
+    size_t m_size{ 0 };
+  };
+
+  BufferPool(size_t buffer_size, size_t initial_buffers);
+
+  // Reuses a free buffer if there is one, otherwise allocates a new one
+  Buffer acquire();
+
+  size_t buffer_size() const noexcept { return m_buffer_size; }
+  size_t num_free() const;
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  BufferPool(BufferPool&&) = delete;
+  BufferPool& operator=(BufferPool&&) = delete;
+
+private:
+  void recycle(std::unique_ptr<char[]> storage);
+
+  const size_t m_buffer_size;
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<char[]>> m_free;
+};
+
+inline std::shared_ptr<BufferPool>
+make_buffer_pool(size_t buffer_size, size_t initial_buffers = 0)
+{
+  return std::make_shared<BufferPool>(buffer_size, initial_buffers);
+}
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_BUFFERPOOL_HPP_
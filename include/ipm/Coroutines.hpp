@@ -0,0 +1,253 @@
+/**
+ * @file Coroutines.hpp C++20 awaitable receives and sends, served by a Reactor
+ *
+ * Rather than parking a thread in each Receiver's receive loop, a coroutine
+ * can co_await ipm::co_receive(receiver, timeout): it is suspended until the
+ * Reactor sees the endpoint's readiness_fd() signal, so a few reactor threads
+ * serve any number of endpoints. The coroutine is resumed on a reactor thread
+ * (or carries straight on, if the operation could be done at once).
+ *
+ * Only one operation at a time may be outstanding on an endpoint, and no
+ * other thread should use it meanwhile.
+ *
+ * Everything here needs a compiler with C++20 coroutines, which defines
+ * IPM_HAVE_COROUTINES; otherwise the header is empty apart from the Reactor.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_COROUTINES_HPP_
+#define IPM_INCLUDE_IPM_COROUTINES_HPP_
+
+#include "ipm/Reactor.hpp"
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define IPM_HAVE_COROUTINES 1
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <utility>
+
+namespace dunedaq::ipm {
+
+template<typename Duration>
+Reactor::clock_t::time_point
+reactor_deadline(const Duration& timeout)
+{
+  if (timeout == Duration::max()) {
+    return Reactor::clock_t::time_point::max();
+  }
+  return Reactor::clock_t::now() + timeout;
+}
+
+/**
+ * @brief What co_receive() returns: co_await gives the Receiver::Response.
+ * -Throws ReceiveTimeoutExpired if nothing arrives in time
+ * -Throws ReactorStopped if the Reactor is destroyed first
+ * -Throws whatever Receiver::try_receive() throws
+ */
+class ReceiveAwaitable
+{
+public:
+  ReceiveAwaitable(Receiver& receiver, const Receiver::duration_t& timeout, Reactor& reactor)
+    : m_receiver(receiver)
+    , m_timeout(timeout)
+    , m_deadline(reactor_deadline(timeout))
+    , m_reactor(reactor)
+  {}
+
+  bool await_ready()
+  {
+    if (attempt()) {
+      return true;
+    }
+    if (m_timeout == Receiver::s_no_block) {
+      finish(Reactor::Outcome::TimedOut);
+      return true;
+    }
+    return false;
+  }
+
+  // Nothing here may touch *this after watch(), as the coroutine can be
+  // resumed, and this awaitable destroyed, before it returns
+  void await_suspend(std::coroutine_handle<> handle)
+  {
+    m_reactor.watch(
+      m_receiver.readiness_fd(),
+      m_deadline,
+      [this] { return attempt(); },
+      [this, handle](Reactor::Outcome outcome) {
+        finish(outcome);
+        handle.resume();
+      });
+  }
+
+  Receiver::Response await_resume()
+  {
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+    return std::move(m_response);
+  }
+
+private:
+  bool attempt() noexcept
+  {
+    try {
+      return m_receiver.ready_to_receive() && m_receiver.try_receive(m_response);
+    } catch (...) {
+      m_error = std::current_exception();
+      return true;
+    }
+  }
+
+  void finish(Reactor::Outcome outcome)
+  {
+    if (outcome == Reactor::Outcome::Abandoned) {
+      m_error = std::make_exception_ptr(ReactorStopped(ERS_HERE));
+    } else if (outcome == Reactor::Outcome::TimedOut) {
+      // One last look, which counts the timeout if there is still nothing
+      try {
+        auto batch = m_receiver.receive_batch(1, Receiver::s_no_block);
+        if (batch.empty()) {
+          throw ReceiveTimeoutExpired(ERS_HERE, m_timeout.count());
+        }
+        m_response = std::move(batch.front());
+      } catch (...) {
+        m_error = std::current_exception();
+      }
+    }
+  }
+
+  Receiver& m_receiver;
+  Receiver::duration_t m_timeout;
+  Reactor::clock_t::time_point m_deadline;
+  Reactor& m_reactor;
+  Receiver::Response m_response{};
+  std::exception_ptr m_error{};
+};
+
+/**
+ * @brief What co_send() returns: co_await completes once the message is sent.
+ * -Throws SendTimeoutExpired if there is no room in time
+ * -Throws ReactorStopped if the Reactor is destroyed first
+ * -Throws whatever Sender::try_send() throws
+ */
+class SendAwaitable
+{
+public:
+  SendAwaitable(Sender& sender,
+                const void* message,
+                Sender::message_size_t message_size,
+                const Sender::duration_t& timeout,
+                std::string metadata,
+                Reactor& reactor)
+    : m_sender(sender)
+    , m_message(message)
+    , m_message_size(message_size)
+    , m_timeout(timeout)
+    , m_deadline(reactor_deadline(timeout))
+    , m_metadata(std::move(metadata))
+    , m_reactor(reactor)
+  {}
+
+  bool await_ready()
+  {
+    if (attempt()) {
+      return true;
+    }
+    if (m_timeout == Sender::s_no_block) {
+      finish(Reactor::Outcome::TimedOut);
+      return true;
+    }
+    return false;
+  }
+
+  // As ReceiveAwaitable::await_suspend
+  void await_suspend(std::coroutine_handle<> handle)
+  {
+    m_reactor.watch(
+      m_sender.readiness_fd(),
+      m_deadline,
+      [this] { return attempt(); },
+      [this, handle](Reactor::Outcome outcome) {
+        finish(outcome);
+        handle.resume();
+      });
+  }
+
+  void await_resume()
+  {
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+  }
+
+private:
+  bool attempt() noexcept
+  {
+    try {
+      return m_sender.ready_to_send() && m_sender.try_send(m_message, m_message_size, m_metadata);
+    } catch (...) {
+      m_error = std::current_exception();
+      return true;
+    }
+  }
+
+  void finish(Reactor::Outcome outcome)
+  {
+    if (outcome == Reactor::Outcome::Abandoned) {
+      m_error = std::make_exception_ptr(ReactorStopped(ERS_HERE));
+    } else if (outcome == Reactor::Outcome::TimedOut) {
+      // One last try, which counts the timeout if there is still no room
+      try {
+        Sender::BatchEntry entry{ m_message, m_message_size, m_metadata };
+        if (m_sender.send_batch(&entry, 1, Sender::s_no_block) == 0) {
+          throw SendTimeoutExpired(ERS_HERE, m_timeout.count());
+        }
+      } catch (...) {
+        m_error = std::current_exception();
+      }
+    }
+  }
+
+  Sender& m_sender;
+  const void* m_message;
+  Sender::message_size_t m_message_size;
+  Sender::duration_t m_timeout;
+  Reactor::clock_t::time_point m_deadline;
+  std::string m_metadata;
+  Reactor& m_reactor;
+  std::exception_ptr m_error{};
+};
+
+// co_await co_receive(receiver, timeout) gives the next message
+inline ReceiveAwaitable
+co_receive(Receiver& receiver, const Receiver::duration_t& timeout, Reactor& reactor = Reactor::instance())
+{
+  return ReceiveAwaitable(receiver, timeout, reactor);
+}
+
+// co_await co_send(...) sends the message, which must stay valid until then
+inline SendAwaitable
+co_send(Sender& sender,
+        const void* message,
+        Sender::message_size_t message_size,
+        const Sender::duration_t& timeout,
+        std::string metadata = "",
+        Reactor& reactor = Reactor::instance())
+{
+  return SendAwaitable(sender, message, message_size, timeout, std::move(metadata), reactor);
+}
+
+} // namespace dunedaq::ipm
+
+#endif // __cpp_impl_coroutine
+
+#endif // IPM_INCLUDE_IPM_COROUTINES_HPP_
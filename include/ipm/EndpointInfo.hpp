@@ -0,0 +1,159 @@
+/**
+ * @file EndpointInfo.hpp Monitoring counters kept by every Sender and Receiver
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_ENDPOINTINFO_HPP_
+#define IPM_INCLUDE_IPM_ENDPOINTINFO_HPP_
+
+#include "ipm/LatencyHistogram.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief A snapshot of an endpoint's counters, as returned by
+ * Sender::get_info() and Receiver::get_info(). All counts are totals since the
+ * endpoint was created.
+ */
+struct EndpointInfo
+{
+  uint64_t m_messages{ 0 };        // Messages sent or received
+  uint64_t m_bytes{ 0 };           // Payload bytes sent or received, excluding metadata
+  uint64_t m_largest_message{ 0 }; // Size of the largest message, in bytes
+  uint64_t m_timeouts{ 0 };        // Calls which ran out of time (a partly-sent batch counts once)
+  uint64_t m_retries{ 0 };         // Times the transport had to wait before it could go on
+  uint64_t m_blocked_ns{ 0 };      // Time spent in those waits: backpressure for a Sender, idle for a Receiver
+  uint64_t m_queue_depth{ 0 };     // Messages queued inside the transport right now, where it can tell
+  uint64_t m_in_flight{ 0 };       // Sender::send_async() calls queued or under way right now
+  uint64_t m_dropped{ 0 };         // Messages counted as sent which the transport then had to discard
+
+  // For receivers of messages sent with timestamps (see the "timestamps" connection_info key)
+  uint64_t m_sequence_gaps{ 0 };   // Messages missing, going by the senders' sequence numbers
+  uint64_t m_latency_samples{ 0 }; // Timestamped messages received; the latencies are over these
+  uint64_t m_latency_p50_ns{ 0 };
+  uint64_t m_latency_p99_ns{ 0 };
+  uint64_t m_latency_p999_ns{ 0 };
+  uint64_t m_latency_max_ns{ 0 };
+};
+
+/**
+ * @brief The counters behind EndpointInfo. They are lock-free and use relaxed
+ * ordering, so updating them costs a few uncontended atomic adds per message;
+ * a snapshot may mix values from either side of a concurrent update.
+ */
+class EndpointCounters
+{
+public:
+  EndpointCounters() = default;
+  ~EndpointCounters() { delete m_latency.load(std::memory_order_relaxed); }
+
+  EndpointCounters(const EndpointCounters&) = delete;
+  EndpointCounters& operator=(const EndpointCounters&) = delete;
+
+  void count_message(uint64_t bytes) noexcept
+  {
+    m_messages.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t largest = m_largest_message.load(std::memory_order_relaxed);
+    while (bytes > largest && !m_largest_message.compare_exchange_weak(largest, bytes, std::memory_order_relaxed)) {
+    }
+  }
+
+  void count_timeout() noexcept { m_timeouts.fetch_add(1, std::memory_order_relaxed); }
+
+  void count_dropped(uint64_t messages) noexcept { m_dropped.fetch_add(messages, std::memory_order_relaxed); }
+
+  // One wait in a retry loop, and how long it took
+  void count_wait(std::chrono::steady_clock::duration waited) noexcept
+  {
+    m_retries.fetch_add(1, std::memory_order_relaxed);
+    m_blocked_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count(),
+                           std::memory_order_relaxed);
+  }
+
+  // Transit time of a timestamped message. The histogram is only allocated once there is one.
+  void record_latency(uint64_t latency_ns)
+  {
+    LatencyHistogram* histogram = m_latency.load(std::memory_order_acquire);
+    if (histogram == nullptr) {
+      auto* fresh = new LatencyHistogram();
+      if (m_latency.compare_exchange_strong(histogram, fresh, std::memory_order_acq_rel)) {
+        histogram = fresh;
+      } else {
+        delete fresh; // Another thread got there first; histogram now points at its one
+      }
+    }
+    histogram->record(latency_ns);
+  }
+
+  void count_gaps(uint64_t missing) noexcept { m_sequence_gaps.fetch_add(missing, std::memory_order_relaxed); }
+
+  EndpointInfo snapshot() const noexcept
+  {
+    EndpointInfo info;
+    info.m_messages = m_messages.load(std::memory_order_relaxed);
+    info.m_bytes = m_bytes.load(std::memory_order_relaxed);
+    info.m_largest_message = m_largest_message.load(std::memory_order_relaxed);
+    info.m_timeouts = m_timeouts.load(std::memory_order_relaxed);
+    info.m_retries = m_retries.load(std::memory_order_relaxed);
+    info.m_blocked_ns = m_blocked_ns.load(std::memory_order_relaxed);
+    info.m_dropped = m_dropped.load(std::memory_order_relaxed);
+    info.m_sequence_gaps = m_sequence_gaps.load(std::memory_order_relaxed);
+    if (const LatencyHistogram* histogram = m_latency.load(std::memory_order_acquire)) {
+      info.m_latency_samples = histogram->count();
+      info.m_latency_p50_ns = histogram->percentile(0.5);
+      info.m_latency_p99_ns = histogram->percentile(0.99);
+      info.m_latency_p999_ns = histogram->percentile(0.999);
+      info.m_latency_max_ns = histogram->max();
+    }
+    return info;
+  }
+
+private:
+  std::atomic<uint64_t> m_messages{ 0 };
+  std::atomic<uint64_t> m_bytes{ 0 };
+  std::atomic<uint64_t> m_largest_message{ 0 };
+  std::atomic<uint64_t> m_timeouts{ 0 };
+  std::atomic<uint64_t> m_retries{ 0 };
+  std::atomic<uint64_t> m_blocked_ns{ 0 };
+  std::atomic<uint64_t> m_dropped{ 0 };
+  std::atomic<uint64_t> m_sequence_gaps{ 0 };
+  std::atomic<LatencyHistogram*> m_latency{ nullptr };
+};
+
+/**
+ * @brief Records the wait it is alive for with EndpointCounters::count_wait;
+ * does nothing if counters is null
+ */
+class WaitTimer
+{
+public:
+  explicit WaitTimer(EndpointCounters* counters)
+    : m_counters(counters)
+    , m_start_time(counters ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+  {}
+  ~WaitTimer()
+  {
+    if (m_counters) {
+      m_counters->count_wait(std::chrono::steady_clock::now() - m_start_time);
+    }
+  }
+
+  WaitTimer(const WaitTimer&) = delete;
+  WaitTimer& operator=(const WaitTimer&) = delete;
+
+private:
+  EndpointCounters* m_counters;
+  std::chrono::steady_clock::time_point m_start_time;
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_ENDPOINTINFO_HPP_
@@ -0,0 +1,107 @@
+/**
+ * @file LatencyHistogram.hpp Lock-free log-linear histogram of latencies
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_LATENCYHISTOGRAM_HPP_
+#define IPM_INCLUDE_IPM_LATENCYHISTOGRAM_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief A histogram of nanosecond values in the style of HdrHistogram: each
+ * power of two is split into s_sub_buckets equal buckets, so any recorded
+ * value is known to within about 3%, from 1 ns up to about 18 minutes (larger
+ * values land in the last bucket). Recording is a couple of relaxed atomic
+ * operations, so it can be done from any thread while others read.
+ */
+class LatencyHistogram
+{
+public:
+  void record(uint64_t value_ns) noexcept
+  {
+    m_buckets[bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value_ns > max && !m_max.compare_exchange_weak(max, value_ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  uint64_t count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+  uint64_t max() const noexcept { return m_max.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief The value below which the given fraction of the recorded values
+   * lie, e.g. 0.99 for the 99th percentile; 0 if nothing has been recorded
+   * @return The upper edge of the bucket holding that value, capped at max()
+   */
+  uint64_t percentile(double fraction) const noexcept
+  {
+    uint64_t total = 0;
+    for (size_t i = 0; i < s_num_buckets; ++i) {
+      total += m_buckets[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5);
+    if (rank == 0) {
+      rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < s_num_buckets; ++i) {
+      seen += m_buckets[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        uint64_t upper = bucket_upper_edge(i);
+        return upper < max() ? upper : max();
+      }
+    }
+    return max();
+  }
+
+private:
+  static constexpr unsigned s_sub_bucket_bits = 5;
+  static constexpr uint64_t s_sub_buckets = uint64_t(1) << s_sub_bucket_bits;
+  static constexpr unsigned s_max_exponent = 40; // 2^40 ns is about 18 minutes
+  // Values below 2 * s_sub_buckets each get their own bucket
+  static constexpr size_t s_num_buckets = 2 * s_sub_buckets + (s_max_exponent - s_sub_bucket_bits) * s_sub_buckets;
+
+  static size_t bucket_index(uint64_t value) noexcept
+  {
+    if (value < 2 * s_sub_buckets) {
+      return static_cast<size_t>(value);
+    }
+    unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    if (exponent > s_max_exponent) {
+      return s_num_buckets - 1;
+    }
+    uint64_t sub_bucket = (value >> (exponent - s_sub_bucket_bits)) & (s_sub_buckets - 1);
+    return static_cast<size_t>(2 * s_sub_buckets + (exponent - s_sub_bucket_bits - 1) * s_sub_buckets + sub_bucket);
+  }
+
+  static uint64_t bucket_upper_edge(size_t index) noexcept
+  {
+    if (index < 2 * s_sub_buckets) {
+      return index;
+    }
+    uint64_t octave = (index - 2 * s_sub_buckets) / s_sub_buckets;
+    uint64_t sub_bucket = (index - 2 * s_sub_buckets) % s_sub_buckets;
+    unsigned shift = static_cast<unsigned>(octave + 1);
+    return ((s_sub_buckets + sub_bucket + 1) << shift) - 1;
+  }
+
+  std::atomic<uint64_t> m_buckets[s_num_buckets] = {};
+  std::atomic<uint64_t> m_count{ 0 };
+  std::atomic<uint64_t> m_max{ 0 };
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_LATENCYHISTOGRAM_HPP_
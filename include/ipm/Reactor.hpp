@@ -0,0 +1,119 @@
+/**
+ * @file Reactor.hpp Waits on many endpoints' readiness with a few threads
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_REACTOR_HPP_
+#define IPM_INCLUDE_IPM_REACTOR_HPP_
+
+#include "ers/Issue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm, ReactorStopped, "Wait abandoned, as its Reactor was destroyed first", )
+ERS_DECLARE_ISSUE(ipm,
+                  ReactorStartFailed,
+                  "Unable to start a Reactor: " << reason,
+                  ((std::string)reason)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  ReactorCallbackFailed,
+                  "Completion callback of a Reactor wait threw: " << reason,
+                  ((std::string)reason)) // NOLINT
+} // namespace dunedaq
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief An event loop run by a fixed number of threads, which retries
+ * non-blocking operations whenever a file descriptor says the endpoint's
+ * readiness may have changed (as with Receiver::readiness_fd()), until they
+ * succeed or their deadline passes. Any number of waits can be outstanding, so
+ * a few threads can serve many connections; the co_receive() and co_send()
+ * awaitables of Coroutines.hpp are built on it.
+ *
+ * Endpoints without such a descriptor (-1) are retried every
+ * s_poll_interval instead.
+ */
+class Reactor
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+  static constexpr std::chrono::milliseconds s_poll_interval{ 1 };
+
+  enum class Outcome
+  {
+    Ready,    // attempt() returned true
+    TimedOut, // The deadline passed first
+    Abandoned // The Reactor was destroyed first
+  };
+
+  // Returns true once the operation is over, and must not throw
+  using attempt_fn_t = std::function<bool()>;
+  // Anything it throws is reported with ers::error as ReactorCallbackFailed
+  using done_fn_t = std::function<void(Outcome outcome)>;
+
+  // -Throws ReactorStartFailed if the kernel refuses an epoll or eventfd descriptor
+  explicit Reactor(size_t num_threads = 1);
+  // Finishes the waits still outstanding as Abandoned, on the calling thread
+  ~Reactor();
+
+  // Shared by the awaitables when not given a Reactor of their own
+  static Reactor& instance();
+
+  /**
+   * @brief Call attempt() on a reactor thread each time fd becomes readable
+   * (or every s_poll_interval if fd is -1), until it returns true or deadline
+   * passes; then call done() once, also on a reactor thread. The caller
+   * should have made its own attempt first, as only changes are reported.
+   * attempt() is never called concurrently with itself.
+   * @param deadline clock_t::time_point::max() waits without one
+   */
+  void watch(int fd, clock_t::time_point deadline, attempt_fn_t attempt, done_fn_t done);
+
+  // Waits not yet done
+  size_t num_watches() const;
+
+  size_t num_threads() const noexcept { return m_threads.size(); }
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+private:
+  struct Watch;
+  using timers_t = std::multimap<clock_t::time_point, std::shared_ptr<Watch>>;
+
+  void run();
+  // Makes an attempt on behalf of an event (from_fd) or a timer
+  void service(std::shared_ptr<Watch> const& watch, bool from_fd);
+  void add_timer(std::shared_ptr<Watch> const& watch, clock_t::time_point when);
+  void wake();
+
+  int m_epoll_fd{ -1 };
+  int m_wake_fd{ -1 }; // An eventfd, registered with epoll as id 0
+
+  mutable std::mutex m_mutex; // Protects the members below and each Watch's m_timer
+  std::unordered_map<uint64_t, std::shared_ptr<Watch>> m_watches;
+  timers_t m_timers; // Deadlines, and retry times of watches without a descriptor
+  uint64_t m_next_id{ 1 };
+
+  std::atomic<bool> m_stopping{ false };
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_REACTOR_HPP_
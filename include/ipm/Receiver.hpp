@@ -14,6 +14,20 @@
  *
  * - Meaningfully implement the timeout feature in receive_, and have it
  *   throw the ReceiveTimeoutExpired exception if it occurs
+ * - Override receive_view_ to hand out the transport's own message buffers,
+ *   avoiding the copy into Response made by the default implementation
+ * - Override receive_multipart_ if the transport preserves the parts of
+ *   messages sent with Sender::send_multipart
+ * - Override receive_batch_ with a non-blocking drain of already-queued
+ *   messages
+ * - Override receive_into_ to copy straight from transport buffers into the
+ *   caller's memory, leaving a message which doesn't fit at the head of the
+ *   transport's queue or handing it back with keep_for_next_receive
+ *
+ * Dispatch threads (start_dispatch) have to be stopped while the
+ * implementation still exists, which the Receivers from make_ipm_receiver see
+ * to; one made any other way must call stop_dispatch() before it is destroyed,
+ * or be deleted through Receiver::destroy.
  *
  * This is part of the DUNE DAQ Application Framework, copyright 2020.
  * Licensing/copyright details are in the COPYING file that you should have
@@ -23,13 +37,20 @@
 #ifndef IPM_INCLUDE_IPM_RECEIVER_HPP_
 #define IPM_INCLUDE_IPM_RECEIVER_HPP_
 
+#include "ipm/EndpointInfo.hpp"
+#include "ipm/ResponsePool.hpp"
+
 #include "cetlib/BasicPluginFactory.h"
 #include "cetlib/compiler_macros.h"
 #include "ers/Issue.h"
 #include "nlohmann/json.hpp"
 
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace dunedaq {
@@ -42,6 +63,15 @@ ERS_DECLARE_ISSUE(ipm,
                   ReceiveTimeoutExpired,
                   "Unable to receive within timeout period (timeout period was " << timeout << " milliseconds)",
                   ((int)timeout)) // NOLINT
+ERS_DECLARE_ISSUE(ipm, NullPointerPassedToReceive, "A null pointer to memory was passed to Receiver::receive_into", )
+ERS_DECLARE_ISSUE(ipm, DispatchAlreadyStarted, "Receiver is already dispatching messages to a handler", )
+ERS_DECLARE_ISSUE(ipm,
+                  DispatchNotStopped,
+                  "Receiver destroyed while still dispatching; stop_dispatch must be called first", )
+ERS_DECLARE_ISSUE(ipm,
+                  DispatchFailed,
+                  "Unable to dispatch a received message: " << reason,
+                  ((std::string)reason)) // NOLINT
 } // namespace dunedaq
 
 #ifndef EXTERN_C_FUNC_DECLARE_START
@@ -61,37 +91,191 @@ ERS_DECLARE_ISSUE(ipm,
 
 namespace dunedaq::ipm {
 
+class ReceiveDispatcher;
+
 class Receiver
 {
 
 public:
   using duration_t = std::chrono::milliseconds;
-  static constexpr duration_t s_block = std::chrono::duration_values<duration_t>::max();
-  static constexpr duration_t s_no_block = std::chrono::duration_values<duration_t>::zero();
+  static constexpr duration_t s_block = duration_t::max();
+  static constexpr duration_t s_no_block = duration_t::zero();
 
   using message_size_t = int;
   static constexpr message_size_t s_any_size =
     0; // Since "I want 0 bytes" is pointless, "0" denotes "I don't care about the size"
 
-  Receiver() = default;
+  Receiver();
+  virtual ~Receiver();
 
   virtual void connect_for_receives(const nlohmann::json& connection_info) = 0;
 
   virtual bool can_receive() const noexcept = 0;
 
+  // The transport settings in effect once connected, as JSON keyed like the
+  // connection_info which sets them. Empty if the implementation has none to report.
+  virtual nlohmann::json effective_options() const { return nlohmann::json::object(); }
+
+  // Counters for monitoring (e.g. from a DAQModule's get_info), kept without
+  // locks by the receive functions below
+  EndpointInfo get_info() const;
+
   // receive() will perform some universally-desirable checks before calling user-implemented receive_:
   // -Throws KnownStateForbidsReceive if can_receive() == false
   // -Throws UnexpectedNumberOfBytes if the "nbytes" argument isn't anysize, and the
   //  received bytes inside the function aren't the same number as nbytes
 
+  // If a ResponsePool has been set, m_data's storage comes from the pool and
+  // goes back to it when the Response is destroyed or assigned over. A copy
+  // has storage of its own, outside the pool; a move takes the pool along.
+  // The pool handle means Response is not an aggregate, so the constructor
+  // below keeps brace-initialization as Response{ metadata, data } working.
+
   struct Response
   {
     std::string m_metadata{ "" };
     std::vector<char> m_data{};
+
+    Response() = default;
+    Response(std::string metadata, std::vector<char> data = {}) // NOLINT
+      : m_metadata(std::move(metadata))
+      , m_data(std::move(data))
+    {}
+    ~Response();
+
+    Response(const Response& other)
+      : m_metadata(other.m_metadata)
+      , m_data(other.m_data)
+    {}
+    Response& operator=(const Response& other);
+    Response(Response&&) noexcept = default;
+    Response& operator=(Response&& other) noexcept;
+
+  private:
+    friend class Receiver;
+
+    void release_to_pool() noexcept;
+
+    std::shared_ptr<ResponsePool> m_pool{};
   };
 
   Response receive(const duration_t& timeout, message_size_t num_bytes = s_any_size);
 
+  // With a pool set, receive() copies each message into a recycled buffer
+  // from the pool instead of allocating a new one. This pays off with
+  // implementations that override receive_view_, such as ZmqReceiver.
+  // Pass nullptr to stop using a pool.
+  void set_response_pool(std::shared_ptr<ResponsePool> pool) { m_response_pool = std::move(pool); }
+  std::shared_ptr<ResponsePool> get_response_pool() const { return m_response_pool; }
+
+  // ResponseView refers to message data owned by the transport rather than
+  // copying it out. m_metadata, m_data and m_size remain valid for as long as
+  // m_handle (or any copy of it) is alive.
+
+  struct ResponseView
+  {
+    std::string_view m_metadata{};
+    const char* m_data{ nullptr };
+    size_t m_size{ 0 };
+    std::shared_ptr<const void> m_handle{};
+  };
+
+  // receive_view() performs the same checks as receive()
+  ResponseView receive_view(const duration_t& timeout, message_size_t num_bytes = s_any_size);
+
+  // MultipartResponseView gives access to each part of a message sent with
+  // Sender::send_multipart() without concatenating them. As with
+  // ResponseView, the parts remain valid for as long as m_handle is alive.
+
+  struct Part
+  {
+    const char* m_data{ nullptr };
+    size_t m_size{ 0 };
+  };
+
+  struct MultipartResponseView
+  {
+    std::string_view m_metadata{};
+    std::vector<Part> m_parts{};
+    std::shared_ptr<const void> m_handle{};
+  };
+
+  // receive_multipart() throws KnownStateForbidsReceive if can_receive() == false
+  MultipartResponseView receive_multipart(const duration_t& timeout);
+
+  // receive_batch() waits up to timeout for a first message, then returns it
+  // together with any further messages that are already queued, up to
+  // max_messages in total. It never waits after the first message. Running
+  // out of time is not an error here: an empty vector is returned instead.
+  // -Throws KnownStateForbidsReceive if can_receive() == false
+
+  std::vector<Response> receive_batch(size_t max_messages, const duration_t& timeout);
+
+  // receive_into() copies the next message straight into caller-owned memory,
+  // and its metadata into *metadata if given (reusing the string's capacity),
+  // so a steady-state receive loop needs no heap allocations. m_size is the
+  // real size of the message. If that is more than buffer_size, nothing is
+  // copied, m_buffer_too_small is set, and the message is kept: the next
+  // receive of any kind returns it first. If the timeout expires,
+  // m_timed_out is set, which tells it apart from an empty message.
+  // -Throws KnownStateForbidsReceive if can_receive() == false
+  // -Throws NullPointerPassedToReceive if buffer is null and buffer_size isn't zero
+
+  struct ReceiveIntoResult
+  {
+    message_size_t m_size{ 0 };
+    bool m_buffer_too_small{ false };
+    bool m_timed_out{ false };
+  };
+
+  ReceiveIntoResult receive_into(void* buffer,
+                                 message_size_t buffer_size,
+                                 const duration_t& timeout,
+                                 std::string* metadata = nullptr);
+
+  // For event loops such as Reactor (see Coroutines.hpp): readiness_fd() is a
+  // file descriptor which becomes readable whenever a message may have become
+  // ready, or -1 if the implementation has none. It signals changes only, so
+  // check ready_to_receive() before waiting on it. ready_to_receive() says
+  // whether a message can be had without waiting; implementations which can't
+  // tell cheaply return true. Neither is safe to call while another thread
+  // is receiving.
+  virtual int readiness_fd() const { return -1; }
+  bool ready_to_receive() { return m_pending_view.has_value() || ready_to_receive_(); }
+
+  // try_receive() takes the next message into response if one is ready, and
+  // returns false otherwise, without waiting. Unlike receive(s_no_block), it
+  // neither throws nor counts a timeout when there is nothing, as event loops
+  // retry it every time the endpoint might be ready.
+  // -Throws KnownStateForbidsReceive if can_receive() == false
+  bool try_receive(Response& response);
+
+  // Dispatch mode: instead of calling receive in a loop, register a handler,
+  // which dispatch threads belonging to this Receiver call with each message
+  // as soon as it arrives. Nothing times out while the connection is idle.
+  // The threads take turns to receive one message each, then run the handler
+  // outside the turn, so with one thread messages are handled in order, and
+  // with more they are handled concurrently. Whatever the handler throws is
+  // reported as DispatchFailed. The receive functions must not be called
+  // while dispatching.
+  // -Throws KnownStateForbidsReceive if can_receive() == false
+  // -Throws DispatchAlreadyStarted if dispatching has already started
+
+  using handler_fn_t = std::function<void(Response& message)>;
+  static constexpr size_t s_default_dispatch_threads = 1;
+
+  void start_dispatch(handler_fn_t handler, size_t num_threads = s_default_dispatch_threads);
+
+  // Returns once every handler under way has returned, so it must not be
+  // called from a handler
+  void stop_dispatch();
+
+  bool is_dispatching() const noexcept { return m_dispatch != nullptr; }
+
+  // A deleter for Receivers made other than by make_ipm_receiver, which
+  // stops dispatching while the implementation the threads use still exists
+  static void destroy(Receiver* receiver);
+
   Receiver(const Receiver&) = delete;
   Receiver& operator=(const Receiver&) = delete;
 
@@ -100,13 +284,60 @@ public:
 
 protected:
   virtual Response receive_(const duration_t& timeout) = 0;
+
+  // The default implementation wraps the Response returned by receive_
+  virtual ResponseView receive_view_(const duration_t& timeout);
+  // The default implementation returns the result of receive_view_ as a single part
+  virtual MultipartResponseView receive_multipart_(const duration_t& timeout);
+  // The default implementation calls receive_ until it times out
+  virtual std::vector<Response> receive_batch_(size_t max_messages, const duration_t& timeout);
+  // The default implementation copies out of receive_view_, handing messages
+  // that don't fit to keep_for_next_receive
+  virtual ReceiveIntoResult receive_into_(void* buffer,
+                                          message_size_t buffer_size,
+                                          const duration_t& timeout,
+                                          std::string* metadata);
+  // Implementations which can tell whether a message is waiting override this
+  virtual bool ready_to_receive_() { return true; }
+
+  // For receive_into_ implementations which have taken a message off the
+  // transport but found it too big: every receive function returns it before
+  // asking the implementation for another
+  void keep_for_next_receive(ResponseView view) { m_pending_view = std::move(view); }
+
+  // Implementations record the waits in their receive loops here (see WaitTimer)
+  EndpointCounters& counters() noexcept { return m_counters; }
+  // Messages queued inside the transport, for get_info; 0 if it can't tell
+  virtual size_t queue_depth_() const { return 0; }
+
+private:
+  friend class ReceiveDispatcher;
+
+  // Each returns false if there is nothing to take; neither counts anything
+  bool take_pending(ResponseView& view);
+  bool receive_one(Response& response, const duration_t& timeout);
+  // Into storage from the pool, if one is set
+  void copy_to_response(const ResponseView& view, Response& response) const;
+  // Keeps the message for the next receive if it doesn't fit
+  ReceiveIntoResult copy_into(ResponseView view, void* buffer, message_size_t buffer_size, std::string* metadata);
+
+  std::optional<ResponseView> m_pending_view{}; // Kept by receive_into, for the next receive
+  std::shared_ptr<ResponsePool> m_response_pool{};
+  EndpointCounters m_counters;
+  std::unique_ptr<ReceiveDispatcher> m_dispatch; // While dispatching
 };
 
 inline std::shared_ptr<Receiver>
 make_ipm_receiver(std::string const& plugin_name)
 {
   static cet::BasicPluginFactory bpf("duneIPM", "make");
-  return bpf.makePlugin<std::shared_ptr<Receiver>>(plugin_name);
+  auto plugin = bpf.makePlugin<std::shared_ptr<Receiver>>(plugin_name);
+  // Whatever the plugin's own deleter, stop dispatching before it runs
+  auto receiver = plugin.get();
+  return std::shared_ptr<Receiver>(receiver, [plugin = std::move(plugin)](Receiver* stopping) mutable {
+    stopping->stop_dispatch();
+    plugin.reset();
+  });
 }
 
 } // namespace dunedaq::ipm
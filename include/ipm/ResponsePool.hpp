@@ -0,0 +1,98 @@
+/**
+ * @file ResponsePool.hpp ResponsePool Class Interface
+ *
+ * ResponsePool recycles the storage behind Receiver::Response::m_data. Once
+ * a pool has been given to a Receiver with Receiver::set_response_pool,
+ * Receiver::receive copies each message into a buffer taken from the pool,
+ * and that buffer goes back to the pool when the Response is destroyed.
+ *
+ * Buffers are kept in power-of-two size classes from s_min_class_size up to
+ * the pool's max_buffer_size. Messages larger than that are allocated and
+ * freed as usual, and counted as misses. prefill() allocates buffers up front
+ * and touches every page, so that the first messages of a run don't take page
+ * faults either.
+ *
+ * ResponsePool is thread-safe: responses may be destroyed on any thread, and
+ * one pool may be shared by several Receivers. Outstanding responses keep
+ * their pool alive.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_RESPONSEPOOL_HPP_
+#define IPM_INCLUDE_IPM_RESPONSEPOOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dunedaq::ipm {
+
+class ResponsePool
+{
+
+public:
+  static constexpr size_t s_min_class_size = 256;
+  static constexpr size_t s_default_max_buffer_size = 16 * 1024 * 1024;
+  static constexpr size_t s_default_max_free_per_class = 16;
+
+  struct Stats
+  {
+    size_t m_hits{ 0 };         // acquire() calls served from a free buffer
+    size_t m_misses{ 0 };       // acquire() calls which had to allocate
+    size_t m_dropped{ 0 };      // Returned buffers freed because their class was full or they were oversized
+    size_t m_free_buffers{ 0 }; // Buffers currently held by the pool
+    size_t m_free_bytes{ 0 };   // Total capacity of the buffers currently held by the pool
+  };
+
+  explicit ResponsePool(size_t max_buffer_size = s_default_max_buffer_size,
+                        size_t max_free_per_class = s_default_max_free_per_class);
+
+  // Allocates and pre-faults count buffers in the size class holding buffer_size
+  void prefill(size_t buffer_size, size_t count);
+
+  // Returns an empty vector with capacity for at least size bytes
+  std::vector<char> acquire(size_t size);
+
+  // Keeps buffer for reuse if its size class has room, otherwise frees it
+  void release(std::vector<char>&& buffer) noexcept;
+
+  size_t max_buffer_size() const noexcept { return m_max_buffer_size; }
+  Stats get_stats() const;
+
+  ResponsePool(const ResponsePool&) = delete;
+  ResponsePool& operator=(const ResponsePool&) = delete;
+
+  ResponsePool(ResponsePool&&) = delete;
+  ResponsePool& operator=(ResponsePool&&) = delete;
+
+private:
+  static constexpr size_t s_no_class = static_cast<size_t>(-1);
+
+  // The smallest class which can hold size bytes
+  size_t class_for_size(size_t size) const noexcept;
+  // The largest class which a buffer with this capacity can serve
+  size_t class_for_capacity(size_t capacity) const noexcept;
+  size_t class_size(size_t size_class) const noexcept { return s_min_class_size << size_class; }
+
+  const size_t m_max_buffer_size;
+  const size_t m_max_free_per_class;
+
+  mutable std::mutex m_mutex;
+  std::vector<std::vector<std::vector<char>>> m_free; // Indexed by size class
+  Stats m_stats;
+};
+
+inline std::shared_ptr<ResponsePool>
+make_response_pool(size_t max_buffer_size = ResponsePool::s_default_max_buffer_size,
+                   size_t max_free_per_class = ResponsePool::s_default_max_free_per_class)
+{
+  return std::make_shared<ResponsePool>(max_buffer_size, max_free_per_class);
+}
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_RESPONSEPOOL_HPP_
@@ -14,6 +14,15 @@
  *
  * - Meaningfully implement the timeout feature in send_, and have it
  *   throw the SendTimeoutExpired exception if it occurs
+ * - Override send_zero_copy_ to hand caller-owned buffers to the transport
+ *   without the copy made by the default implementation
+ * - Override send_batch_ to pipeline many messages under a single deadline
+ *
+ * send_async needs nothing from the implementor: its queue and IO thread are
+ * kept by the Sender itself, and call send_ and send_zero_copy_ as the
+ * synchronous sends do. The IO thread has to be stopped while the
+ * implementation still exists, which the Senders from make_ipm_sender see to;
+ * one made any other way must be deleted through Sender::destroy.
  *
  * This is part of the DUNE DAQ Application Framework, copyright 2020.
  * Licensing/copyright details are in the COPYING file that you should have
@@ -23,13 +32,23 @@
 #ifndef IPM_INCLUDE_IPM_SENDER_HPP_
 #define IPM_INCLUDE_IPM_SENDER_HPP_
 
+#include "ipm/BufferPool.hpp"
+#include "ipm/EndpointInfo.hpp"
+
 #include "cetlib/BasicPluginFactory.h"
 #include "cetlib/compiler_macros.h"
 #include "ers/Issue.h"
 #include "nlohmann/json.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace dunedaq {
@@ -39,6 +58,15 @@ ERS_DECLARE_ISSUE(ipm,
                   SendTimeoutExpired,
                   "Unable to send within timeout period (timeout period was " << timeout << " milliseconds)",
                   ((int)timeout)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  MessageLargerThanBuffer,
+                  "Message of " << message_size << " bytes does not fit in a buffer of " << buffer_size << " bytes",
+                  ((int)message_size)((size_t)buffer_size)) // NOLINT
+ERS_DECLARE_ISSUE(ipm, AsyncSendAbandoned, "Asynchronous send abandoned, as its Sender was destroyed first", )
+ERS_DECLARE_ISSUE(ipm,
+                  CompletionCallbackFailed,
+                  "Completion callback of an asynchronous send threw: " << reason,
+                  ((std::string)reason)) // NOLINT
 
 } // namespace dunedaq
 
@@ -59,22 +87,37 @@ ERS_DECLARE_ISSUE(ipm,
 
 namespace dunedaq::ipm {
 
+class AsyncSendQueue;
+class Sender;
+
+inline std::shared_ptr<Sender>
+make_ipm_sender(std::string const& plugin_name);
+
 class Sender
 {
 
 public:
   using duration_t = std::chrono::milliseconds;
-  static constexpr duration_t s_block = std::chrono::duration_values<duration_t>::max();
-  static constexpr duration_t s_no_block = std::chrono::duration_values<duration_t>::zero();
+  static constexpr duration_t s_block = duration_t::max();
+  static constexpr duration_t s_no_block = duration_t::zero();
 
   using message_size_t = int;
 
-  Sender() = default;
+  Sender();
+  virtual ~Sender();
 
   virtual void connect_for_sends(const nlohmann::json& connection_info) = 0;
 
   virtual bool can_send() const noexcept = 0;
 
+  // The transport settings in effect once connected, as JSON keyed like the
+  // connection_info which sets them. Empty if the implementation has none to report.
+  virtual nlohmann::json effective_options() const { return nlohmann::json::object(); }
+
+  // Counters for monitoring (e.g. from a DAQModule's get_info), kept without
+  // locks by the send functions below
+  EndpointInfo get_info() const;
+
   // send() will perform some universally-desirable checks before calling user-implemented send_()
   // -Throws KnownStateForbidsSend if can_send() == false
   // -Throws NullPointerPassedToSend if message is a null pointer
@@ -85,11 +128,126 @@ public:
             const duration_t& timeout,
             std::string const& metadata = "");
 
+  // Called by the transport once it no longer needs a buffer passed to
+  // send_zero_copy(). hint is handed back untouched.
+  using release_fn_t = void (*)(void* message, void* hint);
+
+  // send_zero_copy() takes ownership of message: release(message, hint) is
+  // called exactly once when the transport is done with it, whether or not the
+  // send succeeds, and possibly from a transport-owned thread. Otherwise
+  // performs the same checks as send().
+
+  void send_zero_copy(void* message,
+                      message_size_t message_size,
+                      release_fn_t release,
+                      void* hint,
+                      const duration_t& timeout,
+                      std::string const& metadata = "");
+
+  // Sends the first message_size bytes of a pooled buffer without a copy. The
+  // buffer goes back to its pool once the transport is done with it.
+  // -Throws MessageLargerThanBuffer if message_size exceeds the buffer's size
+
+  void send(BufferPool::Buffer&& buffer,
+            message_size_t message_size,
+            const duration_t& timeout,
+            std::string const& metadata = "");
+
+  // send_multipart() sends all parts as one message where the implementation
+  // supports it, so that Receiver::receive_multipart() gets them back as
+  // separate parts and Receiver::receive() as one concatenated message. The
+  // default implementation sends each part as a separate message.
+  // -Throws NullPointerPassedToSend if any non-empty part is a null pointer
+
   void send_multipart(const void** message_parts,
                       const std::vector<message_size_t>& message_sizes,
                       const duration_t& timeout,
                       std::string const& metadata = "");
 
+  // One message of a batch passed to send_batch()
+  struct BatchEntry
+  {
+    const void* m_message{ nullptr };
+    message_size_t m_size{ 0 };
+    std::string_view m_metadata{};
+  };
+
+  // send_batch() sends the entries in order under one overall timeout and
+  // returns how many of them were accepted before it expired. All entries are
+  // validated before anything is sent:
+  // -Throws KnownStateForbidsSend if can_send() == false
+  // -Throws NullPointerPassedToSend if any non-empty entry has a null pointer
+  // -Entries with m_size == 0 are skipped (and count as accepted), as in send()
+
+  size_t send_batch(const BatchEntry* entries, size_t num_entries, const duration_t& timeout);
+
+  // For event loops, as Receiver::readiness_fd() and ready_to_receive(): a
+  // file descriptor which becomes readable whenever there may be room to send
+  // (or -1), and whether a send can be made without waiting
+  virtual int readiness_fd() const { return -1; }
+  virtual bool ready_to_send() { return true; }
+
+  // try_send() sends the message if it can without waiting, and otherwise
+  // returns false, without throwing SendTimeoutExpired or counting a timeout.
+  // It performs the same checks as send().
+
+  bool try_send(const void* message, message_size_t message_size, std::string const& metadata = "");
+
+  // Called once an asynchronous send is over, with a null error if the
+  // message was sent, and otherwise what went wrong (SendTimeoutExpired if it
+  // ran out of time). Runs on the Sender's IO thread, or on the caller's if
+  // the message never got into the queue, so should be quick.
+  using completion_fn_t = std::function<void(std::exception_ptr error)>;
+
+  // send_async() queues the message and returns at once, leaving the send to
+  // an IO thread belonging to this Sender, which makes the sends in order.
+  // The timeout runs from the call, so includes time spent in the queue; if
+  // the queue is full the call waits up to the timeout for room. Synchronous
+  // sends first wait for all asynchronous sends to complete, which comes out
+  // of their own timeout (try_send doesn't wait, but returns false).
+  // -Throws KnownStateForbidsSend if can_send() == false
+  // -Throws NullPointerPassedToSend if message is a null pointer
+  // -If message_size == 0, completes at once
+
+  // Queues a copy of the message
+  void send_async(const void* message,
+                  message_size_t message_size,
+                  const duration_t& timeout,
+                  std::string const& metadata,
+                  completion_fn_t on_complete);
+  std::future<void> send_async(const void* message,
+                               message_size_t message_size,
+                               const duration_t& timeout,
+                               std::string const& metadata = "");
+
+  // Queues the pooled buffer itself, which is sent without a copy
+  // -Throws MessageLargerThanBuffer if message_size exceeds the buffer's size
+  void send_async(BufferPool::Buffer&& buffer,
+                  message_size_t message_size,
+                  const duration_t& timeout,
+                  std::string const& metadata,
+                  completion_fn_t on_complete);
+  std::future<void> send_async(BufferPool::Buffer&& buffer,
+                               message_size_t message_size,
+                               const duration_t& timeout,
+                               std::string const& metadata = "");
+
+  // Asynchronous sends queued or under way (also reported by get_info)
+  size_t in_flight() const noexcept;
+
+  // Blocks until every asynchronous send made so far has completed
+  void wait_for_async_sends();
+
+  // How many asynchronous sends can be queued, rounded up to a power of two.
+  // Only has an effect before the first send_async().
+  static constexpr size_t s_default_async_queue_depth = 1024;
+  void set_async_queue_depth(size_t depth) { m_async_queue_depth = depth; }
+
+  // A deleter for Senders made other than by make_ipm_sender, which abandons
+  // asynchronous sends still queued, and waits for one under way, while the
+  // implementation they need still exists
+  static void destroy(Sender* sender);
+
   Sender(const Sender&) = delete;
   Sender& operator=(const Sender&) = delete;
 
@@ -98,6 +256,15 @@ public:
 
 protected:
   virtual void send_(const void* message, message_size_t N, const duration_t& timeout, std::string const& metadata) = 0;
+  // The default implementation sends a copy via send_, then releases the buffer
+  virtual void send_zero_copy_(void* message,
+                               message_size_t N,
+                               release_fn_t release,
+                               void* hint,
+                               const duration_t& timeout,
+                               std::string const& metadata);
+  // The default implementation calls send_ with whatever is left of the timeout
+  virtual size_t send_batch_(const BatchEntry* entries, size_t num_entries, const duration_t& timeout);
   virtual void send_multipart_(const void** message_parts,
                                const std::vector<message_size_t>& message_sizes,
                                const duration_t& timeout,
@@ -107,13 +274,51 @@ protected:
       send_(message_parts[i], message_sizes[i], timeout, metadata);
     }
   }
+
+  // Implementations record the waits in their send loops here (see WaitTimer)
+  EndpointCounters& counters() noexcept { return m_counters; }
+  // Messages queued inside the transport, for get_info; 0 if it can't tell
+  virtual size_t queue_depth_() const { return 0; }
+
+private:
+  friend class AsyncSendQueue;
+  friend std::shared_ptr<Sender> make_ipm_sender(std::string const& plugin_name);
+
+  // The synchronous sends, once any asynchronous ones have completed
+  void send_now(const void* message,
+                message_size_t message_size,
+                const duration_t& timeout,
+                std::string const& metadata);
+  void send_zero_copy_now(void* message,
+                          message_size_t message_size,
+                          release_fn_t release,
+                          void* hint,
+                          const duration_t& timeout,
+                          std::string const& metadata);
+  // Waits up to timeout for the asynchronous sends, and takes the time spent
+  // off it. Returns false if they were still under way when it ran out.
+  bool wait_for_async_sends_if_any(duration_t& timeout);
+  AsyncSendQueue& async_queue();
+  void stop_async_sends();
+
+  EndpointCounters m_counters;
+  size_t m_async_queue_depth{ s_default_async_queue_depth };
+  std::once_flag m_async_started;
+  std::unique_ptr<AsyncSendQueue> m_async_queue; // Made by the first send_async()...
+  std::atomic<AsyncSendQueue*> m_async{ nullptr }; // ...and published here for the other calls
 };
 
 inline std::shared_ptr<Sender>
 make_ipm_sender(std::string const& plugin_name)
 {
   static cet::BasicPluginFactory bpf("duneIPM", "make");
-  return bpf.makePlugin<std::shared_ptr<Sender>>(plugin_name);
+  auto plugin = bpf.makePlugin<std::shared_ptr<Sender>>(plugin_name);
+  // Whatever the plugin's own deleter, stop the IO thread before it runs
+  auto sender = plugin.get();
+  return std::shared_ptr<Sender>(sender, [plugin = std::move(plugin)](Sender* stopping) mutable {
+    stopping->stop_async_sends();
+    plugin.reset();
+  });
 }
 
 } // namespace dunedaq::ipm
@@ -0,0 +1,94 @@
+/**
+ * @file Serialization.hpp How TypedSender and TypedReceiver turn objects into messages and back
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_SERIALIZATION_HPP_
+#define IPM_INCLUDE_IPM_SERIALIZATION_HPP_
+
+#include "ers/Issue.h"
+#include "nlohmann/json.hpp"
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm,
+                  DeserializationFailed,
+                  "Unable to deserialize a message of " << size << " bytes: " << reason,
+                  ((size_t)size)((std::string)reason)) // NOLINT
+} // namespace dunedaq
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief Types sent as their own bytes: no serialization, and a received
+ * message is copied straight into the object. Both ends must agree on the
+ * type's layout and byte order.
+ */
+template<typename T>
+inline constexpr bool is_bitwise_message_v = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>;
+
+/**
+ * @brief Contiguous, resizable containers of bitwise types (std::vector and
+ * std::basic_string), sent from their data() without serialization.
+ * std::array of a bitwise type is itself bitwise.
+ */
+template<typename T>
+struct is_contiguous_message : std::false_type
+{};
+
+template<typename U, typename Allocator>
+struct is_contiguous_message<std::vector<U, Allocator>> : std::bool_constant<is_bitwise_message_v<U>>
+{};
+
+// std::vector<bool> packs its bits, so has no data()
+template<typename Allocator>
+struct is_contiguous_message<std::vector<bool, Allocator>> : std::false_type
+{};
+
+template<typename C, typename Traits, typename Allocator>
+struct is_contiguous_message<std::basic_string<C, Traits, Allocator>> : std::bool_constant<is_bitwise_message_v<C>>
+{};
+
+template<typename T>
+inline constexpr bool is_contiguous_message_v = is_contiguous_message<T>::value;
+
+/**
+ * @brief Turns any other type into bytes and back. Specialize it for a type
+ * to use a different format; by default, types which nlohmann::json can
+ * convert (through to_json/from_json functions) are sent as MessagePack.
+ */
+template<typename T, typename Enable = void>
+struct Serializer
+{
+  static_assert(std::is_constructible_v<nlohmann::json, const T&>,
+                "T is neither trivially copyable nor a contiguous container of trivially copyable elements: give it "
+                "nlohmann::json to_json/from_json functions, or specialize dunedaq::ipm::Serializer<T>");
+
+  // Replaces the contents of buffer, reusing its capacity
+  static void serialize(const T& value, std::vector<char>& buffer)
+  {
+    buffer.clear();
+    nlohmann::json::to_msgpack(nlohmann::json(value), buffer);
+  }
+
+  // @throws DeserializationFailed if the bytes aren't a valid T
+  static T deserialize(const char* data, size_t size)
+  {
+    try {
+      return nlohmann::json::from_msgpack(data, data + size).template get<T>();
+    } catch (nlohmann::json::exception const& err) {
+      throw DeserializationFailed(ERS_HERE, size, err.what());
+    }
+  }
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_SERIALIZATION_HPP_
@@ -0,0 +1,235 @@
+/**
+ * @file TypedReceiver.hpp Receives objects of one type through a Receiver
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_TYPEDRECEIVER_HPP_
+#define IPM_INCLUDE_IPM_TYPEDRECEIVER_HPP_
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Serialization.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief Elements of type U received without a copy, as returned by
+ * TypedReceiver::receive_view(). As with Receiver::ResponseView, the elements
+ * and metadata remain valid for as long as m_handle is alive.
+ */
+template<typename U>
+struct TypedView
+{
+  const U* m_data{ nullptr };
+  size_t m_count{ 0 };
+  std::string_view m_metadata{};
+  std::shared_ptr<const void> m_handle{};
+
+  const U* begin() const noexcept { return m_data; }
+  const U* end() const noexcept { return m_data + m_count; }
+  size_t size() const noexcept { return m_count; }
+  const U& operator[](size_t i) const noexcept { return m_data[i]; }
+};
+
+/**
+ * @brief Wraps a Receiver so that it returns objects of type T, the
+ * counterpart of TypedSender<T>. Bitwise types and contiguous containers of
+ * them are received straight into the object with Receiver::receive_into(),
+ * so a loop which keeps receiving into the same object makes no allocations
+ * once it is big enough; anything else is deserialized by Serializer<T>
+ * directly from the transport's buffer.
+ */
+template<typename T>
+class TypedReceiver
+{
+public:
+  explicit TypedReceiver(std::shared_ptr<Receiver> receiver)
+    : m_receiver(std::move(receiver))
+  {}
+
+  // -Throws ReceiveTimeoutExpired if nothing arrives in time
+  // -Throws UnexpectedNumberOfBytes if the message's size can't be that of a T
+  // -Throws DeserializationFailed if Serializer<T> can't make sense of it
+  T receive(const Receiver::duration_t& timeout, std::string* metadata = nullptr)
+  {
+    if constexpr (is_bitwise_message_v<T> || is_contiguous_message_v<T>) {
+      T value{};
+      if (!receive_into(value, timeout, metadata)) {
+        throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+      }
+      return value;
+    } else {
+      auto view = m_receiver->receive_view(timeout);
+      if (metadata) {
+        metadata->assign(view.m_metadata);
+      }
+      return Serializer<T>::deserialize(view.m_data, view.m_size);
+    }
+  }
+
+  // As receive(), but into an existing object, reusing its storage. Returns
+  // false if nothing arrives in time.
+  bool receive_into(T& value, const Receiver::duration_t& timeout, std::string* metadata = nullptr)
+  {
+    if constexpr (is_bitwise_message_v<T>) {
+      auto result = m_receiver->receive_into(&value, sizeof(T), timeout, metadata);
+      if (result.m_buffer_too_small) {
+        discard(result.m_size, sizeof(T));
+      }
+      if (result.m_timed_out) {
+        return false;
+      }
+      check_size(result.m_size, sizeof(T), sizeof(T));
+      return true;
+    } else if constexpr (is_contiguous_message_v<T>) {
+      using element_t = typename T::value_type;
+      auto result = m_receiver->receive_into(value.data(), value.size() * sizeof(element_t), timeout, metadata);
+      if (result.m_buffer_too_small) {
+        // The message is kept for the next call, which can't then wait
+        if (result.m_size % sizeof(element_t) != 0) {
+          discard(result.m_size, (result.m_size / sizeof(element_t)) * sizeof(element_t));
+        }
+        value.resize(result.m_size / sizeof(element_t));
+        result = m_receiver->receive_into(
+          value.data(), value.size() * sizeof(element_t), Receiver::s_no_block, metadata);
+      }
+      if (result.m_timed_out) {
+        return false;
+      }
+      check_size(result.m_size, sizeof(element_t), (result.m_size / sizeof(element_t)) * sizeof(element_t));
+      value.resize(result.m_size / sizeof(element_t));
+      return true;
+    } else {
+      try {
+        value = receive(timeout, metadata);
+      } catch (ReceiveTimeoutExpired const&) {
+        return false;
+      }
+      return true;
+    }
+  }
+
+  /**
+   * @brief Receive without copying, for bitwise types (one element) and
+   * contiguous containers (their elements). The elements are read in place
+   * from the transport's buffer where it is suitably aligned for them;
+   * otherwise they are copied once into aligned memory.
+   * -Throws as receive()
+   */
+  template<typename U = T>
+  auto receive_view(const Receiver::duration_t& timeout)
+  {
+    static_assert(is_bitwise_message_v<U> || is_contiguous_message_v<U>,
+                  "receive_view() needs a bitwise type or a contiguous container of them");
+    using element_t = typename element_of<U>::type;
+
+    auto view = m_receiver->receive_view(timeout);
+    if constexpr (is_bitwise_message_v<U>) {
+      check_size(view.m_size, sizeof(U), sizeof(U));
+    } else {
+      check_size(view.m_size, sizeof(element_t), (view.m_size / sizeof(element_t)) * sizeof(element_t));
+    }
+
+    TypedView<element_t> typed;
+    typed.m_count = view.m_size / sizeof(element_t);
+    typed.m_metadata = view.m_metadata;
+    if (reinterpret_cast<uintptr_t>(view.m_data) % alignof(element_t) == 0) {
+      typed.m_data = reinterpret_cast<const element_t*>(view.m_data);
+      typed.m_handle = std::move(view.m_handle);
+    } else {
+      // Keeps the original alive too, as the metadata still refers to it
+      auto aligned = std::make_shared<std::pair<std::shared_ptr<const void>, std::vector<element_t>>>(
+        std::move(view.m_handle), std::vector<element_t>(typed.m_count));
+      memcpy(aligned->second.data(), view.m_data, view.m_size);
+      typed.m_data = aligned->second.data();
+      typed.m_handle = std::move(aligned);
+    }
+    return typed;
+  }
+
+  /**
+   * @brief Dispatch mode (see Receiver::start_dispatch): handler is called
+   * with each message as a T, on the receiver's dispatch threads. Messages
+   * which can't be a T are reported as DispatchFailed, with the reason.
+   */
+  void start_dispatch(std::function<void(T& value)> handler,
+                      size_t num_threads = Receiver::s_default_dispatch_threads)
+  {
+    m_receiver->start_dispatch(
+      [handler = std::move(handler)](Receiver::Response& message) {
+        T value = from_message(message.m_data.data(), message.m_data.size());
+        handler(value);
+      },
+      num_threads);
+  }
+  void stop_dispatch() { m_receiver->stop_dispatch(); }
+
+  Receiver& receiver() const noexcept { return *m_receiver; }
+  bool can_receive() const noexcept { return m_receiver->can_receive(); }
+
+private:
+  template<typename U, typename Enable = void>
+  struct element_of
+  {
+    using type = U;
+  };
+  template<typename U>
+  struct element_of<U, std::enable_if_t<is_contiguous_message_v<U>>>
+  {
+    using type = typename U::value_type;
+  };
+
+  static T from_message(const char* data, size_t size)
+  {
+    if constexpr (is_bitwise_message_v<T>) {
+      check_size(size, sizeof(T), sizeof(T));
+      T value{};
+      memcpy(&value, data, size);
+      return value;
+    } else if constexpr (is_contiguous_message_v<T>) {
+      using element_t = typename T::value_type;
+      check_size(size, sizeof(element_t), (size / sizeof(element_t)) * sizeof(element_t));
+      T value(size / sizeof(element_t), element_t{});
+      if (size > 0) {
+        memcpy(value.data(), data, size);
+      }
+      return value;
+    } else {
+      return Serializer<T>::deserialize(data, size);
+    }
+  }
+
+  // The size has to be a multiple of unit, and equal to expected
+  static void check_size(size_t size, size_t unit, size_t expected)
+  {
+    if (size % unit != 0 || size != expected) {
+      throw UnexpectedNumberOfBytes(ERS_HERE, static_cast<int>(expected), static_cast<int>(size));
+    }
+  }
+
+  // Takes a message which can't be a T off the receiver, so that it doesn't
+  // block the ones behind it, and reports it
+  [[noreturn]] void discard(size_t size, size_t expected)
+  {
+    std::vector<char> scratch(size);
+    m_receiver->receive_into(scratch.data(), scratch.size(), Receiver::s_no_block);
+    throw UnexpectedNumberOfBytes(ERS_HERE, static_cast<int>(expected), static_cast<int>(size));
+  }
+
+  std::shared_ptr<Receiver> m_receiver;
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_TYPEDRECEIVER_HPP_
@@ -0,0 +1,61 @@
+/**
+ * @file TypedSender.hpp Sends objects of one type through a Sender
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_INCLUDE_IPM_TYPEDSENDER_HPP_
+#define IPM_INCLUDE_IPM_TYPEDSENDER_HPP_
+
+#include "ipm/Sender.hpp"
+#include "ipm/Serialization.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief Wraps a Sender so that it takes objects of type T rather than
+ * pointers and byte counts. How each object goes out is chosen at compile
+ * time (see Serialization.hpp): bitwise types and contiguous containers of
+ * them are sent straight from the object's memory, and anything else goes
+ * through Serializer<T> into a buffer which is reused from send to send.
+ *
+ * Like Sender::send, sending an empty container does nothing.
+ */
+template<typename T>
+class TypedSender
+{
+public:
+  explicit TypedSender(std::shared_ptr<Sender> sender)
+    : m_sender(std::move(sender))
+  {}
+
+  void send(const T& value, const Sender::duration_t& timeout, std::string const& metadata = "")
+  {
+    if constexpr (is_bitwise_message_v<T>) {
+      m_sender->send(&value, sizeof(T), timeout, metadata);
+    } else if constexpr (is_contiguous_message_v<T>) {
+      m_sender->send(value.data(), value.size() * sizeof(typename T::value_type), timeout, metadata);
+    } else {
+      Serializer<T>::serialize(value, m_buffer);
+      m_sender->send(m_buffer.data(), m_buffer.size(), timeout, metadata);
+    }
+  }
+
+  Sender& sender() const noexcept { return *m_sender; }
+  bool can_send() const noexcept { return m_sender->can_send(); }
+
+private:
+  std::shared_ptr<Sender> m_sender;
+  std::vector<char> m_buffer; // Serialized messages, for types which need it
+};
+
+} // namespace dunedaq::ipm
+
+#endif // IPM_INCLUDE_IPM_TYPEDSENDER_HPP_
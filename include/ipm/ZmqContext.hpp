@@ -3,31 +3,90 @@
 
 /**
  *
- * @file ZmqContext.hpp ZmqContext Singleton class for hosting 0MQ context
+ * @file ZmqContext.hpp ZmqContext Singleton class for hosting 0MQ contexts
+ *
+ * By default every ZeroMQ socket in the process shares one context with a
+ * single IO thread. Sockets can be placed on separate named contexts (via the
+ * "zmq_context" key of their connection_info), each with its own IO threads,
+ * so that e.g. bulk data and control traffic don't compete for the same one.
  *
  * This is part of the DUNE DAQ Application Framework, copyright 2020.
  * Licensing/copyright details are in the COPYING file that you should have
  * received with this code.
  */
 
+#include "ers/Issue.h"
+#include "nlohmann/json.hpp"
 #include "zmq.hpp"
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm,
+                  ZmqContextInUse,
+                  "ZeroMQ context \"" << name << "\" already has sockets, so its settings can no longer be changed",
+                  ((std::string)name)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  ZmqContextConfigurationFailed,
+                  "Unable to apply " << setting << " to ZeroMQ context \"" << name << "\": " << reason,
+                  ((std::string)name)((std::string)setting)((std::string)reason)) // NOLINT
+} // namespace dunedaq
+
 namespace dunedaq::ipm {
 class ZmqContext
 {
 public:
-  static ZmqContext& instance()
-  {
-    static ZmqContext s_ctx;
-    return s_ctx;
-  }
+  static constexpr const char* s_default_name = "default";
+
+  static ZmqContext& instance();
+
+  zmq::context_t& GetContext() { return GetContext(s_default_name); }
 
-  zmq::context_t& GetContext() { return m_context; }
+  /**
+   * @brief Get the named context, creating it with ZeroMQ's defaults if it
+   * hasn't been configured. Its settings are fixed from then on.
+   */
+  zmq::context_t& GetContext(const std::string& name);
+
+  /**
+   * @brief Set up the named context before any socket uses it. Recognised
+   * keys are "io_threads" (ZMQ_IO_THREADS), "max_sockets" (ZMQ_MAX_SOCKETS),
+   * "cpu_affinity" (a list of CPUs for the IO threads),
+   * "thread_sched_policy" and "thread_priority"; any other key, or a value
+   * of the wrong type, throws ZmqContextConfigurationFailed.
+   *
+   * Until a socket uses the context, configuring it again replaces the
+   * earlier settings outright. Once it is in use, configuring it is allowed
+   * only with identical settings, so that every socket sharing it can carry
+   * the same configuration; anything else throws ZmqContextInUse.
+   */
+  void configure(const std::string& name, const nlohmann::json& config);
+
+  /**
+   * @brief The context for a socket with the given connection_info. Its
+   * optional "zmq_context" key is either a context name, or an object with a
+   * "name" and the settings accepted by configure.
+   */
+  zmq::context_t& context_for(const nlohmann::json& connection_info);
 
 private:
+  struct Entry
+  {
+    zmq::context_t m_context;
+    nlohmann::json m_config = nlohmann::json::object();
+    bool m_in_use{ false };
+  };
+
   ZmqContext() {}
-  ~ZmqContext() { m_context.close(); }
-  zmq::context_t m_context;
+  ~ZmqContext();
+
+  Entry& entry(const std::string& name); // Requires m_mutex
+
+  std::mutex m_mutex;
+  std::map<std::string, std::unique_ptr<Entry>> m_contexts;
 
   ZmqContext(ZmqContext const&) = delete;
   ZmqContext(ZmqContext&&) = delete;
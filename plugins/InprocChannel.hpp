@@ -0,0 +1,325 @@
+/**
+ *
+ * @file InprocChannel.hpp Bounded in-process message queues shared by name
+ *
+ * An InprocChannel carries messages between InprocSenders and InprocReceivers
+ * in the same process. Messages own their payload, either as a copy made by
+ * Sender::send or as the caller's own buffer handed over by
+ * Sender::send_zero_copy, so moving one through the channel moves a few
+ * pointers and never the payload itself.
+ *
+ * The messages go through a BoundedQueue, so neither side takes a lock while
+ * the other keeps up; a side that finds the queue empty or full sleeps on a
+ * condition variable, and the other side only takes the mutex to notify it
+ * when it sees a waiter.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_INPROCCHANNEL_HPP_
+#define IPM_PLUGINS_INPROCCHANNEL_HPP_
+
+#include "ipm/BoundedQueue.hpp"
+#include "ipm/Sender.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+// One message in flight. The payload is either m_owned, or a buffer which
+// belongs to the sender until m_release is called on it.
+class InprocMessage
+{
+public:
+  InprocMessage() = default;
+  ~InprocMessage() { reset(); }
+
+  InprocMessage(InprocMessage&& other) noexcept { *this = std::move(other); }
+  InprocMessage& operator=(InprocMessage&& other) noexcept
+  {
+    if (this != &other) {
+      reset();
+      m_metadata = std::move(other.m_metadata);
+      m_owned = std::move(other.m_owned);
+      m_external = other.m_external;
+      m_external_size = other.m_external_size;
+      m_release = other.m_release;
+      m_hint = other.m_hint;
+      other.m_external = nullptr;
+      other.m_release = nullptr;
+    }
+    return *this;
+  }
+
+  InprocMessage(const InprocMessage&) = delete;
+  InprocMessage& operator=(const InprocMessage&) = delete;
+
+  void set_owned(std::vector<char>&& data)
+  {
+    reset();
+    m_owned = std::move(data);
+  }
+
+  void set_external(void* data, size_t size, Sender::release_fn_t release, void* hint)
+  {
+    reset();
+    m_external = data;
+    m_external_size = size;
+    m_release = release;
+    m_hint = hint;
+  }
+
+  const char* data() const noexcept { return m_external ? static_cast<const char*>(m_external) : m_owned.data(); }
+  size_t size() const noexcept { return m_external ? m_external_size : m_owned.size(); }
+
+  // Hands the payload over as a vector, copying only if it was a sender's own buffer
+  std::vector<char> take_data()
+  {
+    if (!m_external) {
+      return std::move(m_owned);
+    }
+    std::vector<char> copy(data(), data() + size());
+    reset();
+    return copy;
+  }
+
+  // Returns an external buffer to its sender and drops any owned payload
+  void reset() noexcept
+  {
+    if (m_external && m_release) {
+      m_release(m_external, m_hint);
+    }
+    m_external = nullptr;
+    m_release = nullptr;
+    m_owned = std::vector<char>();
+  }
+
+  std::string m_metadata;
+
+private:
+  std::vector<char> m_owned;
+  void* m_external{ nullptr };
+  size_t m_external_size{ 0 };
+  Sender::release_fn_t m_release{ nullptr };
+  void* m_hint{ nullptr };
+};
+
+class InprocChannel
+{
+public:
+  static constexpr size_t s_default_capacity = 1000; // Same as ZeroMQ's default high-water mark
+
+  explicit InprocChannel(size_t capacity)
+    : m_queue(capacity)
+  {}
+
+  InprocChannel(const InprocChannel&) = delete;
+  InprocChannel& operator=(const InprocChannel&) = delete;
+  InprocChannel(InprocChannel&&) = delete;
+  InprocChannel& operator=(InprocChannel&&) = delete;
+
+  size_t capacity() const noexcept { return m_queue.capacity(); }
+
+  // Messages in the channel; only a snapshot while others are using it
+  size_t size() const noexcept { return std::min(m_queue.size(), m_queue.capacity()); }
+
+  /**
+   * @brief Move message into the channel, waiting for room until start_time + timeout
+   * @param counters If not null, each wait is recorded there
+   * @return false if the channel stayed full; message is left untouched then
+   */
+  template<typename Duration>
+  bool push(InprocMessage& message,
+            std::chrono::steady_clock::time_point start_time,
+            const Duration& timeout,
+            EndpointCounters* counters = nullptr)
+  {
+    while (!m_queue.try_push(message)) {
+      WaitTimer timer(counters);
+      if (!m_not_full.wait([this]() { return m_queue.can_push(); }, start_time, timeout)) {
+        return false;
+      }
+    }
+    m_not_empty.notify();
+    return true;
+  }
+
+  /**
+   * @brief Move the oldest message out of the channel, waiting for one until start_time + timeout
+   * @param counters If not null, each wait is recorded there
+   * @return false if the channel stayed empty
+   */
+  template<typename Duration>
+  bool pop(InprocMessage& message,
+           std::chrono::steady_clock::time_point start_time,
+           const Duration& timeout,
+           EndpointCounters* counters = nullptr)
+  {
+    while (!m_queue.try_pop(message)) {
+      WaitTimer timer(counters);
+      if (!m_not_empty.wait([this]() { return m_queue.can_pop(); }, start_time, timeout)) {
+        return false;
+      }
+    }
+    m_not_full.notify();
+    return true;
+  }
+
+private:
+  // Sleeping side of one direction of the channel. The notifying side only
+  // touches the mutex when a waiter has announced itself in m_num_waiting.
+  class Waiters
+  {
+  public:
+    void notify()
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (m_num_waiting.load(std::memory_order_relaxed) != 0) {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_condition.notify_all();
+      }
+    }
+
+    // Returns false once the deadline has passed without ready() becoming true
+    template<typename Ready, typename Duration>
+    bool wait(Ready ready, std::chrono::steady_clock::time_point start_time, const Duration& timeout)
+    {
+      if (timeout != Duration::max() && std::chrono::steady_clock::now() - start_time >= timeout) {
+        return false;
+      }
+      if (spin_until(ready)) {
+        return true;
+      }
+
+      std::unique_lock<std::mutex> lk(m_mutex);
+      m_num_waiting.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      bool is_ready = true;
+      if (timeout == Duration::max()) {
+        m_condition.wait(lk, ready);
+      } else {
+        is_ready = m_condition.wait_until(lk, start_time + timeout, ready);
+      }
+      m_num_waiting.fetch_sub(1, std::memory_order_relaxed);
+      return is_ready;
+    }
+
+  private:
+    // A peer which is keeping up usually makes progress within a few
+    // microseconds. On a single CPU spinning would only hold the peer up.
+    template<typename Ready>
+    static bool spin_until(Ready ready)
+    {
+      static const int spin_iterations = std::thread::hardware_concurrency() > 1 ? 1000 : 0;
+      for (int i = 0; i < spin_iterations; ++i) {
+        if (ready()) {
+          return true;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+      }
+      return false;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<int> m_num_waiting{ 0 };
+  };
+
+  BoundedQueue<InprocMessage> m_queue;
+  alignas(64) Waiters m_not_empty;
+  Waiters m_not_full;
+};
+
+/**
+ * @brief Process-wide table of channels by endpoint name. Like ZmqContext, the
+ * instance is shared by every plugin library loaded into the process.
+ */
+class InprocEndpoints
+{
+public:
+  static InprocEndpoints& instance()
+  {
+    static InprocEndpoints s_endpoints;
+    return s_endpoints;
+  }
+
+  /**
+   * @brief The channel for connection_info's "inproc://<name>" connection
+   * string, created with the optional "capacity" (in messages) if no sender or
+   * receiver currently holds it. The name is forgotten again once the last
+   * sender or receiver holding the channel lets go of it.
+   */
+  std::shared_ptr<InprocChannel> get(const nlohmann::json& connection_info)
+  {
+    auto name = connection_info.value<std::string>("connection_string", "inproc://default");
+    auto capacity = connection_info.value<size_t>("capacity", InprocChannel::s_default_capacity);
+
+    std::lock_guard<std::mutex> lk(m_table->m_mutex);
+    auto& entry = m_table->m_channels[name];
+    auto channel = entry.lock();
+    if (!channel) {
+      // The deleter only holds the table weakly, in case it outlives the instance
+      std::weak_ptr<Table> table = m_table;
+      channel = std::shared_ptr<InprocChannel>(new InprocChannel(capacity), [table, name](InprocChannel* released) {
+        delete released; // NOLINT
+        forget(table, name);
+      });
+      entry = channel;
+    }
+    return channel;
+  }
+
+private:
+  struct Table
+  {
+    std::mutex m_mutex;
+    std::map<std::string, std::weak_ptr<InprocChannel>> m_channels;
+  };
+
+  InprocEndpoints() = default;
+
+  // Another channel may have been made under the name meanwhile, which stays
+  static void forget(std::weak_ptr<Table> const& weak_table, std::string const& name)
+  {
+    auto table = weak_table.lock();
+    if (!table) {
+      return;
+    }
+    std::lock_guard<std::mutex> lk(table->m_mutex);
+    auto it = table->m_channels.find(name);
+    if (it != table->m_channels.end() && it->second.expired()) {
+      table->m_channels.erase(it);
+    }
+  }
+
+  InprocEndpoints(InprocEndpoints const&) = delete;
+  InprocEndpoints(InprocEndpoints&&) = delete;
+  InprocEndpoints& operator=(InprocEndpoints const&) = delete;
+  InprocEndpoints& operator=(InprocEndpoints&&) = delete;
+
+  std::shared_ptr<Table> m_table = std::make_shared<Table>();
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_INPROCCHANNEL_HPP_
@@ -0,0 +1,112 @@
+/**
+ *
+ * @file InprocReceiver.cpp InprocReceiver messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "InprocChannel.hpp"
+
+#include "ipm/Receiver.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "InprocReceiver"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace dunedaq {
+namespace ipm {
+
+class InprocReceiver : public Receiver
+{
+public:
+  bool can_receive() const noexcept override { return m_channel != nullptr; }
+  void connect_for_receives(const nlohmann::json& connection_info) override
+  {
+    TLOG(TLVL_INFO) << "Connection String is "
+                    << connection_info.value<std::string>("connection_string", "inproc://default");
+    m_channel = InprocEndpoints::instance().get(connection_info);
+  }
+
+protected:
+  // A payload copied by Sender::send is moved into the Response as it is
+  Receiver::Response receive_(const duration_t& timeout) override
+  {
+    InprocMessage msg;
+    pop(msg, timeout);
+
+    Receiver::Response output;
+    output.m_metadata = std::move(msg.m_metadata);
+    output.m_data = msg.take_data();
+    TLOG(TLVL_TRACE + 2) << "Received " << output.m_data.size() << " bytes";
+    return output;
+  }
+
+  // The view refers to the sender's buffer (or the copy made by send) directly
+  Receiver::ResponseView receive_view_(const duration_t& timeout) override
+  {
+    auto msg = std::make_shared<InprocMessage>();
+    pop(*msg, timeout);
+    return view_of(std::move(msg));
+  }
+
+  Receiver::ReceiveIntoResult receive_into_(void* buffer,
+                                            message_size_t buffer_size,
+                                            const duration_t& timeout,
+                                            std::string* metadata) override
+  {
+    Receiver::ReceiveIntoResult result;
+    InprocMessage msg;
+    if (!m_channel->pop(msg, std::chrono::steady_clock::now(), timeout, &counters())) {
+      result.m_timed_out = true;
+      return result;
+    }
+
+    result.m_size = static_cast<message_size_t>(msg.size());
+    if (result.m_size > buffer_size) {
+      result.m_buffer_too_small = true;
+      keep_for_next_receive(view_of(std::make_shared<InprocMessage>(std::move(msg))));
+      return result;
+    }
+    if (result.m_size > 0) {
+      memcpy(buffer, msg.data(), msg.size());
+    }
+    if (metadata) {
+      metadata->assign(msg.m_metadata);
+    }
+    return result;
+  }
+
+  size_t queue_depth_() const override { return m_channel ? m_channel->size() : 0; }
+
+private:
+  static Receiver::ResponseView view_of(std::shared_ptr<InprocMessage> msg)
+  {
+    Receiver::ResponseView view;
+    view.m_metadata = msg->m_metadata;
+    view.m_data = msg->data();
+    view.m_size = msg->size();
+    view.m_handle = std::move(msg);
+    return view;
+  }
+
+  void pop(InprocMessage& msg, const duration_t& timeout)
+  {
+    if (!m_channel->pop(msg, std::chrono::steady_clock::now(), timeout, &counters())) {
+      throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+    }
+  }
+
+  std::shared_ptr<InprocChannel> m_channel;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_RECEIVER(dunedaq::ipm::InprocReceiver)
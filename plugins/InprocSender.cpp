@@ -0,0 +1,109 @@
+/**
+ *
+ * @file InprocSender.cpp InprocSender messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "InprocChannel.hpp"
+
+#include "ipm/Sender.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "InprocSender"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+class InprocSender : public Sender
+{
+public:
+  bool can_send() const noexcept override { return m_channel != nullptr; }
+  void connect_for_sends(const nlohmann::json& connection_info) override
+  {
+    TLOG(TLVL_INFO) << "Connection String is "
+                    << connection_info.value<std::string>("connection_string", "inproc://default");
+    m_channel = InprocEndpoints::instance().get(connection_info);
+  }
+
+protected:
+  void send_(const void* message, int N, const duration_t& timeout, std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting send of " << N << " bytes";
+    auto data = static_cast<const char*>(message);
+    InprocMessage msg;
+    msg.m_metadata = topic;
+    msg.set_owned(std::vector<char>(data, data + N));
+    push(msg, timeout);
+    TLOG(TLVL_TRACE + 2) << "Completed send of " << N << " bytes";
+  }
+
+  // The buffer itself travels to the receiver, which releases it once done with it
+  void send_zero_copy_(void* message,
+                       int N,
+                       release_fn_t release,
+                       void* hint,
+                       const duration_t& timeout,
+                       std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting zero-copy send of " << N << " bytes";
+    InprocMessage msg;
+    msg.m_metadata = topic;
+    msg.set_external(message, N, release, hint);
+    push(msg, timeout);
+    TLOG(TLVL_TRACE + 2) << "Completed zero-copy send of " << N << " bytes";
+  }
+
+  // The parts are concatenated into one message
+  void send_multipart_(const void** message_parts,
+                       const std::vector<int>& message_sizes,
+                       const duration_t& timeout,
+                       std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting multipart send of " << message_sizes.size() << " parts";
+    size_t total_size = 0;
+    for (auto size : message_sizes) {
+      total_size += size;
+    }
+    std::vector<char> data(total_size);
+    char* dest = data.data();
+    for (size_t i = 0; i < message_sizes.size(); ++i) {
+      if (message_sizes[i] > 0) {
+        memcpy(dest, message_parts[i], message_sizes[i]);
+        dest += message_sizes[i];
+      }
+    }
+
+    InprocMessage msg;
+    msg.m_metadata = topic;
+    msg.set_owned(std::move(data));
+    push(msg, timeout);
+    TLOG(TLVL_TRACE + 2) << "Completed multipart send of " << message_sizes.size() << " parts";
+  }
+
+  size_t queue_depth_() const override { return m_channel ? m_channel->size() : 0; }
+
+private:
+  void push(InprocMessage& msg, const duration_t& timeout)
+  {
+    if (!m_channel->push(msg, std::chrono::steady_clock::now(), timeout, &counters())) {
+      throw SendTimeoutExpired(ERS_HERE, timeout.count());
+    }
+  }
+
+  std::shared_ptr<InprocChannel> m_channel;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_SENDER(dunedaq::ipm::InprocSender)
@@ -0,0 +1,291 @@
+/**
+ *
+ * @file IoUring.hpp A minimal io_uring wrapper for the Uring plugins
+ *
+ * The rings are driven through the raw system calls, so that the plugins
+ * don't depend on liburing. Where the kernel headers are too old to describe
+ * multishot receive and provided-buffer rings, IPM_HAVE_IO_URING is 0 and the
+ * plugins only use their epoll fallback.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_IOURING_HPP_
+#define IPM_PLUGINS_IOURING_HPP_
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_FEAT_EXT_ARG)
+#define IPM_HAVE_IO_URING 1
+#else
+#define IPM_HAVE_IO_URING 0
+#endif
+
+#if IPM_HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace dunedaq {
+namespace ipm {
+
+class IoUring
+{
+public:
+  IoUring() = default;
+  ~IoUring()
+  {
+    if (m_sqes != nullptr) {
+      munmap(m_sqes, m_sqes_size);
+    }
+    if (m_ring != nullptr) {
+      munmap(m_ring, m_ring_size);
+    }
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+  IoUring(IoUring&&) = delete;
+  IoUring& operator=(IoUring&&) = delete;
+
+  /**
+   * @brief Create the ring
+   * @return false (with errno set) if the kernel doesn't provide io_uring, or
+   * lacks the features the plugins rely on
+   */
+  bool init(unsigned entries)
+  {
+    io_uring_params params{};
+    m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (m_fd < 0) {
+      return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+      errno = ENOSYS;
+      return false;
+    }
+
+    m_ring_size = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                           params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    m_ring = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    if (m_ring == MAP_FAILED) {
+      m_ring = nullptr;
+      return false;
+    }
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return false;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto* base = static_cast<char*>(m_ring);
+    m_sq_head = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    m_sq_entries = params.sq_entries;
+    m_cq_head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // Submission slot i always refers to SQE i
+    auto* array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < m_sq_entries; ++i) {
+      array[i] = i;
+    }
+    m_sqe_tail = *m_sq_tail;
+    return true;
+  }
+
+  int fd() const noexcept { return m_fd; }
+
+  // A zeroed SQE to fill in, or nullptr if the submission queue is full
+  io_uring_sqe* get_sqe() noexcept
+  {
+    if (m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries) {
+      return nullptr;
+    }
+    io_uring_sqe* sqe = &m_sqes[m_sqe_tail & m_sq_mask];
+    ++m_sqe_tail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+  }
+
+  /**
+   * @brief Submit every SQE filled in since the last call, in one system call,
+   * and wait for at least wait_nr completions
+   * @param timeout If not null, stop waiting after this long
+   * @return The number of SQEs submitted, or -errno (-ETIME on timeout)
+   */
+  int submit_and_wait(unsigned wait_nr, const timespec* timeout = nullptr) noexcept
+  {
+    __atomic_store_n(m_sq_tail, m_sqe_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = m_sqe_tail - m_sqe_submitted;
+
+    io_uring_getevents_arg arg{};
+    unsigned flags = 0;
+    if (wait_nr > 0) {
+      flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (timeout != nullptr) {
+      arg.ts = reinterpret_cast<uint64_t>(timeout);
+      flags |= IORING_ENTER_EXT_ARG;
+    }
+    for (;;) {
+      long result = syscall(__NR_io_uring_enter,
+                            m_fd,
+                            to_submit,
+                            wait_nr,
+                            flags,
+                            timeout != nullptr ? static_cast<void*>(&arg) : nullptr,
+                            timeout != nullptr ? sizeof(arg) : _NSIG / 8);
+      if (result >= 0) {
+        m_sqe_submitted += static_cast<unsigned>(result);
+        return static_cast<int>(result);
+      }
+      if (errno != EINTR) {
+        return -errno;
+      }
+    }
+  }
+
+  // Calls f(const io_uring_cqe&) for each completion available, and returns how many there were
+  template<typename F>
+  unsigned for_each_cqe(F&& f)
+  {
+    unsigned head = *m_cq_head;
+    unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    for (; head != tail; ++head, ++count) {
+      f(m_cqes[head & m_cq_mask]);
+    }
+    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+    return count;
+  }
+
+  int register_buffer_ring(io_uring_buf_reg& reg) noexcept
+  {
+    long result = syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+    return result < 0 ? -errno : 0;
+  }
+
+private:
+  int m_fd{ -1 };
+  void* m_ring{ nullptr };
+  size_t m_ring_size{ 0 };
+  io_uring_sqe* m_sqes{ nullptr };
+  size_t m_sqes_size{ 0 };
+
+  unsigned* m_sq_head{ nullptr };
+  unsigned* m_sq_tail{ nullptr };
+  unsigned m_sq_mask{ 0 };
+  unsigned m_sq_entries{ 0 };
+  unsigned m_sqe_tail{ 0 };      // SQEs handed out by get_sqe
+  unsigned m_sqe_submitted{ 0 }; // SQEs the kernel has consumed
+
+  unsigned* m_cq_head{ nullptr };
+  unsigned* m_cq_tail{ nullptr };
+  unsigned m_cq_mask{ 0 };
+  io_uring_cqe* m_cqes{ nullptr };
+};
+
+/**
+ * @brief A ring of equally-sized receive buffers which the kernel picks from
+ * when a recv completes (IORING_REGISTER_PBUF_RING), so that any number of
+ * connections can share one pool of registered memory
+ */
+class ProvidedBufferRing
+{
+public:
+  ProvidedBufferRing(unsigned num_buffers, size_t buffer_size)
+    : m_num_buffers(num_buffers)
+    , m_buffer_size(buffer_size)
+  {}
+
+  ~ProvidedBufferRing()
+  {
+    if (m_ring != nullptr) {
+      munmap(m_ring, m_num_buffers * sizeof(io_uring_buf));
+    }
+    if (m_buffers != nullptr) {
+      munmap(m_buffers, m_num_buffers * m_buffer_size);
+    }
+  }
+
+  ProvidedBufferRing(const ProvidedBufferRing&) = delete;
+  ProvidedBufferRing& operator=(const ProvidedBufferRing&) = delete;
+
+  // num_buffers must be a power of two
+  bool register_with(IoUring& ring, uint16_t group_id)
+  {
+    void* entries = mmap(nullptr,
+                         m_num_buffers * sizeof(io_uring_buf),
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                         -1,
+                         0);
+    void* buffers =
+      mmap(nullptr, m_num_buffers * m_buffer_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (entries == MAP_FAILED || buffers == MAP_FAILED) {
+      return false;
+    }
+    m_ring = static_cast<io_uring_buf_ring*>(entries);
+    m_buffers = static_cast<char*>(buffers);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(m_ring);
+    reg.ring_entries = m_num_buffers;
+    reg.bgid = group_id;
+    if (ring.register_buffer_ring(reg) != 0) {
+      return false;
+    }
+    for (unsigned id = 0; id < m_num_buffers; ++id) {
+      give_back(static_cast<uint16_t>(id));
+    }
+    return true;
+  }
+
+  const char* buffer(uint16_t id) const noexcept { return m_buffers + id * m_buffer_size; }
+
+  // Hand a buffer back to the kernel once its contents have been consumed
+  void give_back(uint16_t id) noexcept
+  {
+    // Not m_ring->bufs: in C++ the kernel header's flexible array member lands
+    // 8 bytes into the ring rather than overlaying its tail
+    io_uring_buf& entry = reinterpret_cast<io_uring_buf*>(m_ring)[m_tail & (m_num_buffers - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(m_buffers + id * m_buffer_size);
+    entry.len = static_cast<uint32_t>(m_buffer_size);
+    entry.bid = id;
+    ++m_tail;
+    __atomic_store_n(&m_ring->tail, m_tail, __ATOMIC_RELEASE);
+  }
+
+private:
+  unsigned m_num_buffers;
+  size_t m_buffer_size;
+  io_uring_buf_ring* m_ring{ nullptr };
+  char* m_buffers{ nullptr };
+  uint16_t m_tail{ 0 };
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_HAVE_IO_URING
+
+#endif // IPM_PLUGINS_IOURING_HPP_
@@ -0,0 +1,109 @@
+/**
+ *
+ * @file ShmReceiver.cpp ShmReceiver messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ShmRing.hpp"
+
+#include "ipm/Receiver.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "ShmReceiver"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace dunedaq {
+namespace ipm {
+
+// A ring has exactly one consumer, so only one ShmReceiver may use a given name at a time
+class ShmReceiver : public Receiver
+{
+public:
+  ~ShmReceiver()
+  {
+    // Senders which still have the ring mapped can finish; new ones get a fresh ring
+    if (m_ring) {
+      m_ring->unlink();
+    }
+  }
+
+  bool can_receive() const noexcept override { return m_ring != nullptr; }
+  void connect_for_receives(const nlohmann::json& connection_info) override
+  {
+    m_ring = make_shm_ring(connection_info);
+    TLOG(TLVL_INFO) << "Connected to shared memory ring "
+                    << connection_info.value<std::string>("connection_string", "shm://ipm_default") << " of "
+                    << m_ring->capacity() << " bytes";
+  }
+
+protected:
+  Receiver::Response receive_(const duration_t& timeout) override
+  {
+    Receiver::Response output;
+    auto copy_out = [&](std::string_view metadata, const char* data, size_t size) {
+      output.m_metadata.assign(metadata);
+      output.m_data.assign(data, data + size);
+      return true;
+    };
+
+    auto start_time = std::chrono::steady_clock::now();
+    while (!m_ring->try_read(copy_out)) {
+      WaitTimer timer(&counters());
+      if (!m_ring->wait_for_data(start_time, timeout)) {
+        throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+      }
+    }
+
+    TLOG(TLVL_TRACE + 2) << "Received " << output.m_data.size() << " bytes";
+    return output;
+  }
+
+  // Copies straight out of the ring; a message that doesn't fit simply stays at the head of the ring
+  Receiver::ReceiveIntoResult receive_into_(void* buffer,
+                                            message_size_t buffer_size,
+                                            const duration_t& timeout,
+                                            std::string* metadata) override
+  {
+    Receiver::ReceiveIntoResult result;
+    auto copy_out = [&](std::string_view message_metadata, const char* data, size_t size) {
+      result.m_size = static_cast<message_size_t>(size);
+      if (result.m_size > buffer_size) {
+        result.m_buffer_too_small = true;
+        return false;
+      }
+      if (size > 0) {
+        memcpy(buffer, data, size);
+      }
+      if (metadata) {
+        metadata->assign(message_metadata);
+      }
+      return true;
+    };
+
+    auto start_time = std::chrono::steady_clock::now();
+    while (!m_ring->try_read(copy_out)) {
+      WaitTimer timer(&counters());
+      if (!m_ring->wait_for_data(start_time, timeout)) {
+        result.m_timed_out = true;
+        return result;
+      }
+    }
+    return result;
+  }
+
+private:
+  std::unique_ptr<ShmRing> m_ring;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_RECEIVER(dunedaq::ipm::ShmReceiver)
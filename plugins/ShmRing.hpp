@@ -0,0 +1,497 @@
+/**
+ *
+ * @file ShmRing.hpp Ring buffer of variable-size records in POSIX shared memory
+ *
+ * The ring lives in a /dev/shm segment which both ends map. Any number of
+ * producers append records by reserving space with a CAS on the tail, copying
+ * the record in, and publishing it by storing its length last. A single
+ * consumer reads records in order from the head, zeroes the bytes it has
+ * consumed (so that a record slot reads as "not yet published" until its
+ * producer fills it in) and then advances the head. A record that would run
+ * past the end of the ring is preceded by a padding record filling the rest
+ * of the ring, so records are always contiguous.
+ *
+ * Neither side makes a system call while the other keeps up. A consumer that
+ * finds the ring empty, or a producer that finds it full, sleeps on a futex
+ * in the shared header; the other side only issues the wake-up when it sees
+ * that somebody is waiting.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_SHMRING_HPP_
+#define IPM_PLUGINS_SHMRING_HPP_
+
+#include "ipm/EndpointInfo.hpp"
+
+#include "ers/Issue.h"
+#include "nlohmann/json.hpp"
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm,
+                  SharedMemoryError,
+                  "Shared memory ring \"" << name << "\": " << reason,
+                  ((std::string)name)((std::string)reason)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  MessageLargerThanRing,
+                  "Message of " << message_size << " bytes does not fit in a ring of " << capacity << " bytes",
+                  ((size_t)message_size)((size_t)capacity)) // NOLINT
+
+namespace ipm {
+
+class ShmRing
+{
+public:
+  static constexpr size_t s_default_capacity = 8 * 1024 * 1024;
+  static constexpr size_t s_min_capacity = 4096;
+  static constexpr size_t s_max_capacity = size_t(1) << 31; // Record lengths are 32-bit
+
+  // One piece of a record's payload; the parts are stored back to back
+  struct Part
+  {
+    const void* m_data;
+    size_t m_size;
+  };
+
+  /**
+   * @brief Map the ring with the given shm name (e.g. "/ipm_data"), creating
+   * it with the given capacity if it doesn't exist yet. If it does, the
+   * capacity it was created with is used.
+   */
+  ShmRing(const std::string& name, size_t capacity)
+    : m_name(name)
+  {
+    capacity = round_up_capacity(capacity);
+    if (capacity > s_max_capacity) {
+      throw SharedMemoryError(ERS_HERE, m_name, "requested capacity is over the 2 GiB limit");
+    }
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd >= 0) {
+      create(fd, capacity);
+    } else if (errno == EEXIST) {
+      fd = shm_open(m_name.c_str(), O_RDWR, 0);
+      if (fd < 0) {
+        throw SharedMemoryError(ERS_HERE, m_name, std::string("shm_open failed: ") + strerror(errno));
+      }
+      attach(fd);
+    } else {
+      throw SharedMemoryError(ERS_HERE, m_name, std::string("shm_open failed: ") + strerror(errno));
+    }
+    close(fd);
+  }
+
+  ~ShmRing() { munmap(m_header, s_header_size + m_capacity); }
+
+  ShmRing(const ShmRing&) = delete;
+  ShmRing& operator=(const ShmRing&) = delete;
+  ShmRing(ShmRing&&) = delete;
+  ShmRing& operator=(ShmRing&&) = delete;
+
+  // Removes the name from /dev/shm; processes which already have it mapped are unaffected
+  void unlink() noexcept { shm_unlink(m_name.c_str()); }
+
+  size_t capacity() const noexcept { return m_capacity; }
+
+  // Largest message (payload plus metadata) that write() accepts
+  size_t max_message_size() const noexcept { return m_capacity - sizeof(RecordHeader); }
+
+  /**
+   * @brief Append one record holding metadata followed by the payload parts,
+   * waiting for space until start_time + timeout
+   * @param counters If not null, each wait is recorded there
+   * @return false if there was no room for the record before the deadline
+   */
+  template<typename Duration>
+  bool write(std::string_view metadata,
+             const Part* parts,
+             size_t num_parts,
+             std::chrono::steady_clock::time_point start_time,
+             const Duration& timeout,
+             EndpointCounters* counters = nullptr)
+  {
+    size_t payload_size = 0;
+    for (size_t i = 0; i < num_parts; ++i) {
+      payload_size += parts[i].m_size;
+    }
+    if (payload_size + metadata.size() > max_message_size()) {
+      throw MessageLargerThanRing(ERS_HERE, payload_size + metadata.size(), m_capacity);
+    }
+
+    auto length = sizeof(RecordHeader) + metadata.size() + payload_size;
+    uint64_t position = 0;
+    while (!claim(aligned(length), position)) {
+      WaitTimer timer(counters);
+      if (!wait_for_space(aligned(length), start_time, timeout)) {
+        return false;
+      }
+    }
+
+    auto* record = m_data + (position & m_mask);
+    auto* header = reinterpret_cast<RecordHeader*>(record);
+    header->m_metadata_size = static_cast<uint32_t>(metadata.size());
+    char* dest = record + sizeof(RecordHeader);
+    memcpy(dest, metadata.data(), metadata.size());
+    dest += metadata.size();
+    for (size_t i = 0; i < num_parts; ++i) {
+      memcpy(dest, parts[i].m_data, parts[i].m_size);
+      dest += parts[i].m_size;
+    }
+    publish(header, length);
+    return true;
+  }
+
+  /**
+   * @brief Hand the record at the head to consume(metadata, data, size). The
+   * record is removed from the ring if consume returns true, and left in place
+   * for the next read otherwise.
+   * @return false if the ring is empty
+   */
+  template<typename Consume>
+  bool try_read(Consume&& consume)
+  {
+    for (;;) {
+      auto position = m_header->m_head.load(std::memory_order_relaxed);
+      auto* record = m_data + (position & m_mask);
+      auto* header = reinterpret_cast<RecordHeader*>(record);
+      auto length = header->m_length.load(std::memory_order_acquire);
+      if (length == 0) {
+        return false;
+      }
+
+      bool is_padding = header->m_metadata_size == s_padding;
+      if (!is_padding) {
+        const char* metadata = record + sizeof(RecordHeader);
+        std::string_view metadata_view(metadata, header->m_metadata_size);
+        const char* data = metadata + header->m_metadata_size;
+        if (!consume(metadata_view, data, length - sizeof(RecordHeader) - header->m_metadata_size)) {
+          return true;
+        }
+      }
+
+      release(position, aligned(length));
+      if (!is_padding) {
+        return true;
+      }
+    }
+  }
+
+  /**
+   * @brief Sleep until a record may have been published, or until
+   * start_time + timeout
+   * @return false once the deadline has passed; true means the caller should
+   * retry try_read
+   */
+  template<typename Duration>
+  bool wait_for_data(std::chrono::steady_clock::time_point start_time, const Duration& timeout)
+  {
+    timespec remaining;
+    if (!time_left(start_time, timeout, remaining)) {
+      return false;
+    }
+    if (spin_until([this]() { return has_data(); })) {
+      return true;
+    }
+
+    m_header->m_consumer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto seq = m_header->m_data_seq.load(std::memory_order_relaxed);
+    if (!has_data()) {
+      futex_wait(&m_header->m_data_seq, seq, timeout == Duration::max() ? nullptr : &remaining);
+    }
+    m_header->m_consumer_waiting.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  static constexpr uint64_t s_magic = 0x49504d5348524e47; // "IPMSHRNG"
+  static constexpr uint32_t s_version = 1;
+  static constexpr uint32_t s_padding = UINT32_MAX; // m_metadata_size of a padding record
+  static constexpr size_t s_header_size = 4096;     // The data area starts on the next page
+  static constexpr int s_spin_iterations = 1000;    // Roughly a few microseconds of pause instructions
+
+  struct alignas(64) SharedHeader
+  {
+    uint64_t m_magic;
+    uint32_t m_version;
+    uint64_t m_capacity;
+    std::atomic<uint32_t> m_initialized;
+
+    alignas(64) std::atomic<uint64_t> m_tail; // Next position producers will reserve
+    alignas(64) std::atomic<uint64_t> m_head; // Next position the consumer will read
+
+    alignas(64) std::atomic<uint32_t> m_data_seq; // Futex: bumped when data arrives for a waiting consumer
+    std::atomic<uint32_t> m_consumer_waiting;
+
+    alignas(64) std::atomic<uint32_t> m_space_seq; // Futex: bumped when space frees up for waiting producers
+    std::atomic<uint32_t> m_producers_waiting;
+  };
+  static_assert(sizeof(SharedHeader) <= s_header_size);
+  static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                "Atomics shared between processes must be lock-free");
+
+  struct RecordHeader
+  {
+    std::atomic<uint32_t> m_length; // Header, metadata and payload; zero until published
+    uint32_t m_metadata_size;
+  };
+
+  static size_t aligned(size_t length) noexcept { return (length + 7) & ~size_t(7); }
+
+  static size_t round_up_capacity(size_t capacity) noexcept
+  {
+    size_t rounded = s_min_capacity;
+    while (rounded < capacity) {
+      rounded <<= 1;
+    }
+    return rounded;
+  }
+
+  void create(int fd, size_t capacity)
+  {
+    if (ftruncate(fd, static_cast<off_t>(s_header_size + capacity)) != 0) {
+      auto reason = std::string("ftruncate failed: ") + strerror(errno);
+      close(fd);
+      shm_unlink(m_name.c_str());
+      throw SharedMemoryError(ERS_HERE, m_name, reason);
+    }
+    map(fd, capacity);
+
+    // The freshly truncated segment is all zeroes, which is an empty ring with no records
+    auto* header = new (m_header) SharedHeader();
+    header->m_magic = s_magic;
+    header->m_version = s_version;
+    header->m_capacity = capacity;
+    header->m_initialized.store(1, std::memory_order_release);
+  }
+
+  void attach(int fd)
+  {
+    // The creator may still be setting the segment up, so give it a moment
+    struct stat st;
+    for (int attempt = 0;; ++attempt) {
+      if (fstat(fd, &st) != 0) {
+        auto reason = std::string("fstat failed: ") + strerror(errno);
+        close(fd);
+        throw SharedMemoryError(ERS_HERE, m_name, reason);
+      }
+      if (st.st_size >= static_cast<off_t>(s_header_size + s_min_capacity)) {
+        break;
+      }
+      if (attempt == 1000) {
+        close(fd);
+        throw SharedMemoryError(ERS_HERE, m_name, "segment was never sized by its creator");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    map(fd, static_cast<size_t>(st.st_size) - s_header_size);
+
+    for (int attempt = 0; m_header->m_initialized.load(std::memory_order_acquire) == 0; ++attempt) {
+      if (attempt == 1000) {
+        close(fd);
+        throw SharedMemoryError(ERS_HERE, m_name, "segment was never initialized by its creator");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (m_header->m_magic != s_magic || m_header->m_version != s_version || m_header->m_capacity != m_capacity) {
+      close(fd);
+      throw SharedMemoryError(ERS_HERE, m_name, "segment exists but is not a compatible ring");
+    }
+  }
+
+  void map(int fd, size_t capacity)
+  {
+    void* address = mmap(nullptr, s_header_size + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      auto reason = std::string("mmap failed: ") + strerror(errno);
+      close(fd);
+      throw SharedMemoryError(ERS_HERE, m_name, reason);
+    }
+    m_header = static_cast<SharedHeader*>(address);
+    m_data = static_cast<char*>(address) + s_header_size;
+    m_capacity = capacity;
+    m_mask = capacity - 1;
+  }
+
+  // Reserves aligned_length contiguous bytes, publishing padding records as
+  // needed to wrap; returns false if the ring is too full
+  bool claim(size_t aligned_length, uint64_t& position)
+  {
+    auto tail = m_header->m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+      auto head = m_header->m_head.load(std::memory_order_acquire);
+      auto to_end = m_capacity - (tail & m_mask);
+      auto needed = to_end < aligned_length ? to_end : aligned_length;
+      if (tail + needed - head > m_capacity) {
+        return false;
+      }
+      if (!m_header->m_tail.compare_exchange_weak(tail, tail + needed, std::memory_order_acq_rel)) {
+        continue;
+      }
+      if (needed == aligned_length) {
+        position = tail;
+        return true;
+      }
+
+      auto* padding = reinterpret_cast<RecordHeader*>(m_data + (tail & m_mask));
+      padding->m_metadata_size = s_padding;
+      publish(padding, to_end);
+      tail += needed;
+    }
+  }
+
+  void publish(RecordHeader* header, size_t length)
+  {
+    header->m_length.store(static_cast<uint32_t>(length), std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_header->m_consumer_waiting.load(std::memory_order_relaxed) != 0) {
+      m_header->m_data_seq.fetch_add(1, std::memory_order_relaxed);
+      futex_wake(&m_header->m_data_seq);
+    }
+  }
+
+  void release(uint64_t position, size_t aligned_length)
+  {
+    memset(m_data + (position & m_mask), 0, aligned_length);
+    m_header->m_head.store(position + aligned_length, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_header->m_producers_waiting.load(std::memory_order_relaxed) != 0) {
+      m_header->m_space_seq.fetch_add(1, std::memory_order_relaxed);
+      futex_wake(&m_header->m_space_seq);
+    }
+  }
+
+  bool has_data() const
+  {
+    auto position = m_header->m_head.load(std::memory_order_relaxed);
+    auto* header = reinterpret_cast<RecordHeader*>(m_data + (position & m_mask));
+    return header->m_length.load(std::memory_order_acquire) != 0;
+  }
+
+  bool has_space(size_t aligned_length) const
+  {
+    auto tail = m_header->m_tail.load(std::memory_order_relaxed);
+    auto head = m_header->m_head.load(std::memory_order_acquire);
+    auto to_end = m_capacity - (tail & m_mask);
+    auto needed = to_end < aligned_length ? to_end : aligned_length;
+    return tail + needed - head <= m_capacity;
+  }
+
+  // A peer which is keeping up usually makes progress within a few
+  // microseconds, which is much cheaper to wait out than a futex round trip.
+  // On a single CPU spinning would only hold the peer up.
+  template<typename Condition>
+  static bool spin_until(Condition condition)
+  {
+    static const int spin_iterations = std::thread::hardware_concurrency() > 1 ? s_spin_iterations : 0;
+    for (int i = 0; i < spin_iterations; ++i) {
+      if (condition()) {
+        return true;
+      }
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+    }
+    return false;
+  }
+
+  template<typename Duration>
+  bool wait_for_space(size_t aligned_length, std::chrono::steady_clock::time_point start_time, const Duration& timeout)
+  {
+    timespec remaining;
+    if (!time_left(start_time, timeout, remaining)) {
+      return false;
+    }
+    if (spin_until([&]() { return has_space(aligned_length); })) {
+      return true;
+    }
+
+    m_header->m_producers_waiting.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto seq = m_header->m_space_seq.load(std::memory_order_relaxed);
+    if (!has_space(aligned_length)) {
+      futex_wait(&m_header->m_space_seq, seq, timeout == Duration::max() ? nullptr : &remaining);
+    }
+    m_header->m_producers_waiting.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Fills in the time left before start_time + timeout; false if there is none
+  template<typename Duration>
+  static bool time_left(std::chrono::steady_clock::time_point start_time, const Duration& timeout, timespec& remaining)
+  {
+    if (timeout == Duration::max()) {
+      return true;
+    }
+    auto left = timeout - std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now() - start_time);
+    if (left <= Duration::zero()) {
+      return false;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+    remaining.tv_sec = static_cast<time_t>(ns / 1000000000);
+    remaining.tv_nsec = static_cast<long>(ns % 1000000000);
+    return true;
+  }
+
+  // Not FUTEX_PRIVATE_FLAG: the words are shared between processes
+  static void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, const timespec* timeout)
+  {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+  }
+
+  static void futex_wake(std::atomic<uint32_t>* word)
+  {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+  std::string m_name;
+  SharedHeader* m_header{ nullptr };
+  char* m_data{ nullptr };
+  size_t m_capacity{ 0 };
+  size_t m_mask{ 0 };
+};
+
+/**
+ * @brief Map the ring named by a "shm://<name>" connection string, which is
+ * /dev/shm/<name>. The optional "capacity" key sets the size in bytes of a
+ * ring this call creates.
+ */
+inline std::unique_ptr<ShmRing>
+make_shm_ring(const nlohmann::json& connection_info)
+{
+  static const std::string scheme = "shm://";
+  auto connection_string = connection_info.value<std::string>("connection_string", "shm://ipm_default");
+  if (connection_string.compare(0, scheme.size(), scheme) != 0 || connection_string.size() == scheme.size() ||
+      connection_string.find('/', scheme.size()) != std::string::npos) {
+    throw SharedMemoryError(ERS_HERE, connection_string, "connection string must be of the form shm://<name>");
+  }
+  auto capacity = connection_info.value<size_t>("capacity", ShmRing::s_default_capacity);
+  return std::make_unique<ShmRing>("/" + connection_string.substr(scheme.size()), capacity);
+}
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_SHMRING_HPP_
@@ -0,0 +1,73 @@
+/**
+ *
+ * @file ShmSender.cpp ShmSender messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ShmRing.hpp"
+
+#include "ipm/Sender.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "ShmSender"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+class ShmSender : public Sender
+{
+public:
+  bool can_send() const noexcept override { return m_ring != nullptr; }
+  void connect_for_sends(const nlohmann::json& connection_info) override
+  {
+    m_ring = make_shm_ring(connection_info);
+    TLOG(TLVL_INFO) << "Connected to shared memory ring "
+                    << connection_info.value<std::string>("connection_string", "shm://ipm_default") << " of "
+                    << m_ring->capacity() << " bytes";
+  }
+
+protected:
+  void send_(const void* message, int N, const duration_t& timeout, std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting send of " << N << " bytes";
+    ShmRing::Part part{ message, static_cast<size_t>(N) };
+    if (!m_ring->write(topic, &part, 1, std::chrono::steady_clock::now(), timeout, &counters())) {
+      throw SendTimeoutExpired(ERS_HERE, timeout.count());
+    }
+    TLOG(TLVL_TRACE + 2) << "Completed send of " << N << " bytes";
+  }
+
+  // The parts are written back to back into a single record
+  void send_multipart_(const void** message_parts,
+                       const std::vector<int>& message_sizes,
+                       const duration_t& timeout,
+                       std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting multipart send of " << message_sizes.size() << " parts";
+    std::vector<ShmRing::Part> parts;
+    parts.reserve(message_sizes.size());
+    for (size_t i = 0; i < message_sizes.size(); ++i) {
+      parts.push_back({ message_parts[i], static_cast<size_t>(message_sizes[i]) });
+    }
+    if (!m_ring->write(topic, parts.data(), parts.size(), std::chrono::steady_clock::now(), timeout, &counters())) {
+      throw SendTimeoutExpired(ERS_HERE, timeout.count());
+    }
+    TLOG(TLVL_TRACE + 2) << "Completed multipart send of " << message_sizes.size() << " parts";
+  }
+
+private:
+  std::unique_ptr<ShmRing> m_ring;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_SENDER(dunedaq::ipm::ShmSender)
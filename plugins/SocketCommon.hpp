@@ -0,0 +1,371 @@
+/**
+ *
+ * @file SocketCommon.hpp Framing, addressing and waiting shared by the TCP and Unix-domain socket plugins
+ *
+ * Each message goes over the stream as one frame: a FrameHeader giving the
+ * sizes of the topic and of the payload, followed by the topic bytes and then
+ * the payload bytes.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_SOCKETCOMMON_HPP_
+#define IPM_PLUGINS_SOCKETCOMMON_HPP_
+
+#include "ipm/EndpointInfo.hpp"
+
+#include "ers/Issue.h"
+#include "nlohmann/json.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm,
+                  SocketError,
+                  "Socket error on " << connection << ": " << reason,
+                  ((std::string)connection)((std::string)reason)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  PeerDisconnected,
+                  "Peer on " << connection << " disconnected part way through a message",
+                  ((std::string)connection)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  FrameTooLarge,
+                  "Peer on " << connection << " sent a " << size << "-byte message, over the limit of " << limit
+                             << " bytes; dropping the connection",
+                  ((std::string)connection)((uint64_t)size)((uint64_t)limit)) // NOLINT
+
+namespace ipm {
+
+enum class SocketFamily
+{
+  Tcp,
+  Uds,
+};
+
+// On the wire in network byte order
+struct FrameHeader
+{
+  uint32_t m_topic_size;
+  uint32_t m_payload_size;
+};
+
+struct SocketAddress
+{
+  sockaddr_storage m_address{};
+  socklen_t m_length{ 0 };
+};
+
+/**
+ * @brief Parse "tcp://<host>:<port>" or "ipc://<path>" (matching the ZeroMQ
+ * plugins' connection strings). A host of "*" means every local interface.
+ */
+inline SocketAddress
+resolve_address(SocketFamily family, const std::string& connection_string)
+{
+  SocketAddress result;
+  if (family == SocketFamily::Uds) {
+    static const std::string scheme = "ipc://";
+    auto path = connection_string.substr(std::min(scheme.size(), connection_string.size()));
+    sockaddr_un address{};
+    if (connection_string.compare(0, scheme.size(), scheme) != 0 || path.empty() ||
+        path.size() >= sizeof(address.sun_path)) {
+      throw SocketError(ERS_HERE, connection_string, "connection string must be of the form ipc://<path>");
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    memcpy(&result.m_address, &address, sizeof(address));
+    result.m_length = sizeof(address);
+    return result;
+  }
+
+  static const std::string scheme = "tcp://";
+  auto colon = connection_string.rfind(':');
+  if (connection_string.compare(0, scheme.size(), scheme) != 0 || colon == std::string::npos || colon < scheme.size()) {
+    throw SocketError(ERS_HERE, connection_string, "connection string must be of the form tcp://<host>:<port>");
+  }
+  auto host = connection_string.substr(scheme.size(), colon - scheme.size());
+  auto port = connection_string.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = host == "*" ? AI_PASSIVE : 0;
+  addrinfo* addresses = nullptr;
+  int status = getaddrinfo(host == "*" ? nullptr : host.c_str(), port.c_str(), &hints, &addresses);
+  if (status != 0 || addresses == nullptr) {
+    throw SocketError(ERS_HERE, connection_string, std::string("unable to resolve address: ") + gai_strerror(status));
+  }
+  memcpy(&result.m_address, addresses->ai_addr, addresses->ai_addrlen);
+  result.m_length = addresses->ai_addrlen;
+  freeaddrinfo(addresses);
+  return result;
+}
+
+/**
+ * @brief Check the types and ranges of the optional "send_buffer_size",
+ * "receive_buffer_size", "tcp_nodelay" and "max_message_size" keys of
+ * connection_info, before any socket is made with them
+ * @throws SocketError naming the key if a value is unusable
+ */
+inline void
+validate_socket_options(const nlohmann::json& connection_info)
+{
+  auto connection_string = connection_info.value<std::string>("connection_string", "");
+  for (const char* key : { "send_buffer_size", "receive_buffer_size" }) {
+    auto it = connection_info.find(key);
+    if (it != connection_info.end() &&
+        (!it->is_number_integer() || it->get<int64_t>() < 1 || it->get<int64_t>() > INT_MAX)) {
+      throw SocketError(ERS_HERE, connection_string, std::string(key) + " must be a positive integer (bytes)");
+    }
+  }
+  auto nodelay = connection_info.find("tcp_nodelay");
+  if (nodelay != connection_info.end() && !nodelay->is_boolean()) {
+    throw SocketError(ERS_HERE, connection_string, "tcp_nodelay must be true or false");
+  }
+  auto max_size = connection_info.find("max_message_size");
+  if (max_size != connection_info.end() &&
+      (!max_size->is_number_integer() || max_size->get<int64_t>() < 1)) {
+    throw SocketError(ERS_HERE, connection_string, "max_message_size must be a positive integer (bytes)");
+  }
+}
+
+// Sets one option, throwing SocketError if the kernel refuses it
+inline void
+set_socket_option(int fd, int level, int option, int value, const char* name, const std::string& connection_string)
+{
+  if (setsockopt(fd, level, option, &value, sizeof(value)) != 0) {
+    throw SocketError(ERS_HERE, connection_string, std::string("setting ") + name + " failed: " + strerror(errno));
+  }
+}
+
+/**
+ * @brief Apply the optional "send_buffer_size" and "receive_buffer_size"
+ * (SO_SNDBUF/SO_RCVBUF, in bytes) and, for TCP, "tcp_nodelay" (default true)
+ * settings in connection_info, already checked by validate_socket_options, to
+ * a socket
+ * @throws SocketError if the kernel refuses one
+ */
+inline void
+apply_socket_options(int fd, SocketFamily family, const nlohmann::json& connection_info)
+{
+  auto connection_string = connection_info.value<std::string>("connection_string", "");
+  if (connection_info.contains("send_buffer_size")) {
+    set_socket_option(fd,
+                      SOL_SOCKET,
+                      SO_SNDBUF,
+                      connection_info["send_buffer_size"].get<int>(),
+                      "send_buffer_size (SO_SNDBUF)",
+                      connection_string);
+  }
+  if (connection_info.contains("receive_buffer_size")) {
+    set_socket_option(fd,
+                      SOL_SOCKET,
+                      SO_RCVBUF,
+                      connection_info["receive_buffer_size"].get<int>(),
+                      "receive_buffer_size (SO_RCVBUF)",
+                      connection_string);
+  }
+  if (family == SocketFamily::Tcp) {
+    set_socket_option(fd,
+                      IPPROTO_TCP,
+                      TCP_NODELAY,
+                      connection_info.value<bool>("tcp_nodelay", true) ? 1 : 0,
+                      "tcp_nodelay (TCP_NODELAY)",
+                      connection_string);
+  }
+}
+
+/**
+ * @brief The largest message (topic and payload together) a receiver accepts,
+ * from the optional "max_message_size" key of connection_info (in bytes,
+ * default 1 GiB). The sizes come off the wire, so anything bigger is taken as
+ * a corrupt or hostile stream rather than allocated.
+ */
+inline uint64_t
+max_message_size(const nlohmann::json& connection_info)
+{
+  static constexpr uint64_t default_max_message_size = uint64_t(1) << 30;
+  return connection_info.value<uint64_t>("max_message_size", default_max_message_size);
+}
+
+/**
+ * @brief Sleep in poll until fd reports one of events, or until the time left
+ * before start_time + timeout runs out
+ * @param timeout Duration::max() waits without a deadline
+ * @param counters If not null, the wait is recorded there
+ * @return false once the deadline has passed, true otherwise (the caller
+ * should then retry its non-blocking operation)
+ */
+template<typename Duration>
+bool
+wait_for_fd(int fd,
+            short events,
+            std::chrono::steady_clock::time_point start_time,
+            const Duration& timeout,
+            EndpointCounters* counters = nullptr)
+{
+  int poll_timeout = -1; // Block until ready
+  if (timeout != Duration::max()) {
+    auto remaining = start_time + timeout - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+      return false;
+    }
+    // Rounded up, so that we don't spin through the last fraction of a millisecond
+    poll_timeout = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+  }
+
+  WaitTimer timer(counters);
+  pollfd item{ fd, events, 0 };
+  poll(&item, 1, poll_timeout);
+  return true;
+}
+
+/**
+ * @brief The descriptor behind the socket plugins' readiness_fd(): an epoll
+ * set holding whichever socket currently says whether the endpoint can make
+ * progress, so that an event loop can keep waiting on the same descriptor
+ * across reconnects. With a retry interval, a timer in the set ticks at that
+ * interval while no socket is watched, for a receiver to come back and retry
+ * connecting.
+ */
+class ReadinessSet
+{
+public:
+  ReadinessSet() = default;
+  ~ReadinessSet()
+  {
+    if (m_epoll_fd >= 0) {
+      close(m_epoll_fd);
+    }
+    if (m_timer_fd >= 0) {
+      close(m_timer_fd);
+    }
+  }
+
+  ReadinessSet(const ReadinessSet&) = delete;
+  ReadinessSet& operator=(const ReadinessSet&) = delete;
+
+  // Does nothing if already open
+  // -Throws SocketError if the kernel refuses the descriptors
+  void open(const std::string& connection_string, std::chrono::nanoseconds retry_interval)
+  {
+    if (m_epoll_fd >= 0) {
+      return;
+    }
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+      throw SocketError(ERS_HERE, connection_string, std::string("epoll_create1 failed: ") + strerror(errno));
+    }
+    m_retry_interval = retry_interval;
+    if (retry_interval.count() == 0) {
+      return;
+    }
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = m_timer_fd;
+    if (m_timer_fd < 0 || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_timer_fd, &event) != 0) {
+      throw SocketError(ERS_HERE, connection_string, std::string("timerfd failed: ") + strerror(errno));
+    }
+    arm_timer(true);
+  }
+
+  int fd() const noexcept { return m_epoll_fd; }
+
+  // Watch fd for events in place of the socket watched before; -1 watches
+  // none, and starts the retry timer. Call before closing the watched socket.
+  void watch(int fd, uint32_t events)
+  {
+    if (m_epoll_fd < 0 || fd == m_watched_fd) {
+      return;
+    }
+    if (m_watched_fd >= 0) {
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_watched_fd, nullptr);
+    }
+    m_watched_fd = fd;
+    if (fd >= 0) {
+      epoll_event event{};
+      event.events = events;
+      event.data.fd = fd;
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+    arm_timer(fd < 0);
+  }
+
+  // Whether the retry timer has ticked since last asked
+  bool take_retry_tick()
+  {
+    uint64_t ticks = 0;
+    return m_timer_fd >= 0 && read(m_timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks);
+  }
+
+private:
+  // Armed, the first tick comes at once; disarming also drops ticks not yet taken
+  void arm_timer(bool armed)
+  {
+    if (m_timer_fd < 0) {
+      return;
+    }
+    itimerspec spec{};
+    if (armed) {
+      auto seconds = std::chrono::duration_cast<std::chrono::seconds>(m_retry_interval);
+      spec.it_interval.tv_sec = seconds.count();
+      spec.it_interval.tv_nsec = (m_retry_interval - seconds).count();
+      spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(m_timer_fd, 0, &spec, nullptr);
+  }
+
+  int m_epoll_fd{ -1 };
+  int m_timer_fd{ -1 };
+  int m_watched_fd{ -1 };
+  std::chrono::nanoseconds m_retry_interval{ 0 };
+};
+
+// Drops the first num_bytes bytes from an iovec array after a partial transfer
+inline void
+advance_iovecs(iovec*& iov, size_t& num_iov, size_t num_bytes)
+{
+  while (num_iov > 0 && num_bytes >= iov->iov_len) {
+    num_bytes -= iov->iov_len;
+    ++iov;
+    --num_iov;
+  }
+  if (num_iov > 0) {
+    iov->iov_base = static_cast<char*>(iov->iov_base) + num_bytes;
+    iov->iov_len -= num_bytes;
+  }
+}
+
+inline size_t
+iovec_limit(size_t num_iov)
+{
+  return std::min(num_iov, static_cast<size_t>(IOV_MAX));
+}
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_SOCKETCOMMON_HPP_
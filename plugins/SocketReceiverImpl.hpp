@@ -0,0 +1,338 @@
+/**
+ *
+ * @file SocketReceiverImpl.hpp Implementations of common routines for TCP and Unix-domain socket Receivers
+ *
+ * The receiver connects to the address its sender is bound to, retrying until
+ * the sender is there, and reconnects if the sender goes away between
+ * messages.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_SOCKETRECEIVERIMPL_HPP_
+#define IPM_PLUGINS_SOCKETRECEIVERIMPL_HPP_
+
+#include "SocketCommon.hpp"
+
+#include "ipm/Receiver.hpp"
+
+#include "TRACE/trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace dunedaq {
+namespace ipm {
+
+class SocketReceiverImpl : public Receiver
+{
+public:
+  explicit SocketReceiverImpl(SocketFamily family)
+    : m_family(family)
+  {}
+
+  ~SocketReceiverImpl() { close_connection(); }
+
+  bool can_receive() const noexcept override { return m_address.m_length != 0; }
+  int readiness_fd() const override { return m_readiness.fd(); }
+  void connect_for_receives(const nlohmann::json& connection_info) override
+  {
+    validate_socket_options(connection_info);
+    m_connection_info = connection_info;
+    m_connection_string = connection_info.value<std::string>("connection_string", "");
+    TLOG(TLVL_INFO) << "Connection String is " << m_connection_string;
+    m_address = resolve_address(m_family, m_connection_string);
+    m_max_message_size = max_message_size(connection_info);
+    m_readiness.open(m_connection_string, s_connect_retry_interval);
+    // Start connecting now if the sender is already there, so that it can send
+    // before our first receive; otherwise the first receive keeps trying
+    wait_for_connection(std::chrono::steady_clock::now(), duration_t::zero());
+  }
+
+protected:
+  // Without a connection, worth a try each time the retry timer ticks
+  bool ready_to_receive_() override
+  {
+    if (!is_connected()) {
+      return m_readiness.fd() < 0 || m_readiness.take_retry_tick();
+    }
+    pollfd item{ m_fd, POLLIN, 0 };
+    return poll(&item, 1, 0) > 0;
+  }
+
+  // Topic and payload are read straight into the Response
+  Receiver::Response receive_(const duration_t& timeout) override
+  {
+    auto start_time = std::chrono::steady_clock::now();
+    FrameHeader header;
+    if (!read_header(header, start_time, timeout)) {
+      throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+    }
+
+    auto output = read_body(header, start_time, timeout);
+
+    TLOG(TLVL_TRACE + 2) << "Received " << output.m_data.size() << " bytes";
+    return output;
+  }
+
+  // The payload is read straight into the caller's buffer. A payload which
+  // doesn't fit is still read off the stream, so that the next frame starts
+  // where expected, and kept for the next receive.
+  Receiver::ReceiveIntoResult receive_into_(void* buffer,
+                                            message_size_t buffer_size,
+                                            const duration_t& timeout,
+                                            std::string* metadata) override
+  {
+    try {
+      return receive_frame_into(buffer, buffer_size, timeout, metadata);
+    } catch (ReceiveTimeoutExpired const&) {
+      // The sender stalled part way through a frame, and has been dropped
+      Receiver::ReceiveIntoResult result;
+      result.m_timed_out = true;
+      return result;
+    }
+  }
+
+private:
+  Receiver::ReceiveIntoResult receive_frame_into(void* buffer,
+                                                 message_size_t buffer_size,
+                                                 const duration_t& timeout,
+                                                 std::string* metadata)
+  {
+    auto start_time = std::chrono::steady_clock::now();
+    Receiver::ReceiveIntoResult result;
+    FrameHeader header;
+    if (!read_header(header, start_time, timeout)) {
+      result.m_timed_out = true;
+      return result;
+    }
+
+    result.m_size = static_cast<message_size_t>(header.m_payload_size);
+    if (result.m_size > buffer_size) {
+      result.m_buffer_too_small = true;
+      auto kept = std::make_shared<Receiver::Response>(read_body(header, start_time, timeout));
+      Receiver::ResponseView view;
+      view.m_metadata = kept->m_metadata;
+      view.m_data = kept->m_data.data();
+      view.m_size = kept->m_data.size();
+      view.m_handle = std::move(kept);
+      keep_for_next_receive(std::move(view));
+      return result;
+    }
+
+    std::string& topic = metadata ? *metadata : m_scratch_topic;
+    topic.resize(header.m_topic_size);
+    iovec body[] = { { topic.data(), topic.size() }, { buffer, header.m_payload_size } };
+    read_body(body, 2, start_time, timeout);
+    return result;
+  }
+
+  // Waits up to the timeout for the start of the next frame, then reads the whole header. A frame over
+  // the size limit drops the connection, as the stream can't be trusted after it.
+  bool read_header(FrameHeader& header, std::chrono::steady_clock::time_point start_time, const duration_t& timeout)
+  {
+    iovec iov{ &header, sizeof(header) };
+    while (!read_fully(&iov, 1, true, start_time, timeout)) {
+      if (!is_connected() && wait_for_connection(start_time, timeout)) {
+        continue; // The sender went away between frames and we have reconnected
+      }
+      return false;
+    }
+    header.m_topic_size = ntohl(header.m_topic_size);
+    header.m_payload_size = ntohl(header.m_payload_size);
+    uint64_t size = uint64_t(header.m_topic_size) + header.m_payload_size;
+    if (size > m_max_message_size) {
+      close_connection();
+      throw FrameTooLarge(ERS_HERE, m_connection_string, size, m_max_message_size);
+    }
+    return true;
+  }
+
+  // Once a header has been read, the rest of its frame is already on its way
+  void read_body(iovec* iov,
+                 size_t num_iov,
+                 std::chrono::steady_clock::time_point start_time,
+                 const duration_t& timeout)
+  {
+    read_fully(iov, num_iov, false, start_time, timeout);
+  }
+
+  Receiver::Response read_body(const FrameHeader& header,
+                               std::chrono::steady_clock::time_point start_time,
+                               const duration_t& timeout)
+  {
+    Receiver::Response output;
+    output.m_metadata.resize(header.m_topic_size);
+    output.m_data.resize(header.m_payload_size);
+    iovec body[] = { { output.m_metadata.data(), output.m_metadata.size() },
+                     { output.m_data.data(), output.m_data.size() } };
+    read_body(body, 2, start_time, timeout);
+    return output;
+  }
+
+  /**
+   * @brief recvmsg until the iovecs are full. If at_frame_start, a sender
+   * which has disconnected, or the timeout expiring, before the first byte
+   * arrives makes this return false. Once a frame has begun, the rest of it
+   * is waited for until the same deadline, but for at least s_min_frame_time
+   * after its first byte, so that a receive which doesn't wait can finish a
+   * frame it finds under way. A sender which stalls for longer is dropped,
+   * as the stream can't be resumed part way through a frame, and
+   * ReceiveTimeoutExpired is thrown.
+   */
+  bool read_fully(iovec* iov,
+                  size_t num_iov,
+                  bool at_frame_start,
+                  std::chrono::steady_clock::time_point start_time,
+                  const duration_t& timeout)
+  {
+    if (!wait_for_connection(start_time, timeout)) {
+      return false;
+    }
+
+    size_t bytes_read = 0;
+    while (num_iov > 0 && iov->iov_len == 0) {
+      ++iov;
+      --num_iov;
+    }
+    while (num_iov > 0) {
+      msghdr msg{};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovec_limit(num_iov);
+      ssize_t result = recvmsg(m_fd, &msg, MSG_DONTWAIT);
+      if (result > 0) {
+        if (at_frame_start && bytes_read == 0) {
+          m_frame_start_time = std::chrono::steady_clock::now();
+        }
+        bytes_read += static_cast<size_t>(result);
+        advance_iovecs(iov, num_iov, static_cast<size_t>(result));
+      } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (at_frame_start && bytes_read == 0) {
+          if (!wait_for_fd(m_fd, POLLIN, start_time, timeout, &counters())) {
+            return false;
+          }
+        } else if (!wait_for_rest_of_frame(start_time, timeout)) {
+          TLOG(TLVL_INFO) << "Timed out part way through a frame, dropping the sender on " << m_connection_string;
+          close_connection();
+          throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+        }
+      } else if (result < 0 && errno == EINTR) {
+        continue;
+      } else {
+        TLOG(TLVL_INFO) << "Lost sender: " << (result == 0 ? "connection closed" : strerror(errno));
+        close_connection();
+        if (at_frame_start && bytes_read == 0) {
+          return false;
+        }
+        throw PeerDisconnected(ERS_HERE, m_connection_string);
+      }
+    }
+    return true;
+  }
+
+  bool wait_for_rest_of_frame(std::chrono::steady_clock::time_point start_time, const duration_t& timeout)
+  {
+    if (timeout == duration_t::max()) {
+      return wait_for_fd(m_fd, POLLIN, start_time, timeout, &counters());
+    }
+    auto deadline = std::max<std::chrono::steady_clock::time_point>(start_time + timeout,
+                                                                     m_frame_start_time + s_min_frame_time);
+    return wait_for_fd(m_fd, POLLIN, m_frame_start_time, deadline - m_frame_start_time, &counters());
+  }
+
+  bool is_connected() const noexcept { return m_fd >= 0 && !m_connecting; }
+
+  // Connects (or finishes connecting) to the sender, retrying until start_time + timeout
+  bool wait_for_connection(std::chrono::steady_clock::time_point start_time, const duration_t& timeout)
+  {
+    for (;;) {
+      if (m_fd < 0) {
+        m_fd = socket(m_address.m_address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (m_fd < 0) {
+          throw SocketError(ERS_HERE, m_connection_string, std::string("socket failed: ") + strerror(errno));
+        }
+        try {
+          apply_socket_options(m_fd, m_family, m_connection_info);
+        } catch (SocketError const&) {
+          close_connection();
+          throw;
+        }
+        if (connect(m_fd, reinterpret_cast<const sockaddr*>(&m_address.m_address), m_address.m_length) == 0) {
+          m_connecting = false;
+        } else if (errno == EINPROGRESS || errno == EAGAIN) {
+          m_connecting = true;
+        } else {
+          close_connection(); // Most likely the sender isn't listening yet
+        }
+      }
+
+      if (m_fd >= 0 && m_connecting) {
+        pollfd item{ m_fd, POLLOUT, 0 };
+        if (poll(&item, 1, 0) > 0) {
+          int error = 0;
+          socklen_t length = sizeof(error);
+          getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &length);
+          if (error == 0) {
+            m_connecting = false;
+          } else {
+            close_connection();
+          }
+        }
+      }
+
+      if (is_connected()) {
+        m_readiness.watch(m_fd, EPOLLIN);
+        return true;
+      }
+
+      // Retry, or keep waiting for the connection in progress, until the deadline
+      auto now = std::chrono::steady_clock::now();
+      if (timeout != duration_t::max() && now - start_time >= timeout) {
+        return false;
+      }
+      if (m_fd >= 0) {
+        wait_for_fd(m_fd, POLLOUT, start_time, timeout, &counters());
+      } else {
+        auto retry_interval = std::chrono::steady_clock::duration(s_connect_retry_interval);
+        if (timeout != duration_t::max()) {
+          retry_interval = std::min(retry_interval, start_time + timeout - now);
+        }
+        WaitTimer timer(&counters());
+        std::this_thread::sleep_for(retry_interval);
+      }
+    }
+  }
+
+  void close_connection()
+  {
+    m_readiness.watch(-1, 0);
+    if (m_fd >= 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+    m_connecting = false;
+  }
+
+  static constexpr std::chrono::milliseconds s_connect_retry_interval{ 10 };
+  static constexpr std::chrono::milliseconds s_min_frame_time{ 100 };
+
+  SocketFamily m_family;
+  nlohmann::json m_connection_info;
+  std::string m_connection_string;
+  SocketAddress m_address;
+  uint64_t m_max_message_size{ 0 };
+  int m_fd{ -1 };
+  bool m_connecting{ false };
+  std::chrono::steady_clock::time_point m_frame_start_time{}; // When the first byte of the current frame arrived
+  ReadinessSet m_readiness; // Follows m_fd once connected
+  std::string m_scratch_topic;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_SOCKETRECEIVERIMPL_HPP_
@@ -0,0 +1,278 @@
+/**
+ *
+ * @file SocketSenderImpl.hpp Implementations of common routines for TCP and Unix-domain socket Senders
+ *
+ * Like ZmqSender, the sender binds to the address in connection_string and the
+ * receiver connects to it. A single receiver is served at a time; if it goes
+ * away the sender waits for another to connect.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#ifndef IPM_PLUGINS_SOCKETSENDERIMPL_HPP_
+#define IPM_PLUGINS_SOCKETSENDERIMPL_HPP_
+
+#include "SocketCommon.hpp"
+
+#include "ipm/Sender.hpp"
+
+#include "TRACE/trace.h"
+
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+class SocketSenderImpl : public Sender
+{
+public:
+  explicit SocketSenderImpl(SocketFamily family)
+    : m_family(family)
+  {}
+
+  ~SocketSenderImpl()
+  {
+    close_peer();
+    if (m_listen_fd >= 0) {
+      close(m_listen_fd);
+      if (m_family == SocketFamily::Uds) {
+        unlink(reinterpret_cast<const sockaddr_un*>(&m_address.m_address)->sun_path);
+      }
+    }
+  }
+
+  bool can_send() const noexcept override { return m_listen_fd >= 0; }
+  int readiness_fd() const override { return m_readiness.fd(); }
+  // Room to write to the receiver, or one waiting to be accepted
+  bool ready_to_send() override
+  {
+    if (m_listen_fd < 0) {
+      return true;
+    }
+    pollfd item = m_peer_fd >= 0 ? pollfd{ m_peer_fd, POLLOUT, 0 } : pollfd{ m_listen_fd, POLLIN, 0 };
+    return poll(&item, 1, 0) > 0;
+  }
+  void connect_for_sends(const nlohmann::json& connection_info) override
+  {
+    validate_socket_options(connection_info);
+    m_connection_info = connection_info;
+    m_connection_string = connection_info.value<std::string>("connection_string", "");
+    TLOG(TLVL_INFO) << "Connection String is " << m_connection_string;
+    m_address = resolve_address(m_family, m_connection_string);
+
+    int fd = socket(m_address.m_address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      throw SocketError(ERS_HERE, m_connection_string, std::string("socket failed: ") + strerror(errno));
+    }
+    try {
+      if (m_family == SocketFamily::Tcp) {
+        set_socket_option(fd, SOL_SOCKET, SO_REUSEADDR, 1, "SO_REUSEADDR", m_connection_string);
+      } else {
+        // A socket file left behind by an earlier run would make bind fail
+        unlink(reinterpret_cast<const sockaddr_un*>(&m_address.m_address)->sun_path);
+      }
+      // Accepted connections inherit the buffer sizes, which must be set before listen to take effect for TCP
+      apply_socket_options(fd, m_family, m_connection_info);
+    } catch (SocketError const&) {
+      close(fd);
+      throw;
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&m_address.m_address), m_address.m_length) != 0 ||
+        listen(fd, 1) != 0) {
+      auto reason = std::string("bind/listen failed: ") + strerror(errno);
+      close(fd);
+      throw SocketError(ERS_HERE, m_connection_string, reason);
+    }
+    m_listen_fd = fd;
+    m_readiness.open(m_connection_string, std::chrono::nanoseconds::zero());
+    m_readiness.watch(m_listen_fd, EPOLLIN);
+  }
+
+protected:
+  void send_(const void* message, int N, const duration_t& timeout, std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting send of " << N << " bytes";
+    iovec part{ const_cast<void*>(message), static_cast<size_t>(N) };
+    send_frame(topic, &part, 1, timeout);
+    TLOG(TLVL_TRACE + 2) << "Completed send of " << N << " bytes";
+  }
+
+  // The parts are gathered straight from the caller's buffers into one frame
+  void send_multipart_(const void** message_parts,
+                       const std::vector<int>& message_sizes,
+                       const duration_t& timeout,
+                       std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting multipart send of " << message_sizes.size() << " parts";
+    std::vector<iovec> parts(message_sizes.size());
+    for (size_t i = 0; i < parts.size(); ++i) {
+      parts[i].iov_base = const_cast<void*>(message_parts[i]);
+      parts[i].iov_len = static_cast<size_t>(message_sizes[i]);
+    }
+    send_frame(topic, parts.data(), parts.size(), timeout);
+    TLOG(TLVL_TRACE + 2) << "Completed multipart send of " << message_sizes.size() << " parts";
+  }
+
+  /**
+   * @brief How many bytes the receiver's socket will surely take without
+   * waiting: half its send buffer, as the kernel doubles SO_SNDBUF to cover
+   * its own bookkeeping, less what is still queued (SIOCOUTQ). A send with no
+   * time to wait only starts a frame which fits, so that it can't be torn.
+   */
+  size_t send_space() const
+  {
+    int buffer_size = 0;
+    socklen_t length = sizeof(buffer_size);
+    int queued = 0;
+    if (getsockopt(m_peer_fd, SOL_SOCKET, SO_SNDBUF, &buffer_size, &length) != 0 ||
+        ioctl(m_peer_fd, SIOCOUTQ, &queued) != 0 || buffer_size / 2 <= queued) {
+      return 0;
+    }
+    return static_cast<size_t>(buffer_size / 2 - queued);
+  }
+
+  int peer_fd() const noexcept { return m_peer_fd; }
+  const nlohmann::json& connection_info() const noexcept { return m_connection_info; }
+  const std::string& connection_string() const noexcept { return m_connection_string; }
+
+  // Fills in a frame header (in network byte order) for a message
+  static FrameHeader make_header(size_t topic_size, size_t payload_size) noexcept
+  {
+    return { htonl(static_cast<uint32_t>(topic_size)), htonl(static_cast<uint32_t>(payload_size)) };
+  }
+
+  /**
+   * @brief Write the iovecs to the receiver, within start_time + timeout. A
+   * frame can't be resumed once part of it is out, so if the deadline passes
+   * (or the receiver goes away) part way through, the connection is dropped
+   * and the receiver sees the sender disconnect rather than a torn frame.
+   * @return false if the receiver disconnected before anything was written
+   */
+  bool write_iovecs(iovec* iov,
+                    size_t num_iov,
+                    std::chrono::steady_clock::time_point start_time,
+                    const duration_t& timeout)
+  {
+    size_t bytes_sent = 0;
+    while (num_iov > 0) {
+      msghdr msg{};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovec_limit(num_iov);
+      ssize_t result = sendmsg(m_peer_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (result >= 0) {
+        bytes_sent += static_cast<size_t>(result);
+        advance_iovecs(iov, num_iov, static_cast<size_t>(result));
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!wait_for_fd(m_peer_fd, POLLOUT, start_time, timeout, &counters())) {
+          if (bytes_sent > 0) {
+            TLOG(TLVL_INFO) << "Timed out part way through a frame, dropping the receiver on " << m_connection_string;
+            close_peer();
+          }
+          throw SendTimeoutExpired(ERS_HERE, timeout.count());
+        }
+      } else if (errno != EINTR) {
+        TLOG(TLVL_INFO) << "Lost receiver: " << strerror(errno);
+        close_peer();
+        if (bytes_sent == 0) {
+          return false;
+        }
+        throw PeerDisconnected(ERS_HERE, m_connection_string);
+      }
+    }
+    return true;
+  }
+
+  // Accepts a receiver if there isn't one, waiting up to start_time + timeout
+  bool wait_for_peer(std::chrono::steady_clock::time_point start_time, const duration_t& timeout)
+  {
+    // Writes to a receiver which has closed its end still succeed until the
+    // reset comes back, so check for the hang-up before handing it a frame
+    if (m_peer_fd >= 0) {
+      pollfd item{ m_peer_fd, POLLRDHUP, 0 };
+      if (poll(&item, 1, 0) > 0 && (item.revents & (POLLRDHUP | POLLHUP | POLLERR))) {
+        TLOG(TLVL_INFO) << "Receiver on " << m_connection_string << " has gone away";
+        close_peer();
+      }
+    }
+    while (m_peer_fd < 0) {
+      // Left blocking: our own writes pass MSG_DONTWAIT, and asynchronous
+      // writers such as io_uring need the kernel to wait for room itself
+      int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        try {
+          apply_socket_options(fd, m_family, m_connection_info);
+        } catch (SocketError const&) {
+          close(fd);
+          throw;
+        }
+        m_peer_fd = fd;
+        m_readiness.watch(m_peer_fd, EPOLLOUT);
+        TLOG(TLVL_INFO) << "Accepted receiver on " << m_connection_string;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!wait_for_fd(m_listen_fd, POLLIN, start_time, timeout, &counters())) {
+          return false;
+        }
+      } else if (errno != EINTR && errno != ECONNABORTED) {
+        throw SocketError(ERS_HERE, m_connection_string, std::string("accept failed: ") + strerror(errno));
+      }
+    }
+    return true;
+  }
+
+  void close_peer()
+  {
+    if (m_peer_fd >= 0) {
+      m_readiness.watch(m_listen_fd, EPOLLIN);
+      close(m_peer_fd);
+      m_peer_fd = -1;
+    }
+  }
+
+private:
+  // The timeout covers waiting for a receiver and writing the whole frame
+  void send_frame(std::string_view topic, const iovec* parts, size_t num_parts, const duration_t& timeout)
+  {
+    auto start_time = std::chrono::steady_clock::now();
+
+    size_t payload_size = 0;
+    for (size_t i = 0; i < num_parts; ++i) {
+      payload_size += parts[i].iov_len;
+    }
+    FrameHeader header = make_header(topic.size(), payload_size);
+    size_t frame_size = sizeof(header) + topic.size() + payload_size;
+
+    m_iov.clear();
+    m_iov.push_back({ &header, sizeof(header) });
+    m_iov.push_back({ const_cast<char*>(topic.data()), topic.size() });
+    m_iov.insert(m_iov.end(), parts, parts + num_parts);
+
+    // A receiver which has gone away before any of the frame was written is replaced by the next one to connect
+    do {
+      if (!wait_for_peer(start_time, timeout) || (timeout == s_no_block && frame_size > send_space())) {
+        throw SendTimeoutExpired(ERS_HERE, timeout.count());
+      }
+    } while (!write_iovecs(m_iov.data(), m_iov.size(), start_time, timeout));
+  }
+
+  SocketFamily m_family;
+  nlohmann::json m_connection_info;
+  std::string m_connection_string;
+  SocketAddress m_address;
+  int m_listen_fd{ -1 };
+  int m_peer_fd{ -1 };
+  ReadinessSet m_readiness; // The receiver once accepted, otherwise the listening socket
+  std::vector<iovec> m_iov; // Reused between sends
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_SOCKETSENDERIMPL_HPP_
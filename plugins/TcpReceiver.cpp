@@ -0,0 +1,28 @@
+/**
+ *
+ * @file TcpReceiver.cpp TcpReceiver messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "SocketReceiverImpl.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "TcpReceiver"
+
+namespace dunedaq {
+namespace ipm {
+class TcpReceiver : public SocketReceiverImpl
+{
+public:
+  TcpReceiver()
+    : SocketReceiverImpl(SocketFamily::Tcp)
+  {}
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_RECEIVER(dunedaq::ipm::TcpReceiver)
@@ -0,0 +1,28 @@
+/**
+ *
+ * @file TcpSender.cpp TcpSender messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "SocketSenderImpl.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "TcpSender"
+
+namespace dunedaq {
+namespace ipm {
+class TcpSender : public SocketSenderImpl
+{
+public:
+  TcpSender()
+    : SocketSenderImpl(SocketFamily::Tcp)
+  {}
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_SENDER(dunedaq::ipm::TcpSender)
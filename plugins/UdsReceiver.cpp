@@ -0,0 +1,28 @@
+/**
+ *
+ * @file UdsReceiver.cpp UdsReceiver messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "SocketReceiverImpl.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "UdsReceiver"
+
+namespace dunedaq {
+namespace ipm {
+class UdsReceiver : public SocketReceiverImpl
+{
+public:
+  UdsReceiver()
+    : SocketReceiverImpl(SocketFamily::Uds)
+  {}
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_RECEIVER(dunedaq::ipm::UdsReceiver)
@@ -0,0 +1,28 @@
+/**
+ *
+ * @file UdsSender.cpp UdsSender messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "SocketSenderImpl.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "UdsSender"
+
+namespace dunedaq {
+namespace ipm {
+class UdsSender : public SocketSenderImpl
+{
+public:
+  UdsSender()
+    : SocketSenderImpl(SocketFamily::Uds)
+  {}
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_SENDER(dunedaq::ipm::UdsSender)
@@ -0,0 +1,725 @@
+/**
+ *
+ * @file UringEngine.hpp The receive engine behind UringReceiver
+ *
+ * One engine thread per process services the connections of every
+ * UringReceiver. With io_uring, each connection has a multishot recv
+ * outstanding which draws on a shared ring of provided buffers, so that a
+ * steady stream of data costs no system calls beyond the engine's one
+ * io_uring_enter per batch of completions. Where the kernel doesn't offer
+ * io_uring (or the "backend" key in connection_info asks for "epoll"), the
+ * same engine runs on epoll and recv instead.
+ *
+ * Frames (see SocketCommon.hpp) are reassembled on the engine thread and
+ * queued for the receiver that owns the connection.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_URINGENGINE_HPP_
+#define IPM_PLUGINS_URINGENGINE_HPP_
+
+#include "IoUring.hpp"
+#include "SocketCommon.hpp"
+
+#include "TRACE/trace.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+struct UringMessage
+{
+  std::string m_metadata;
+  std::vector<char> m_data;
+};
+
+// Reassembles frames from the bytes of a stream, in whatever pieces they arrive
+class FrameParser
+{
+public:
+  explicit FrameParser(uint64_t max_message_size)
+    : m_max_message_size(max_message_size)
+  {}
+
+  /**
+   * @brief Calls on_message(UringMessage&&) for each frame completed by these bytes
+   * @return false if a frame's header gives a topic and payload over the size
+   * limit; nothing after that header is read, and the stream is no longer usable
+   */
+  template<typename F>
+  bool feed(const char* data, size_t size, F&& on_message)
+  {
+    while (size > 0) {
+      if (m_header_bytes < sizeof(m_header)) {
+        size_t count = std::min(size, sizeof(m_header) - m_header_bytes);
+        memcpy(reinterpret_cast<char*>(&m_header) + m_header_bytes, data, count);
+        m_header_bytes += count;
+        data += count;
+        size -= count;
+        if (m_header_bytes < sizeof(m_header)) {
+          return true;
+        }
+        if (message_size() > m_max_message_size) {
+          return false;
+        }
+        m_message.m_metadata.resize(ntohl(m_header.m_topic_size));
+        m_message.m_data.resize(ntohl(m_header.m_payload_size));
+        m_body_bytes = 0;
+      }
+
+      size_t topic_size = m_message.m_metadata.size();
+      size_t body_size = topic_size + m_message.m_data.size();
+      while (size > 0 && m_body_bytes < body_size) {
+        char* destination = m_body_bytes < topic_size ? m_message.m_metadata.data() + m_body_bytes
+                                                      : m_message.m_data.data() + (m_body_bytes - topic_size);
+        size_t count = std::min(size, (m_body_bytes < topic_size ? topic_size : body_size) - m_body_bytes);
+        memcpy(destination, data, count);
+        m_body_bytes += count;
+        data += count;
+        size -= count;
+      }
+      if (m_body_bytes == body_size) {
+        on_message(std::move(m_message));
+        m_message = UringMessage();
+        m_header_bytes = 0;
+      }
+    }
+    return true;
+  }
+
+  // The topic and payload size given by the current header
+  uint64_t message_size() const noexcept
+  {
+    return uint64_t(ntohl(m_header.m_topic_size)) + ntohl(m_header.m_payload_size);
+  }
+  uint64_t max_message_size() const noexcept { return m_max_message_size; }
+
+  // Drops any partial frame, when the stream it came from has gone
+  void reset()
+  {
+    m_message = UringMessage();
+    m_header_bytes = 0;
+  }
+
+private:
+  uint64_t m_max_message_size;
+  FrameHeader m_header{};
+  size_t m_header_bytes{ 0 };
+  size_t m_body_bytes{ 0 };
+  UringMessage m_message;
+};
+
+/**
+ * @brief One receiver's connection to its sender, and the queue of messages
+ * received on it. The socket and parser belong to the engine thread; the queue
+ * is shared with the receiver.
+ */
+class UringConnection
+{
+public:
+  UringConnection(const nlohmann::json& connection_info, size_t capacity)
+    : m_connection_info(connection_info)
+    , m_connection_string(connection_info.value<std::string>("connection_string", ""))
+    , m_address(resolve_address(SocketFamily::Tcp, m_connection_string))
+    , m_parser(max_message_size(connection_info))
+    , m_capacity(capacity)
+    , m_ready_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+    if (m_ready_fd < 0) {
+      throw SocketError(ERS_HERE, m_connection_string, std::string("eventfd failed: ") + strerror(errno));
+    }
+  }
+
+  ~UringConnection() { close(m_ready_fd); }
+
+  UringConnection(const UringConnection&) = delete;
+  UringConnection& operator=(const UringConnection&) = delete;
+
+  // Readable while the queue holds a message, for UringReceiver::readiness_fd
+  int readiness_fd() const noexcept { return m_ready_fd; }
+
+  /**
+   * @brief Wait up to timeout for a message, then call consume(UringMessage&)
+   * on it; the message is dequeued if consume returns true
+   * @param counters If not null, a wait for the message is recorded there
+   * @return false if no message arrived in time
+   */
+  template<typename Duration, typename F>
+  bool pop(const Duration& timeout, F&& consume, EndpointCounters* counters = nullptr)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto ready = [&]() { return !m_queue.empty(); };
+    if (!ready()) {
+      WaitTimer timer(counters);
+      if (timeout == Duration::max()) {
+        m_not_empty.wait(lock, ready);
+      } else if (!m_not_empty.wait_for(lock, timeout, ready)) {
+        return false;
+      }
+    }
+    if (consume(m_queue.front())) {
+      m_queue.pop_front();
+      if (m_queue.empty()) {
+        uint64_t count = 0;
+        [[maybe_unused]] auto res = read(m_ready_fd, &count, sizeof(count));
+      }
+      // The engine stopped reading this connection when the queue filled up;
+      // let it carry on once there is a good amount of room again
+      if (m_waiting_for_room && m_queue.size() <= m_capacity / 2) {
+        m_waiting_for_room = false;
+        lock.unlock();
+        if (m_on_room) {
+          m_on_room();
+        }
+      }
+    }
+    return true;
+  }
+
+  size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+  }
+
+private:
+  friend class UringEngine;
+
+  // Returns false if the queue is now full and the engine should stop reading
+  bool push(UringMessage&& message)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push_back(std::move(message));
+      if (m_queue.size() == 1) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto res = write(m_ready_fd, &one, sizeof(one));
+      }
+      if (m_queue.size() >= m_capacity) {
+        m_waiting_for_room = true;
+      }
+    }
+    m_not_empty.notify_one();
+    return !m_waiting_for_room;
+  }
+
+  nlohmann::json m_connection_info;
+  std::string m_connection_string;
+  SocketAddress m_address;
+
+  // Engine thread only
+  int m_fd{ -1 };
+  bool m_connecting{ false };
+  bool m_receiving{ false }; // A recv is outstanding (io_uring) or the fd is in the epoll set
+  bool m_paused{ false };
+  uint64_t m_receive_id{ 0 }; // Identifies the current recv (or epoll registration) in completions
+  std::chrono::steady_clock::time_point m_next_attempt{};
+  FrameParser m_parser;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_not_empty;
+  std::deque<UringMessage> m_queue;
+  size_t m_capacity;
+  int m_ready_fd; // An eventfd, kept readable while m_queue isn't empty
+  bool m_waiting_for_room{ false };
+  std::function<void()> m_on_room;
+};
+
+class UringEngine
+{
+public:
+  enum class Backend
+  {
+    IoUring,
+    Epoll,
+  };
+
+  // The engine for a backend, started on first use. If io_uring isn't
+  // available, its engine runs on epoll instead.
+  static UringEngine& instance(Backend backend)
+  {
+    if (backend == Backend::IoUring) {
+      static UringEngine s_io_uring_engine(Backend::IoUring);
+      return s_io_uring_engine;
+    }
+    static UringEngine s_epoll_engine(Backend::Epoll);
+    return s_epoll_engine;
+  }
+
+  ~UringEngine()
+  {
+    m_stop = true;
+    wake();
+    m_thread.join();
+    for (auto& connection : m_connections) {
+      close_socket(*connection);
+    }
+    if (m_epoll_fd >= 0) {
+      close(m_epoll_fd);
+    }
+    close(m_wake_fd);
+  }
+
+  UringEngine(const UringEngine&) = delete;
+  UringEngine& operator=(const UringEngine&) = delete;
+
+  Backend backend() const noexcept { return m_backend; }
+
+  void add(std::shared_ptr<UringConnection> connection)
+  {
+    std::weak_ptr<UringConnection> weak = connection;
+    connection->m_on_room = [this, weak]() {
+      if (auto resumed = weak.lock()) {
+        request(m_resumed, std::move(resumed));
+      }
+    };
+    request(m_added, std::move(connection));
+  }
+
+  // Once this returns, the engine no longer touches the connection's queue
+  void remove(const std::shared_ptr<UringConnection>& connection)
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_removed.push_back(connection);
+    lock.unlock();
+    wake();
+    lock.lock();
+    m_removal_done.wait(lock, [&]() {
+      if (m_stop) {
+        return true;
+      }
+      for (auto& pending : m_removed) {
+        if (pending == connection) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+
+private:
+  explicit UringEngine(Backend backend)
+    : m_backend(backend)
+  {
+    m_wake_fd = eventfd(0, EFD_CLOEXEC);
+#if IPM_HAVE_IO_URING
+    if (m_backend == Backend::IoUring && !init_io_uring()) {
+      TLOG(TLVL_INFO) << "io_uring is not available (" << strerror(errno) << "), falling back to epoll";
+      m_ring.reset();
+      m_buffers.reset();
+      m_backend = Backend::Epoll;
+    }
+#else
+    m_backend = Backend::Epoll;
+#endif
+    if (m_backend == Backend::Epoll) {
+      fcntl(m_wake_fd, F_SETFL, O_NONBLOCK);
+      m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.u64 = s_wake_id;
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event);
+    }
+    m_thread = std::thread([this]() { run(); });
+  }
+
+  void request(std::vector<std::shared_ptr<UringConnection>>& requests, std::shared_ptr<UringConnection> connection)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      requests.push_back(std::move(connection));
+    }
+    wake();
+  }
+
+  void wake()
+  {
+    uint64_t one = 1;
+    [[maybe_unused]] auto result = write(m_wake_fd, &one, sizeof(one));
+  }
+
+  void run()
+  {
+    while (!m_stop) {
+      take_requests();
+      bool retrying = make_connections();
+      // While connections are being retried, wake up often enough to carry on with them
+      wait_and_dispatch(retrying ? s_connect_retry_interval.count() : -1);
+    }
+  }
+
+  void take_requests()
+  {
+    std::vector<std::shared_ptr<UringConnection>> added, removed, resumed;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      added.swap(m_added);
+      removed = m_removed;
+      resumed.swap(m_resumed);
+    }
+
+    for (auto& connection : added) {
+      m_connections.push_back(std::move(connection));
+    }
+    for (auto& connection : resumed) {
+      connection->m_paused = false;
+      if (connection->m_fd >= 0 && !connection->m_connecting) {
+        start_receiving(*connection);
+      }
+    }
+    if (!removed.empty()) {
+      for (auto& connection : removed) {
+        close_socket(*connection);
+        for (auto it = m_connections.begin(); it != m_connections.end(); ++it) {
+          if (*it == connection) {
+            m_connections.erase(it);
+            break;
+          }
+        }
+      }
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_removed.erase(m_removed.begin(), m_removed.begin() + removed.size());
+      m_removal_done.notify_all();
+    }
+  }
+
+  // Connects, or carries on connecting, every connection without a socket. Returns true if any are still pending.
+  bool make_connections()
+  {
+    bool pending = false;
+    auto now = std::chrono::steady_clock::now();
+    for (auto& connection_ptr : m_connections) {
+      UringConnection& connection = *connection_ptr;
+      if (connection.m_fd >= 0 && !connection.m_connecting) {
+        continue;
+      }
+      pending = true;
+
+      if (connection.m_fd < 0) {
+        if (now < connection.m_next_attempt) {
+          continue;
+        }
+        connection.m_fd =
+          socket(connection.m_address.m_address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (connection.m_fd < 0) {
+          connection.m_next_attempt = now + s_connect_retry_interval;
+          continue;
+        }
+        try {
+          apply_socket_options(connection.m_fd, SocketFamily::Tcp, connection.m_connection_info);
+        } catch (SocketError const& err) {
+          ers::error(err);
+          close_socket(connection);
+          connection.m_next_attempt = now + s_connect_retry_interval;
+          continue;
+        }
+        if (connect(connection.m_fd,
+                    reinterpret_cast<const sockaddr*>(&connection.m_address.m_address),
+                    connection.m_address.m_length) == 0) {
+          connection.m_connecting = false;
+        } else if (errno == EINPROGRESS) {
+          connection.m_connecting = true;
+        } else {
+          close_socket(connection); // Most likely the sender isn't listening yet
+          continue;
+        }
+      }
+
+      if (connection.m_connecting) {
+        pollfd item{ connection.m_fd, POLLOUT, 0 };
+        if (poll(&item, 1, 0) <= 0) {
+          continue;
+        }
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(connection.m_fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+          close_socket(connection);
+          continue;
+        }
+        connection.m_connecting = false;
+      }
+
+      TLOG(TLVL_INFO) << "Connected to " << connection.m_connection_string;
+      if (m_backend == Backend::IoUring) {
+        // io_uring waits for data itself, and would fail a recv on a non-blocking socket instead
+        fcntl(connection.m_fd, F_SETFL, fcntl(connection.m_fd, F_GETFL) & ~O_NONBLOCK);
+      }
+      if (!connection.m_paused) {
+        start_receiving(connection);
+      }
+    }
+    return pending;
+  }
+
+  // Closes the socket after a disconnection (or on removal), dropping any partial frame
+  void close_socket(UringConnection& connection)
+  {
+    if (connection.m_fd < 0) {
+      return;
+    }
+    stop_receiving(connection);
+    // Anything still to complete on the old socket is of no use now
+    for (auto it = m_receives.begin(); it != m_receives.end();) {
+      it = it->second == &connection ? m_receives.erase(it) : std::next(it);
+    }
+    close(connection.m_fd);
+    connection.m_fd = -1;
+    connection.m_connecting = false;
+    connection.m_parser.reset();
+    connection.m_next_attempt = std::chrono::steady_clock::now() + s_connect_retry_interval;
+  }
+
+  void disconnected(UringConnection& connection)
+  {
+    TLOG(TLVL_INFO) << "Lost sender on " << connection.m_connection_string;
+    close_socket(connection);
+  }
+
+  /**
+   * @brief Queues the frames in newly received bytes, and stops reading if the
+   * queue fills up. A frame over the size limit closes the socket, as the
+   * stream can't be trusted after it; the connection is then made again.
+   * @return false if the socket was closed
+   */
+  bool received(UringConnection& connection, const char* data, size_t size)
+  {
+    bool room = true;
+    auto& parser = connection.m_parser;
+    if (!parser.feed(data, size, [&](UringMessage&& message) { room = connection.push(std::move(message)); })) {
+      ers::error(
+        FrameTooLarge(ERS_HERE, connection.m_connection_string, parser.message_size(), parser.max_message_size()));
+      close_socket(connection);
+      return false;
+    }
+    if (!room && !connection.m_paused) {
+      connection.m_paused = true;
+      stop_receiving(connection);
+    }
+    return true;
+  }
+
+  void start_receiving(UringConnection& connection)
+  {
+    if (connection.m_receiving) {
+      return;
+    }
+    connection.m_receiving = true;
+    connection.m_receive_id = ++m_last_receive_id;
+    m_receives[connection.m_receive_id] = &connection;
+#if IPM_HAVE_IO_URING
+    if (m_backend == Backend::IoUring) {
+      io_uring_sqe* sqe = get_sqe();
+      sqe->opcode = IORING_OP_RECV;
+      sqe->fd = connection.m_fd;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = s_buffer_group;
+      sqe->ioprio = m_multishot ? IORING_RECV_MULTISHOT : 0;
+      sqe->user_data = connection.m_receive_id;
+      return;
+    }
+#endif
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = connection.m_receive_id;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, connection.m_fd, &event);
+  }
+
+  void stop_receiving(UringConnection& connection)
+  {
+    if (!connection.m_receiving) {
+      return;
+    }
+    connection.m_receiving = false;
+    uint64_t receive_id = std::exchange(connection.m_receive_id, 0);
+#if IPM_HAVE_IO_URING
+    if (m_backend == Backend::IoUring) {
+      // Data the recv took from the socket before the cancellation still
+      // completes, and is still queued; the ID is forgotten with its last completion
+      io_uring_sqe* sqe = get_sqe();
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = receive_id;
+      sqe->user_data = s_cancel_id;
+      return;
+    }
+#endif
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, connection.m_fd, nullptr);
+    m_receives.erase(receive_id);
+  }
+
+  void wait_and_dispatch(int timeout_ms)
+  {
+#if IPM_HAVE_IO_URING
+    if (m_backend == Backend::IoUring) {
+      timespec timeout{ 0, timeout_ms * 1000000L };
+      m_ring->submit_and_wait(1, timeout_ms >= 0 ? &timeout : nullptr);
+      m_ring->for_each_cqe([this](const io_uring_cqe& cqe) { dispatch(cqe); });
+      return;
+    }
+#endif
+    epoll_event events[64];
+    int num_events = epoll_wait(m_epoll_fd, events, 64, timeout_ms);
+    for (int i = 0; i < num_events; ++i) {
+      if (events[i].data.u64 == s_wake_id) {
+        uint64_t count;
+        [[maybe_unused]] auto result = read(m_wake_fd, &count, sizeof(count));
+        continue;
+      }
+      auto found = m_receives.find(events[i].data.u64);
+      if (found == m_receives.end()) {
+        continue;
+      }
+      UringConnection& connection = *found->second;
+      // Read until the socket is drained, or until the receiver's queue is full
+      while (connection.m_receiving) {
+        ssize_t result = recv(connection.m_fd, m_scratch.data(), m_scratch.size(), MSG_DONTWAIT);
+        if (result > 0) {
+          received(connection, m_scratch.data(), static_cast<size_t>(result));
+        } else if (result < 0 && errno == EINTR) {
+          continue;
+        } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          break;
+        } else {
+          disconnected(connection);
+        }
+      }
+    }
+  }
+
+#if IPM_HAVE_IO_URING
+  bool init_io_uring()
+  {
+    m_ring = std::make_unique<IoUring>();
+    m_buffers = std::make_unique<ProvidedBufferRing>(s_num_receive_buffers, s_receive_buffer_size);
+    if (!m_ring->init(s_ring_entries) || !m_buffers->register_with(*m_ring, s_buffer_group)) {
+      return false;
+    }
+    arm_wake_read();
+    return true;
+  }
+
+  io_uring_sqe* get_sqe()
+  {
+    io_uring_sqe* sqe = m_ring->get_sqe();
+    while (sqe == nullptr) {
+      m_ring->submit_and_wait(0);
+      sqe = m_ring->get_sqe();
+    }
+    return sqe;
+  }
+
+  void arm_wake_read()
+  {
+    io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wake_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&m_wake_count);
+    sqe->len = sizeof(m_wake_count);
+    sqe->user_data = s_wake_id;
+  }
+
+  void dispatch(const io_uring_cqe& cqe)
+  {
+    if (cqe.user_data == s_wake_id) {
+      if (!m_stop) {
+        arm_wake_read();
+      }
+      return;
+    }
+    if (cqe.user_data == s_cancel_id) {
+      return;
+    }
+
+    auto found = m_receives.find(cqe.user_data);
+    UringConnection* connection = found == m_receives.end() ? nullptr : found->second;
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      auto id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      if (connection != nullptr && cqe.res > 0 &&
+          !received(*connection, m_buffers->buffer(id), static_cast<size_t>(cqe.res))) {
+        connection = nullptr; // Closing the socket has already forgotten this recv
+      }
+      m_buffers->give_back(id);
+    }
+    if (connection == nullptr || (cqe.flags & IORING_CQE_F_MORE)) {
+      return; // A recv on a closed socket, or a multishot recv which carries on
+    }
+
+    // The recv has finished: unless we cancelled it, find out why, and start another if appropriate
+    m_receives.erase(found);
+    if (cqe.user_data != connection->m_receive_id) {
+      return;
+    }
+    connection->m_receiving = false;
+    connection->m_receive_id = 0;
+    if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -EINVAL && cqe.res != -EINTR)) {
+      disconnected(*connection);
+      return;
+    }
+    if (cqe.res == -EINVAL && m_multishot) {
+      TLOG(TLVL_INFO) << "Multishot recv is not supported, falling back to one recv at a time";
+      m_multishot = false;
+    }
+    if (!connection->m_paused) {
+      start_receiving(*connection);
+    }
+  }
+
+  static constexpr unsigned s_ring_entries = 256;
+  static constexpr unsigned s_num_receive_buffers = 256;
+  static constexpr size_t s_receive_buffer_size = 64 * 1024;
+  static constexpr uint16_t s_buffer_group = 0;
+
+  std::unique_ptr<IoUring> m_ring;
+  std::unique_ptr<ProvidedBufferRing> m_buffers;
+  bool m_multishot{ true };
+  uint64_t m_wake_count{ 0 };
+#endif
+
+  // Completion/event IDs which don't refer to a recv; recv IDs start at 1
+  static constexpr uint64_t s_wake_id = 0;
+  static constexpr uint64_t s_cancel_id = ~uint64_t(0);
+  static constexpr std::chrono::milliseconds s_connect_retry_interval{ 10 };
+
+  Backend m_backend;
+  int m_wake_fd{ -1 };
+  int m_epoll_fd{ -1 };
+  std::vector<char> m_scratch = std::vector<char>(64 * 1024); // Read buffer for the epoll backend
+
+  std::atomic<bool> m_stop{ false };
+  std::thread m_thread;
+
+  // Engine thread only
+  std::vector<std::shared_ptr<UringConnection>> m_connections;
+  std::unordered_map<uint64_t, UringConnection*> m_receives;
+  uint64_t m_last_receive_id{ 0 };
+
+  std::mutex m_mutex;
+  std::condition_variable m_removal_done;
+  std::vector<std::shared_ptr<UringConnection>> m_added;
+  std::vector<std::shared_ptr<UringConnection>> m_removed;
+  std::vector<std::shared_ptr<UringConnection>> m_resumed;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_URINGENGINE_HPP_
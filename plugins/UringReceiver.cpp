@@ -0,0 +1,108 @@
+/**
+ *
+ * @file UringReceiver.cpp UringReceiver messaging class definitions
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "UringEngine.hpp"
+
+#include "ipm/Receiver.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "UringReceiver"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace dunedaq {
+namespace ipm {
+
+class UringReceiver : public Receiver
+{
+public:
+  ~UringReceiver()
+  {
+    if (m_connection) {
+      m_engine->remove(m_connection);
+    }
+  }
+
+  bool can_receive() const noexcept override { return m_connection != nullptr; }
+  int readiness_fd() const override { return m_connection ? m_connection->readiness_fd() : -1; }
+  void connect_for_receives(const nlohmann::json& connection_info) override
+  {
+    TLOG(TLVL_INFO) << "Connection String is " << connection_info.value<std::string>("connection_string", "");
+    validate_socket_options(connection_info);
+    auto backend = connection_info.value<std::string>("backend", "io_uring") == "epoll"
+                     ? UringEngine::Backend::Epoll
+                     : UringEngine::Backend::IoUring;
+    m_connection = std::make_shared<UringConnection>(connection_info,
+                                                     connection_info.value<size_t>("capacity", s_default_capacity));
+    m_engine = &UringEngine::instance(backend);
+    m_engine->add(m_connection);
+  }
+
+protected:
+  // The engine thread has already reassembled the message; it is moved into the Response
+  Receiver::Response receive_(const duration_t& timeout) override
+  {
+    Receiver::Response output;
+    auto move_out = [&](UringMessage& message) {
+      output.m_metadata = std::move(message.m_metadata);
+      output.m_data = std::move(message.m_data);
+      return true;
+    };
+    if (!m_connection->pop(timeout, move_out, &counters())) {
+      throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+    }
+    TLOG(TLVL_TRACE + 2) << "Received " << output.m_data.size() << " bytes";
+    return output;
+  }
+
+  // A message which doesn't fit stays at the front of the queue
+  Receiver::ReceiveIntoResult receive_into_(void* buffer,
+                                            message_size_t buffer_size,
+                                            const duration_t& timeout,
+                                            std::string* metadata) override
+  {
+    Receiver::ReceiveIntoResult result;
+    auto copy_out = [&](UringMessage& message) {
+      result.m_size = static_cast<message_size_t>(message.m_data.size());
+      if (result.m_size > buffer_size) {
+        result.m_buffer_too_small = true;
+        return false;
+      }
+      if (result.m_size > 0) {
+        memcpy(buffer, message.m_data.data(), message.m_data.size());
+      }
+      if (metadata) {
+        *metadata = std::move(message.m_metadata);
+      }
+      return true;
+    };
+    if (!m_connection->pop(timeout, copy_out, &counters())) {
+      result.m_timed_out = true;
+    }
+    return result;
+  }
+
+  bool ready_to_receive_() override { return !m_connection || m_connection->size() > 0; }
+
+  size_t queue_depth_() const override { return m_connection ? m_connection->size() : 0; }
+
+private:
+  static constexpr size_t s_default_capacity = 1000;
+
+  UringEngine* m_engine{ nullptr };
+  std::shared_ptr<UringConnection> m_connection;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_RECEIVER(dunedaq::ipm::UringReceiver)
@@ -0,0 +1,316 @@
+/**
+ *
+ * @file UringSender.cpp UringSender messaging class definitions
+ *
+ * UringSender speaks the same protocol as TcpSender, and shares its
+ * connection handling. What it adds is send_batch: with io_uring the frames
+ * of a batch are submitted as one chain of linked sendmsg operations, in a
+ * single system call; without it they are gathered into as few sendmsg calls
+ * as IOV_MAX allows. Either way, the batch stops once its deadline passes; a
+ * frame left part-written then can't be resumed, so the connection is dropped
+ * (the receiver sees the sender go away, never a partial message).
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "IoUring.hpp"
+#include "SocketSenderImpl.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "UringSender"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+class UringSender : public SocketSenderImpl
+{
+public:
+  UringSender()
+    : SocketSenderImpl(SocketFamily::Tcp)
+  {}
+
+  void connect_for_sends(const nlohmann::json& connection_info) override
+  {
+    SocketSenderImpl::connect_for_sends(connection_info);
+#if IPM_HAVE_IO_URING
+    if (connection_info.value<std::string>("backend", "io_uring") != "epoll") {
+      m_ring = std::make_unique<IoUring>();
+      if (!m_ring->init(s_ring_entries)) {
+        TLOG(TLVL_INFO) << "io_uring is not available (" << strerror(errno) << "), batches will use sendmsg";
+        m_ring.reset();
+      }
+    }
+#endif
+  }
+
+protected:
+  size_t send_batch_(const BatchEntry* entries, size_t num_entries, const duration_t& timeout) override
+  {
+    auto start_time = std::chrono::steady_clock::now();
+    size_t next = 0;
+    while (next < num_entries) {
+      if (entries[next].m_size == 0) {
+        ++next;
+        continue;
+      }
+      if (!wait_for_peer(start_time, timeout)) {
+        return next;
+      }
+
+      size_t end = prepare_frames(entries, next, num_entries);
+      if (timeout == s_no_block) {
+        end = keep_frames_that_fit(end);
+        if (m_frames.empty()) {
+          return next;
+        }
+      }
+      Outcome outcome = Outcome::Done;
+      size_t num_sent = 0;
+#if IPM_HAVE_IO_URING
+      // Without time to wait there is nothing for the ring to overlap, and the frames kept all fit
+      if (m_ring && timeout != s_no_block) {
+        num_sent = write_frames_io_uring(start_time, timeout, outcome);
+      } else
+#endif
+      {
+        num_sent = write_frames_gathered(start_time, timeout, outcome);
+      }
+
+      next = num_sent < m_frames.size() ? m_frames[num_sent].m_entry : end;
+      if (outcome == Outcome::TimedOut) {
+        return next;
+      }
+      // Otherwise carry on from the first frame not sent, with a new receiver if the last one went away
+    }
+    return num_entries;
+  }
+
+private:
+  enum class Outcome
+  {
+    Done,
+    TimedOut, // The deadline passed before the next frame was started
+    Retry,    // Nothing more was written, but there is still time
+  };
+
+  struct Frame
+  {
+    FrameHeader m_header;
+    iovec m_iov[3];
+    msghdr m_msg;
+    size_t m_entry; // Index in the batch
+  };
+
+  // Lays out frames for the non-empty entries from first onwards, up to s_max_frames; returns the entry after the last
+  size_t prepare_frames(const BatchEntry* entries, size_t first, size_t num_entries)
+  {
+    m_frames.clear();
+    m_frames.reserve(s_max_frames); // The iovecs point into the frames, so they mustn't move
+    size_t entry = first;
+    for (; entry < num_entries && m_frames.size() < s_max_frames; ++entry) {
+      if (entries[entry].m_size == 0) {
+        continue;
+      }
+      Frame& frame = m_frames.emplace_back();
+      frame.m_header = make_header(entries[entry].m_metadata.size(), entries[entry].m_size);
+      frame.m_entry = entry;
+      frame.m_iov[0] = { &frame.m_header, sizeof(frame.m_header) };
+      frame.m_iov[1] = { const_cast<char*>(entries[entry].m_metadata.data()), entries[entry].m_metadata.size() };
+      frame.m_iov[2] = { const_cast<void*>(entries[entry].m_message), static_cast<size_t>(entries[entry].m_size) };
+      frame.m_msg = msghdr{};
+      frame.m_msg.msg_iov = frame.m_iov;
+      frame.m_msg.msg_iovlen = 3;
+    }
+    return entry;
+  }
+
+  // Drops the first frame which won't fit in send_space() and those after it; returns the entry after the last kept
+  size_t keep_frames_that_fit(size_t end)
+  {
+    size_t space = send_space();
+    size_t num_kept = 0;
+    while (num_kept < m_frames.size() && frame_size(m_frames[num_kept]) <= space) {
+      space -= frame_size(m_frames[num_kept]);
+      ++num_kept;
+    }
+    if (num_kept < m_frames.size()) {
+      end = m_frames[num_kept].m_entry;
+      m_frames.erase(m_frames.begin() + static_cast<std::ptrdiff_t>(num_kept), m_frames.end());
+    }
+    return end;
+  }
+
+  static size_t frame_size(const Frame& frame)
+  {
+    return frame.m_iov[0].iov_len + frame.m_iov[1].iov_len + frame.m_iov[2].iov_len;
+  }
+
+  bool deadline_passed(std::chrono::steady_clock::time_point start_time, const duration_t& timeout) const
+  {
+    return timeout != duration_t::max() && std::chrono::steady_clock::now() - start_time >= timeout;
+  }
+
+  /**
+   * @brief Without io_uring, gather the frames into as few sendmsg calls as
+   * IOV_MAX allows. If the deadline passes while waiting for room, the rest
+   * are left unsent, and a frame in progress drops the connection.
+   * @return The number of frames sent
+   */
+  size_t write_frames_gathered(std::chrono::steady_clock::time_point start_time,
+                               const duration_t& timeout,
+                               Outcome& outcome)
+  {
+    m_iov.clear();
+    for (auto& frame : m_frames) {
+      m_iov.insert(m_iov.end(), frame.m_iov, frame.m_iov + 3);
+    }
+
+    iovec* iov = m_iov.data();
+    size_t num_iov = m_iov.size();
+    size_t num_sent = 0;
+    size_t frame_bytes = 0; // Of frame num_sent, written so far
+    while (num_iov > 0) {
+      msghdr msg{};
+      msg.msg_iov = iov;
+      msg.msg_iovlen = iovec_limit(num_iov);
+      ssize_t result = sendmsg(peer_fd(), &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (result >= 0) {
+        advance_iovecs(iov, num_iov, static_cast<size_t>(result));
+        frame_bytes += static_cast<size_t>(result);
+        while (num_sent < m_frames.size() && frame_bytes >= frame_size(m_frames[num_sent])) {
+          frame_bytes -= frame_size(m_frames[num_sent]);
+          ++num_sent;
+        }
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (wait_for_fd(peer_fd(), POLLOUT, start_time, timeout, &counters())) {
+          continue;
+        }
+        if (frame_bytes > 0) {
+          TLOG(TLVL_INFO) << "Timed out part way through a frame, dropping the receiver on " << connection_string();
+          close_peer();
+        }
+        outcome = Outcome::TimedOut;
+        return num_sent;
+      } else if (errno != EINTR) {
+        TLOG(TLVL_INFO) << "Lost receiver: " << strerror(errno);
+        close_peer();
+        if (frame_bytes > 0) {
+          throw PeerDisconnected(ERS_HERE, connection_string());
+        }
+        outcome = Outcome::Retry;
+        return num_sent;
+      }
+    }
+    outcome = Outcome::Done;
+    return num_sent;
+  }
+
+#if IPM_HAVE_IO_URING
+  /**
+   * @brief Submit the frames as a chain of linked sendmsg operations, so that
+   * each starts only once the one before has completed in full. If the
+   * deadline passes first, the rest of the chain is cancelled; a frame which
+   * had started by then drops the connection.
+   * @return The number of frames sent
+   */
+  size_t write_frames_io_uring(std::chrono::steady_clock::time_point start_time,
+                               const duration_t& timeout,
+                               Outcome& outcome)
+  {
+    size_t num_frames = m_frames.size();
+    for (size_t i = 0; i < num_frames; ++i) {
+      io_uring_sqe* sqe = m_ring->get_sqe();
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->fd = peer_fd();
+      sqe->addr = reinterpret_cast<uint64_t>(&m_frames[i].m_msg);
+      sqe->len = 1;
+      // MSG_WAITALL makes a short send carry on rather than complete, so the next frame can't overtake it
+      sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+      sqe->flags = i + 1 < num_frames ? IOSQE_IO_LINK : 0;
+      sqe->user_data = i;
+    }
+
+    m_results.assign(num_frames, 0);
+    size_t num_completions = 0;
+    size_t num_expected = num_frames;
+    bool cancelled = false;
+    while (num_completions < num_expected) {
+      timespec remaining{ 0, 0 };
+      const timespec* wait_limit = nullptr;
+      if (!cancelled && timeout != duration_t::max()) {
+        auto left = start_time + timeout - std::chrono::steady_clock::now();
+        if (left > std::chrono::steady_clock::duration::zero()) {
+          auto left_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+          remaining = { static_cast<time_t>(left_ns / 1000000000), static_cast<long>(left_ns % 1000000000) };
+        }
+        wait_limit = &remaining;
+      }
+      int result = 0;
+      {
+        WaitTimer timer(&counters());
+        result = m_ring->submit_and_wait(static_cast<unsigned>(num_expected - num_completions), wait_limit);
+      }
+      num_completions += m_ring->for_each_cqe([&](const io_uring_cqe& cqe) {
+        if (cqe.user_data < num_frames) {
+          m_results[cqe.user_data] = cqe.res;
+        }
+      });
+      if (result == -ETIME && !cancelled && num_completions < num_expected) {
+        io_uring_sqe* sqe = m_ring->get_sqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = peer_fd();
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = s_cancel_id;
+        cancelled = true;
+        ++num_expected;
+      }
+    }
+
+    for (size_t i = 0; i < num_frames; ++i) {
+      int result = m_results[i];
+      size_t size = frame_size(m_frames[i]);
+      if (result >= 0 && static_cast<size_t>(result) == size) {
+        continue;
+      }
+      if (result > 0) {
+        // Stopped part way through the frame, which the receiver mustn't be left holding
+        TLOG(TLVL_INFO) << "Stopped part way through a frame, dropping the receiver on " << connection_string();
+        close_peer();
+      } else if (result != 0 && result != -ECANCELED && result != -EINTR && result != -EAGAIN) {
+        TLOG(TLVL_INFO) << "Lost receiver: " << strerror(-result);
+        close_peer();
+        outcome = Outcome::Retry;
+        return i;
+      }
+      outcome = deadline_passed(start_time, timeout) ? Outcome::TimedOut : Outcome::Retry;
+      return i;
+    }
+    outcome = Outcome::Done;
+    return num_frames;
+  }
+
+  static constexpr unsigned s_ring_entries = 256;
+  static constexpr uint64_t s_cancel_id = ~uint64_t(0);
+
+  std::unique_ptr<IoUring> m_ring;
+  std::vector<int> m_results;
+#endif
+
+  static constexpr size_t s_max_frames = 128; // Within both the ring and IOV_MAX / 3
+
+  std::vector<Frame> m_frames;
+  std::vector<iovec> m_iov;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_SENDER(dunedaq::ipm::UringSender)
@@ -0,0 +1,90 @@
+/**
+ *
+ * @file ZmqCoalescing.hpp Packing of many small messages into one ZeroMQ payload frame
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_ZMQCOALESCING_HPP_
+#define IPM_PLUGINS_ZMQCOALESCING_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+/**
+ * @brief What a sender with "coalesce_bytes" set appends to the header frame
+ * of a message whose payload frame packs several sends on one topic. Like
+ * ZmqMessageStamp, it follows the topic so that subscriptions still match.
+ * The magic starts (in memory) with 0xff, which is never part of a UTF-8
+ * topic, so that no topic string is mistaken for one.
+ */
+struct ZmqCoalescedMarker
+{
+  static constexpr uint32_t s_magic = 0x4c4f43ff; // "\xff" "COL", read little-endian
+
+  uint32_t m_count;    // Messages in the payload frame
+  uint32_t m_magic{ s_magic };
+
+  void write_to(void* end_of_header) const { memcpy(end_of_header, this, sizeof(ZmqCoalescedMarker)); }
+
+  // True, with marker filled in, if the header ends in a marker
+  static bool read_from(const void* header, size_t header_size, ZmqCoalescedMarker& marker)
+  {
+    if (header_size < sizeof(ZmqCoalescedMarker)) {
+      return false;
+    }
+    memcpy(&marker,
+           static_cast<const char*>(header) + header_size - sizeof(ZmqCoalescedMarker),
+           sizeof(ZmqCoalescedMarker));
+    return marker.m_magic == s_magic && marker.m_count > 0;
+  }
+};
+
+static_assert(sizeof(ZmqCoalescedMarker) == 8, "ZmqCoalescedMarker is sent as-is, so must have no padding");
+
+/**
+ * @brief The payload frame of a coalesced message: each message in turn, as
+ * its size (32 bits, in the sender's byte order) followed by its bytes.
+ */
+struct ZmqCoalescedFrame
+{
+  static constexpr size_t s_size_bytes = sizeof(uint32_t);
+
+  static void append(std::vector<char>& frame, const void* message, uint32_t size)
+  {
+    auto offset = frame.size();
+    frame.resize(offset + s_size_bytes + size);
+    memcpy(frame.data() + offset, &size, s_size_bytes);
+    memcpy(frame.data() + offset + s_size_bytes, message, size);
+  }
+
+  /**
+   * @brief Find the message at offset, and move offset on past it
+   * @return False if there is no whole message there
+   */
+  static bool next(const char* frame, size_t frame_size, size_t& offset, std::string_view& message)
+  {
+    uint32_t size = 0;
+    if (frame_size - offset < s_size_bytes) {
+      return false;
+    }
+    memcpy(&size, frame + offset, s_size_bytes);
+    if (frame_size - offset - s_size_bytes < size) {
+      return false;
+    }
+    message = std::string_view(frame + offset + s_size_bytes, size);
+    offset += s_size_bytes + size;
+    return true;
+  }
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_ZMQCOALESCING_HPP_
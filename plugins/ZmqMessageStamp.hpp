@@ -0,0 +1,63 @@
+/**
+ *
+ * @file ZmqMessageStamp.hpp Send timestamps and sequence numbers carried in the header frame of ZeroMQ messages
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_ZMQMESSAGESTAMP_HPP_
+#define IPM_PLUGINS_ZMQMESSAGESTAMP_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+namespace dunedaq {
+namespace ipm {
+
+/**
+ * @brief What a sender with "timestamps" set appends to the topic in the
+ * header frame of each message. Being after the topic, it leaves ZeroMQ's
+ * prefix matching of subscriptions unaffected; receivers recognise it by
+ * m_magic and strip it before the metadata reaches the caller. Both ends are
+ * assumed to share a byte order and, for the latency to mean anything, a
+ * synchronised clock.
+ */
+struct ZmqMessageStamp
+{
+  static constexpr uint64_t s_magic = 0x314d5453514d5049; // "IPMQSTM1", read little-endian
+
+  uint64_t m_stream;       // Identifies one sender's messages on one topic
+  uint64_t m_sequence;     // Counts up from 0 within the stream
+  int64_t m_send_time_ns;  // system_clock at the start of the send attempt which succeeded
+  uint64_t m_magic{ s_magic };
+
+  static int64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+  }
+
+  void write_to(void* end_of_header) const { memcpy(end_of_header, this, sizeof(ZmqMessageStamp)); }
+
+  /**
+   * @brief Look for a stamp at the end of a header frame
+   * @return True, with stamp filled in, if the header ends in one
+   */
+  static bool read_from(const void* header, size_t header_size, ZmqMessageStamp& stamp)
+  {
+    if (header_size < sizeof(ZmqMessageStamp)) {
+      return false;
+    }
+    memcpy(&stamp, static_cast<const char*>(header) + header_size - sizeof(ZmqMessageStamp), sizeof(ZmqMessageStamp));
+    return stamp.m_magic == s_magic;
+  }
+};
+
+static_assert(sizeof(ZmqMessageStamp) == 32, "ZmqMessageStamp is sent as-is, so must have no padding");
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_ZMQMESSAGESTAMP_HPP_
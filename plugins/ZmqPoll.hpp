@@ -0,0 +1,83 @@
+/**
+ *
+ * @file ZmqPoll.hpp Deadline-aware waiting on ZeroMQ socket readiness
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_ZMQPOLL_HPP_
+#define IPM_PLUGINS_ZMQPOLL_HPP_
+
+#include "ipm/EndpointInfo.hpp"
+
+#include "zmq.hpp"
+
+#include <cerrno>
+#include <chrono>
+
+namespace dunedaq {
+namespace ipm {
+
+/**
+ * @brief Sleep in zmq_poll until the socket reports one of events, or until
+ * the time left before start_time + timeout runs out
+ * @param timeout duration_t::max() waits without a deadline
+ * @param counters If not null, the wait is recorded there
+ * @return false once the deadline has passed, true otherwise (the caller
+ * should then retry its non-blocking operation)
+ */
+template<typename Duration>
+bool
+wait_for_socket(zmq::socket_t& socket,
+                short events,
+                std::chrono::steady_clock::time_point start_time,
+                const Duration& timeout,
+                EndpointCounters* counters = nullptr)
+{
+  long poll_timeout = -1; // Block until ready
+  if (timeout != Duration::max()) {
+    auto remaining = timeout - std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now() - start_time);
+    if (remaining <= Duration::zero()) {
+      return false;
+    }
+    poll_timeout = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+  }
+
+  WaitTimer timer(counters);
+  zmq::pollitem_t item{ static_cast<void*>(socket), 0, events, 0 };
+  try {
+    zmq::poll(&item, 1, poll_timeout);
+  } catch (zmq::error_t const& err) {
+    if (err.num() != EINTR) {
+      throw;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief The descriptor which ZeroMQ makes readable whenever the socket's
+ * events may have changed (ZMQ_FD), for waiting in an event loop
+ */
+inline int
+zmq_readiness_fd(const zmq::socket_t& socket)
+{
+  return socket.getsockopt<int>(ZMQ_FD);
+}
+
+/**
+ * @brief Whether the socket reports one of events (ZMQ_EVENTS). This also
+ * consumes the signal on ZMQ_FD, which is only raised again by a change, so
+ * check it before waiting on the descriptor.
+ */
+inline bool
+zmq_socket_ready(const zmq::socket_t& socket, int events)
+{
+  return (socket.getsockopt<int>(ZMQ_EVENTS) & events) != 0;
+}
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_ZMQPOLL_HPP_
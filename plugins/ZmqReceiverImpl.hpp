@@ -9,15 +9,36 @@
 #ifndef IPM_PLUGINS_ZMQRECEIVERIMPL_HPP_
 #define IPM_PLUGINS_ZMQRECEIVERIMPL_HPP_
 
+#include "ZmqCoalescing.hpp"
+#include "ZmqMessageStamp.hpp"
+#include "ZmqPoll.hpp"
+#include "ZmqSocketOptions.hpp"
+#include "ZmqTopicTable.hpp"
+
 #include "ipm/Subscriber.hpp"
 #include "ipm/ZmqContext.hpp"
 
 #include "TRACE/trace.h"
+#include "ers/Issue.h"
 #include "zmq.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm, ZmqReceiveFailed, "ZeroMQ receive failed: " << reason, ((std::string)reason)) // NOLINT
+} // namespace dunedaq
+
 namespace dunedaq {
 namespace ipm {
 
@@ -32,69 +53,480 @@ public:
   };
 
   explicit ZmqReceiverImpl(ReceiverType type)
-    : m_socket(ZmqContext::instance().GetContext(),
-               type == ReceiverType::Pull ? zmq::socket_type::pull : zmq::socket_type::sub)
+    : m_socket_type(type == ReceiverType::Pull ? zmq::socket_type::pull : zmq::socket_type::sub)
   {}
   bool can_receive() const noexcept override { return m_socket_connected; }
+  nlohmann::json effective_options() const override { return m_effective_options; }
+  int readiness_fd() const override { return m_readiness_fd; }
   void connect_for_receives(const nlohmann::json& connection_info) override
   {
     std::string connection_string = connection_info.value<std::string>("connection_string", "inproc://default");
     TLOG(TLVL_INFO) << "Connection String is " << connection_string;
-    m_socket.setsockopt(ZMQ_RCVTIMEO, 1); // 1 ms, we'll repeat until we reach timeout
+    // The socket is made here, as connection_info says which context it belongs to
+    m_socket = zmq::socket_t(ZmqContext::instance().context_for(connection_info), m_socket_type);
+    apply_zmq_socket_options(m_socket, connection_info);
+    m_effective_options = effective_zmq_socket_options(m_socket);
+    TLOG(TLVL_INFO) << "Socket options are " << m_effective_options.dump();
+    m_topic_table = ZmqTopicTable::from_connection_info(connection_info);
+    if (m_topic_table) {
+      TLOG(TLVL_INFO) << "Expecting binary headers for " << m_topic_table->size() << " topics";
+    }
+    for (auto const& topic : m_topics) {
+      set_subscription(ZMQ_SUBSCRIBE, topic);
+    }
     m_socket.connect(connection_string);
+    m_readiness_fd = zmq_readiness_fd(m_socket);
     m_socket_connected = true;
   }
 
-  void subscribe(std::string const& topic) override { m_socket.setsockopt(ZMQ_SUBSCRIBE, topic.c_str(), topic.size()); }
+  // Subscriptions made before connect_for_receives are applied once the socket exists
+  void subscribe(std::string const& topic) override
+  {
+    if (m_socket_connected) {
+      set_subscription(ZMQ_SUBSCRIBE, topic);
+    } else {
+      m_topics.push_back(topic);
+    }
+  }
   void unsubscribe(std::string const& topic) override
   {
-    m_socket.setsockopt(ZMQ_UNSUBSCRIBE, topic.c_str(), topic.size());
+    if (m_socket_connected) {
+      set_subscription(ZMQ_UNSUBSCRIBE, topic);
+    } else {
+      auto it = std::find(m_topics.begin(), m_topics.end(), topic);
+      if (it != m_topics.end()) {
+        m_topics.erase(it);
+      }
+    }
   }
 
 protected:
+  // Unconnected, a receive attempt is what reports the problem
+  bool ready_to_receive_() override
+  {
+    return !m_socket_connected || m_coalesced || zmq_socket_ready(m_socket, ZMQ_POLLIN);
+  }
+
   Receiver::Response receive_(const duration_t& timeout) override
   {
+    Frames frames;
+    receive_frames(frames, timeout);
+
     Receiver::Response output;
-    zmq::message_t hdr, msg;
-    size_t res = 0;
+    frames.copy_to(output);
+
+    TLOG(TLVL_TRACE + 2) << "Returning output with metadata size " << output.m_metadata.size() << " and data size "
+                         << output.m_data.size();
+    return output;
+  }
+
+  std::vector<Receiver::Response> receive_batch_(size_t max_messages, const duration_t& timeout) override
+  {
+    std::vector<Receiver::Response> batch;
+    batch.reserve(std::min(max_messages, s_batch_reserve));
+
+    // Only the first message is waited for; the rest of the batch is
+    // whatever the socket has already queued
+    auto wait = timeout;
+    while (batch.size() < max_messages) {
+      Frames frames;
+      if (!try_receive_frames(frames, wait)) {
+        break;
+      }
+      batch.emplace_back();
+      frames.copy_to(batch.back());
+      wait = s_no_block;
+    }
+
+    TLOG(TLVL_TRACE + 2) << "Returning batch of " << batch.size() << " messages";
+    return batch;
+  }
+
+  Receiver::ResponseView receive_view_(const duration_t& timeout) override
+  {
+    auto frames = reusable_frames();
+    receive_frames(*frames, timeout);
+    auto view = view_of(std::move(frames));
+
+    TLOG(TLVL_TRACE + 2) << "Returning view with metadata size " << view.m_metadata.size() << " and data size "
+                         << view.m_size;
+    return view;
+  }
+
+  Receiver::MultipartResponseView receive_multipart_(const duration_t& timeout) override
+  {
+    auto frames = reusable_frames();
+    receive_frames(*frames, timeout);
+
+    Receiver::MultipartResponseView multipart;
+    multipart.m_metadata = frames->metadata();
+    multipart.m_parts.reserve(1 + frames->m_extra_parts.size());
+    multipart.m_parts.push_back(Part{ frames->first_part().data(), frames->first_part().size() });
+    for (auto const& part : frames->m_extra_parts) {
+      multipart.m_parts.push_back(Part{ part.data<char>(), part.size() });
+    }
+    multipart.m_handle = std::move(frames);
+
+    TLOG(TLVL_TRACE + 2) << "Returning multipart view with metadata size " << multipart.m_metadata.size() << " and "
+                         << multipart.m_parts.size() << " parts";
+    return multipart;
+  }
+
+  Receiver::ReceiveIntoResult receive_into_(void* buffer,
+                                            message_size_t buffer_size,
+                                            const duration_t& timeout,
+                                            std::string* metadata) override
+  {
+    Receiver::ReceiveIntoResult result;
+    Frames frames;
+    if (!try_receive_frames(frames, timeout)) {
+      result.m_timed_out = true;
+      return result;
+    }
+
+    result.m_size = static_cast<message_size_t>(frames.payload_size());
+    if (result.m_size > buffer_size) {
+      TLOG(TLVL_TRACE + 2) << "Message of " << result.m_size << " bytes does not fit in buffer of " << buffer_size
+                           << " bytes, keeping it for the next receive";
+      result.m_buffer_too_small = true;
+      keep_for_next_receive(view_of(std::make_shared<Frames>(std::move(frames))));
+      return result;
+    }
+
+    if (result.m_size > 0) {
+      frames.copy_payload(static_cast<char*>(buffer));
+    }
+    if (metadata) {
+      *metadata = frames.metadata();
+    }
+
+    TLOG(TLVL_TRACE + 2) << "Received " << result.m_size << " bytes into caller's buffer";
+    return result;
+  }
+
+private:
+  // The header (topic) and payload frames of one message, as owned by ZeroMQ.
+  // Messages sent with send_multipart carry their second and later parts in
+  // m_extra_parts. The metadata is the start of the header, before any stamp,
+  // or for a binary header the topic it names. A message unpacked from a
+  // coalesced frame has no frames of its own, but refers into m_coalesced_in.
+  struct Frames
+  {
+    zmq::message_t m_header;
+    zmq::message_t m_payload;
+    std::vector<zmq::message_t> m_extra_parts;
+    std::vector<char> m_concatenated;
+    size_t m_metadata_size{ 0 };
+    std::string_view m_topic;                           // For a binary header
+    std::shared_ptr<const ZmqTopicTable> m_topic_table; // Owns what m_topic refers to
+    uint32_t m_num_coalesced{ 0 };                      // Messages packed in m_payload, if any
+    std::shared_ptr<const Frames> m_coalesced_in;
+    std::string_view m_unpacked; // The message's bytes, within m_coalesced_in
+
+    std::string_view metadata() const
+    {
+      if (m_coalesced_in) {
+        return m_coalesced_in->metadata();
+      }
+      return m_topic_table ? m_topic : std::string_view(m_header.data<char>(), m_metadata_size);
+    }
+
+    // Empties the frames for the next message, keeping the vectors' storage
+    void reset()
+    {
+      m_header.rebuild();
+      m_payload.rebuild();
+      m_extra_parts.clear();
+      m_concatenated.clear();
+      m_metadata_size = 0;
+      m_topic = std::string_view();
+      m_topic_table.reset();
+      m_num_coalesced = 0;
+      m_coalesced_in.reset();
+      m_unpacked = std::string_view();
+    }
+
+    std::string_view first_part() const
+    {
+      return m_coalesced_in ? m_unpacked : std::string_view(m_payload.data<char>(), m_payload.size());
+    }
+
+    void copy_to(Receiver::Response& output) const
+    {
+      output.m_metadata.assign(metadata());
+      copy_payload(output.m_data);
+    }
+
+    size_t payload_size() const
+    {
+      size_t total_size = first_part().size();
+      for (auto const& part : m_extra_parts) {
+        total_size += part.size();
+      }
+      return total_size;
+    }
+
+    // Copies all parts back to back; dest must have room for payload_size() bytes
+    void copy_payload(char* dest) const
+    {
+      memcpy(dest, first_part().data(), first_part().size());
+      dest += first_part().size();
+      for (auto const& part : m_extra_parts) {
+        memcpy(dest, part.data(), part.size());
+        dest += part.size();
+      }
+    }
+
+    void copy_payload(std::vector<char>& data) const
+    {
+      if (m_extra_parts.empty()) {
+        data.assign(first_part().begin(), first_part().end());
+        return;
+      }
+
+      data.clear();
+      data.reserve(payload_size());
+      data.insert(data.end(), m_payload.data<char>(), m_payload.data<char>() + m_payload.size());
+      for (auto const& part : m_extra_parts) {
+        data.insert(data.end(), part.data<char>(), part.data<char>() + part.size());
+      }
+    }
+  };
+
+  /**
+   * @brief Frames for a view to hold, reusing those handed out with the last
+   * view once every copy of its handle is gone, as happens when receive()
+   * copies the view into a pooled Response. A view still held elsewhere is
+   * left alone, and new frames are made. The last message's frames are kept
+   * until the next receive.
+   */
+  std::shared_ptr<Frames> reusable_frames()
+  {
+    if (m_view_frames.use_count() == 1) {
+      // Pairs with the release in the last other owner's decrement, so its reads of the frames are over
+      std::atomic_thread_fence(std::memory_order_acquire);
+      m_view_frames->reset();
+    } else {
+      m_view_frames = std::make_shared<Frames>();
+    }
+    return m_view_frames;
+  }
+
+  // The view keeps the frames alive
+  static Receiver::ResponseView view_of(std::shared_ptr<Frames> frames)
+  {
+    Receiver::ResponseView view;
+    view.m_metadata = frames->metadata();
+    if (frames->m_extra_parts.empty()) {
+      view.m_data = frames->first_part().data();
+      view.m_size = frames->first_part().size();
+    } else {
+      // The parts of a multipart message have to be made contiguous
+      frames->copy_payload(frames->m_concatenated);
+      view.m_data = frames->m_concatenated.data();
+      view.m_size = frames->m_concatenated.size();
+    }
+    view.m_handle = std::move(frames);
+    return view;
+  }
+
+  void receive_frames(Frames& frames, const duration_t& timeout)
+  {
+    if (!try_receive_frames(frames, timeout)) {
+      throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+    }
+  }
+
+  // Returns false if no message arrived before the timeout
+  bool try_receive_frames(Frames& frames, const duration_t& timeout)
+  {
+    if (next_coalesced(frames)) {
+      return true;
+    }
+    bool res = false;
 
     auto start_time = std::chrono::steady_clock::now();
     do {
 
       try {
         TLOG(TLVL_TRACE + 3) << "Going to receive header";
-        res = m_socket.recv(&hdr);
-        TLOG(TLVL_TRACE + 3) << "Recv res=" << res << " for header (hdr.size() == " << hdr.size() << ")";
+        res = m_socket.recv(&frames.m_header, ZMQ_DONTWAIT);
+        TLOG(TLVL_TRACE + 3) << "Recv res=" << res << " for header (hdr.size() == " << frames.m_header.size() << ")";
       } catch (zmq::error_t const& err) {
-        // Throw ERS-ified exception
+        // Running out of messages (EAGAIN) is reported by res, not thrown; an interrupted call is retried
+        if (err.num() != EINTR) {
+          throw ZmqReceiveFailed(ERS_HERE, err.what());
+        }
       }
-      if (res > 0 || hdr.more()) {
-        TLOG(TLVL_TRACE + 3) << "Going to receive data";
-        output.m_metadata.resize(hdr.size());
-        memcpy(&output.m_metadata[0], hdr.data(), hdr.size());
-
-        // ZMQ guarantees that the entire message has arrived
-        res = m_socket.recv(&msg);
-        TLOG(TLVL_TRACE + 3) << "Recv res=" << res << " for data (msg.size() == " << msg.size() << ")";
-        output.m_data.resize(msg.size());
-        memcpy(&output.m_data[0], msg.data(), msg.size());
+    } while (!res && wait_for_socket(m_socket, ZMQ_POLLIN, start_time, timeout, &counters()));
+
+    if (!res) {
+      return false;
+    }
+
+    if (frames.m_header.more()) {
+      read_header(frames);
+
+      TLOG(TLVL_TRACE + 3) << "Going to receive data";
+
+      // ZMQ guarantees that the entire message has arrived
+      m_socket.recv(&frames.m_payload);
+      TLOG(TLVL_TRACE + 3) << "Received data (msg.size() == " << frames.m_payload.size() << ")";
+
+      bool more = frames.m_payload.more();
+      while (more) {
+        frames.m_extra_parts.emplace_back();
+        m_socket.recv(&frames.m_extra_parts.back());
+        more = frames.m_extra_parts.back().more();
+      }
+    } else {
+      // A single-frame message carries no topic
+      frames.m_payload = std::move(frames.m_header);
+    }
+
+    if (frames.m_num_coalesced > 0) {
+      m_coalesced = std::make_shared<Frames>(std::move(frames));
+      m_coalesced_offset = 0;
+      frames = Frames();
+      return next_coalesced(frames);
+    }
+    return true;
+  }
+
+  // Takes the next message out of the coalesced frame being unpacked, if any
+  bool next_coalesced(Frames& frames)
+  {
+    if (!m_coalesced) {
+      return false;
+    }
+    auto const& payload = m_coalesced->m_payload;
+    if (!ZmqCoalescedFrame::next(payload.data<char>(), payload.size(), m_coalesced_offset, frames.m_unpacked)) {
+      TLOG(TLVL_WARNING) << "Dropping the malformed end of a frame of " << m_coalesced->m_num_coalesced
+                         << " coalesced messages";
+      m_coalesced.reset();
+      return false;
+    }
+    frames.m_coalesced_in = m_coalesced;
+    if (m_coalesced_offset == payload.size()) {
+      m_coalesced.reset();
+    }
+    return true;
+  }
+
+  // Works out the metadata, and takes note of any stamp or sequence number
+  void read_header(Frames& frames)
+  {
+    const void* header = frames.m_header.data();
+    size_t header_size = frames.m_header.size();
+    ZmqCoalescedMarker marker;
+    if (ZmqCoalescedMarker::read_from(header, header_size, marker)) {
+      frames.m_num_coalesced = marker.m_count;
+      header_size -= sizeof(ZmqCoalescedMarker);
+    }
+    ZmqMessageStamp stamp;
+    ZmqTopicTable::Header binary;
+    if (ZmqTopicTable::read_header(header, header_size, binary) &&
+        header_size == ZmqTopicTable::s_header_size +
+                         (binary.m_flags & ZmqTopicTable::s_stamped ? sizeof(ZmqMessageStamp) : 0)) {
+      // A topic this receiver doesn't know of comes out as empty metadata
+      frames.m_topic = m_topic_table ? m_topic_table->name(binary.m_topic_id) : std::string_view();
+      frames.m_topic_table = m_topic_table ? m_topic_table : s_no_topic_table;
+      if (binary.m_flags & ZmqTopicTable::s_stamped) {
+        ZmqMessageStamp::read_from(header, header_size, stamp);
+        record_stamp(stamp);
       } else {
-        usleep(1000);
+        track_sequence((uint64_t(binary.m_source) << 32) | binary.m_topic_id, binary.m_sequence);
       }
-    } while (std::chrono::steady_clock::now() - start_time < timeout && res == 0);
+      return;
+    }
 
-    if (res == 0) {
-      throw ReceiveTimeoutExpired(ERS_HERE, timeout.count());
+    frames.m_metadata_size = header_size;
+    if (ZmqMessageStamp::read_from(header, header_size, stamp)) {
+      frames.m_metadata_size -= sizeof(ZmqMessageStamp);
+      record_stamp(stamp);
     }
+  }
 
-    TLOG(TLVL_TRACE + 2) << "Returning output with metadata size " << output.m_metadata.size() << " and data size "
-                         << output.m_data.size();
-    return output;
+  void record_stamp(const ZmqMessageStamp& stamp)
+  {
+    int64_t latency = ZmqMessageStamp::now_ns() - stamp.m_send_time_ns;
+    counters().record_latency(latency > 0 ? static_cast<uint64_t>(latency) : 0);
+    track_sequence(stamp.m_stream, stamp.m_sequence);
   }
 
-private:
+  // Only a subscriber counts gaps: a PUSH socket deals its messages out among
+  // its PULL peers, so a pull socket's gaps are just messages another took
+  void track_sequence(uint64_t stream, uint64_t sequence)
+  {
+    if (m_socket_type != zmq::socket_type::sub) {
+      return;
+    }
+    ++m_num_tracked;
+    auto [it, first] = m_streams.try_emplace(stream, StreamState{ sequence, m_num_tracked });
+    if (first) {
+      // Messages sent before the subscription or connection took hold don't count as missing
+      if (m_streams.size() > s_max_streams) {
+        forget_quiet_streams();
+      }
+      return;
+    }
+    if (sequence > it->second.m_last_sequence + 1) {
+      counters().count_gaps(sequence - it->second.m_last_sequence - 1);
+    }
+    it->second = StreamState{ sequence, m_num_tracked };
+  }
+
+  // Senders which have gone away (or restarted, with new stream IDs) leave
+  // their streams behind, so once there are too many the quieter half go
+  void forget_quiet_streams()
+  {
+    std::vector<uint64_t> last_seen;
+    last_seen.reserve(m_streams.size());
+    for (auto const& [id, state] : m_streams) {
+      last_seen.push_back(state.m_last_seen);
+    }
+    auto middle = last_seen.begin() + last_seen.size() / 2;
+    std::nth_element(last_seen.begin(), middle, last_seen.end());
+    for (auto it = m_streams.begin(); it != m_streams.end();) {
+      it = it->second.m_last_seen < *middle ? m_streams.erase(it) : std::next(it);
+    }
+  }
+
+  // A prefix subscription covers both the topics sent as strings and the
+  // binary headers of the listed topics it matches
+  void set_subscription(int option, std::string const& topic)
+  {
+    m_socket.setsockopt(option, topic.c_str(), topic.size());
+    if (m_topic_table) {
+      for (auto const& prefix : m_topic_table->subscriptions(topic)) {
+        m_socket.setsockopt(option, prefix.data(), prefix.size());
+      }
+    }
+  }
+
+  inline static const std::shared_ptr<const ZmqTopicTable> s_no_topic_table = std::make_shared<ZmqTopicTable>();
+
+  static constexpr size_t s_batch_reserve = 64;
+  static constexpr size_t s_max_streams = 4096;
+
+  struct StreamState
+  {
+    uint64_t m_last_sequence;
+    uint64_t m_last_seen; // When its last message came, counting the messages tracked
+  };
+
+  zmq::socket_type m_socket_type;
   zmq::socket_t m_socket;
   bool m_socket_connected{ false };
+  int m_readiness_fd{ -1 };          // ZMQ_FD, fixed once the socket is made
+  std::vector<std::string> m_topics; // Subscribed to before the socket was made
+  nlohmann::json m_effective_options = nlohmann::json::object();
+  std::shared_ptr<const Frames> m_coalesced; // Being unpacked, one message per receive
+  size_t m_coalesced_offset{ 0 };            // Of the next message in m_coalesced
+  std::shared_ptr<Frames> m_view_frames;     // Last handed out by reusable_frames()
+  std::unordered_map<uint64_t, StreamState> m_streams; // Each stream seen, by its ID
+  uint64_t m_num_tracked{ 0 };
+  std::shared_ptr<const ZmqTopicTable> m_topic_table; // Null unless connection_info lists topics
 };
 
 } // namespace ipm
@@ -10,13 +10,30 @@
 #ifndef IPM_PLUGINS_ZMQSENDERIMPL_HPP_
 #define IPM_PLUGINS_ZMQSENDERIMPL_HPP_
 
+#include "ZmqCoalescing.hpp"
+#include "ZmqMessageStamp.hpp"
+#include "ZmqPoll.hpp"
+#include "ZmqSocketOptions.hpp"
+#include "ZmqTopicTable.hpp"
+
 #include "ipm/Sender.hpp"
 #include "ipm/ZmqContext.hpp"
 
 #include "TRACE/trace.h"
 #include "zmq.hpp"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace dunedaq {
 namespace ipm {
@@ -30,49 +47,398 @@ public:
   };
 
   explicit ZmqSenderImpl(SenderType type)
-    : m_socket(ZmqContext::instance().GetContext(),
-               type == SenderType::Push ? zmq::socket_type::push : zmq::socket_type::pub)
+    : m_socket_type(type == SenderType::Push ? zmq::socket_type::push : zmq::socket_type::pub)
   {}
+  ~ZmqSenderImpl() { stop_flushing(); }
   bool can_send() const noexcept override { return m_socket_connected; }
+  nlohmann::json effective_options() const override { return m_effective_options; }
+  int readiness_fd() const override { return m_readiness_fd; }
+  bool ready_to_send() override
+  {
+    if (!m_socket_connected) {
+      return true;
+    }
+    // The flush thread may be using the socket
+    std::unique_lock<std::mutex> lock(m_coalesce_mutex, std::defer_lock);
+    if (m_coalesce_bytes > 0) {
+      lock.lock();
+    }
+    return zmq_socket_ready(m_socket, ZMQ_POLLOUT);
+  }
   void connect_for_sends(const nlohmann::json& connection_info)
   {
     std::string connection_string = connection_info.value<std::string>("connection_string", "inproc://default");
     TLOG(TLVL_INFO) << "Connection String is " << connection_string;
-    m_socket.setsockopt(ZMQ_SNDTIMEO, 1); // 1 ms, we'll repeat until we reach timeout
+    // Connecting again replaces the socket, which the flush thread mustn't be using
+    stop_flushing();
+    // The socket is made here, as connection_info says which context it belongs to
+    m_socket = zmq::socket_t(ZmqContext::instance().context_for(connection_info), m_socket_type);
+    apply_zmq_socket_options(m_socket, connection_info);
+    m_effective_options = effective_zmq_socket_options(m_socket);
+    m_conflate = m_effective_options["conflate"].get<bool>();
+    auto timestamps = connection_info.value("timestamps", nlohmann::json(false));
+    if (!timestamps.is_boolean()) {
+      throw InvalidSocketOption(ERS_HERE, "timestamps", "expected true or false");
+    }
+    m_timestamps = timestamps.get<bool>();
+    if (m_timestamps && m_conflate) {
+      throw InvalidSocketOption(ERS_HERE, "timestamps", "the stamp goes in the topic frame, which conflate leaves out");
+    }
+    m_effective_options["timestamps"] = m_timestamps;
+    configure_coalescing(connection_info);
+    m_topic_table = ZmqTopicTable::from_connection_info(connection_info);
+    if (m_topic_table) {
+      TLOG(TLVL_INFO) << "Sending binary headers for " << m_topic_table->size() << " topics";
+    }
+    TLOG(TLVL_INFO) << "Socket options are " << m_effective_options.dump();
     m_socket.bind(connection_string);
+    m_readiness_fd = zmq_readiness_fd(m_socket);
     m_socket_connected = true;
+    if (m_coalesce_bytes > 0) {
+      m_flush_thread = std::thread(&ZmqSenderImpl::flush_when_due, this);
+    }
   }
 
 protected:
   void send_(const void* message, int N, const duration_t& timeout, std::string const& topic) override
   {
-    TLOG(TLVL_INFO) << "Starting send of " << N << " bytes";
-    auto start_time = std::chrono::steady_clock::now();
-    bool res = false;
-    do {
+    TLOG(TLVL_TRACE + 3) << "Starting send of " << N << " bytes";
+    if (m_coalesce_bytes > 0) {
+      if (!try_coalesce(message, N, topic, std::chrono::steady_clock::now(), timeout)) {
+        throw SendTimeoutExpired(ERS_HERE, timeout.count());
+      }
+    } else {
+      zmq::message_t msg(message, N);
+      send_frames(&msg, 1, timeout, topic);
+    }
+    TLOG(TLVL_TRACE + 2) << "Completed send of " << N << " bytes";
+  }
 
-      zmq::message_t topic_msg(topic.c_str(), topic.size());
-      res = m_socket.send(topic_msg, ZMQ_SNDMORE);
+  void send_zero_copy_(void* message,
+                       int N,
+                       release_fn_t release,
+                       void* hint,
+                       const duration_t& timeout,
+                       std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting zero-copy send of " << N << " bytes";
+    // ZeroMQ calls release from its IO thread once the payload has been sent,
+    // or from ~message_t if it never is
+    zmq::message_t msg(message, N, release, hint);
+    send_frames(&msg, 1, timeout, topic);
+    TLOG(TLVL_TRACE + 2) << "Completed zero-copy send of " << N << " bytes";
+  }
 
-      if (!res) {
-        TLOG(TLVL_INFO) << "Unable to send message";
+  // All parts go out as a single ZeroMQ multipart message behind one topic frame
+  void send_multipart_(const void** message_parts,
+                       const std::vector<int>& message_sizes,
+                       const duration_t& timeout,
+                       std::string const& topic) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting multipart send of " << message_sizes.size() << " parts";
+    std::vector<zmq::message_t> parts;
+    parts.reserve(message_sizes.size());
+    for (size_t i = 0; i < message_sizes.size(); ++i) {
+      parts.emplace_back(message_parts[i], message_sizes[i]);
+    }
+    send_frames(parts.data(), parts.size(), timeout, topic);
+    TLOG(TLVL_TRACE + 2) << "Completed multipart send of " << message_sizes.size() << " parts";
+  }
+
+  size_t send_batch_(const BatchEntry* entries, size_t num_entries, const duration_t& timeout) override
+  {
+    TLOG(TLVL_TRACE + 3) << "Starting batch send of " << num_entries << " messages";
+    for (size_t i = 0; m_conflate && i < num_entries; ++i) {
+      check_conflatable(entries[i].m_metadata, 1);
+    }
+    auto start_time = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_entries; ++i) {
+      if (entries[i].m_size == 0) {
         continue;
       }
+      bool sent = false;
+      if (m_coalesce_bytes > 0) {
+        sent = try_coalesce(entries[i].m_message, entries[i].m_size, entries[i].m_metadata, start_time, timeout);
+      } else {
+        zmq::message_t msg(entries[i].m_message, entries[i].m_size);
+        sent = try_send_frames(&msg, 1, entries[i].m_metadata, start_time, timeout);
+      }
+      if (!sent) {
+        TLOG(TLVL_TRACE + 2) << "Timeout expired after sending " << i << " of " << num_entries << " messages";
+        return i;
+      }
+    }
+    TLOG(TLVL_TRACE + 2) << "Completed batch send of " << num_entries << " messages";
+    return num_entries;
+  }
 
+private:
+  void check_conflatable(std::string_view topic, size_t num_parts) const
+  {
+    if (!topic.empty()) {
+      throw UnsupportedWithConflate(ERS_HERE, "a topic");
+    }
+    if (num_parts != 1) {
+      throw UnsupportedWithConflate(ERS_HERE, "a multipart message");
+    }
+  }
+
+  void send_frames(zmq::message_t* parts, size_t num_parts, const duration_t& timeout, std::string const& topic)
+  {
+    auto start_time = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(m_coalesce_mutex, std::defer_lock);
+    if (m_coalesce_bytes > 0) {
+      // Whatever is waiting to be coalesced goes first, to keep the order
+      lock.lock();
+      if (m_coalesced_count > 0 && !try_flush(start_time, timeout)) {
+        throw SendTimeoutExpired(ERS_HERE, timeout.count());
+      }
+    }
+    if (!try_send_frames(parts, num_parts, topic, start_time, timeout)) {
+      throw SendTimeoutExpired(ERS_HERE, timeout.count());
+    }
+  }
+
+  void configure_coalescing(const nlohmann::json& connection_info)
+  {
+    auto bytes = connection_info.value("coalesce_bytes", nlohmann::json(0));
+    auto delay_us = connection_info.value("coalesce_delay_us", nlohmann::json(s_default_coalesce_delay_us));
+    if (!bytes.is_number_integer() || bytes.get<int64_t>() < 0) {
+      throw InvalidSocketOption(ERS_HERE, "coalesce_bytes", "expected a non-negative integer");
+    }
+    if (!delay_us.is_number_integer() || delay_us.get<int64_t>() < 1) {
+      throw InvalidSocketOption(ERS_HERE, "coalesce_delay_us", "expected an integer of at least 1");
+    }
+    m_coalesce_bytes = bytes.get<size_t>();
+    m_coalesce_delay = std::chrono::microseconds(delay_us.get<int64_t>());
+    if (m_coalesce_bytes > 0 && m_conflate) {
+      throw InvalidSocketOption(ERS_HERE, "coalesce_bytes", "conflate would keep only the last frame of many messages");
+    }
+    if (m_coalesce_bytes > 0 && m_timestamps) {
+      throw InvalidSocketOption(ERS_HERE, "coalesce_bytes", "a stamp would time the frame, not its messages");
+    }
+    m_coalesced.reserve(m_coalesce_bytes);
+    m_effective_options["coalesce_bytes"] = m_coalesce_bytes;
+    m_effective_options["coalesce_delay_us"] = m_coalesce_delay.count();
+  }
+
+  /**
+   * @brief Add a message to the frame being coalesced, first sending that
+   * frame if the message is on another topic or would take it past
+   * coalesce_bytes. A message too big for any frame goes on its own, and a
+   * frame with no room left for another message goes straight away.
+   * @return False if a send needed to make way didn't happen before the
+   * timeout, in which case the message is not taken
+   */
+  bool try_coalesce(const void* message,
+                    int N,
+                    std::string_view topic,
+                    std::chrono::steady_clock::time_point start_time,
+                    const duration_t& timeout)
+  {
+    std::lock_guard<std::mutex> lock(m_coalesce_mutex);
+    size_t entry_size = ZmqCoalescedFrame::s_size_bytes + N;
+    if (m_coalesced_count > 0 &&
+        (topic != m_coalesced_topic || m_coalesced.size() + entry_size > m_coalesce_bytes)) {
+      if (!try_flush(start_time, timeout)) {
+        return false;
+      }
+    }
+    if (entry_size > m_coalesce_bytes) {
       zmq::message_t msg(message, N);
-      res = m_socket.send(msg);
-    } while (std::chrono::steady_clock::now() - start_time < timeout && !res);
+      return try_send_frames(&msg, 1, topic, start_time, timeout);
+    }
+    if (m_coalesced_count == 0) {
+      m_coalesced_topic.assign(topic);
+      m_coalesce_deadline = std::chrono::steady_clock::now() + m_coalesce_delay;
+      m_flush_cv.notify_one();
+    }
+    ZmqCoalescedFrame::append(m_coalesced, message, N);
+    ++m_coalesced_count;
+    if (m_coalesced.size() + ZmqCoalescedFrame::s_size_bytes + 1 > m_coalesce_bytes &&
+        !try_flush(start_time, s_no_block)) {
+      // The socket is full, so leave the frame to the next send or the flush thread, without a further delay
+      m_coalesce_deadline = std::chrono::steady_clock::now();
+      m_flush_cv.notify_one();
+    }
+    return true;
+  }
+
+  // Sends the frame being coalesced. Must be called with m_coalesce_mutex held.
+  bool try_flush(std::chrono::steady_clock::time_point start_time, const duration_t& timeout)
+  {
+    zmq::message_t msg(m_coalesced.data(), m_coalesced.size());
+    if (!try_send_frames(&msg, 1, m_coalesced_topic, start_time, timeout, m_coalesced_count)) {
+      return false;
+    }
+    TLOG(TLVL_TRACE) << "Sent " << m_coalesced_count << " coalesced messages in " << m_coalesced.size() << " bytes";
+    m_coalesced.clear();
+    m_coalesced_count = 0;
+    return true;
+  }
+
+  // Stops the flush thread, giving whatever is still waiting one last chance to go
+  void stop_flushing()
+  {
+    if (!m_flush_thread.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_coalesce_mutex);
+      m_stop_flushing = true;
+      if (m_coalesced_count > 0 && !try_flush(std::chrono::steady_clock::now(), s_no_block)) {
+        TLOG(TLVL_WARNING) << "Dropping " << m_coalesced_count << " coalesced messages which could not be sent";
+        counters().count_dropped(m_coalesced_count);
+        m_coalesced.clear();
+        m_coalesced_count = 0;
+      }
+    }
+    m_flush_cv.notify_one();
+    m_flush_thread.join();
+    m_stop_flushing = false;
+  }
+
+  // The flush thread: sends each frame once it has waited coalesce_delay_us,
+  // if no send has filled it before then
+  void flush_when_due()
+  {
+    std::unique_lock<std::mutex> lock(m_coalesce_mutex);
+    while (!m_stop_flushing) {
+      if (m_coalesced_count == 0) {
+        m_flush_cv.wait(lock);
+      } else if (std::chrono::steady_clock::now() < m_coalesce_deadline) {
+        m_flush_cv.wait_until(lock, m_coalesce_deadline);
+      } else if (!try_flush(std::chrono::steady_clock::now(), s_no_block)) {
+        // The socket is full; a send will flush once it has room, or else try again later
+        m_coalesce_deadline = std::chrono::steady_clock::now() + m_coalesce_delay;
+      }
+    }
+  }
+
+  // Returns false if the socket did not accept the message before start_time +
+  // timeout. A coalesced payload frame is sent with the number of messages in it.
+  bool try_send_frames(zmq::message_t* parts,
+                       size_t num_parts,
+                       std::string_view topic,
+                       std::chrono::steady_clock::time_point start_time,
+                       const duration_t& timeout,
+                       uint32_t num_coalesced = 0)
+  {
+    // ZeroMQ can only conflate single-frame messages, so with conflate set the
+    // payload goes out without the topic frame
+    if (m_conflate) {
+      check_conflatable(topic, num_parts);
+    }
+    // Listed topics go as a binary header, and others as the topic string
+    uint32_t topic_id = 0;
+    bool binary = m_topic_table && m_topic_table->find(topic, topic_id);
+    // Both the binary header and the stamp carry the stream's sequence number
+    Stream* stream = m_timestamps || binary ? &stream_for(topic, binary ? &topic_id : nullptr) : nullptr;
+    size_t header_size = binary ? ZmqTopicTable::s_header_size : topic.size();
+    size_t marker_size = num_coalesced > 0 ? sizeof(ZmqCoalescedMarker) : 0;
+    zmq::message_t topic_msg(header_size + (m_timestamps ? sizeof(ZmqMessageStamp) : 0) + marker_size);
+    if (num_coalesced > 0) {
+      ZmqCoalescedMarker{ num_coalesced }.write_to(topic_msg.data<char>() + topic_msg.size() - marker_size);
+    }
+    if (binary) {
+      uint8_t flags = m_timestamps ? ZmqTopicTable::s_stamped : 0;
+      ZmqTopicTable::write_header(topic_msg.data(),
+                                  ZmqTopicTable::Header{ topic_id, flags, m_source, stream->m_next_sequence });
+    } else if (!topic.empty()) {
+      memcpy(topic_msg.data(), topic.data(), topic.size());
+    }
+    ZmqMessageStamp stamp;
+    if (m_timestamps) {
+      stamp.m_stream = stream->m_id;
+      stamp.m_sequence = stream->m_next_sequence;
+    }
+    zmq::message_t& first_msg = m_conflate ? parts[0] : topic_msg;
+    int first_flags = m_conflate ? ZMQ_DONTWAIT : ZMQ_SNDMORE | ZMQ_DONTWAIT;
+    bool res = false;
+
+    do {
+      // A failed send leaves the message untouched, so it can be retried as-is
+      // once the stamp's time has been brought up to date
+      if (m_timestamps) {
+        stamp.m_send_time_ns = ZmqMessageStamp::now_ns();
+        stamp.write_to(topic_msg.data<char>() + header_size);
+      }
+      res = m_socket.send(first_msg, first_flags);
+      if (!res) {
+        TLOG(TLVL_TRACE) << "Socket not ready for send, waiting";
+      }
+    } while (!res && wait_for_socket(m_socket, ZMQ_POLLOUT, start_time, timeout, &counters()));
 
     if (!res) {
-      throw SendTimeoutExpired(ERS_HERE, timeout.count());
+      return false;
+    }
+    if (stream) {
+      ++stream->m_next_sequence;
+    }
+    if (m_conflate) {
+      return true;
     }
 
-    TLOG(TLVL_INFO) << "Completed send of " << N << " bytes";
+    // Once the first frame of a message has been queued, ZeroMQ accepts the
+    // remaining frames regardless of the high-water mark, so these cannot
+    // block or leave a partial message behind
+    for (size_t i = 0; i < num_parts; ++i) {
+      m_socket.send(parts[i], i + 1 < num_parts ? ZMQ_SNDMORE : 0);
+    }
+    return true;
   }
 
-private:
+  // The messages sent on one topic, which receivers check for gaps. A listed
+  // topic's stream is identified by our source and its topic ID, as in its
+  // binary header, and any other by its name mixed with our random ID.
+  struct Stream
+  {
+    std::string m_topic;
+    uint64_t m_id;
+    uint64_t m_next_sequence{ 0 };
+  };
+
+  // The streams are found by views of their own topics, so looking one up doesn't copy the topic
+  Stream& stream_for(std::string_view topic, const uint32_t* topic_id)
+  {
+    auto it = m_streams.find(topic);
+    if (it == m_streams.end()) {
+      uint64_t id = topic_id ? (uint64_t(m_source) << 32) | *topic_id
+                             : m_sender_id ^ (std::hash<std::string_view>()(topic) * 0x9e3779b97f4a7c15ULL);
+      auto stream = std::make_unique<Stream>(Stream{ std::string(topic), id });
+      std::string_view key = stream->m_topic;
+      it = m_streams.emplace(key, std::move(stream)).first;
+    }
+    return *it->second;
+  }
+
+  zmq::socket_type m_socket_type;
   zmq::socket_t m_socket;
-  bool m_socket_connected;
+  bool m_socket_connected{ false };
+  int m_readiness_fd{ -1 }; // ZMQ_FD, fixed once the socket is made
+  bool m_conflate{ false };
+  bool m_timestamps{ false };
+  // Random, so that streams from different senders (or runs) are told apart
+  uint64_t m_sender_id{ (uint64_t(std::random_device()()) << 32) | std::random_device()() };
+  std::unordered_map<std::string_view, std::unique_ptr<Stream>> m_streams;
+  std::shared_ptr<const ZmqTopicTable> m_topic_table; // Null unless connection_info lists topics
+  uint16_t m_source{ static_cast<uint16_t>(m_sender_id >> 48) };
+  nlohmann::json m_effective_options = nlohmann::json::object();
+
+  static constexpr int64_t s_default_coalesce_delay_us = 1000;
+
+  // Coalescing, off while m_coalesce_bytes is 0. Once it is on, the flush
+  // thread shares the socket, so every send holds m_coalesce_mutex.
+  size_t m_coalesce_bytes{ 0 };
+  std::chrono::microseconds m_coalesce_delay{ s_default_coalesce_delay_us };
+  std::mutex m_coalesce_mutex;
+  std::condition_variable m_flush_cv;
+  std::vector<char> m_coalesced; // The payload frame being filled
+  uint32_t m_coalesced_count{ 0 };
+  std::string m_coalesced_topic;
+  std::chrono::steady_clock::time_point m_coalesce_deadline; // When the flush thread sends m_coalesced
+  bool m_stop_flushing{ false };
+  std::thread m_flush_thread;
 };
 
 } // namespace ipm
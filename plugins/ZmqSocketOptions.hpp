@@ -0,0 +1,139 @@
+/**
+ *
+ * @file ZmqSocketOptions.hpp Tuning keys for ZeroMQ sockets, read from connection_info
+ *
+ * The keys, their types and their defaults are documented in
+ * schema/ipm-ZmqSocketOptions-schema.jsonnet.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_ZMQSOCKETOPTIONS_HPP_
+#define IPM_PLUGINS_ZMQSOCKETOPTIONS_HPP_
+
+#include "ers/Issue.h"
+#include "nlohmann/json.hpp"
+#include "zmq.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm,
+                  InvalidSocketOption,
+                  "Invalid value for socket option " << option << ": " << reason,
+                  ((std::string)option)((std::string)reason)) // NOLINT
+ERS_DECLARE_ISSUE(ipm,
+                  UnsupportedWithConflate,
+                  "A socket with conflate set only carries single-frame messages, so cannot send " << what,
+                  ((std::string)what)) // NOLINT
+} // namespace dunedaq
+
+namespace dunedaq {
+namespace ipm {
+
+struct ZmqSocketOption
+{
+  enum class Kind
+  {
+    Int,
+    Bool,
+    Mask, // uint64_t bitmask
+  };
+
+  const char* m_key;
+  int m_option;
+  Kind m_kind;
+  int m_min; // For Kind::Int; -1 generally means "use the system default"
+};
+
+inline constexpr ZmqSocketOption s_zmq_socket_options[] = {
+  { "send_hwm", ZMQ_SNDHWM, ZmqSocketOption::Kind::Int, 0 },
+  { "receive_hwm", ZMQ_RCVHWM, ZmqSocketOption::Kind::Int, 0 },
+  { "send_buffer_size", ZMQ_SNDBUF, ZmqSocketOption::Kind::Int, -1 },
+  { "receive_buffer_size", ZMQ_RCVBUF, ZmqSocketOption::Kind::Int, -1 },
+  { "affinity", ZMQ_AFFINITY, ZmqSocketOption::Kind::Mask, 0 },
+  { "immediate", ZMQ_IMMEDIATE, ZmqSocketOption::Kind::Bool, 0 },
+  { "conflate", ZMQ_CONFLATE, ZmqSocketOption::Kind::Bool, 0 },
+  { "linger", ZMQ_LINGER, ZmqSocketOption::Kind::Int, -1 },
+  { "tcp_keepalive", ZMQ_TCP_KEEPALIVE, ZmqSocketOption::Kind::Bool, 0 },
+  { "tcp_keepalive_idle", ZMQ_TCP_KEEPALIVE_IDLE, ZmqSocketOption::Kind::Int, -1 },
+  { "tcp_keepalive_interval", ZMQ_TCP_KEEPALIVE_INTVL, ZmqSocketOption::Kind::Int, -1 },
+  { "tcp_keepalive_count", ZMQ_TCP_KEEPALIVE_CNT, ZmqSocketOption::Kind::Int, -1 },
+};
+
+/**
+ * @brief Check and set each tuning key present in connection_info. Must be
+ * called before bind/connect, since ZeroMQ copies most options into each
+ * connection as it is made.
+ * @throws InvalidSocketOption if a value has the wrong type or range, or
+ * ZeroMQ rejects it
+ */
+inline void
+apply_zmq_socket_options(zmq::socket_t& socket, const nlohmann::json& connection_info)
+{
+  for (auto const& option : s_zmq_socket_options) {
+    auto it = connection_info.find(option.m_key);
+    if (it == connection_info.end()) {
+      continue;
+    }
+    try {
+      switch (option.m_kind) {
+        case ZmqSocketOption::Kind::Int: {
+          if (!it->is_number_integer() || it->get<int64_t>() < option.m_min ||
+              it->get<int64_t>() > std::numeric_limits<int>::max()) {
+            throw InvalidSocketOption(
+              ERS_HERE, option.m_key, "expected an integer of at least " + std::to_string(option.m_min));
+          }
+          socket.setsockopt(option.m_option, it->get<int>());
+          break;
+        }
+        case ZmqSocketOption::Kind::Bool: {
+          if (!it->is_boolean()) {
+            throw InvalidSocketOption(ERS_HERE, option.m_key, "expected true or false");
+          }
+          socket.setsockopt(option.m_option, it->get<bool>() ? 1 : 0);
+          break;
+        }
+        case ZmqSocketOption::Kind::Mask: {
+          if (!it->is_number_unsigned() && !(it->is_number_integer() && it->get<int64_t>() >= 0)) {
+            throw InvalidSocketOption(ERS_HERE, option.m_key, "expected a non-negative integer bitmask");
+          }
+          socket.setsockopt(option.m_option, it->get<uint64_t>());
+          break;
+        }
+      }
+    } catch (zmq::error_t const& err) {
+      throw InvalidSocketOption(ERS_HERE, option.m_key, err.what());
+    }
+  }
+}
+
+// Every tuning option as the socket now reports it, under the connection_info keys
+inline nlohmann::json
+effective_zmq_socket_options(const zmq::socket_t& socket)
+{
+  nlohmann::json options = nlohmann::json::object();
+  for (auto const& option : s_zmq_socket_options) {
+    switch (option.m_kind) {
+      case ZmqSocketOption::Kind::Int:
+        options[option.m_key] = socket.getsockopt<int>(option.m_option);
+        break;
+      case ZmqSocketOption::Kind::Bool:
+        // ZMQ_TCP_KEEPALIVE reports -1 for the system default, i.e. off
+        options[option.m_key] = socket.getsockopt<int>(option.m_option) > 0;
+        break;
+      case ZmqSocketOption::Kind::Mask:
+        options[option.m_key] = socket.getsockopt<uint64_t>(option.m_option);
+        break;
+    }
+  }
+  return options;
+}
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_ZMQSOCKETOPTIONS_HPP_
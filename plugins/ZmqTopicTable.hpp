@@ -0,0 +1,188 @@
+/**
+ *
+ * @file ZmqTopicTable.hpp Topic IDs and the fixed-layout binary message header used by the ZeroMQ plugins
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef IPM_PLUGINS_ZMQTOPICTABLE_HPP_
+#define IPM_PLUGINS_ZMQTOPICTABLE_HPP_
+
+#include "ers/Issue.h"
+#include "nlohmann/json.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dunedaq {
+ERS_DECLARE_ISSUE(ipm, InvalidTopicTable, "Invalid \"topics\" in connection_info: " << reason, ((std::string)reason))
+} // namespace dunedaq
+
+namespace dunedaq {
+namespace ipm {
+
+/**
+ * @brief The topics agreed on by both ends of a connection through the
+ * "topics" connection_info key, either a list (the IDs being the positions in
+ * it) or an object from topic to ID. Messages on a listed topic carry a
+ * 16-byte binary header in place of the topic string:
+ *
+ *   byte 0      s_marker, which a topic string is taken never to start with
+ *   bytes 1-4   topic ID, little-endian
+ *   byte 5      flags
+ *   bytes 6-7   source, a random tag telling apart the senders of a topic
+ *   bytes 8-15  sequence number within the (source, topic), little-endian
+ *
+ * The marker and ID lead, so that a subscription to them is a ZeroMQ prefix
+ * subscription to exactly that topic.
+ */
+class ZmqTopicTable
+{
+public:
+  static constexpr size_t s_header_size = 16;
+  static constexpr size_t s_subscription_size = 5;
+  static constexpr uint8_t s_marker = 0;
+
+  enum Flags : uint8_t
+  {
+    s_stamped = 1, // A ZmqMessageStamp follows the header
+  };
+
+  struct Header
+  {
+    uint32_t m_topic_id{ 0 };
+    uint8_t m_flags{ 0 };
+    uint16_t m_source{ 0 };
+    uint64_t m_sequence{ 0 };
+  };
+
+  /**
+   * @return The table given by connection_info, or null if it has none
+   * @throws InvalidTopicTable if "topics" is malformed or repeats a topic or ID
+   */
+  static std::shared_ptr<const ZmqTopicTable> from_connection_info(const nlohmann::json& connection_info)
+  {
+    auto it = connection_info.find("topics");
+    if (it == connection_info.end()) {
+      return nullptr;
+    }
+    auto table = std::make_shared<ZmqTopicTable>();
+    if (it->is_array()) {
+      for (size_t i = 0; i < it->size(); ++i) {
+        if (!(*it)[i].is_string()) {
+          throw InvalidTopicTable(ERS_HERE, "a list of topics must hold only strings");
+        }
+        table->add((*it)[i].get<std::string>(), static_cast<uint32_t>(i));
+      }
+    } else if (it->is_object()) {
+      for (auto const& [topic, id] : it->items()) {
+        if (!id.is_number_integer() || id.get<int64_t>() < 0 || id.get<int64_t>() > UINT32_MAX) {
+          throw InvalidTopicTable(ERS_HERE, "the ID of " + topic + " is not a 32-bit unsigned integer");
+        }
+        table->add(topic, id.get<uint32_t>());
+      }
+    } else {
+      throw InvalidTopicTable(ERS_HERE, "expected a list of topics, or an object from topic to ID");
+    }
+    return table;
+  }
+
+  // Without a copy of the topic, so cheap enough for every send
+  bool find(std::string_view topic, uint32_t& id) const
+  {
+    auto it = m_ids.find(topic);
+    if (it == m_ids.end()) {
+      return false;
+    }
+    id = it->second;
+    return true;
+  }
+
+  // The topic with this ID, or an empty view if there is none
+  std::string_view name(uint32_t id) const
+  {
+    auto it = m_names.find(id);
+    return it == m_names.end() ? std::string_view() : std::string_view(it->second);
+  }
+
+  size_t size() const noexcept { return m_names.size(); }
+
+  // What a subscriber subscribes to for each listed topic starting with prefix
+  std::vector<std::string> subscriptions(std::string_view prefix) const
+  {
+    std::vector<std::string> result;
+    for (auto const& [id, topic] : m_names) {
+      if (topic.compare(0, prefix.size(), prefix) == 0) {
+        char bytes[s_header_size] = {};
+        write_header(bytes, Header{ id });
+        result.emplace_back(bytes, s_subscription_size);
+      }
+    }
+    return result;
+  }
+
+  static void write_header(void* dest, const Header& header) noexcept
+  {
+    auto* bytes = static_cast<uint8_t*>(dest);
+    bytes[0] = s_marker;
+    put(bytes + 1, header.m_topic_id, 4);
+    bytes[5] = header.m_flags;
+    put(bytes + 6, header.m_source, 2);
+    put(bytes + 8, header.m_sequence, 8);
+  }
+
+  // False if what is there isn't a binary header
+  static bool read_header(const void* src, size_t size, Header& header) noexcept
+  {
+    auto* bytes = static_cast<const uint8_t*>(src);
+    if (size < s_header_size || bytes[0] != s_marker) {
+      return false;
+    }
+    header.m_topic_id = static_cast<uint32_t>(get(bytes + 1, 4));
+    header.m_flags = bytes[5];
+    header.m_source = static_cast<uint16_t>(get(bytes + 6, 2));
+    header.m_sequence = get(bytes + 8, 8);
+    return true;
+  }
+
+private:
+  void add(const std::string& topic, uint32_t id)
+  {
+    if (topic.empty() || static_cast<uint8_t>(topic[0]) == s_marker) {
+      throw InvalidTopicTable(ERS_HERE, "topics must be non-empty and not start with a null character");
+    }
+    auto [name, added] = m_names.emplace(id, topic);
+    if (!added || !m_ids.emplace(name->second, id).second) {
+      throw InvalidTopicTable(ERS_HERE, "topic " + topic + " or its ID " + std::to_string(id) + " is repeated");
+    }
+  }
+
+  static void put(uint8_t* dest, uint64_t value, size_t num_bytes) noexcept
+  {
+    for (size_t i = 0; i < num_bytes; ++i) {
+      dest[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  }
+
+  static uint64_t get(const uint8_t* src, size_t num_bytes) noexcept
+  {
+    uint64_t value = 0;
+    for (size_t i = 0; i < num_bytes; ++i) {
+      value |= uint64_t(src[i]) << (8 * i);
+    }
+    return value;
+  }
+
+  std::unordered_map<uint32_t, std::string> m_names;
+  std::unordered_map<std::string_view, uint32_t> m_ids; // Views of the strings in m_names, which never move
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+#endif // IPM_PLUGINS_ZMQTOPICTABLE_HPP_
@@ -0,0 +1,69 @@
+/**
+ * @file BufferPool.cpp BufferPool Class implementations
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/BufferPool.hpp"
+
+#include <memory>
+#include <utility>
+
+void
+dunedaq::ipm::BufferPool::Buffer::reset()
+{
+  if (m_pool) {
+    m_pool->recycle(std::move(m_storage));
+    m_pool.reset();
+  }
+  m_storage.reset();
+  m_size = 0;
+}
+
+dunedaq::ipm::BufferPool::BufferPool(size_t buffer_size, size_t initial_buffers)
+  : m_buffer_size(buffer_size)
+{
+  m_free.reserve(initial_buffers);
+  for (size_t i = 0; i < initial_buffers; ++i) {
+    m_free.emplace_back(new char[m_buffer_size]);
+  }
+}
+
+dunedaq::ipm::BufferPool::Buffer
+dunedaq::ipm::BufferPool::acquire()
+{
+  Buffer buffer;
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (!m_free.empty()) {
+      buffer.m_storage = std::move(m_free.back());
+      m_free.pop_back();
+    }
+  }
+  if (!buffer.m_storage) {
+    // Deliberately not value-initialized: the producer is about to overwrite it
+    buffer.m_storage.reset(new char[m_buffer_size]);
+  }
+  buffer.m_size = m_buffer_size;
+  buffer.m_pool = shared_from_this();
+  return buffer;
+}
+
+size_t
+dunedaq::ipm::BufferPool::num_free() const
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  return m_free.size();
+}
+
+void
+dunedaq::ipm::BufferPool::recycle(std::unique_ptr<char[]> storage)
+{
+  if (!storage) {
+    return;
+  }
+  std::lock_guard<std::mutex> lk(m_mutex);
+  m_free.push_back(std::move(storage));
+}
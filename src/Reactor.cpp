@@ -0,0 +1,285 @@
+/**
+ * @file Reactor.cpp Reactor Class implementations
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Reactor.hpp"
+
+#include "ers/ers.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int s_max_events = 64; // Per epoll_wait
+constexpr uint64_t s_wake_id = 0;
+
+void
+call_done(dunedaq::ipm::Reactor::done_fn_t const& done, dunedaq::ipm::Reactor::Outcome outcome)
+{
+  try {
+    done(outcome);
+  } catch (std::exception const& err) {
+    ers::error(dunedaq::ipm::ReactorCallbackFailed(ERS_HERE, err.what()));
+  } catch (...) {
+    ers::error(dunedaq::ipm::ReactorCallbackFailed(ERS_HERE, "unknown exception"));
+  }
+}
+
+} // namespace ""
+
+struct dunedaq::ipm::Reactor::Watch
+{
+  uint64_t m_id{ 0 };
+  int m_fd{ -1 };
+  clock_t::time_point m_deadline;
+  attempt_fn_t m_attempt;
+  done_fn_t m_done;
+
+  std::mutex m_mutex;       // Held around attempts, so that they never overlap
+  bool m_finished{ false }; // Under m_mutex
+
+  timers_t::iterator m_timer; // Under the Reactor's m_mutex
+  bool m_has_timer{ false };
+};
+
+dunedaq::ipm::Reactor::Reactor(size_t num_threads)
+{
+  m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_epoll_fd < 0) {
+    throw ReactorStartFailed(ERS_HERE, std::string("epoll_create1: ") + strerror(errno));
+  }
+  m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.u64 = s_wake_id;
+  if (m_wake_fd < 0 || epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event) != 0) {
+    std::string reason = std::string("eventfd: ") + strerror(errno);
+    if (m_wake_fd >= 0) {
+      close(m_wake_fd);
+    }
+    close(m_epoll_fd);
+    throw ReactorStartFailed(ERS_HERE, reason);
+  }
+
+  for (size_t i = 0; i < std::max<size_t>(num_threads, 1); ++i) {
+    m_threads.emplace_back(&Reactor::run, this);
+  }
+}
+
+dunedaq::ipm::Reactor::~Reactor()
+{
+  m_stopping = true;
+  wake();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+
+  std::unordered_map<uint64_t, std::shared_ptr<Watch>> watches;
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    watches.swap(m_watches);
+    m_timers.clear();
+  }
+  for (auto& [id, watch] : watches) {
+    {
+      std::lock_guard<std::mutex> lk(watch->m_mutex);
+      if (watch->m_finished) {
+        continue;
+      }
+      watch->m_finished = true;
+    }
+    call_done(watch->m_done, Outcome::Abandoned);
+  }
+
+  close(m_wake_fd);
+  close(m_epoll_fd);
+}
+
+dunedaq::ipm::Reactor&
+dunedaq::ipm::Reactor::instance()
+{
+  static Reactor s_reactor;
+  return s_reactor;
+}
+
+void
+dunedaq::ipm::Reactor::watch(int fd, clock_t::time_point deadline, attempt_fn_t attempt, done_fn_t done)
+{
+  auto watch = std::make_shared<Watch>();
+  watch->m_fd = fd;
+  watch->m_deadline = deadline;
+  watch->m_attempt = std::move(attempt);
+  watch->m_done = std::move(done);
+
+  std::lock_guard<std::mutex> lk(m_mutex);
+  watch->m_id = m_next_id++;
+  if (fd >= 0) {
+    // One-shot, so that only one thread gets each event; re-armed after
+    // every attempt which doesn't finish the wait
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u64 = watch->m_id;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      // E.g. the descriptor is already being watched: fall back to polling
+      watch->m_fd = -1;
+    }
+  }
+  m_watches.emplace(watch->m_id, watch);
+
+  if (watch->m_fd < 0) {
+    add_timer(watch, std::min(clock_t::now() + s_poll_interval, deadline));
+  } else if (deadline != clock_t::time_point::max()) {
+    add_timer(watch, deadline);
+  }
+}
+
+size_t
+dunedaq::ipm::Reactor::num_watches() const
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  return m_watches.size();
+}
+
+void
+dunedaq::ipm::Reactor::run()
+{
+  epoll_event events[s_max_events];
+  std::vector<std::shared_ptr<Watch>> ready;
+
+  while (!m_stopping) {
+    int timeout_ms = -1;
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      if (!m_timers.empty()) {
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(m_timers.begin()->first - clock_t::now());
+        timeout_ms = static_cast<int>(std::clamp<std::chrono::milliseconds::rep>(wait.count(), 0, INT_MAX));
+      }
+    }
+
+    int num_events = epoll_wait(m_epoll_fd, events, s_max_events, timeout_ms);
+    if (m_stopping) {
+      break;
+    }
+
+    ready.clear();
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      for (int i = 0; i < num_events; ++i) {
+        if (events[i].data.u64 == s_wake_id) {
+          uint64_t count = 0;
+          // Another thread may have read it first, which is fine
+          [[maybe_unused]] auto res = read(m_wake_fd, &count, sizeof(count));
+          continue;
+        }
+        // Events for waits which have just finished are dropped
+        auto it = m_watches.find(events[i].data.u64);
+        if (it != m_watches.end()) {
+          ready.push_back(it->second);
+        }
+      }
+    }
+    for (auto const& watch : ready) {
+      service(watch, true);
+    }
+
+    ready.clear();
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      auto now = clock_t::now();
+      while (!m_timers.empty() && m_timers.begin()->first <= now) {
+        ready.push_back(m_timers.begin()->second);
+        ready.back()->m_has_timer = false;
+        m_timers.erase(m_timers.begin());
+      }
+    }
+    for (auto const& watch : ready) {
+      service(watch, false);
+    }
+  }
+
+  // The wakeup is left unread for the other threads
+  wake();
+}
+
+void
+dunedaq::ipm::Reactor::service(std::shared_ptr<Watch> const& watch, bool from_fd)
+{
+  Outcome outcome = Outcome::Ready;
+  {
+    std::lock_guard<std::mutex> lk(watch->m_mutex);
+    if (watch->m_finished) {
+      return;
+    }
+    auto now = clock_t::now();
+    if (watch->m_attempt()) {
+      outcome = Outcome::Ready;
+    } else if (now >= watch->m_deadline) {
+      outcome = Outcome::TimedOut;
+    } else {
+      if (watch->m_fd < 0) {
+        std::lock_guard<std::mutex> reactor_lk(m_mutex);
+        add_timer(watch, std::min(now + s_poll_interval, watch->m_deadline));
+      } else if (from_fd) {
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.u64 = watch->m_id;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, watch->m_fd, &event);
+      } else {
+        // epoll_wait woke a little early for the deadline
+        std::lock_guard<std::mutex> reactor_lk(m_mutex);
+        add_timer(watch, watch->m_deadline);
+      }
+      return;
+    }
+    watch->m_finished = true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_watches.erase(watch->m_id);
+    if (watch->m_has_timer) {
+      m_timers.erase(watch->m_timer);
+      watch->m_has_timer = false;
+    }
+    if (watch->m_fd >= 0) {
+      epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, watch->m_fd, nullptr);
+    }
+  }
+
+  call_done(watch->m_done, outcome);
+}
+
+void
+dunedaq::ipm::Reactor::add_timer(std::shared_ptr<Watch> const& watch, clock_t::time_point when)
+{
+  watch->m_timer = m_timers.emplace(when, watch);
+  watch->m_has_timer = true;
+  // A thread may be asleep until a later time
+  if (watch->m_timer == m_timers.begin()) {
+    wake();
+  }
+}
+
+void
+dunedaq::ipm::Reactor::wake()
+{
+  uint64_t one = 1;
+  [[maybe_unused]] auto res = write(m_wake_fd, &one, sizeof(one));
+}
@@ -8,13 +8,246 @@
 
 #include "ipm/Receiver.hpp"
 
+#include "ers/ers.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief The dispatch threads behind Receiver::start_dispatch. A thread takes
+ * the receive mutex to wait for and take one message, then runs the handler
+ * without it, so that the next thread can be receiving meanwhile. Where the
+ * implementation has a readiness_fd(), the wait is a poll() on it which an
+ * eventfd interrupts on stop; otherwise the implementation's own receive
+ * waits, in spells short enough for a stop to be noticed promptly. A thread
+ * whose receives keep failing waits longer and longer before its next try.
+ */
+class ReceiveDispatcher
+{
+public:
+  ReceiveDispatcher(Receiver& receiver, Receiver::handler_fn_t handler, size_t num_threads)
+    : m_receiver(receiver)
+    , m_handler(std::move(handler))
+    , m_stop_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+    if (m_stop_fd < 0) {
+      throw DispatchFailed(ERS_HERE, std::string("eventfd: ") + strerror(errno));
+    }
+    for (size_t i = 0; i < std::max<size_t>(num_threads, 1); ++i) {
+      m_threads.emplace_back(&ReceiveDispatcher::run, this);
+    }
+  }
+
+  // Waits for the handlers under way to return
+  ~ReceiveDispatcher()
+  {
+    m_stopping = true;
+    uint64_t one = 1;
+    [[maybe_unused]] auto res = write(m_stop_fd, &one, sizeof(one));
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+    close(m_stop_fd);
+  }
+
+  ReceiveDispatcher(const ReceiveDispatcher&) = delete;
+  ReceiveDispatcher& operator=(const ReceiveDispatcher&) = delete;
+
+private:
+  void run()
+  {
+    int num_failures = 0; // In a row
+    while (!m_stopping) {
+      Receiver::Response received;
+      bool got_one = false;
+      try {
+        std::lock_guard<std::mutex> lock(m_receive_mutex);
+        // Stopping may have begun while another thread had its turn
+        if (m_stopping) {
+          break;
+        }
+        int fd = m_receiver.readiness_fd();
+        if (fd < 0) {
+          got_one = m_receiver.receive_one(received, s_wait_without_fd);
+        } else if (wait_until_ready(fd)) {
+          got_one = m_receiver.receive_one(received, Receiver::s_no_block);
+        }
+      } catch (std::exception const& err) {
+        ers::error(DispatchFailed(ERS_HERE, err.what()));
+        back_off(++num_failures);
+        continue;
+      }
+      num_failures = 0;
+      if (!got_one) {
+        continue;
+      }
+
+      m_receiver.m_counters.count_message(received.m_data.size());
+      try {
+        m_handler(received);
+      } catch (std::exception const& err) {
+        ers::error(DispatchFailed(ERS_HERE, err.what()));
+      } catch (...) {
+        ers::error(DispatchFailed(ERS_HERE, "the handler threw an unknown exception"));
+      }
+    }
+  }
+
+  // Returns false if stopped first. The descriptor only signals changes, so
+  // readiness is checked before each wait.
+  bool wait_until_ready(int fd)
+  {
+    while (!m_receiver.ready_to_receive()) {
+      pollfd fds[2] = { { fd, POLLIN, 0 }, { m_stop_fd, POLLIN, 0 } };
+      WaitTimer timer(&m_receiver.m_counters);
+      poll(fds, 2, -1);
+      if (m_stopping) {
+        return false;
+      }
+    }
+    return !m_stopping;
+  }
+
+  // Sleeps for a time doubling with each failure in a row, up to a limit, unless stopped first
+  void back_off(int num_failures)
+  {
+    auto delay = s_max_back_off;
+    if (num_failures <= s_doublings_to_max_back_off) {
+      delay = std::min(s_max_back_off, s_min_back_off * (1 << (num_failures - 1)));
+    }
+    pollfd item{ m_stop_fd, POLLIN, 0 };
+    poll(&item, 1, static_cast<int>(delay.count()));
+  }
+
+  static constexpr Receiver::duration_t s_wait_without_fd{ 100 };
+  static constexpr Receiver::duration_t s_min_back_off{ 10 };
+  static constexpr Receiver::duration_t s_max_back_off{ 1000 };
+  static constexpr int s_doublings_to_max_back_off = 7;
+
+  Receiver& m_receiver;
+  Receiver::handler_fn_t m_handler;
+  int m_stop_fd;
+  std::atomic<bool> m_stopping{ false };
+  std::mutex m_receive_mutex; // Held by the thread whose turn it is to receive
+  std::vector<std::thread> m_threads;
+};
+
+} // namespace dunedaq::ipm
+
+dunedaq::ipm::Receiver::Receiver() = default;
+
+dunedaq::ipm::Receiver::~Receiver()
+{
+  // The dispatch threads would be left calling into an implementation which
+  // has already been destroyed, and joining them here can't make that safe
+  if (m_dispatch) {
+    ers::fatal(DispatchNotStopped(ERS_HERE));
+    std::abort();
+  }
+}
+
+void
+dunedaq::ipm::Receiver::destroy(Receiver* receiver)
+{
+  receiver->m_dispatch.reset();
+  delete receiver; // NOLINT
+}
+
+void
+dunedaq::ipm::Receiver::start_dispatch(handler_fn_t handler, size_t num_threads)
+{
+  if (!can_receive()) {
+    throw KnownStateForbidsReceive(ERS_HERE);
+  }
+  if (m_dispatch) {
+    throw DispatchAlreadyStarted(ERS_HERE);
+  }
+  m_dispatch = std::make_unique<ReceiveDispatcher>(*this, std::move(handler), num_threads);
+}
+
+void
+dunedaq::ipm::Receiver::stop_dispatch()
+{
+  m_dispatch.reset();
+}
+
+dunedaq::ipm::Receiver::Response::~Response()
+{
+  release_to_pool();
+}
+
+dunedaq::ipm::Receiver::Response&
+dunedaq::ipm::Receiver::Response::operator=(const Response& other)
+{
+  if (this != &other) {
+    // Keeps our own storage (and pool) if it is big enough for the copy
+    m_metadata = other.m_metadata;
+    m_data = other.m_data;
+  }
+  return *this;
+}
+
+dunedaq::ipm::Receiver::Response&
+dunedaq::ipm::Receiver::Response::operator=(Response&& other) noexcept
+{
+  if (this != &other) {
+    release_to_pool();
+    m_metadata = std::move(other.m_metadata);
+    m_data = std::move(other.m_data);
+    m_pool = std::move(other.m_pool);
+  }
+  return *this;
+}
+
+void
+dunedaq::ipm::Receiver::Response::release_to_pool() noexcept
+{
+  if (m_pool) {
+    m_pool->release(std::move(m_data));
+    m_data = std::vector<char>();
+    m_pool.reset();
+  }
+}
+
 dunedaq::ipm::Receiver::Response
 dunedaq::ipm::Receiver::receive(const duration_t& timeout, message_size_t bytes)
 {
   if (!can_receive()) {
     throw KnownStateForbidsReceive(ERS_HERE);
   }
-  auto message = receive_(timeout);
+
+  Response message;
+  try {
+    ResponseView view;
+    if (take_pending(view)) {
+      copy_to_response(view, message);
+    } else if (m_response_pool) {
+      copy_to_response(receive_view_(timeout), message);
+    } else {
+      message = receive_(timeout);
+    }
+  } catch (ReceiveTimeoutExpired const&) {
+    m_counters.count_timeout();
+    throw;
+  }
+  m_counters.count_message(message.m_data.size());
 
   if (bytes != s_any_size) {
     auto received_size = static_cast<message_size_t>(message.m_data.size());
@@ -25,3 +258,266 @@ dunedaq::ipm::Receiver::receive(const duration_t& timeout, message_size_t bytes)
 
   return message;
 }
+
+dunedaq::ipm::Receiver::ResponseView
+dunedaq::ipm::Receiver::receive_view(const duration_t& timeout, message_size_t bytes)
+{
+  if (!can_receive()) {
+    throw KnownStateForbidsReceive(ERS_HERE);
+  }
+  ResponseView view;
+  try {
+    if (!take_pending(view)) {
+      view = receive_view_(timeout);
+    }
+  } catch (ReceiveTimeoutExpired const&) {
+    m_counters.count_timeout();
+    throw;
+  }
+  m_counters.count_message(view.m_size);
+
+  if (bytes != s_any_size) {
+    auto received_size = static_cast<message_size_t>(view.m_size);
+    if (received_size != bytes) {
+      throw UnexpectedNumberOfBytes(ERS_HERE, received_size, bytes);
+    }
+  }
+
+  return view;
+}
+
+dunedaq::ipm::Receiver::ResponseView
+dunedaq::ipm::Receiver::receive_view_(const duration_t& timeout)
+{
+  auto response = std::make_shared<Response>(receive_(timeout));
+
+  ResponseView view;
+  view.m_metadata = response->m_metadata;
+  view.m_data = response->m_data.data();
+  view.m_size = response->m_data.size();
+  view.m_handle = std::move(response);
+  return view;
+}
+
+dunedaq::ipm::Receiver::MultipartResponseView
+dunedaq::ipm::Receiver::receive_multipart(const duration_t& timeout)
+{
+  if (!can_receive()) {
+    throw KnownStateForbidsReceive(ERS_HERE);
+  }
+
+  MultipartResponseView multipart;
+  try {
+    ResponseView view;
+    if (take_pending(view)) {
+      multipart.m_metadata = view.m_metadata;
+      multipart.m_parts.push_back(Part{ view.m_data, view.m_size });
+      multipart.m_handle = std::move(view.m_handle);
+    } else {
+      multipart = receive_multipart_(timeout);
+    }
+  } catch (ReceiveTimeoutExpired const&) {
+    m_counters.count_timeout();
+    throw;
+  }
+  uint64_t total_size = 0;
+  for (auto const& part : multipart.m_parts) {
+    total_size += part.m_size;
+  }
+  m_counters.count_message(total_size);
+  return multipart;
+}
+
+dunedaq::ipm::Receiver::MultipartResponseView
+dunedaq::ipm::Receiver::receive_multipart_(const duration_t& timeout)
+{
+  auto view = receive_view_(timeout);
+
+  MultipartResponseView multipart;
+  multipart.m_metadata = view.m_metadata;
+  multipart.m_parts.push_back(Part{ view.m_data, view.m_size });
+  multipart.m_handle = std::move(view.m_handle);
+  return multipart;
+}
+
+std::vector<dunedaq::ipm::Receiver::Response>
+dunedaq::ipm::Receiver::receive_batch(size_t max_messages, const duration_t& timeout)
+{
+  if (!can_receive()) {
+    throw KnownStateForbidsReceive(ERS_HERE);
+  }
+  if (max_messages == 0) {
+    return {};
+  }
+
+  std::vector<Response> batch;
+  ResponseView view;
+  if (take_pending(view)) {
+    // Followed only by what is already queued, as after any first message
+    batch.emplace_back();
+    copy_to_response(view, batch.back());
+    if (max_messages > 1) {
+      auto rest = receive_batch_(max_messages - 1, s_no_block);
+      std::move(rest.begin(), rest.end(), std::back_inserter(batch));
+    }
+  } else {
+    batch = receive_batch_(max_messages, timeout);
+  }
+  if (batch.empty()) {
+    m_counters.count_timeout();
+  }
+  for (auto const& message : batch) {
+    m_counters.count_message(message.m_data.size());
+  }
+  return batch;
+}
+
+bool
+dunedaq::ipm::Receiver::try_receive(Response& response)
+{
+  if (!can_receive()) {
+    throw KnownStateForbidsReceive(ERS_HERE);
+  }
+
+  if (!receive_one(response, s_no_block)) {
+    return false;
+  }
+  m_counters.count_message(response.m_data.size());
+  return true;
+}
+
+bool
+dunedaq::ipm::Receiver::take_pending(ResponseView& view)
+{
+  if (!m_pending_view) {
+    return false;
+  }
+  view = std::move(*m_pending_view);
+  m_pending_view.reset();
+  return true;
+}
+
+void
+dunedaq::ipm::Receiver::copy_to_response(const ResponseView& view, Response& response) const
+{
+  response.release_to_pool();
+  if (m_response_pool) {
+    response.m_data = m_response_pool->acquire(view.m_size);
+    response.m_pool = m_response_pool;
+  }
+  response.m_data.assign(view.m_data, view.m_data + view.m_size);
+  response.m_metadata.assign(view.m_metadata);
+}
+
+bool
+dunedaq::ipm::Receiver::receive_one(Response& response, const duration_t& timeout)
+{
+  ResponseView view;
+  if (take_pending(view)) {
+    copy_to_response(view, response);
+    return true;
+  }
+  if (m_response_pool) {
+    try {
+      copy_to_response(receive_view_(timeout), response);
+    } catch (ReceiveTimeoutExpired const&) {
+      return false;
+    }
+    return true;
+  }
+  auto batch = receive_batch_(1, timeout);
+  if (batch.empty()) {
+    return false;
+  }
+  response = std::move(batch.front());
+  return true;
+}
+
+std::vector<dunedaq::ipm::Receiver::Response>
+dunedaq::ipm::Receiver::receive_batch_(size_t max_messages, const duration_t& timeout)
+{
+  std::vector<Response> batch;
+  try {
+    batch.push_back(receive_(timeout));
+    while (batch.size() < max_messages) {
+      batch.push_back(receive_(s_no_block));
+    }
+  } catch (ReceiveTimeoutExpired const&) {
+    // Nothing (more) to receive
+  }
+  return batch;
+}
+
+dunedaq::ipm::Receiver::ReceiveIntoResult
+dunedaq::ipm::Receiver::receive_into(void* buffer,
+                                     message_size_t buffer_size,
+                                     const duration_t& timeout,
+                                     std::string* metadata)
+{
+  if (!can_receive()) {
+    throw KnownStateForbidsReceive(ERS_HERE);
+  }
+
+  if (!buffer && buffer_size != 0) {
+    throw NullPointerPassedToReceive(ERS_HERE);
+  }
+
+  ReceiveIntoResult result;
+  ResponseView view;
+  if (take_pending(view)) {
+    result = copy_into(std::move(view), buffer, buffer_size, metadata);
+  } else {
+    result = receive_into_(buffer, buffer_size, timeout, metadata);
+  }
+  if (result.m_timed_out) {
+    m_counters.count_timeout();
+  } else if (!result.m_buffer_too_small) {
+    m_counters.count_message(result.m_size);
+  }
+  return result;
+}
+
+dunedaq::ipm::EndpointInfo
+dunedaq::ipm::Receiver::get_info() const
+{
+  auto info = m_counters.snapshot();
+  info.m_queue_depth = queue_depth_();
+  return info;
+}
+
+dunedaq::ipm::Receiver::ReceiveIntoResult
+dunedaq::ipm::Receiver::receive_into_(void* buffer,
+                                      message_size_t buffer_size,
+                                      const duration_t& timeout,
+                                      std::string* metadata)
+{
+  ResponseView view;
+  try {
+    view = receive_view_(timeout);
+  } catch (ReceiveTimeoutExpired const&) {
+    ReceiveIntoResult result;
+    result.m_timed_out = true;
+    return result;
+  }
+  return copy_into(std::move(view), buffer, buffer_size, metadata);
+}
+
+dunedaq::ipm::Receiver::ReceiveIntoResult
+dunedaq::ipm::Receiver::copy_into(ResponseView view, void* buffer, message_size_t buffer_size, std::string* metadata)
+{
+  ReceiveIntoResult result;
+  result.m_size = static_cast<message_size_t>(view.m_size);
+  if (result.m_size > buffer_size) {
+    result.m_buffer_too_small = true;
+    keep_for_next_receive(std::move(view));
+    return result;
+  }
+
+  if (view.m_size > 0) {
+    memcpy(buffer, view.m_data, view.m_size);
+  }
+  if (metadata) {
+    metadata->assign(view.m_metadata);
+  }
+  return result;
+}
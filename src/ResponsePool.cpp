@@ -0,0 +1,125 @@
+/**
+ * @file ResponsePool.cpp ResponsePool Class implementations
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/ResponsePool.hpp"
+
+#include <utility>
+#include <vector>
+
+dunedaq::ipm::ResponsePool::ResponsePool(size_t max_buffer_size, size_t max_free_per_class)
+  : m_max_buffer_size(max_buffer_size)
+  , m_max_free_per_class(max_free_per_class)
+{
+  size_t num_classes = 0;
+  while (num_classes < 8 * sizeof(size_t) && class_size(num_classes) < m_max_buffer_size) {
+    ++num_classes;
+  }
+  m_free.resize(num_classes + 1);
+  for (auto& free_list : m_free) {
+    // Reserved up front so that release() never has to allocate
+    free_list.reserve(m_max_free_per_class);
+  }
+}
+
+size_t
+dunedaq::ipm::ResponsePool::class_for_size(size_t size) const noexcept
+{
+  if (size > m_max_buffer_size) {
+    return s_no_class;
+  }
+  size_t size_class = 0;
+  while (class_size(size_class) < size) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+size_t
+dunedaq::ipm::ResponsePool::class_for_capacity(size_t capacity) const noexcept
+{
+  if (capacity < s_min_class_size || capacity > class_size(m_free.size() - 1)) {
+    return s_no_class;
+  }
+  size_t size_class = 0;
+  while (size_class + 1 < m_free.size() && class_size(size_class + 1) <= capacity) {
+    ++size_class;
+  }
+  return size_class;
+}
+
+void
+dunedaq::ipm::ResponsePool::prefill(size_t buffer_size, size_t count)
+{
+  auto size_class = class_for_size(buffer_size);
+  if (size_class == s_no_class) {
+    return;
+  }
+
+  std::vector<std::vector<char>> buffers(count);
+  for (auto& buffer : buffers) {
+    // resize() writes every byte, so the pages are faulted in now rather than on the first receive
+    buffer.reserve(class_size(size_class));
+    buffer.resize(class_size(size_class));
+    buffer.clear();
+  }
+
+  for (auto& buffer : buffers) {
+    release(std::move(buffer));
+  }
+}
+
+std::vector<char>
+dunedaq::ipm::ResponsePool::acquire(size_t size)
+{
+  auto size_class = class_for_size(size);
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (size_class != s_no_class && !m_free[size_class].empty()) {
+      auto buffer = std::move(m_free[size_class].back());
+      m_free[size_class].pop_back();
+      ++m_stats.m_hits;
+      --m_stats.m_free_buffers;
+      m_stats.m_free_bytes -= buffer.capacity();
+      return buffer;
+    }
+    ++m_stats.m_misses;
+  }
+
+  std::vector<char> buffer;
+  buffer.reserve(size_class == s_no_class ? size : class_size(size_class));
+  return buffer;
+}
+
+void
+dunedaq::ipm::ResponsePool::release(std::vector<char>&& buffer) noexcept
+{
+  auto size_class = class_for_capacity(buffer.capacity());
+
+  std::vector<char> dropped;
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    if (size_class == s_no_class || m_free[size_class].size() >= m_max_free_per_class) {
+      if (buffer.capacity() != 0) {
+        ++m_stats.m_dropped;
+      }
+      dropped = std::move(buffer); // Freed outside the lock
+    } else {
+      buffer.clear();
+      ++m_stats.m_free_buffers;
+      m_stats.m_free_bytes += buffer.capacity();
+      m_free[size_class].push_back(std::move(buffer));
+    }
+  }
+}
+
+dunedaq::ipm::ResponsePool::Stats
+dunedaq::ipm::ResponsePool::get_stats() const
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  return m_stats;
+}
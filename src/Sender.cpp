@@ -8,14 +8,309 @@
 
 #include "ipm/Sender.hpp"
 
+#include "ipm/BoundedQueue.hpp"
+
+#include "ers/ers.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+namespace {
+
+// Invokes a release callback when it goes out of scope, so that ownership of a
+// zero-copy buffer is honoured on every exit path
+class ReleaseGuard
+{
+public:
+  ReleaseGuard(void* message, dunedaq::ipm::Sender::release_fn_t release, void* hint)
+    : m_message(message)
+    , m_release(release)
+    , m_hint(hint)
+  {}
+  ~ReleaseGuard()
+  {
+    if (m_release) {
+      m_release(m_message, m_hint);
+    }
+  }
+  void dismiss() { m_release = nullptr; }
+
+  ReleaseGuard(const ReleaseGuard&) = delete;
+  ReleaseGuard& operator=(const ReleaseGuard&) = delete;
+
+private:
+  void* m_message;
+  dunedaq::ipm::Sender::release_fn_t m_release;
+  void* m_hint;
+};
+
+void
+release_pooled_buffer(void* /* message */, void* hint)
+{
+  delete static_cast<dunedaq::ipm::BufferPool::Buffer*>(hint); // NOLINT
+}
+
+// What is left of timeout since start_time, leaving at least one attempt
+dunedaq::ipm::Sender::duration_t
+remaining_timeout(std::chrono::steady_clock::time_point start_time, const dunedaq::ipm::Sender::duration_t& timeout)
+{
+  using dunedaq::ipm::Sender;
+  if (timeout == Sender::s_block) {
+    return timeout;
+  }
+  auto elapsed = std::chrono::duration_cast<Sender::duration_t>(std::chrono::steady_clock::now() - start_time);
+  auto remaining = timeout - elapsed;
+  return remaining < Sender::s_no_block ? Sender::s_no_block : remaining;
+}
+
+} // namespace ""
+
+namespace dunedaq::ipm {
+
+/**
+ * @brief The queue and IO thread behind Sender::send_async. Messages go
+ * through a BoundedQueue; the IO thread and any caller waiting for room only
+ * sleep on the mutex when there is nothing else to do, and are woken only if
+ * the other side sees that they are asleep.
+ */
+class AsyncSendQueue
+{
+public:
+  struct Entry
+  {
+    std::vector<char> m_copy;    // A message passed by pointer...
+    BufferPool::Buffer m_buffer; // ...or a pooled buffer
+    Sender::message_size_t m_size{ 0 };
+    std::string m_metadata;
+    std::chrono::steady_clock::time_point m_start_time;
+    Sender::duration_t m_timeout{ Sender::s_block };
+    Sender::completion_fn_t m_on_complete;
+  };
+
+  AsyncSendQueue(Sender& sender, size_t depth)
+    : m_sender(sender)
+    , m_queue(depth)
+    , m_thread(&AsyncSendQueue::run, this)
+  {}
+
+  // Anything still queued is abandoned; a send under way is waited for
+  ~AsyncSendQueue()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_work.notify_one();
+    m_thread.join();
+  }
+
+  AsyncSendQueue(const AsyncSendQueue&) = delete;
+  AsyncSendQueue& operator=(const AsyncSendQueue&) = delete;
+
+  // Queues entry, waiting for room up to its timeout
+  void push(Entry& entry)
+  {
+    m_in_flight.fetch_add(1);
+    while (!m_queue.try_push(entry)) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_waiting_for_room.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto has_room = [&] { return m_queue.can_push(); };
+      bool room = true;
+      if (entry.m_timeout == Sender::s_block) {
+        m_changed.wait(lock, has_room);
+      } else {
+        room = m_changed.wait_until(lock, entry.m_start_time + entry.m_timeout, has_room);
+      }
+      m_waiting_for_room.fetch_sub(1);
+      if (!room) {
+        lock.unlock();
+        m_sender.m_counters.count_timeout();
+        complete(entry.m_on_complete, std::make_exception_ptr(SendTimeoutExpired(ERS_HERE, entry.m_timeout.count())));
+        finish_one();
+        return;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_io_waiting.load()) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_work.notify_one();
+    }
+  }
+
+  size_t in_flight() const noexcept { return m_in_flight.load(std::memory_order_relaxed); }
+
+  // Returns false if sends were still in flight at start_time + timeout
+  bool wait_idle(std::chrono::steady_clock::time_point start_time, const Sender::duration_t& timeout)
+  {
+    // A completion callback which sends synchronously would otherwise wait for itself
+    if (m_in_flight.load() == 0 || std::this_thread::get_id() == m_thread.get_id()) {
+      return true;
+    }
+    if (timeout == Sender::s_no_block) {
+      return false;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_waiting_for_idle.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto idle = [&] { return m_in_flight.load() == 0; };
+    bool is_idle = true;
+    if (timeout == Sender::s_block) {
+      m_changed.wait(lock, idle);
+    } else {
+      is_idle = m_changed.wait_until(lock, start_time + timeout, idle);
+    }
+    m_waiting_for_idle.fetch_sub(1);
+    return is_idle;
+  }
+
+  static void complete(const Sender::completion_fn_t& on_complete, std::exception_ptr error)
+  {
+    if (!on_complete) {
+      return;
+    }
+    try {
+      on_complete(error);
+    } catch (std::exception const& err) {
+      ers::error(CompletionCallbackFailed(ERS_HERE, err.what()));
+    } catch (...) {
+      ers::error(CompletionCallbackFailed(ERS_HERE, "unknown exception"));
+    }
+  }
+
+private:
+  void run()
+  {
+    Entry entry;
+    for (;;) {
+      if (m_queue.try_pop(entry)) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_waiting_for_room.load()) {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_changed.notify_all();
+        }
+        send(entry);
+        entry = Entry();
+        finish_one();
+        continue;
+      }
+      // Messages tend to come in bursts, and waking a sleeping IO thread
+      // costs the producer a system call, so look again a few times first
+      for (int i = 0; i < s_polls_before_sleeping && m_queue.size() == 0; ++i) {
+        std::this_thread::yield();
+      }
+      if (m_queue.size() > 0) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (m_stopping) {
+        return;
+      }
+      m_io_waiting.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      m_work.wait(lock, [&] { return m_stopping || m_queue.size() > 0; });
+      m_io_waiting.store(false);
+    }
+  }
+
+  void send(Entry& entry)
+  {
+    std::exception_ptr error;
+    if (m_stopping) {
+      error = std::make_exception_ptr(AsyncSendAbandoned(ERS_HERE));
+    } else {
+      // The time spent queued comes out of the timeout
+      auto remaining = remaining_timeout(entry.m_start_time, entry.m_timeout);
+      try {
+        if (entry.m_buffer) {
+          auto holder = std::make_unique<BufferPool::Buffer>(std::move(entry.m_buffer));
+          auto data = holder->data();
+          m_sender.send_zero_copy_now(
+            data, entry.m_size, &release_pooled_buffer, holder.release(), remaining, entry.m_metadata);
+        } else {
+          m_sender.send_now(entry.m_copy.data(), entry.m_size, remaining, entry.m_metadata);
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    complete(entry.m_on_complete, error);
+  }
+
+  void finish_one()
+  {
+    if (m_in_flight.fetch_sub(1) == 1) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (m_waiting_for_idle.load()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changed.notify_all();
+      }
+    }
+  }
+
+  static constexpr int s_polls_before_sleeping = 64;
+
+  Sender& m_sender;
+  BoundedQueue<Entry> m_queue;
+  std::atomic<size_t> m_in_flight{ 0 };
+
+  std::mutex m_mutex;
+  std::condition_variable m_work;    // For the IO thread
+  std::condition_variable m_changed; // For callers waiting for room or for the queue to empty
+  std::atomic<bool> m_io_waiting{ false };
+  std::atomic<int> m_waiting_for_room{ 0 };
+  std::atomic<int> m_waiting_for_idle{ 0 };
+  std::atomic<bool> m_stopping{ false };
+
+  std::thread m_thread; // Last, so that it starts once everything else is ready
+};
+
+} // namespace dunedaq::ipm
+
+dunedaq::ipm::Sender::Sender() = default;
+
+dunedaq::ipm::Sender::~Sender() = default;
+
+void
+dunedaq::ipm::Sender::destroy(Sender* sender)
+{
+  sender->stop_async_sends();
+  delete sender; // NOLINT
+}
+
+void
+dunedaq::ipm::Sender::stop_async_sends()
+{
+  m_async.store(nullptr, std::memory_order_release);
+  m_async_queue.reset();
+}
+
 void
 dunedaq::ipm::Sender::send(const void* message,
                            message_size_t message_size,
                            const duration_t& timeout,
                            std::string const& metadata)
+{
+  auto remaining = timeout;
+  if (!wait_for_async_sends_if_any(remaining)) {
+    m_counters.count_timeout();
+    throw SendTimeoutExpired(ERS_HERE, timeout.count());
+  }
+  send_now(message, message_size, remaining, metadata);
+}
+
+void
+dunedaq::ipm::Sender::send_now(const void* message,
+                               message_size_t message_size,
+                               const duration_t& timeout,
+                               std::string const& metadata)
 {
   if (message_size == 0) {
     return;
@@ -29,7 +324,146 @@ dunedaq::ipm::Sender::send(const void* message,
     throw NullPointerPassedToSend(ERS_HERE);
   }
 
-  send_(message, message_size, timeout, metadata);
+  try {
+    send_(message, message_size, timeout, metadata);
+  } catch (SendTimeoutExpired const&) {
+    m_counters.count_timeout();
+    throw;
+  }
+  m_counters.count_message(message_size);
+}
+
+void
+dunedaq::ipm::Sender::send_zero_copy(void* message,
+                                     message_size_t message_size,
+                                     release_fn_t release,
+                                     void* hint,
+                                     const duration_t& timeout,
+                                     std::string const& metadata)
+{
+  ReleaseGuard guard(message, release, hint);
+  auto remaining = timeout;
+  if (!wait_for_async_sends_if_any(remaining)) {
+    m_counters.count_timeout();
+    throw SendTimeoutExpired(ERS_HERE, timeout.count());
+  }
+  guard.dismiss();
+  send_zero_copy_now(message, message_size, release, hint, remaining, metadata);
+}
+
+void
+dunedaq::ipm::Sender::send_zero_copy_now(void* message,
+                                         message_size_t message_size,
+                                         release_fn_t release,
+                                         void* hint,
+                                         const duration_t& timeout,
+                                         std::string const& metadata)
+{
+  ReleaseGuard guard(message, release, hint);
+
+  if (message_size == 0) {
+    return;
+  }
+
+  if (!can_send()) {
+    throw KnownStateForbidsSend(ERS_HERE);
+  }
+
+  if (!message) {
+    throw NullPointerPassedToSend(ERS_HERE);
+  }
+
+  // From here on send_zero_copy_ is responsible for calling release
+  guard.dismiss();
+  try {
+    send_zero_copy_(message, message_size, release, hint, timeout, metadata);
+  } catch (SendTimeoutExpired const&) {
+    m_counters.count_timeout();
+    throw;
+  }
+  m_counters.count_message(message_size);
+}
+
+void
+dunedaq::ipm::Sender::send(BufferPool::Buffer&& buffer,
+                           message_size_t message_size,
+                           const duration_t& timeout,
+                           std::string const& metadata)
+{
+  if (message_size > 0 && static_cast<size_t>(message_size) > buffer.size()) {
+    throw MessageLargerThanBuffer(ERS_HERE, message_size, buffer.size());
+  }
+
+  auto holder = std::make_unique<BufferPool::Buffer>(std::move(buffer));
+  auto data = holder->data();
+  send_zero_copy(data, message_size, &release_pooled_buffer, holder.release(), timeout, metadata);
+}
+
+size_t
+dunedaq::ipm::Sender::send_batch(const BatchEntry* entries, size_t num_entries, const duration_t& timeout)
+{
+  if (num_entries == 0) {
+    return 0;
+  }
+
+  if (!can_send()) {
+    throw KnownStateForbidsSend(ERS_HERE);
+  }
+
+  if (!entries) {
+    throw NullPointerPassedToSend(ERS_HERE);
+  }
+
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (entries[i].m_size != 0 && !entries[i].m_message) {
+      throw NullPointerPassedToSend(ERS_HERE);
+    }
+  }
+
+  auto remaining = timeout;
+  if (!wait_for_async_sends_if_any(remaining)) {
+    m_counters.count_timeout();
+    return 0;
+  }
+
+  size_t num_accepted = send_batch_(entries, num_entries, remaining);
+  for (size_t i = 0; i < num_accepted; ++i) {
+    if (entries[i].m_size != 0) {
+      m_counters.count_message(entries[i].m_size);
+    }
+  }
+  if (num_accepted < num_entries) {
+    m_counters.count_timeout();
+  }
+  return num_accepted;
+}
+
+bool
+dunedaq::ipm::Sender::try_send(const void* message, message_size_t message_size, std::string const& metadata)
+{
+  if (message_size == 0) {
+    return true;
+  }
+
+  if (!can_send()) {
+    throw KnownStateForbidsSend(ERS_HERE);
+  }
+
+  if (!message) {
+    throw NullPointerPassedToSend(ERS_HERE);
+  }
+
+  auto remaining = s_no_block;
+  if (!wait_for_async_sends_if_any(remaining)) {
+    return false;
+  }
+
+  BatchEntry entry{ message, message_size, metadata };
+  if (send_batch_(&entry, 1, s_no_block) == 0) {
+    return false;
+  }
+  m_counters.count_message(message_size);
+  return true;
 }
 
 void
@@ -50,5 +484,208 @@ dunedaq::ipm::Sender::send_multipart(const void** message_parts,
     throw NullPointerPassedToSend(ERS_HERE);
   }
 
-  send_multipart_(message_parts, message_sizes, timeout, metadata);
+  for (size_t i = 0; i < message_sizes.size(); ++i) {
+    if (message_sizes[i] != 0 && !message_parts[i]) {
+      throw NullPointerPassedToSend(ERS_HERE);
+    }
+  }
+
+  auto remaining = timeout;
+  if (!wait_for_async_sends_if_any(remaining)) {
+    m_counters.count_timeout();
+    throw SendTimeoutExpired(ERS_HERE, timeout.count());
+  }
+
+  try {
+    send_multipart_(message_parts, message_sizes, remaining, metadata);
+  } catch (SendTimeoutExpired const&) {
+    m_counters.count_timeout();
+    throw;
+  }
+  uint64_t total_size = 0;
+  for (auto size : message_sizes) {
+    total_size += size;
+  }
+  m_counters.count_message(total_size);
+}
+
+void
+dunedaq::ipm::Sender::send_async(const void* message,
+                                 message_size_t message_size,
+                                 const duration_t& timeout,
+                                 std::string const& metadata,
+                                 completion_fn_t on_complete)
+{
+  if (message_size == 0) {
+    AsyncSendQueue::complete(on_complete, nullptr);
+    return;
+  }
+
+  if (!can_send()) {
+    throw KnownStateForbidsSend(ERS_HERE);
+  }
+
+  if (!message) {
+    throw NullPointerPassedToSend(ERS_HERE);
+  }
+
+  AsyncSendQueue::Entry entry;
+  entry.m_start_time = std::chrono::steady_clock::now();
+  entry.m_copy.assign(static_cast<const char*>(message), static_cast<const char*>(message) + message_size);
+  entry.m_size = message_size;
+  entry.m_metadata = metadata;
+  entry.m_timeout = timeout;
+  entry.m_on_complete = std::move(on_complete);
+  async_queue().push(entry);
+}
+
+void
+dunedaq::ipm::Sender::send_async(BufferPool::Buffer&& buffer,
+                                 message_size_t message_size,
+                                 const duration_t& timeout,
+                                 std::string const& metadata,
+                                 completion_fn_t on_complete)
+{
+  if (message_size > 0 && static_cast<size_t>(message_size) > buffer.size()) {
+    throw MessageLargerThanBuffer(ERS_HERE, message_size, buffer.size());
+  }
+
+  if (message_size == 0) {
+    buffer.reset();
+    AsyncSendQueue::complete(on_complete, nullptr);
+    return;
+  }
+
+  if (!can_send()) {
+    throw KnownStateForbidsSend(ERS_HERE);
+  }
+
+  AsyncSendQueue::Entry entry;
+  entry.m_start_time = std::chrono::steady_clock::now();
+  entry.m_buffer = std::move(buffer);
+  entry.m_size = message_size;
+  entry.m_metadata = metadata;
+  entry.m_timeout = timeout;
+  entry.m_on_complete = std::move(on_complete);
+  async_queue().push(entry);
+}
+
+namespace {
+
+// The completion callback behind the future-returning send_asyncs
+dunedaq::ipm::Sender::completion_fn_t
+fulfil(std::shared_ptr<std::promise<void>> promise)
+{
+  return [promise = std::move(promise)](std::exception_ptr error) {
+    if (error) {
+      promise->set_exception(error);
+    } else {
+      promise->set_value();
+    }
+  };
+}
+
+} // namespace ""
+
+std::future<void>
+dunedaq::ipm::Sender::send_async(const void* message,
+                                 message_size_t message_size,
+                                 const duration_t& timeout,
+                                 std::string const& metadata)
+{
+  auto promise = std::make_shared<std::promise<void>>();
+  auto future = promise->get_future();
+  send_async(message, message_size, timeout, metadata, fulfil(std::move(promise)));
+  return future;
+}
+
+std::future<void>
+dunedaq::ipm::Sender::send_async(BufferPool::Buffer&& buffer,
+                                 message_size_t message_size,
+                                 const duration_t& timeout,
+                                 std::string const& metadata)
+{
+  auto promise = std::make_shared<std::promise<void>>();
+  auto future = promise->get_future();
+  send_async(std::move(buffer), message_size, timeout, metadata, fulfil(std::move(promise)));
+  return future;
+}
+
+size_t
+dunedaq::ipm::Sender::in_flight() const noexcept
+{
+  auto async = m_async.load(std::memory_order_acquire);
+  return async ? async->in_flight() : 0;
+}
+
+void
+dunedaq::ipm::Sender::wait_for_async_sends()
+{
+  auto timeout = s_block;
+  wait_for_async_sends_if_any(timeout);
+}
+
+bool
+dunedaq::ipm::Sender::wait_for_async_sends_if_any(duration_t& timeout)
+{
+  auto async = m_async.load(std::memory_order_acquire);
+  if (!async || async->in_flight() == 0) {
+    return true;
+  }
+  auto start_time = std::chrono::steady_clock::now();
+  if (!async->wait_idle(start_time, timeout)) {
+    return false;
+  }
+  timeout = remaining_timeout(start_time, timeout);
+  return true;
+}
+
+dunedaq::ipm::AsyncSendQueue&
+dunedaq::ipm::Sender::async_queue()
+{
+  std::call_once(m_async_started, [this] {
+    m_async_queue = std::make_unique<AsyncSendQueue>(*this, m_async_queue_depth);
+    m_async.store(m_async_queue.get(), std::memory_order_release);
+  });
+  return *m_async_queue;
+}
+
+dunedaq::ipm::EndpointInfo
+dunedaq::ipm::Sender::get_info() const
+{
+  auto info = m_counters.snapshot();
+  info.m_queue_depth = queue_depth_();
+  info.m_in_flight = in_flight();
+  return info;
+}
+
+void
+dunedaq::ipm::Sender::send_zero_copy_(void* message,
+                                      message_size_t N,
+                                      release_fn_t release,
+                                      void* hint,
+                                      const duration_t& timeout,
+                                      std::string const& metadata)
+{
+  ReleaseGuard guard(message, release, hint);
+  send_(message, N, timeout, metadata);
+}
+
+size_t
+dunedaq::ipm::Sender::send_batch_(const BatchEntry* entries, size_t num_entries, const duration_t& timeout)
+{
+  auto start_time = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (entries[i].m_size == 0) {
+      continue;
+    }
+
+    auto remaining = remaining_timeout(start_time, timeout);
+    try {
+      send_(entries[i].m_message, entries[i].m_size, remaining, std::string(entries[i].m_metadata));
+    } catch (SendTimeoutExpired const&) {
+      return i;
+    }
+  }
+  return num_entries;
 }
@@ -0,0 +1,163 @@
+/**
+ * @file ZmqContext.cpp ZmqContext Class implementations
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/ZmqContext.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+void
+set_option(zmq::context_t& context, const std::string& name, const std::string& setting, int option, int value)
+{
+  try {
+    context.setctxopt(option, value);
+  } catch (zmq::error_t const& err) {
+    throw dunedaq::ipm::ZmqContextConfigurationFailed(ERS_HERE, name, setting, err.what());
+  }
+}
+
+// Checks that every key of config is a known setting of the right type
+void
+validate_config(const std::string& name, const nlohmann::json& config)
+{
+  if (!config.is_object()) {
+    throw dunedaq::ipm::ZmqContextConfigurationFailed(ERS_HERE, name, "zmq_context", "must be a name or an object");
+  }
+  auto is_int = [](const nlohmann::json& value) {
+    return value.is_number_integer() && value.get<int64_t>() >= INT_MIN && value.get<int64_t>() <= INT_MAX;
+  };
+  for (auto const& [key, value] : config.items()) {
+    if (key == "io_threads" || key == "max_sockets" || key == "thread_sched_policy" || key == "thread_priority") {
+      if (!is_int(value)) {
+        throw dunedaq::ipm::ZmqContextConfigurationFailed(ERS_HERE, name, key, "must be an integer");
+      }
+    } else if (key == "cpu_affinity") {
+      if (!value.is_array() || !std::all_of(value.begin(), value.end(), is_int)) {
+        throw dunedaq::ipm::ZmqContextConfigurationFailed(ERS_HERE, name, key, "must be a list of CPU numbers");
+      }
+    } else {
+      throw dunedaq::ipm::ZmqContextConfigurationFailed(ERS_HERE, name, key, "not a recognised setting");
+    }
+  }
+}
+
+} // namespace ""
+
+dunedaq::ipm::ZmqContext&
+dunedaq::ipm::ZmqContext::instance()
+{
+  static ZmqContext s_ctx;
+  return s_ctx;
+}
+
+dunedaq::ipm::ZmqContext::~ZmqContext()
+{
+  for (auto& [name, entry] : m_contexts) {
+    entry->m_context.close();
+  }
+}
+
+zmq::context_t&
+dunedaq::ipm::ZmqContext::GetContext(const std::string& name)
+{
+  std::lock_guard<std::mutex> lk(m_mutex);
+  Entry& the_entry = entry(name);
+  the_entry.m_in_use = true;
+  return the_entry.m_context;
+}
+
+void
+dunedaq::ipm::ZmqContext::configure(const std::string& name, const nlohmann::json& config)
+{
+  validate_config(name, config);
+
+  std::lock_guard<std::mutex> lk(m_mutex);
+  auto found = m_contexts.find(name);
+  if (found != m_contexts.end() && (found->second->m_in_use || config == found->second->m_config)) {
+    if (config != found->second->m_config) {
+      throw ZmqContextInUse(ERS_HERE, name);
+    }
+    return;
+  }
+
+  // Settings accumulate on a context (each cpu_affinity entry adds a CPU), so
+  // a new configuration starts from a fresh one; the old one has no sockets
+  auto the_entry = std::make_unique<Entry>();
+
+  // ZeroMQ reads these when it starts the IO threads, along with the first socket
+  auto& context = the_entry->m_context;
+  if (config.contains("io_threads")) {
+    set_option(context, name, "io_threads", ZMQ_IO_THREADS, config["io_threads"].get<int>());
+  }
+  if (config.contains("max_sockets")) {
+    set_option(context, name, "max_sockets", ZMQ_MAX_SOCKETS, config["max_sockets"].get<int>());
+  }
+#if defined(ZMQ_THREAD_AFFINITY_CPU_ADD) && defined(ZMQ_THREAD_SCHED_POLICY)
+  if (config.contains("cpu_affinity")) {
+    for (int cpu : config["cpu_affinity"].get<std::vector<int>>()) {
+      set_option(context, name, "cpu_affinity", ZMQ_THREAD_AFFINITY_CPU_ADD, cpu);
+    }
+  }
+  if (config.contains("thread_sched_policy")) {
+    set_option(context, name, "thread_sched_policy", ZMQ_THREAD_SCHED_POLICY, config["thread_sched_policy"].get<int>());
+  }
+  if (config.contains("thread_priority")) {
+    set_option(context, name, "thread_priority", ZMQ_THREAD_PRIORITY, config["thread_priority"].get<int>());
+  }
+#else
+  for (const char* setting : { "cpu_affinity", "thread_sched_policy", "thread_priority" }) {
+    if (config.contains(setting)) {
+      throw ZmqContextConfigurationFailed(ERS_HERE, name, setting, "not supported by this version of ZeroMQ");
+    }
+  }
+#endif
+  the_entry->m_config = config;
+  m_contexts[name] = std::move(the_entry);
+}
+
+zmq::context_t&
+dunedaq::ipm::ZmqContext::context_for(const nlohmann::json& connection_info)
+{
+  if (!connection_info.contains("zmq_context")) {
+    return GetContext();
+  }
+  auto const& context_info = connection_info["zmq_context"];
+  if (context_info.is_string()) {
+    return GetContext(context_info.get<std::string>());
+  }
+
+  if (!context_info.is_object()) {
+    throw ZmqContextConfigurationFailed(ERS_HERE, s_default_name, "zmq_context", "must be a name or an object");
+  }
+  auto found_name = context_info.find("name");
+  if (found_name != context_info.end() && !found_name->is_string()) {
+    throw ZmqContextConfigurationFailed(ERS_HERE, s_default_name, "name", "must be a string");
+  }
+  auto name = context_info.value<std::string>("name", s_default_name);
+  auto config = context_info;
+  config.erase("name");
+  configure(name, config);
+  return GetContext(name);
+}
+
+dunedaq::ipm::ZmqContext::Entry&
+dunedaq::ipm::ZmqContext::entry(const std::string& name)
+{
+  auto& the_entry = m_contexts[name];
+  if (!the_entry) {
+    the_entry = std::make_unique<Entry>();
+  }
+  return *the_entry;
+}
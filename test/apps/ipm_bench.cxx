@@ -0,0 +1,599 @@
+/**
+ * @file ipm_bench.cxx Throughput and latency benchmark for the IPM plugins
+ *
+ * Runs every combination of the given plugins, patterns, transports, message
+ * sizes and producer/consumer counts within one process, and writes the
+ * results to stdout as JSON. Run with --help for the options.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/LatencyHistogram.hpp"
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+#include "ipm/Subscriber.hpp"
+
+#include "nlohmann/json.hpp"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// The plugins are <family>Sender, <family>Receiver, <family>Publisher and
+// <family>Subscriber; these are the transports each family is known to speak
+const std::map<std::string, std::vector<std::string>> s_family_transports = {
+  { "Zmq", { "inproc", "ipc", "tcp" } }, { "Inproc", { "inproc" } }, { "Shm", { "shm" } },
+  { "Tcp", { "tcp" } },                  { "Uds", { "ipc" } },       { "Uring", { "tcp" } },
+};
+
+// Of those, the families which have a Publisher and Subscriber
+const std::set<std::string> s_pub_sub_families = { "Zmq" };
+
+// Messages allowed to queue at each endpoint are capped so that large
+// messages don't use up all the memory
+constexpr size_t s_max_queued_bytes = 256 * 1024 * 1024;
+constexpr size_t s_max_queued_messages = 1000;
+
+const std::string s_warmup_topic = "WARMUP";
+constexpr size_t s_warmup_size = 16;
+const std::string s_data_topic = "DATA";
+
+const Sender::duration_t s_send_timeout(100);
+const Receiver::duration_t s_receive_timeout(100);
+constexpr auto s_drain_timeout = std::chrono::seconds(10);
+
+struct Options
+{
+  std::vector<std::string> m_families{ "Zmq" };
+  std::vector<std::string> m_patterns{ "push-pull" };
+  std::vector<std::string> m_transports;
+  std::vector<size_t> m_sizes;
+  std::vector<int> m_producers{ 1 };
+  std::vector<int> m_consumers{ 1 };
+  double m_duration_s{ 1.0 };
+  int m_base_port{ 29900 };
+  nlohmann::json m_connection_info = nlohmann::json::object();
+};
+
+struct Point
+{
+  std::string m_family;
+  std::string m_pattern;
+  std::string m_transport;
+  size_t m_size;
+  int m_producers;
+  int m_consumers;
+};
+
+void
+usage()
+{
+  std::cerr
+    << "Usage: ipm_bench [options]\n"
+       "Lists are comma-separated, and every combination is run.\n"
+       "  --plugins LIST       Plugin families: Zmq, Inproc, Shm, Tcp, Uds, Uring, ... (default Zmq)\n"
+       "  --patterns LIST      push-pull, pub-sub (Zmq only) and/or ping-pong (default push-pull)\n"
+       "  --transports LIST    inproc, ipc, tcp and/or shm (default: all those the plugin speaks)\n"
+       "  --sizes LIST         Message sizes in bytes, with optional K, M or G (default 16 to 64M by 4x)\n"
+       "  --producers LIST     Senders, each with its own endpoint; pairs for ping-pong (default 1)\n"
+       "  --consumers LIST     Receivers, spread over the endpoints (default 1)\n"
+       "  --duration SECONDS   How long to send for at each point (default 1)\n"
+       "  --base-port PORT     First TCP port to use (default 29900)\n"
+       "  --connection-info J  JSON object merged into every connection_info,\n"
+       "                       e.g. '{\"zmq_context\": {\"name\": \"bench\", \"io_threads\": 2}}'\n";
+}
+
+std::vector<std::string>
+split(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+size_t
+parse_size(const std::string& text)
+{
+  size_t end = 0;
+  size_t size = std::stoull(text, &end);
+  std::string suffix = text.substr(end);
+  if (suffix == "K" || suffix == "k") {
+    size <<= 10;
+  } else if (suffix == "M") {
+    size <<= 20;
+  } else if (suffix == "G") {
+    size <<= 30;
+  } else if (!suffix.empty()) {
+    throw std::invalid_argument("bad size " + text);
+  }
+  return size;
+}
+
+Options
+parse_options(int argc, char* argv[])
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      usage();
+      exit(0);
+    }
+    if (i + 1 >= argc) {
+      throw std::invalid_argument("missing value for " + arg);
+    }
+    std::string value = argv[++i];
+    if (arg == "--plugins") {
+      options.m_families = split(value);
+    } else if (arg == "--patterns") {
+      options.m_patterns = split(value);
+    } else if (arg == "--transports") {
+      options.m_transports = split(value);
+    } else if (arg == "--sizes") {
+      options.m_sizes.clear();
+      for (auto const& size : split(value)) {
+        options.m_sizes.push_back(parse_size(size));
+      }
+    } else if (arg == "--producers" || arg == "--consumers") {
+      auto& counts = arg == "--producers" ? options.m_producers : options.m_consumers;
+      counts.clear();
+      for (auto const& count : split(value)) {
+        counts.push_back(std::stoi(count));
+      }
+    } else if (arg == "--duration") {
+      options.m_duration_s = std::stod(value);
+    } else if (arg == "--base-port") {
+      options.m_base_port = std::stoi(value);
+    } else if (arg == "--connection-info") {
+      options.m_connection_info = nlohmann::json::parse(value);
+    } else {
+      throw std::invalid_argument("unknown option " + arg);
+    }
+  }
+  if (options.m_sizes.empty()) {
+    for (size_t size = 16; size <= 64 * 1024 * 1024; size *= 4) {
+      options.m_sizes.push_back(size);
+    }
+  }
+  return options;
+}
+
+uint64_t
+now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+// User plus system time of the whole process, including transport threads
+uint64_t
+cpu_ns()
+{
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  auto to_ns = [](const timeval& tv) { return uint64_t(tv.tv_sec) * 1000000000 + uint64_t(tv.tv_usec) * 1000; };
+  return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+}
+
+// Payloads carry their send time in the first 8 bytes, where there is room
+void
+stamp(std::vector<char>& buffer)
+{
+  if (buffer.size() >= sizeof(uint64_t)) {
+    uint64_t sent = now_ns();
+    memcpy(buffer.data(), &sent, sizeof(sent));
+  }
+}
+
+void
+record_latency(LatencyHistogram& latencies, const std::vector<char>& buffer, size_t size)
+{
+  if (size >= sizeof(uint64_t)) {
+    uint64_t sent = 0;
+    memcpy(&sent, buffer.data(), sizeof(sent));
+    uint64_t now = now_ns();
+    latencies.record(now > sent ? now - sent : 0);
+  }
+}
+
+class Bench
+{
+public:
+  explicit Bench(const Options& options)
+    : m_options(options)
+  {}
+
+  nlohmann::json run(const Point& point)
+  {
+    m_point = point;
+    m_sent = 0;
+    m_received = 0;
+    m_send_timeouts = 0;
+    m_producers_done = false;
+    m_latencies = std::make_unique<LatencyHistogram>();
+
+    if (point.m_pattern == "ping-pong") {
+      return run_ping_pong();
+    }
+    if (point.m_pattern == "push-pull" || point.m_pattern == "pub-sub") {
+      return run_one_way();
+    }
+    throw std::invalid_argument("unknown pattern " + point.m_pattern);
+  }
+
+private:
+  std::string connection_string()
+  {
+    int n = m_next_endpoint++;
+    auto const& transport = m_point.m_transport;
+    if (transport == "inproc") {
+      return "inproc://ipm_bench_" + std::to_string(n);
+    }
+    if (transport == "ipc") {
+      return "ipc:///tmp/ipm_bench_" + std::to_string(getpid()) + "_" + std::to_string(n);
+    }
+    if (transport == "tcp") {
+      return "tcp://127.0.0.1:" + std::to_string(m_options.m_base_port + n);
+    }
+    if (transport == "shm") {
+      return "shm://ipm_bench_" + std::to_string(getpid()) + "_" + std::to_string(n);
+    }
+    throw std::invalid_argument("unknown transport " + transport);
+  }
+
+  nlohmann::json connection_info(const std::string& connection_string) const
+  {
+    size_t depth = std::clamp(s_max_queued_bytes / m_point.m_size, size_t(2), s_max_queued_messages);
+    nlohmann::json info{ { "connection_string", connection_string } };
+    if (m_point.m_family == "Zmq") {
+      info["send_hwm"] = depth;
+      info["receive_hwm"] = depth;
+    } else if (m_point.m_family == "Inproc" || m_point.m_family == "Uring") {
+      info["capacity"] = depth;
+    } else if (m_point.m_family == "Shm") {
+      info["capacity"] = std::max<size_t>(8 * 1024 * 1024, depth * (m_point.m_size + 64));
+    }
+    info.update(m_options.m_connection_info);
+    return info;
+  }
+
+  std::shared_ptr<Receiver> make_receiver(bool subscriber)
+  {
+    if (!subscriber) {
+      return make_ipm_receiver(m_point.m_family + "Receiver");
+    }
+    auto the_subscriber = make_ipm_subscriber(m_point.m_family + "Subscriber");
+    the_subscriber->subscribe(s_warmup_topic);
+    the_subscriber->subscribe(s_data_topic);
+    return the_subscriber;
+  }
+
+  // Sends warm-up messages until every receiver of the endpoint has had one,
+  // so that connections (and subscriptions) are in place before the timing
+  // starts. Leftover warm-up messages are skipped by the consumers. They are
+  // kept small, as stream transports can't finish sending a large message
+  // until someone reads it.
+  void warm_up(Sender& sender, const std::vector<Receiver*>& receivers)
+  {
+    std::vector<char> buffer(std::min(m_point.m_size, s_warmup_size));
+    std::vector<bool> ready(receivers.size(), false);
+    std::string metadata;
+    auto deadline = clock_type::now() + s_drain_timeout;
+    while (std::count(ready.begin(), ready.end(), false) > 0) {
+      if (clock_type::now() > deadline) {
+        throw std::runtime_error("receivers did not connect");
+      }
+      try {
+        sender.send(buffer.data(), buffer.size(), s_send_timeout, s_warmup_topic);
+      } catch (SendTimeoutExpired const&) {
+      }
+      for (size_t i = 0; i < receivers.size(); ++i) {
+        if (!ready[i]) {
+          ready[i] = !receivers[i]
+                        ->receive_into(buffer.data(), buffer.size(), Receiver::duration_t(10), &metadata)
+                        .m_timed_out;
+        }
+      }
+    }
+  }
+
+  void produce(Sender& sender, clock_type::time_point deadline)
+  {
+    std::vector<char> buffer(m_point.m_size);
+    uint64_t sent = 0;
+    while (clock_type::now() < deadline) {
+      stamp(buffer);
+      try {
+        sender.send(buffer.data(), buffer.size(), s_send_timeout, s_data_topic);
+        ++sent;
+      } catch (SendTimeoutExpired const&) {
+        ++m_send_timeouts;
+      }
+    }
+    m_sent += sent;
+  }
+
+  // For push-pull every message sent is waited for; for pub-sub the
+  // consumers stop once the publishers have finished and nothing more comes
+  void consume(Receiver& receiver, bool expect_all)
+  {
+    std::vector<char> buffer(m_point.m_size);
+    std::string metadata;
+    auto idle_since = clock_type::now();
+    while (true) {
+      auto result = receiver.receive_into(buffer.data(), buffer.size(), s_receive_timeout, &metadata);
+      if (!result.m_timed_out) {
+        idle_since = clock_type::now();
+        if (metadata == s_data_topic) {
+          record_latency(*m_latencies, buffer, result.m_size);
+          ++m_received;
+        }
+        continue;
+      }
+      if (!m_producers_done) {
+        continue;
+      }
+      if (!expect_all || m_received >= m_sent || clock_type::now() - idle_since > s_drain_timeout) {
+        break;
+      }
+    }
+  }
+
+  nlohmann::json run_one_way()
+  {
+    bool pub_sub = m_point.m_pattern == "pub-sub";
+    int num_producers = m_point.m_producers;
+    int num_consumers = m_point.m_consumers;
+    if (num_consumers < num_producers) {
+      throw std::invalid_argument("every producer's endpoint needs at least one consumer");
+    }
+
+    // Producer i binds endpoint i, and consumer j connects to endpoint j % num_producers
+    std::vector<std::shared_ptr<Sender>> senders;
+    std::vector<std::shared_ptr<Receiver>> receivers;
+    std::vector<std::vector<Receiver*>> receivers_of(num_producers);
+    std::vector<std::string> endpoints;
+    for (int i = 0; i < num_producers; ++i) {
+      endpoints.push_back(connection_string());
+      senders.push_back(make_ipm_sender(m_point.m_family + (pub_sub ? "Publisher" : "Sender")));
+      senders.back()->connect_for_sends(connection_info(endpoints.back()));
+    }
+    for (int j = 0; j < num_consumers; ++j) {
+      receivers.push_back(make_receiver(pub_sub));
+      receivers.back()->connect_for_receives(connection_info(endpoints[j % num_producers]));
+      receivers_of[j % num_producers].push_back(receivers.back().get());
+    }
+    for (int i = 0; i < num_producers; ++i) {
+      warm_up(*senders[i], receivers_of[i]);
+    }
+
+    std::vector<std::thread> threads;
+    for (auto& receiver : receivers) {
+      threads.emplace_back([&, receiver]() { consume(*receiver, !pub_sub); });
+    }
+    uint64_t cpu_start = cpu_ns();
+    auto start = clock_type::now();
+    auto deadline = start + std::chrono::duration_cast<clock_type::duration>(
+                              std::chrono::duration<double>(m_options.m_duration_s));
+    std::vector<std::thread> producers;
+    for (auto& sender : senders) {
+      producers.emplace_back([&, sender]() { produce(*sender, deadline); });
+    }
+    for (auto& producer : producers) {
+      producer.join();
+    }
+    m_producers_done = true;
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto elapsed = clock_type::now() - start;
+    return result(m_received, elapsed, cpu_ns() - cpu_start);
+  }
+
+  // Each producer is a pinger, with a ponger which sends every message
+  // straight back; the latency is half the round trip
+  nlohmann::json run_ping_pong()
+  {
+    struct Pair
+    {
+      std::shared_ptr<Sender> m_ping_sender, m_pong_sender;
+      std::shared_ptr<Receiver> m_ping_receiver, m_pong_receiver;
+    };
+    std::vector<Pair> pairs(m_point.m_producers);
+    for (auto& pair : pairs) {
+      auto ping = connection_string();
+      auto pong = connection_string();
+      pair.m_ping_sender = make_ipm_sender(m_point.m_family + "Sender");
+      pair.m_pong_sender = make_ipm_sender(m_point.m_family + "Sender");
+      pair.m_ping_sender->connect_for_sends(connection_info(ping));
+      pair.m_pong_sender->connect_for_sends(connection_info(pong));
+      pair.m_ping_receiver = make_ipm_receiver(m_point.m_family + "Receiver");
+      pair.m_pong_receiver = make_ipm_receiver(m_point.m_family + "Receiver");
+      pair.m_ping_receiver->connect_for_receives(connection_info(ping));
+      pair.m_pong_receiver->connect_for_receives(connection_info(pong));
+      warm_up(*pair.m_ping_sender, { pair.m_ping_receiver.get() });
+      warm_up(*pair.m_pong_sender, { pair.m_pong_receiver.get() });
+    }
+
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> pongers;
+    for (auto& pair : pairs) {
+      pongers.emplace_back([&]() {
+        std::vector<char> buffer(m_point.m_size);
+        std::string metadata;
+        while (!stop) {
+          auto result = pair.m_ping_receiver->receive_into(buffer.data(), buffer.size(), s_receive_timeout, &metadata);
+          if (!result.m_timed_out && metadata == s_data_topic) {
+            pair.m_pong_sender->send(buffer.data(), result.m_size, Sender::s_block, s_data_topic);
+          }
+        }
+      });
+    }
+
+    uint64_t cpu_start = cpu_ns();
+    auto start = clock_type::now();
+    auto deadline = start + std::chrono::duration_cast<clock_type::duration>(
+                              std::chrono::duration<double>(m_options.m_duration_s));
+    std::vector<std::thread> pingers;
+    for (auto& pair : pairs) {
+      pingers.emplace_back([&]() {
+        std::vector<char> buffer(m_point.m_size);
+        std::string metadata;
+        uint64_t round_trips = 0;
+        while (clock_type::now() < deadline) {
+          uint64_t sent = now_ns();
+          pair.m_ping_sender->send(buffer.data(), buffer.size(), Sender::s_block, s_data_topic);
+          Receiver::ReceiveIntoResult result;
+          do {
+            result = pair.m_pong_receiver->receive_into(buffer.data(), buffer.size(), s_receive_timeout, &metadata);
+          } while (result.m_timed_out || metadata != s_data_topic);
+          m_latencies->record((now_ns() - sent) / 2);
+          ++round_trips;
+        }
+        m_sent += round_trips;
+        m_received += round_trips;
+      });
+    }
+    for (auto& pinger : pingers) {
+      pinger.join();
+    }
+    auto elapsed = clock_type::now() - start;
+    uint64_t cpu = cpu_ns() - cpu_start;
+    stop = true;
+    for (auto& ponger : pongers) {
+      ponger.join();
+    }
+    // Each round trip is two messages
+    return result(2 * m_received, elapsed, cpu);
+  }
+
+  nlohmann::json result(uint64_t messages, clock_type::duration elapsed, uint64_t cpu) const
+  {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    nlohmann::json output = point_json(m_point);
+    output["messages"] = messages;
+    output["send_timeouts"] = m_send_timeouts.load();
+    output["seconds"] = seconds;
+    output["msgs_per_s"] = messages / seconds;
+    output["gb_per_s"] = messages * m_point.m_size / seconds / 1e9;
+    output["cpu_ns_per_message"] = messages ? cpu / messages : 0;
+    output["latency_ns"] = { { "p50", m_latencies->percentile(0.5) },
+                             { "p99", m_latencies->percentile(0.99) },
+                             { "p999", m_latencies->percentile(0.999) },
+                             { "max", m_latencies->max() } };
+    return output;
+  }
+
+public:
+  static nlohmann::json point_json(const Point& point)
+  {
+    return { { "plugin", point.m_family },       { "pattern", point.m_pattern },
+             { "transport", point.m_transport }, { "message_size", point.m_size },
+             { "producers", point.m_producers }, { "consumers", point.m_consumers } };
+  }
+
+private:
+  const Options& m_options;
+  Point m_point;
+  int m_next_endpoint{ 0 };
+  std::atomic<uint64_t> m_sent{ 0 };
+  std::atomic<uint64_t> m_received{ 0 };
+  std::atomic<uint64_t> m_send_timeouts{ 0 };
+  std::atomic<bool> m_producers_done{ false };
+  std::unique_ptr<LatencyHistogram> m_latencies;
+};
+
+} // namespace ""
+
+int
+main(int argc, char* argv[])
+{
+  Options options;
+  try {
+    options = parse_options(argc, argv);
+  } catch (std::exception const& err) {
+    std::cerr << "ipm_bench: " << err.what() << "\n";
+    usage();
+    return 1;
+  }
+
+  std::vector<Point> points;
+  for (auto const& family : options.m_families) {
+    auto known = s_family_transports.find(family);
+    auto transports = options.m_transports;
+    if (transports.empty()) {
+      if (known == s_family_transports.end()) {
+        std::cerr << "ipm_bench: give --transports for plugin family " << family << "\n";
+        return 1;
+      }
+      transports = known->second;
+    }
+    for (auto const& pattern : options.m_patterns) {
+      if (pattern == "pub-sub" && known != s_family_transports.end() && !s_pub_sub_families.count(family)) {
+        std::cerr << "ipm_bench: skipping pub-sub for " << family << ", which has no publisher\n";
+        continue;
+      }
+      for (auto const& transport : transports) {
+        if (known != s_family_transports.end() &&
+            std::find(known->second.begin(), known->second.end(), transport) == known->second.end()) {
+          continue;
+        }
+        for (int producers : options.m_producers) {
+          for (int consumers : pattern == "ping-pong" ? std::vector<int>{ producers } : options.m_consumers) {
+            for (size_t size : options.m_sizes) {
+              points.push_back(Point{ family, pattern, transport, size, producers, consumers });
+            }
+          }
+        }
+      }
+    }
+  }
+
+  Bench bench(options);
+  nlohmann::json results = nlohmann::json::array();
+  for (auto const& point : points) {
+    std::cerr << "ipm_bench: " << Bench::point_json(point).dump() << "\n";
+    try {
+      results.push_back(bench.run(point));
+    } catch (std::exception const& err) {
+      auto failed = Bench::point_json(point);
+      failed["error"] = err.what();
+      results.push_back(failed);
+      std::cerr << "ipm_bench: failed: " << err.what() << "\n";
+    }
+  }
+
+  nlohmann::json output{ { "duration_s", options.m_duration_s },
+                         { "connection_info", options.m_connection_info },
+                         { "results", results } };
+  std::cout << output.dump(2) << std::endl;
+  return 0;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file ipm_microbench.cxx Micro-benchmarks of the Sender/Receiver hot path
+ *
+ * Measures the per-call cost of the Sender and Receiver layers over the
+ * NullSender/NullReceiver test plugins, which do no transport work, and of
+ * the ZeroMQ plugins over inproc://. Takes the usual google-benchmark
+ * options, e.g. --benchmark_filter=Null.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/ResponsePool.hpp"
+#include "ipm/Sender.hpp"
+
+#include "TRACE/trace.h"
+#define TRACE_NAME "ipm_microbench"
+
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+namespace {
+
+const Sender::duration_t s_timeout(1000);
+
+std::shared_ptr<Sender>
+null_sender()
+{
+  auto sender = make_ipm_sender("NullSender");
+  sender->connect_for_sends({});
+  return sender;
+}
+
+std::shared_ptr<Receiver>
+null_receiver(size_t message_size)
+{
+  auto receiver = make_ipm_receiver("NullReceiver");
+  receiver->connect_for_receives({ { "message_size", message_size } });
+  return receiver;
+}
+
+// google-benchmark runs each case several times, and ZeroMQ releases an
+// endpoint only some time after its socket closes, so each run gets its own
+nlohmann::json
+zmq_connection_info()
+{
+  static int s_endpoint = 0;
+  return { { "connection_string", "inproc://ipm_microbench_" + std::to_string(s_endpoint++) } };
+}
+
+void
+set_counters(benchmark::State& state, size_t message_size)
+{
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * message_size);
+}
+
+// The floor for everything below: one call through a base-class pointer
+class Base
+{
+public:
+  virtual ~Base() = default;
+  virtual void call(const void* message, int size) = 0;
+};
+
+class Derived : public Base
+{
+public:
+  void call(const void* message, int size) override
+  {
+    benchmark::DoNotOptimize(message);
+    benchmark::DoNotOptimize(size);
+  }
+};
+
+void
+BM_VirtualCall(benchmark::State& state)
+{
+  std::unique_ptr<Base> object = std::make_unique<Derived>();
+  benchmark::DoNotOptimize(object);
+  char message[16] = {};
+  for (auto _ : state) {
+    object->call(message, sizeof(message));
+  }
+  set_counters(state, 0);
+}
+BENCHMARK(BM_VirtualCall);
+
+// The per-message logging in the plugins' send_ and receive_ paths
+void
+BM_Tlog(benchmark::State& state)
+{
+  int size = 1024;
+  for (auto _ : state) {
+    TLOG(TLVL_INFO) << "Starting send of " << size << " bytes";
+  }
+  set_counters(state, 0);
+}
+BENCHMARK(BM_Tlog);
+
+void
+BM_NullSend(benchmark::State& state)
+{
+  auto sender = null_sender();
+  std::vector<char> message(state.range(0));
+  for (auto _ : state) {
+    sender->send(message.data(), message.size(), s_timeout);
+  }
+  set_counters(state, message.size());
+}
+BENCHMARK(BM_NullSend)->Arg(16)->Arg(4096);
+
+void
+BM_NullSendWithTopic(benchmark::State& state)
+{
+  auto sender = null_sender();
+  std::vector<char> message(state.range(0));
+  // Long enough not to fit in std::string's small-string buffer
+  const std::string topic("TriggerPrimitiveStream_APA1");
+  for (auto _ : state) {
+    sender->send(message.data(), message.size(), s_timeout, topic);
+  }
+  set_counters(state, message.size());
+}
+BENCHMARK(BM_NullSendWithTopic)->Arg(16);
+
+void
+BM_NullSendMultipart(benchmark::State& state)
+{
+  auto sender = null_sender();
+  std::vector<char> part(64);
+  std::vector<const void*> parts(state.range(0), part.data());
+  std::vector<Sender::message_size_t> sizes(state.range(0), part.size());
+  for (auto _ : state) {
+    sender->send_multipart(parts.data(), sizes, s_timeout);
+  }
+  set_counters(state, parts.size() * part.size());
+}
+BENCHMARK(BM_NullSendMultipart)->Arg(2)->Arg(16);
+
+void
+BM_NullSendBatch(benchmark::State& state)
+{
+  auto sender = null_sender();
+  std::vector<char> message(16);
+  std::vector<Sender::BatchEntry> batch(state.range(0), Sender::BatchEntry{ message.data(), 16 });
+  for (auto _ : state) {
+    sender->send_batch(batch.data(), batch.size(), s_timeout);
+  }
+  // Per message, for comparison with BM_NullSend
+  state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_NullSendBatch)->Arg(64);
+
+// Handing each message to the Sender's IO thread, which is left to catch up
+// at the end; the queue's waits for room are the backpressure
+void
+BM_NullSendAsync(benchmark::State& state)
+{
+  auto sender = null_sender();
+  std::vector<char> message(state.range(0));
+  for (auto _ : state) {
+    sender->send_async(message.data(), message.size(), s_timeout, "", nullptr);
+  }
+  sender->wait_for_async_sends();
+  set_counters(state, message.size());
+}
+BENCHMARK(BM_NullSendAsync)->Arg(16)->Arg(4096);
+
+// Allocates a fresh Response for every message
+void
+BM_NullReceive(benchmark::State& state)
+{
+  auto receiver = null_receiver(state.range(0));
+  for (auto _ : state) {
+    auto response = receiver->receive(s_timeout);
+    benchmark::DoNotOptimize(response.m_data.data());
+  }
+  set_counters(state, state.range(0));
+}
+BENCHMARK(BM_NullReceive)->Arg(16)->Arg(4096)->Arg(1 << 20);
+
+void
+BM_NullReceiveWithPool(benchmark::State& state)
+{
+  auto receiver = null_receiver(state.range(0));
+  receiver->set_response_pool(make_response_pool());
+  for (auto _ : state) {
+    auto response = receiver->receive(s_timeout);
+    benchmark::DoNotOptimize(response.m_data.data());
+  }
+  set_counters(state, state.range(0));
+}
+BENCHMARK(BM_NullReceiveWithPool)->Arg(16)->Arg(4096)->Arg(1 << 20);
+
+void
+BM_NullReceiveInto(benchmark::State& state)
+{
+  auto receiver = null_receiver(state.range(0));
+  std::vector<char> buffer(state.range(0));
+  for (auto _ : state) {
+    auto result = receiver->receive_into(buffer.data(), buffer.size(), s_timeout);
+    benchmark::DoNotOptimize(result);
+  }
+  set_counters(state, state.range(0));
+}
+BENCHMARK(BM_NullReceiveInto)->Arg(16)->Arg(4096)->Arg(1 << 20);
+
+// One message there and back through ZeroMQ's inproc:// transport, on one
+// thread, so that the queues never fill
+void
+BM_ZmqInprocSendReceive(benchmark::State& state)
+{
+  auto connection_info = zmq_connection_info();
+  auto sender = make_ipm_sender("ZmqSender");
+  auto receiver = make_ipm_receiver("ZmqReceiver");
+  sender->connect_for_sends(connection_info);
+  receiver->connect_for_receives(connection_info);
+  std::vector<char> message(state.range(0));
+  for (auto _ : state) {
+    sender->send(message.data(), message.size(), s_timeout);
+    auto response = receiver->receive(s_timeout);
+    benchmark::DoNotOptimize(response.m_data.data());
+  }
+  set_counters(state, message.size());
+}
+BENCHMARK(BM_ZmqInprocSendReceive)->Arg(16)->Arg(4096);
+
+void
+BM_ZmqInprocSendReceiveInto(benchmark::State& state)
+{
+  auto connection_info = zmq_connection_info();
+  auto sender = make_ipm_sender("ZmqSender");
+  auto receiver = make_ipm_receiver("ZmqReceiver");
+  sender->connect_for_sends(connection_info);
+  receiver->connect_for_receives(connection_info);
+  std::vector<char> message(state.range(0));
+  std::vector<char> buffer(state.range(0));
+  for (auto _ : state) {
+    sender->send(message.data(), message.size(), s_timeout);
+    auto result = receiver->receive_into(buffer.data(), buffer.size(), s_timeout);
+    benchmark::DoNotOptimize(result);
+  }
+  set_counters(state, message.size());
+}
+BENCHMARK(BM_ZmqInprocSendReceiveInto)->Arg(16)->Arg(4096);
+
+} // namespace ""
+
+BENCHMARK_MAIN();
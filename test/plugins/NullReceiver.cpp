@@ -0,0 +1,82 @@
+/**
+ *
+ * @file NullReceiver.cpp A Receiver which always has a message ready, for measuring the cost of the Receiver layer
+ * itself
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+// Every receive returns the same message, of the size given by the
+// "message_size" connection_info key (default 1024 bytes), with metadata
+// taken from "metadata"
+class NullReceiver : public Receiver
+{
+public:
+  bool can_receive() const noexcept override { return m_connected; }
+  void connect_for_receives(const nlohmann::json& connection_info) override
+  {
+    m_message.assign(connection_info.value<size_t>("message_size", 1024), 'X');
+    m_metadata = connection_info.value<std::string>("metadata", "");
+    m_connected = true;
+  }
+
+protected:
+  // Copies out the message, as a transport would have to
+  Receiver::Response receive_(const duration_t& /* timeout */) override
+  {
+    Receiver::Response output;
+    output.m_data = m_message;
+    output.m_metadata = m_metadata;
+    return output;
+  }
+
+  Receiver::ResponseView receive_view_(const duration_t& /* timeout */) override
+  {
+    Receiver::ResponseView view;
+    view.m_metadata = m_metadata;
+    view.m_data = m_message.data();
+    view.m_size = m_message.size();
+    return view;
+  }
+
+  Receiver::ReceiveIntoResult receive_into_(void* buffer,
+                                            message_size_t buffer_size,
+                                            const duration_t& /* timeout */,
+                                            std::string* metadata) override
+  {
+    Receiver::ReceiveIntoResult result;
+    result.m_size = static_cast<message_size_t>(m_message.size());
+    if (result.m_size > buffer_size) {
+      result.m_buffer_too_small = true;
+      return result;
+    }
+    if (result.m_size > 0) {
+      memcpy(buffer, m_message.data(), m_message.size());
+    }
+    if (metadata) {
+      metadata->assign(m_metadata);
+    }
+    return result;
+  }
+
+private:
+  bool m_connected{ false };
+  std::vector<char> m_message;
+  std::string m_metadata;
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_RECEIVER(dunedaq::ipm::NullReceiver)
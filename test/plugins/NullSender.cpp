@@ -0,0 +1,59 @@
+/**
+ *
+ * @file NullSender.cpp A Sender which discards everything, for measuring the cost of the Sender layer itself
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Sender.hpp"
+
+#include <string>
+#include <vector>
+
+namespace dunedaq {
+namespace ipm {
+
+class NullSender : public Sender
+{
+public:
+  bool can_send() const noexcept override { return m_connected; }
+  void connect_for_sends(const nlohmann::json& /* connection_info */) override { m_connected = true; }
+
+protected:
+  void send_(const void* /* message */,
+             int /* N */,
+             const duration_t& /* timeout */,
+             std::string const& /* topic */) override
+  {}
+
+  void send_zero_copy_(void* message,
+                       int /* N */,
+                       release_fn_t release,
+                       void* hint,
+                       const duration_t& /* timeout */,
+                       std::string const& /* topic */) override
+  {
+    release(message, hint);
+  }
+
+  void send_multipart_(const void** /* message_parts */,
+                       const std::vector<int>& /* message_sizes */,
+                       const duration_t& /* timeout */,
+                       std::string const& /* topic */) override
+  {}
+
+  size_t send_batch_(const BatchEntry* /* entries */, size_t num_entries, const duration_t& /* timeout */) override
+  {
+    return num_entries;
+  }
+
+private:
+  bool m_connected{ false };
+};
+
+} // namespace ipm
+} // namespace dunedaq
+
+DEFINE_DUNE_IPM_SENDER(dunedaq::ipm::NullSender)
@@ -16,8 +16,8 @@
 #include "TRACE/trace.h"
 
 #include <chrono>
+#include <sstream>
 #include <string>
-#include <thread>
 #include <utility>
 #include <vector>
 
@@ -31,7 +31,6 @@ namespace ipm {
 
 VectorIntIPMReceiverDAQModule::VectorIntIPMReceiverDAQModule(const std::string& name)
   : appfwk::DAQModule(name)
-  , m_thread(std::bind(&VectorIntIPMReceiverDAQModule::do_work, this, std::placeholders::_1))
   , m_output_queue(nullptr)
 {
 
@@ -60,66 +59,39 @@ VectorIntIPMReceiverDAQModule::do_configure(const data_t& config_data)
   m_num_ints_per_vector = m_cfg.nIntsPerVector;
   m_queue_timeout = static_cast<std::chrono::milliseconds>(m_cfg.queue_timeout_ms);
 
-  m_input = make_ipm_receiver(m_cfg.receiver_type);
-
-  m_input->connect_for_receives(m_cfg.connection_info);
+  auto receiver = make_ipm_receiver(m_cfg.receiver_type);
+  receiver->connect_for_receives(m_cfg.connection_info);
+  m_input = std::make_unique<TypedReceiver<std::vector<int>>>(std::move(receiver));
 }
 
 void
 VectorIntIPMReceiverDAQModule::do_start(const data_t& /*args*/)
 {
-  m_thread.start_working_thread();
+  m_counter = 0;
+  // Each vector is handed over as soon as it arrives, with no polling loop here
+  m_input->start_dispatch([this](std::vector<int>& output) { handle(output); }, m_cfg.dispatch_threads);
 }
 
 void
 VectorIntIPMReceiverDAQModule::do_stop(const data_t& /*args*/)
 {
-  m_thread.stop_working_thread();
+  m_input->stop_dispatch();
 }
 
 void
-VectorIntIPMReceiverDAQModule::do_work(std::atomic<bool>& running_flag)
+VectorIntIPMReceiverDAQModule::handle(std::vector<int>& output)
 {
-  size_t counter = 0;
-  std::ostringstream oss;
+  assert(output.size() == m_num_ints_per_vector);
 
-  while (running_flag.load()) {
-    if (m_input->can_receive()) {
-
-      TLOG(TLVL_TRACE) << get_name() << ": Creating output vector";
-      std::vector<int> output(m_num_ints_per_vector);
-
-      try {
-
-        auto recvd = m_input->receive(m_queue_timeout);
-
-        if (recvd.m_data.size() == 0) {
-          TLOG(TLVL_TRACE) << "No data received, moving to next loop iteration";
-          continue;
-        }
-
-        assert(recvd.m_data.size() == m_num_ints_per_vector * sizeof(int));
-        memcpy(&output[0], &recvd.m_data[0], sizeof(int) * m_num_ints_per_vector);
-      } catch (ReceiveTimeoutExpired const& rte) {
-        TLOG(TLVL_TRACE) << "ReceiveTimeoutExpired: " << rte.what();
-        continue;
-      }
-      oss << ": Received vector " << counter << " with size " << output.size();
-      ers::info(ReceiverProgressUpdate(ERS_HERE, get_name(), oss.str()));
-      oss.str("");
-
-      TLOG(TLVL_TRACE) << get_name() << ": Pushing vector into output_queue";
-      try {
-        m_output_queue->push(std::move(output), m_queue_timeout);
-      } catch (const appfwk::QueueTimeoutExpired& ex) {
-        ers::warning(ex);
-      }
-
-      TLOG(TLVL_TRACE) << get_name() << ": End of do_work loop";
-      counter++;
-    } else {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
+  std::ostringstream oss;
+  oss << ": Received vector " << m_counter++ << " with size " << output.size();
+  ers::info(ReceiverProgressUpdate(ERS_HERE, get_name(), oss.str()));
+
+  TLOG(TLVL_TRACE) << get_name() << ": Pushing vector into output_queue";
+  try {
+    m_output_queue->push(std::move(output), m_queue_timeout);
+  } catch (const appfwk::QueueTimeoutExpired& ex) {
+    ers::warning(ex);
   }
 }
 
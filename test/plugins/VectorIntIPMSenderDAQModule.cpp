@@ -20,6 +20,7 @@
 #include <functional>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 /**
@@ -65,8 +66,9 @@ VectorIntIPMSenderDAQModule::do_configure(const data_t& config_data)
   m_queue_timeout = static_cast<std::chrono::milliseconds>(m_cfg.queue_timeout_ms);
   m_topic = m_cfg.topic;
 
-  m_output = make_ipm_sender(m_cfg.sender_type);
-  m_output->connect_for_sends(m_cfg.connection_info);
+  auto sender = make_ipm_sender(m_cfg.sender_type);
+  sender->connect_for_sends(m_cfg.connection_info);
+  m_output = std::make_unique<TypedSender<std::vector<int>>>(std::move(sender));
 }
 
 void
@@ -100,7 +102,7 @@ VectorIntIPMSenderDAQModule::do_work(std::atomic<bool>& running_flag)
       }
 
       TLOG(TLVL_TRACE) << get_name() << ": Received vector of size " << vec.size() << " from queue, sending";
-      m_output->send(&vec[0], vec.size() * sizeof(int), m_queue_timeout, m_topic);
+      m_output->send(vec, m_queue_timeout, m_topic);
 
       counter++;
       oss << ": Sent " << counter << " vectors";
@@ -12,7 +12,7 @@
 #ifndef IPM_TEST_PLUGINS_VECTORINTIPMSENDERDAQMODULE_HPP_
 #define IPM_TEST_PLUGINS_VECTORINTIPMSENDERDAQMODULE_HPP_
 
-#include "ipm/Sender.hpp"
+#include "ipm/TypedSender.hpp"
 #include "ipm/vectorintipmsenderdaqmodule/Structs.hpp"
 
 #include "appfwk/DAQModule.hpp"
@@ -68,7 +68,7 @@ private:
   size_t m_num_ints_per_vector = 999;
   std::chrono::milliseconds m_queue_timeout;
   std::unique_ptr<appfwk::DAQSource<std::vector<int>>> m_input_queue;
-  std::shared_ptr<Sender> m_output;
+  std::unique_ptr<TypedSender<std::vector<int>>> m_output;
   std::string m_topic{ "" };
 };
 
@@ -9,6 +9,7 @@
 
 #include "VectorIntIPMSubscriberDAQModule.hpp"
 
+#include "ipm/Subscriber.hpp"
 #include "ipm/vectorintipmreceiverdaqmodule/Nljs.hpp"
 
 #include "appfwk/cmd/Nljs.hpp"
@@ -16,8 +17,8 @@
 #include "TRACE/trace.h"
 
 #include <chrono>
+#include <sstream>
 #include <string>
-#include <thread>
 #include <utility>
 #include <vector>
 
@@ -31,7 +32,6 @@ namespace ipm {
 
 VectorIntIPMSubscriberDAQModule::VectorIntIPMSubscriberDAQModule(const std::string& name)
   : appfwk::DAQModule(name)
-  , m_thread(std::bind(&VectorIntIPMSubscriberDAQModule::do_work, this, std::placeholders::_1))
   , m_output_queue(nullptr)
 {
 
@@ -60,69 +60,45 @@ VectorIntIPMSubscriberDAQModule::do_configure(const data_t& config_data)
   m_num_ints_per_vector = m_cfg.nIntsPerVector;
   m_queue_timeout = static_cast<std::chrono::milliseconds>(m_cfg.queue_timeout_ms);
 
-  m_input = make_ipm_subscriber(m_cfg.receiver_type);
+  auto subscriber = make_ipm_subscriber(m_cfg.receiver_type);
 
   std::string topic = m_cfg.topic;
   ERS_INFO("VIISubDM: topic is " << topic);
 
-  m_input->subscribe(topic);
-  m_input->connect_for_receives(m_cfg.connection_info);
+  subscriber->subscribe(topic);
+  subscriber->connect_for_receives(m_cfg.connection_info);
+  m_input = std::make_unique<TypedReceiver<std::vector<int>>>(std::move(subscriber));
 }
 
 void
 VectorIntIPMSubscriberDAQModule::do_start(const data_t& /*args*/)
 {
-  m_thread.start_working_thread();
+  m_counter = 0;
+  // Each vector is handed over as soon as it arrives, with no polling loop here
+  m_input->start_dispatch([this](std::vector<int>& output) { handle(output); }, m_cfg.dispatch_threads);
 }
 
 void
 VectorIntIPMSubscriberDAQModule::do_stop(const data_t& /*args*/)
 {
-  m_thread.stop_working_thread();
+  m_input->stop_dispatch();
 }
 
 void
-VectorIntIPMSubscriberDAQModule::do_work(std::atomic<bool>& running_flag)
+VectorIntIPMSubscriberDAQModule::handle(std::vector<int>& output)
 {
-  size_t counter = 0;
-  std::ostringstream oss;
+  assert(output.size() == m_num_ints_per_vector);
 
-  while (running_flag.load()) {
-    if (m_input->can_receive()) {
-
-      TLOG(TLVL_TRACE) << get_name() << ": Creating output vector";
-      std::vector<int> output(m_num_ints_per_vector);
-
-      try {
-        auto recvd = m_input->receive(m_queue_timeout);
-        if (recvd.m_data.size() == 0) {
-          TLOG(TLVL_TRACE) << "No data received, moving to next loop iteration";
-          continue;
-        }
-
-        assert(recvd.m_data.size() == m_num_ints_per_vector * sizeof(int));
-        memcpy(&output[0], &recvd.m_data[0], sizeof(int) * m_num_ints_per_vector);
-
-        oss << ": Received vector " << counter << " with size " << output.size() << " on topic " << recvd.m_metadata;
-        ers::info(SubscriberProgressUpdate(ERS_HERE, get_name(), oss.str()));
-        oss.str("");
-      } catch (ReceiveTimeoutExpired const& rte) {
-        TLOG(TLVL_TRACE) << "ReceiveTimeoutExpired: " << rte.what();
-        continue;
-      }
-
-      TLOG(TLVL_TRACE) << get_name() << ": Pushing vector into output_queue";
-      try {
-        m_output_queue->push(std::move(output), m_queue_timeout);
-      } catch (const appfwk::QueueTimeoutExpired& ex) {
-        ers::warning(ex);
-      }
-
-      TLOG(TLVL_TRACE) << get_name() << ": End of do_work loop";
-      counter++;
-    } else {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-    }
+  std::ostringstream oss;
+  oss << ": Received vector " << m_counter++ << " with size " << output.size() << " subscribed to topic "
+      << m_cfg.topic;
+  ers::info(SubscriberProgressUpdate(ERS_HERE, get_name(), oss.str()));
+
+  TLOG(TLVL_TRACE) << get_name() << ": Pushing vector into output_queue";
+  try {
+    m_output_queue->push(std::move(output), m_queue_timeout);
+  } catch (const appfwk::QueueTimeoutExpired& ex) {
+    ers::warning(ex);
   }
 }
 
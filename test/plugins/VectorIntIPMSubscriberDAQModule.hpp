@@ -11,14 +11,13 @@
 #ifndef IPM_TEST_PLUGINS_VECTORINTIPMSUBSCRIBERDAQMODULE_HPP_
 #define IPM_TEST_PLUGINS_VECTORINTIPMSUBSCRIBERDAQMODULE_HPP_
 
-#include "ipm/Subscriber.hpp"
+#include "ipm/TypedReceiver.hpp"
 #include "ipm/vectorintipmreceiverdaqmodule/Structs.hpp"
 
 #include "appfwk/DAQModule.hpp"
 #include "appfwk/DAQSink.hpp"
-#include "appfwk/ThreadHelper.hpp"
 
-#include <future>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -55,13 +54,13 @@ private:
   void do_start(const data_t&);
   void do_stop(const data_t&);
 
-  // Threading
-  appfwk::ThreadHelper m_thread;
-  void do_work(std::atomic<bool>& running_flag);
+  // Called on the subscriber's dispatch threads
+  void handle(std::vector<int>& output);
+  std::atomic<size_t> m_counter{ 0 };
 
   // Configuration
   vectorintipmreceiverdaqmodule::Conf m_cfg;
-  std::shared_ptr<Subscriber> m_input;
+  std::unique_ptr<TypedReceiver<std::vector<int>>> m_input;
   std::unique_ptr<appfwk::DAQSink<std::vector<int>>> m_output_queue;
   std::chrono::milliseconds m_queue_timeout;
   size_t m_num_ints_per_vector = 999;
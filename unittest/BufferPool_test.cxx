@@ -0,0 +1,93 @@
+/**
+ * @file BufferPool_test.cxx BufferPool class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/BufferPool.hpp"
+
+#define BOOST_TEST_MODULE BufferPool_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(BufferPool_test)
+
+BOOST_AUTO_TEST_CASE(CopyAndMoveSemantics)
+{
+  BOOST_REQUIRE(!std::is_copy_constructible_v<BufferPool>);
+  BOOST_REQUIRE(!std::is_copy_assignable_v<BufferPool>);
+  BOOST_REQUIRE(!std::is_move_constructible_v<BufferPool>);
+  BOOST_REQUIRE(!std::is_move_assignable_v<BufferPool>);
+
+  BOOST_REQUIRE(!std::is_copy_constructible_v<BufferPool::Buffer>);
+  BOOST_REQUIRE(!std::is_copy_assignable_v<BufferPool::Buffer>);
+  BOOST_REQUIRE(std::is_nothrow_move_constructible_v<BufferPool::Buffer>);
+  BOOST_REQUIRE(std::is_nothrow_move_assignable_v<BufferPool::Buffer>);
+}
+
+BOOST_AUTO_TEST_CASE(AcquireAndRecycle)
+{
+  auto pool = make_buffer_pool(1024, 2);
+  BOOST_REQUIRE_EQUAL(pool->buffer_size(), 1024);
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 2);
+
+  auto first = pool->acquire();
+  BOOST_REQUIRE(first);
+  BOOST_REQUIRE_EQUAL(first.size(), 1024);
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 1);
+
+  char* first_storage = first.data();
+  first.reset();
+  BOOST_REQUIRE(!first);
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 2);
+
+  // The most recently returned buffer is handed out again
+  auto second = pool->acquire();
+  BOOST_REQUIRE_EQUAL(second.data(), first_storage);
+
+  {
+    auto a = pool->acquire();
+    auto b = pool->acquire(); // Pool is empty by now, so this one is freshly allocated
+    BOOST_REQUIRE_EQUAL(pool->num_free(), 0);
+    b = std::move(a); // Assigning over a buffer returns the old storage
+    BOOST_REQUIRE_EQUAL(pool->num_free(), 1);
+  }
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(BuffersOutlivePool)
+{
+  auto pool = make_buffer_pool(16);
+  auto buffer = pool->acquire();
+  std::weak_ptr<BufferPool> weak_pool = pool;
+  pool.reset();
+
+  BOOST_REQUIRE(!weak_pool.expired());
+  buffer.reset();
+  BOOST_REQUIRE(weak_pool.expired());
+}
+
+BOOST_AUTO_TEST_CASE(ReturnFromOtherThread)
+{
+  auto pool = make_buffer_pool(64);
+  std::vector<BufferPool::Buffer> buffers;
+  for (int i = 0; i < 100; ++i) {
+    buffers.push_back(pool->acquire());
+  }
+
+  std::thread releaser([&]() { buffers.clear(); });
+  releaser.join();
+
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,215 @@
+/**
+ * @file Coroutines_test.cxx co_receive, co_send and Reactor Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Coroutines.hpp"
+
+#define BOOST_TEST_MODULE Coroutines_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(Coroutines_test)
+
+#ifdef IPM_HAVE_COROUTINES
+
+namespace {
+
+// Starts at once and runs to completion without anyone waiting on it
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+struct Endpoints
+{
+  Endpoints(const std::string& name, const std::string& transport)
+  {
+    // The Unix-domain socket file is removed by the sender
+    auto connection_string = transport == "Uds"
+                               ? "ipc:///tmp/ipm_Coroutines_test_" + name + "_" + std::to_string(getpid())
+                               : "inproc://Coroutines_test_" + name;
+    nlohmann::json connection_info{ { "connection_string", connection_string } };
+    m_sender = make_ipm_sender(transport + "Sender");
+    m_receiver = make_ipm_receiver(transport + "Receiver");
+    m_sender->connect_for_sends(connection_info);
+    m_receiver->connect_for_receives(connection_info);
+  }
+
+  std::shared_ptr<Sender> m_sender;
+  std::shared_ptr<Receiver> m_receiver;
+};
+
+const std::chrono::milliseconds s_timeout(5000);
+
+template<typename Predicate>
+bool
+wait_until(Predicate done)
+{
+  auto deadline = std::chrono::steady_clock::now() + s_timeout;
+  while (!done() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return done();
+}
+
+// Receives num_messages, each holding its index, then sends the last back.
+// num_done only counts it if they all arrived as expected.
+Detached
+echo_last(Receiver& receiver, Sender& sender, int num_messages, Reactor& reactor, std::atomic<int>& num_done)
+{
+  int value = -1;
+  for (int i = 0; i < num_messages; ++i) {
+    auto response = co_await co_receive(receiver, s_timeout, reactor);
+    if (response.m_data.size() != sizeof(int)) {
+      co_return;
+    }
+    memcpy(&value, response.m_data.data(), sizeof(int));
+    if (value != i) {
+      co_return;
+    }
+  }
+  co_await co_send(sender, &value, sizeof(value), s_timeout, "", reactor);
+  ++num_done;
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(ReceiveAndSend)
+{
+  for (std::string transport : { "Zmq", "Uds", "Inproc" }) {
+    BOOST_TEST_MESSAGE("Transport " << transport);
+    Reactor reactor;
+    Endpoints there("ReceiveAndSend_there_" + transport, transport);
+    Endpoints back("ReceiveAndSend_back_" + transport, transport);
+
+    // ZeroMQ and the socket plugins have a descriptor to wait on; Inproc is polled
+    BOOST_REQUIRE_EQUAL(there.m_receiver->readiness_fd() >= 0, transport != "Inproc");
+    BOOST_REQUIRE_EQUAL(there.m_sender->readiness_fd() >= 0, transport != "Inproc");
+
+    std::atomic<int> num_done{ 0 };
+    echo_last(*there.m_receiver, *back.m_sender, 3, reactor, num_done);
+    BOOST_REQUIRE_EQUAL(reactor.num_watches(), 1);
+
+    for (int i = 0; i < 3; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      there.m_sender->send(&i, sizeof(i), s_timeout);
+    }
+    auto response = back.m_receiver->receive(s_timeout);
+    BOOST_REQUIRE_EQUAL(response.m_data.size(), sizeof(int));
+    BOOST_REQUIRE_EQUAL(*reinterpret_cast<int*>(response.m_data.data()), 2);
+    BOOST_REQUIRE(wait_until([&] { return num_done == 1 && reactor.num_watches() == 0; }));
+
+    auto info = there.m_receiver->get_info();
+    BOOST_REQUIRE_EQUAL(info.m_messages, 3);
+    BOOST_REQUIRE_EQUAL(info.m_timeouts, 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ManyConnections)
+{
+  const int num_connections = 200;
+  const int num_messages = 5;
+  Reactor reactor(2);
+
+  std::vector<std::unique_ptr<Endpoints>> there;
+  std::vector<std::unique_ptr<Endpoints>> back;
+  std::atomic<int> num_done{ 0 };
+  for (int c = 0; c < num_connections; ++c) {
+    there.push_back(std::make_unique<Endpoints>("ManyConnections_there_" + std::to_string(c), "Zmq"));
+    back.push_back(std::make_unique<Endpoints>("ManyConnections_back_" + std::to_string(c), "Zmq"));
+    echo_last(*there[c]->m_receiver, *back[c]->m_sender, num_messages, reactor, num_done);
+  }
+  BOOST_REQUIRE_EQUAL(reactor.num_watches(), num_connections);
+
+  for (int i = 0; i < num_messages; ++i) {
+    for (int c = 0; c < num_connections; ++c) {
+      there[c]->m_sender->send(&i, sizeof(i), s_timeout);
+    }
+  }
+  for (int c = 0; c < num_connections; ++c) {
+    BOOST_REQUIRE_EQUAL(back[c]->m_receiver->receive(s_timeout).m_data.size(), sizeof(int));
+  }
+  BOOST_REQUIRE(wait_until([&] { return num_done == num_connections && reactor.num_watches() == 0; }));
+}
+
+BOOST_AUTO_TEST_CASE(Timeouts)
+{
+  Reactor reactor;
+  Endpoints endpoints("Timeouts", "Zmq");
+  std::atomic<int> num_timeouts{ 0 };
+
+  auto expect_timeout = [&](std::chrono::milliseconds timeout) -> Detached {
+    try {
+      co_await co_receive(*endpoints.m_receiver, timeout, reactor);
+    } catch (ReceiveTimeoutExpired const&) {
+      ++num_timeouts;
+    }
+  };
+
+  // Without waiting, the coroutine carries straight on
+  expect_timeout(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(num_timeouts, 1);
+
+  auto start_time = std::chrono::steady_clock::now();
+  expect_timeout(std::chrono::milliseconds(50));
+  BOOST_REQUIRE(wait_until([&] { return num_timeouts == 2; }));
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+  BOOST_REQUIRE_EQUAL(endpoints.m_receiver->get_info().m_timeouts, 2);
+}
+
+BOOST_AUTO_TEST_CASE(ReactorDestroyed)
+{
+  Endpoints endpoints("ReactorDestroyed", "Zmq");
+  std::atomic<bool> stopped{ false };
+  {
+    Reactor reactor;
+    // Named, as the coroutine refers to the lambda's captures after this statement
+    auto wait_forever = [&]() -> Detached {
+      try {
+        co_await co_receive(*endpoints.m_receiver, Receiver::s_block, reactor);
+      } catch (dunedaq::ipm::ReactorStopped const&) {
+        stopped = true;
+      }
+    };
+    wait_forever();
+    BOOST_REQUIRE(!stopped);
+  }
+  BOOST_REQUIRE(stopped);
+}
+
+#else
+
+BOOST_AUTO_TEST_CASE(NoCoroutines)
+{
+  BOOST_TEST_MESSAGE("Built without C++20 coroutines, so only the Reactor is available");
+  Reactor reactor;
+  BOOST_REQUIRE_EQUAL(reactor.num_threads(), 1);
+}
+
+#endif // IPM_HAVE_COROUTINES
+
+BOOST_AUTO_TEST_SUITE_END()
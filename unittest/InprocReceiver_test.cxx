@@ -0,0 +1,172 @@
+/**
+ * @file InprocReceiver_test.cxx InprocReceiver class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE InprocReceiver_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(InprocReceiver_test)
+
+namespace {
+
+// Mean one-way latency, as half the round trip of a message bounced off an echo thread
+std::chrono::nanoseconds
+mean_one_way_latency(const std::string& sender_type, const std::string& receiver_type, const std::string& name)
+{
+  nlohmann::json ping_info{ { "connection_string", "inproc://" + name + "_ping" } };
+  nlohmann::json pong_info{ { "connection_string", "inproc://" + name + "_pong" } };
+  auto ping_sender = make_ipm_sender(sender_type);
+  auto ping_receiver = make_ipm_receiver(receiver_type);
+  auto pong_sender = make_ipm_sender(sender_type);
+  auto pong_receiver = make_ipm_receiver(receiver_type);
+  ping_sender->connect_for_sends(ping_info);
+  ping_receiver->connect_for_receives(ping_info);
+  pong_sender->connect_for_sends(pong_info);
+  pong_receiver->connect_for_receives(pong_info);
+
+  const int num_round_trips = 20000;
+  std::vector<char> message(64, 'M');
+  std::thread echo_thread([&]() {
+    for (int i = 0; i < num_round_trips; ++i) {
+      auto response = ping_receiver->receive(std::chrono::milliseconds(10000));
+      pong_sender->send(response.m_data.data(), response.m_data.size(), std::chrono::milliseconds(10000));
+    }
+  });
+
+  auto start_time = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_round_trips; ++i) {
+    ping_sender->send(message.data(), message.size(), std::chrono::milliseconds(10000));
+    pong_receiver->receive(std::chrono::milliseconds(10000), message.size());
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  echo_thread.join();
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) / (2 * num_round_trips);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  BOOST_REQUIRE(the_receiver != nullptr);
+  BOOST_REQUIRE(!the_receiver->can_receive());
+
+  the_receiver->connect_for_receives({ { "connection_string", "inproc://InprocReceiver_test_BasicTests" } });
+  BOOST_REQUIRE(the_receiver->can_receive());
+}
+
+BOOST_AUTO_TEST_CASE(SendReceive)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocReceiver_test_SendReceive" } };
+  auto the_sender = make_ipm_sender("InprocSender");
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block);
+
+  auto response = the_receiver->receive(Receiver::s_no_block, test_data.size());
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "TOPIC");
+  BOOST_REQUIRE(response.m_data == test_data);
+
+  auto view = the_receiver->receive_view(Receiver::s_no_block);
+  BOOST_REQUIRE(view.m_metadata.empty());
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), "TEST");
+
+  // Endpoints with different names don't see each other's messages
+  auto other_receiver = make_ipm_receiver("InprocReceiver");
+  other_receiver->connect_for_receives({ { "connection_string", "inproc://InprocReceiver_test_Other" } });
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block);
+  BOOST_REQUIRE_EXCEPTION(other_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE_NO_THROW(the_receiver->receive(Receiver::s_no_block));
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveTimeout)
+{
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_receiver->connect_for_receives({ { "connection_string", "inproc://InprocReceiver_test_ReceiveTimeout" } });
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(50)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocReceiver_test_ReceiveInto" } };
+  auto the_sender = make_ipm_sender("InprocSender");
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string test_data("TESTDATA");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+
+  std::vector<char> buffer(4);
+  std::string metadata;
+  auto result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+
+  buffer.resize(result.m_size);
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(result.m_timed_out);
+
+  // A message kept for not fitting comes first from any kind of receive, and
+  // the ones behind it are intact
+  std::string long_data("TESTDATA_TOO_LONG");
+  the_sender->send(long_data.data(), long_data.size(), Sender::s_block, "LONG");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "NEXT");
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  auto kept = the_receiver->receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(kept.m_metadata, "LONG");
+  BOOST_REQUIRE_EQUAL(std::string(kept.m_data.begin(), kept.m_data.end()), long_data);
+  auto next = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(next.m_metadata, "NEXT");
+  BOOST_REQUIRE_EQUAL(std::string(next.m_data.begin(), next.m_data.end()), test_data);
+}
+
+BOOST_AUTO_TEST_CASE(LatencyComparedToZmq)
+{
+  auto latency = mean_one_way_latency("InprocSender", "InprocReceiver", "InprocReceiver_test_Latency");
+  auto zmq_latency = mean_one_way_latency("ZmqSender", "ZmqReceiver", "InprocReceiver_test_ZmqLatency");
+
+  BOOST_TEST_MESSAGE("Mean one-way latency: " << latency.count() << " ns through InprocSender/InprocReceiver, "
+                                              << zmq_latency.count() << " ns through ZeroMQ inproc");
+  BOOST_CHECK_LT(latency.count(), zmq_latency.count());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
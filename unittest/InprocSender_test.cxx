@@ -0,0 +1,209 @@
+/**
+ * @file InprocSender_test.cxx InprocSender class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE InprocSender_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(InprocSender_test)
+
+namespace {
+
+void
+count_releases(void* /* message */, void* hint)
+{
+  ++*static_cast<std::atomic<int>*>(hint);
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_sender = make_ipm_sender("InprocSender");
+  BOOST_REQUIRE(the_sender != nullptr);
+  BOOST_REQUIRE(!the_sender->can_send());
+
+  the_sender->connect_for_sends({ { "connection_string", "inproc://InprocSender_test_BasicTests" } });
+  BOOST_REQUIRE(the_sender->can_send());
+}
+
+BOOST_AUTO_TEST_CASE(SendTimeout)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocSender_test_SendTimeout" },
+                                   { "capacity", 2 } };
+  auto the_sender = make_ipm_sender("InprocSender");
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block, "1");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block, "2");
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(50), "LOST"),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+
+  // A buffer handed over without copying is still released if it can't be sent
+  std::atomic<int> num_releases{ 0 };
+  BOOST_REQUIRE_EXCEPTION(
+    the_sender->send_zero_copy(test_data.data(), test_data.size(), &count_releases, &num_releases, Sender::s_no_block),
+    dunedaq::ipm::SendTimeoutExpired,
+    [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE_EQUAL(num_releases.load(), 1);
+
+  // A blocked sender carries on as soon as the receiver makes room
+  std::thread receiver_thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    the_receiver->receive(std::chrono::milliseconds(1000));
+  });
+  the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000), "3");
+  receiver_thread.join();
+
+  BOOST_REQUIRE_EQUAL(the_receiver->receive(Receiver::s_no_block).m_metadata, "2");
+  BOOST_REQUIRE_EQUAL(the_receiver->receive(Receiver::s_no_block).m_metadata, "3");
+}
+
+BOOST_AUTO_TEST_CASE(GetInfo)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocSender_test_GetInfo" }, { "capacity", 2 } };
+  auto the_sender = make_ipm_sender("InprocSender");
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block);
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block);
+  BOOST_REQUIRE_EQUAL(the_sender->get_info().m_queue_depth, 2);
+  BOOST_REQUIRE_EQUAL(the_receiver->get_info().m_queue_depth, 2);
+
+  // Backpressure shows up as retries and time blocked
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(50)),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  auto info = the_sender->get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 2);
+  BOOST_REQUIRE_EQUAL(info.m_bytes, 2 * test_data.size());
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 1);
+  BOOST_REQUIRE_GE(info.m_retries, 1);
+  BOOST_REQUIRE_GE(info.m_blocked_ns, 40000000);
+
+  the_receiver->receive(Receiver::s_no_block);
+  the_receiver->receive(Receiver::s_no_block);
+  info = the_receiver->get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 2);
+  BOOST_REQUIRE_EQUAL(info.m_queue_depth, 0);
+}
+
+BOOST_AUTO_TEST_CASE(ZeroCopy)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocSender_test_ZeroCopy" } };
+  auto the_sender = make_ipm_sender("InprocSender");
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  // The receiver sees the sender's own buffer, which is released once the view is dropped
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  std::atomic<int> num_releases{ 0 };
+  the_sender->send_zero_copy(test_data.data(), test_data.size(), &count_releases, &num_releases, Sender::s_block, "ZC");
+  {
+    auto view = the_receiver->receive_view(Receiver::s_no_block);
+    BOOST_REQUIRE_EQUAL(view.m_metadata, "ZC");
+    BOOST_REQUIRE_EQUAL(static_cast<const void*>(view.m_data), static_cast<const void*>(test_data.data()));
+    BOOST_REQUIRE_EQUAL(num_releases.load(), 0);
+  }
+  BOOST_REQUIRE_EQUAL(num_releases.load(), 1);
+
+  // Pooled buffers go back to their pool once received
+  auto pool = make_buffer_pool(test_data.size());
+  auto buffer = pool->acquire();
+  std::copy(test_data.begin(), test_data.end(), buffer.data());
+  the_sender->send(std::move(buffer), test_data.size(), Sender::s_block, "POOL");
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 0);
+
+  auto response = the_receiver->receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "POOL");
+  BOOST_REQUIRE(response.m_data == test_data);
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 1);
+
+  // Messages still queued when the last endpoint goes away are released too
+  the_sender->send_zero_copy(test_data.data(), test_data.size(), &count_releases, &num_releases, Sender::s_block);
+  the_sender.reset();
+  the_receiver.reset();
+  BOOST_REQUIRE_EQUAL(num_releases.load(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(Multipart)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocSender_test_Multipart" } };
+  auto the_sender = make_ipm_sender("InprocSender");
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string header = "HEADER";
+  std::string fragment = "FRAGMENT";
+  const void* parts[] = { header.data(), fragment.data() };
+  std::vector<Sender::message_size_t> sizes{ static_cast<Sender::message_size_t>(header.size()),
+                                             static_cast<Sender::message_size_t>(fragment.size()) };
+
+  the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+  auto response = the_receiver->receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "EVENT");
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), header + fragment);
+}
+
+BOOST_AUTO_TEST_CASE(ManySenders)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://InprocSender_test_ManySenders" },
+                                   { "capacity", 64 } };
+  auto the_receiver = make_ipm_receiver("InprocReceiver");
+  the_receiver->connect_for_receives(connection_info);
+
+  const int num_senders = 4;
+  const int num_messages = 10000;
+  std::vector<std::thread> sender_threads;
+  for (int sender = 0; sender < num_senders; ++sender) {
+    sender_threads.emplace_back([&, sender]() {
+      auto the_sender = make_ipm_sender("InprocSender");
+      the_sender->connect_for_sends(connection_info);
+      for (int i = 0; i < num_messages; ++i) {
+        int value = sender * num_messages + i;
+        the_sender->send(&value, sizeof(value), std::chrono::milliseconds(5000));
+      }
+    });
+  }
+
+  std::vector<int> next_from_sender(num_senders, 0);
+  for (int i = 0; i < num_senders * num_messages; ++i) {
+    auto response = the_receiver->receive(std::chrono::milliseconds(5000), sizeof(int));
+    int value = *reinterpret_cast<const int*>(response.m_data.data());
+    BOOST_REQUIRE_EQUAL(value % num_messages, next_from_sender[value / num_messages]++);
+  }
+
+  for (auto& sender_thread : sender_threads) {
+    sender_thread.join();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,86 @@
+/**
+ * @file LatencyHistogram_test.cxx LatencyHistogram class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/EndpointInfo.hpp"
+#include "ipm/LatencyHistogram.hpp"
+
+#define BOOST_TEST_MODULE LatencyHistogram_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(LatencyHistogram_test)
+
+BOOST_AUTO_TEST_CASE(Empty)
+{
+  LatencyHistogram histogram;
+  BOOST_REQUIRE_EQUAL(histogram.count(), 0);
+  BOOST_REQUIRE_EQUAL(histogram.max(), 0);
+  BOOST_REQUIRE_EQUAL(histogram.percentile(0.5), 0);
+}
+
+BOOST_AUTO_TEST_CASE(Percentiles)
+{
+  LatencyHistogram histogram;
+  // Small values are kept exactly
+  for (uint64_t value = 1; value <= 50; ++value) {
+    histogram.record(value);
+  }
+  BOOST_REQUIRE_EQUAL(histogram.count(), 50);
+  BOOST_REQUIRE_EQUAL(histogram.percentile(0.5), 25);
+  BOOST_REQUIRE_EQUAL(histogram.percentile(1.0), 50);
+
+  // Larger ones to within about 3%
+  LatencyHistogram wide;
+  for (uint64_t value = 1; value <= 100000; ++value) {
+    wide.record(value * 1000);
+  }
+  BOOST_REQUIRE_EQUAL(wide.max(), 100000000);
+  for (double fraction : { 0.5, 0.99, 0.999 }) {
+    double expected = fraction * 100000000;
+    BOOST_CHECK_CLOSE(static_cast<double>(wide.percentile(fraction)), expected, 3.2);
+  }
+  BOOST_REQUIRE_EQUAL(wide.percentile(1.0), wide.max());
+
+  // Values off the end of the range are not lost
+  wide.record(uint64_t(1) << 50);
+  BOOST_REQUIRE_EQUAL(wide.max(), uint64_t(1) << 50);
+  BOOST_REQUIRE_EQUAL(wide.count(), 100001);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentRecords)
+{
+  EndpointCounters counters;
+  BOOST_REQUIRE_EQUAL(counters.snapshot().m_latency_samples, 0);
+
+  constexpr int num_threads = 4;
+  constexpr uint64_t records_per_thread = 100000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&]() {
+      for (uint64_t value = 0; value < records_per_thread; ++value) {
+        counters.record_latency(value);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto info = counters.snapshot();
+  BOOST_REQUIRE_EQUAL(info.m_latency_samples, num_threads * records_per_thread);
+  BOOST_REQUIRE_EQUAL(info.m_latency_max_ns, records_per_thread - 1);
+  BOOST_CHECK_CLOSE(static_cast<double>(info.m_latency_p50_ns), records_per_thread / 2.0, 3.2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,7 +12,12 @@
 
 #include "boost/test/unit_test.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace dunedaq::ipm;
@@ -35,18 +40,33 @@ public:
   bool can_receive() const noexcept override { return m_can_receive; }
   void make_me_ready_to_receive() { m_can_receive = true; }
   void sabotage_my_receiving_ability() { m_can_receive = false; }
+  void make_my_receives_time_out() { m_times_out = true; }
+  void make_my_messages_empty() { m_empty = true; }
+  void make_my_receives_fail() { m_fails = true; }
+  int get_num_receives() const { return m_num_receives; }
 
 protected:
   Receiver::Response receive_(const duration_t& /* timeout */) override
   {
+    ++m_num_receives;
+    if (m_fails) {
+      throw std::runtime_error("receive failed");
+    }
+    if (m_times_out) {
+      throw ReceiveTimeoutExpired(ERS_HERE, 0);
+    }
     Receiver::Response output;
-    output.m_data = std::vector<char>(s_bytes_on_each_receive, 'A');
+    output.m_data = std::vector<char>(m_empty ? 0 : s_bytes_on_each_receive, 'A');
     output.m_metadata = "";
     return output;
   }
 
 private:
   bool m_can_receive;
+  bool m_times_out{ false };
+  bool m_empty{ false };
+  bool m_fails{ false };
+  std::atomic<int> m_num_receives{ 0 };
 };
 
 } // namespace ""
@@ -83,4 +103,255 @@ BOOST_AUTO_TEST_CASE(StatusChecks)
                           [&](dunedaq::ipm::KnownStateForbidsReceive) { return true; });
 }
 
+BOOST_AUTO_TEST_CASE(ReceiveView)
+{
+  ReceiverImpl the_receiver;
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive_view(Receiver::s_no_block),
+                          dunedaq::ipm::KnownStateForbidsReceive,
+                          [&](dunedaq::ipm::KnownStateForbidsReceive) { return true; });
+
+  the_receiver.make_me_ready_to_receive();
+
+  Receiver::ResponseView view;
+  BOOST_REQUIRE_NO_THROW(view = the_receiver.receive_view(Receiver::s_no_block, ReceiverImpl::s_bytes_on_each_receive));
+  BOOST_REQUIRE(view.m_handle != nullptr);
+  BOOST_REQUIRE(view.m_metadata.empty());
+  BOOST_REQUIRE_EQUAL(view.m_size, static_cast<size_t>(ReceiverImpl::s_bytes_on_each_receive));
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), std::string(ReceiverImpl::s_bytes_on_each_receive, 'A'));
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive_view(Receiver::s_no_block, ReceiverImpl::s_bytes_on_each_receive - 1),
+                          dunedaq::ipm::UnexpectedNumberOfBytes,
+                          [&](dunedaq::ipm::UnexpectedNumberOfBytes) { return true; });
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveMultipart)
+{
+  ReceiverImpl the_receiver;
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive_multipart(Receiver::s_no_block),
+                          dunedaq::ipm::KnownStateForbidsReceive,
+                          [&](dunedaq::ipm::KnownStateForbidsReceive) { return true; });
+
+  the_receiver.make_me_ready_to_receive();
+
+  auto multipart = the_receiver.receive_multipart(Receiver::s_no_block);
+  BOOST_REQUIRE(multipart.m_handle != nullptr);
+  BOOST_REQUIRE_EQUAL(multipart.m_parts.size(), 1);
+  BOOST_REQUIRE_EQUAL(std::string(multipart.m_parts[0].m_data, multipart.m_parts[0].m_size),
+                      std::string(ReceiverImpl::s_bytes_on_each_receive, 'A'));
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveBatch)
+{
+  ReceiverImpl the_receiver;
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive_batch(10, Receiver::s_no_block),
+                          dunedaq::ipm::KnownStateForbidsReceive,
+                          [&](dunedaq::ipm::KnownStateForbidsReceive) { return true; });
+
+  the_receiver.make_me_ready_to_receive();
+
+  BOOST_REQUIRE(the_receiver.receive_batch(0, Receiver::s_no_block).empty());
+
+  // ReceiverImpl always has a message ready, so batches are always full
+  auto batch = the_receiver.receive_batch(10, Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(batch.size(), 10);
+  for (auto const& response : batch) {
+    BOOST_REQUIRE_EQUAL(response.m_data.size(), static_cast<size_t>(ReceiverImpl::s_bytes_on_each_receive));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  ReceiverImpl the_receiver;
+  std::vector<char> buffer(ReceiverImpl::s_bytes_on_each_receive);
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block),
+                          dunedaq::ipm::KnownStateForbidsReceive,
+                          [&](dunedaq::ipm::KnownStateForbidsReceive) { return true; });
+
+  the_receiver.make_me_ready_to_receive();
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive_into(nullptr, buffer.size(), Receiver::s_no_block),
+                          dunedaq::ipm::NullPointerPassedToReceive,
+                          [&](dunedaq::ipm::NullPointerPassedToReceive) { return true; });
+
+  // A buffer that is too small leaves the message in place for the next call
+  auto result = the_receiver.receive_into(buffer.data(), buffer.size() - 1, Receiver::s_no_block);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(ReceiverImpl::s_bytes_on_each_receive));
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), std::string(buffer.size(), '\0'));
+
+  std::string metadata("stale");
+  result = the_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(ReceiverImpl::s_bytes_on_each_receive));
+  BOOST_REQUIRE(metadata.empty());
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), std::string(buffer.size(), 'A'));
+
+  // An empty message is not a timeout
+  the_receiver.make_my_messages_empty();
+  result = the_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(result.m_size, 0);
+  BOOST_REQUIRE(!result.m_timed_out);
+
+  the_receiver.make_my_receives_time_out();
+  result = the_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block);
+  BOOST_REQUIRE(result.m_timed_out);
+}
+
+BOOST_AUTO_TEST_CASE(PooledResponses)
+{
+  ReceiverImpl the_receiver;
+  the_receiver.make_me_ready_to_receive();
+
+  auto pool = make_response_pool();
+  the_receiver.set_response_pool(pool);
+  BOOST_REQUIRE_EQUAL(the_receiver.get_response_pool(), pool);
+
+  const char* first_storage = nullptr;
+  {
+    auto response = the_receiver.receive(Receiver::s_no_block, ReceiverImpl::s_bytes_on_each_receive);
+    BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()),
+                        std::string(ReceiverImpl::s_bytes_on_each_receive, 'A'));
+    first_storage = response.m_data.data();
+    BOOST_REQUIRE_EQUAL(pool->get_stats().m_misses, 1);
+    BOOST_REQUIRE_EQUAL(pool->get_stats().m_free_buffers, 0);
+  }
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_free_buffers, 1);
+
+  // The storage comes back round, including through moves and assignments
+  auto response = the_receiver.receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(response.m_data.data(), first_storage);
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_hits, 1);
+
+  auto moved = std::move(response);
+  moved = the_receiver.receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_free_buffers, 1);
+
+  // A copy doesn't take a buffer from the pool, nor give one back
+  {
+    auto copy = moved;
+    BOOST_REQUIRE(copy.m_data == moved.m_data);
+  }
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_free_buffers, 1);
+
+  // Still brace-initializable as when Response was an aggregate
+  Receiver::Response built{ "TOPIC", { 'A', 'B' } };
+  BOOST_REQUIRE_EQUAL(built.m_metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(built.m_data.size(), 2);
+
+  // As does try_receive, on which co_receive and dispatching are built
+  Receiver::Response tried;
+  BOOST_REQUIRE(the_receiver.try_receive(tried));
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_hits + pool->get_stats().m_misses, 4);
+
+  the_receiver.set_response_pool(nullptr);
+  auto unpooled = the_receiver.receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_hits + pool->get_stats().m_misses, 4);
+}
+
+BOOST_AUTO_TEST_CASE(GetInfo)
+{
+  ReceiverImpl the_receiver;
+  the_receiver.make_me_ready_to_receive();
+  BOOST_REQUIRE_EQUAL(the_receiver.get_info().m_messages, 0);
+
+  the_receiver.receive(Receiver::s_no_block);
+  the_receiver.receive_view(Receiver::s_no_block);
+  the_receiver.receive_multipart(Receiver::s_no_block);
+  the_receiver.receive_batch(3, Receiver::s_no_block);
+  std::vector<char> buffer(ReceiverImpl::s_bytes_on_each_receive);
+  the_receiver.receive_into(buffer.data(), 1, Receiver::s_no_block); // Too small, so not counted yet
+  the_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block);
+
+  auto info = the_receiver.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 7);
+  BOOST_REQUIRE_EQUAL(info.m_bytes, 7 * ReceiverImpl::s_bytes_on_each_receive);
+  BOOST_REQUIRE_EQUAL(info.m_largest_message, static_cast<uint64_t>(ReceiverImpl::s_bytes_on_each_receive));
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 0);
+
+  the_receiver.make_my_receives_time_out();
+  BOOST_REQUIRE_EXCEPTION(the_receiver.receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(the_receiver.receive_batch(3, Receiver::s_no_block).empty());
+  BOOST_REQUIRE(the_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block).m_timed_out);
+  info = the_receiver.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 7);
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 3);
+
+  // An empty message counts as a message, not a timeout
+  ReceiverImpl empty_receiver;
+  empty_receiver.make_me_ready_to_receive();
+  empty_receiver.make_my_messages_empty();
+  BOOST_REQUIRE(!empty_receiver.receive_into(buffer.data(), buffer.size(), Receiver::s_no_block).m_timed_out);
+  info = empty_receiver.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 1);
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(Dispatch)
+{
+  ReceiverImpl the_receiver;
+  std::atomic<int> num_handled{ 0 };
+  auto handler = [&](Receiver::Response& message) {
+    // Reported as DispatchFailed, after which dispatching carries on
+    if (++num_handled == 1) {
+      throw std::runtime_error("first message rejected");
+    }
+    if (message.m_data.size() != static_cast<size_t>(ReceiverImpl::s_bytes_on_each_receive)) {
+      num_handled = -1000000;
+    }
+  };
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver.start_dispatch(handler),
+                          dunedaq::ipm::KnownStateForbidsReceive,
+                          [&](dunedaq::ipm::KnownStateForbidsReceive) { return true; });
+
+  the_receiver.make_me_ready_to_receive();
+  the_receiver.start_dispatch(handler, 2);
+  BOOST_REQUIRE(the_receiver.is_dispatching());
+  BOOST_REQUIRE_EXCEPTION(the_receiver.start_dispatch(handler),
+                          dunedaq::ipm::DispatchAlreadyStarted,
+                          [&](dunedaq::ipm::DispatchAlreadyStarted) { return true; });
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (num_handled < 100 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  the_receiver.stop_dispatch();
+  BOOST_REQUIRE(!the_receiver.is_dispatching());
+
+  // Every handler has returned, and no more are called
+  int handled = num_handled;
+  BOOST_REQUIRE_GE(handled, 100);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  BOOST_REQUIRE_EQUAL(num_handled, handled);
+
+  auto info = the_receiver.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, handled);
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 0);
+
+  // A receiver which keeps failing is retried less and less often, and the
+  // wait before the next try doesn't hold up a stop
+  ReceiverImpl failing_receiver;
+  failing_receiver.make_me_ready_to_receive();
+  failing_receiver.make_my_receives_fail();
+  failing_receiver.start_dispatch(handler);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  auto start_time = std::chrono::steady_clock::now();
+  failing_receiver.stop_dispatch();
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time < std::chrono::milliseconds(100));
+  BOOST_REQUIRE_LE(failing_receiver.get_num_receives(), 10);
+
+  // Made other than by make_ipm_receiver, Receiver::destroy stops dispatching first
+  std::shared_ptr<ReceiverImpl> destroyed_receiver(new ReceiverImpl(), &Receiver::destroy);
+  destroyed_receiver->make_me_ready_to_receive();
+  destroyed_receiver->start_dispatch([](Receiver::Response&) {});
+  destroyed_receiver.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
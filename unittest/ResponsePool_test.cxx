@@ -0,0 +1,108 @@
+/**
+ * @file ResponsePool_test.cxx ResponsePool class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/ResponsePool.hpp"
+
+#define BOOST_TEST_MODULE ResponsePool_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(ResponsePool_test)
+
+BOOST_AUTO_TEST_CASE(CopyAndMoveSemantics)
+{
+  BOOST_REQUIRE(!std::is_copy_constructible_v<ResponsePool>);
+  BOOST_REQUIRE(!std::is_copy_assignable_v<ResponsePool>);
+  BOOST_REQUIRE(!std::is_move_constructible_v<ResponsePool>);
+  BOOST_REQUIRE(!std::is_move_assignable_v<ResponsePool>);
+}
+
+BOOST_AUTO_TEST_CASE(SizeClasses)
+{
+  auto pool = make_response_pool(4096);
+
+  auto small = pool->acquire(1);
+  BOOST_REQUIRE(small.empty());
+  BOOST_REQUIRE_EQUAL(small.capacity(), ResponsePool::s_min_class_size);
+
+  auto medium = pool->acquire(1000);
+  BOOST_REQUIRE_EQUAL(medium.capacity(), 1024);
+
+  // Larger than max_buffer_size: allocated to size, and not kept on release
+  auto large = pool->acquire(5000);
+  BOOST_REQUIRE_EQUAL(large.capacity(), 5000);
+
+  auto stats = pool->get_stats();
+  BOOST_REQUIRE_EQUAL(stats.m_hits, 0);
+  BOOST_REQUIRE_EQUAL(stats.m_misses, 3);
+
+  pool->release(std::move(small));
+  pool->release(std::move(medium));
+  pool->release(std::move(large));
+
+  stats = pool->get_stats();
+  BOOST_REQUIRE_EQUAL(stats.m_free_buffers, 2);
+  BOOST_REQUIRE_EQUAL(stats.m_free_bytes, ResponsePool::s_min_class_size + 1024);
+  BOOST_REQUIRE_EQUAL(stats.m_dropped, 1);
+
+  // A 1024-byte buffer also serves requests which round up to 1024, but not 1025
+  auto reused = pool->acquire(600);
+  BOOST_REQUIRE_EQUAL(reused.capacity(), 1024);
+  auto fresh = pool->acquire(1025);
+  BOOST_REQUIRE_EQUAL(fresh.capacity(), 2048);
+
+  stats = pool->get_stats();
+  BOOST_REQUIRE_EQUAL(stats.m_hits, 1);
+  BOOST_REQUIRE_EQUAL(stats.m_misses, 4);
+  BOOST_REQUIRE_EQUAL(stats.m_free_buffers, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Prefill)
+{
+  auto pool = make_response_pool(1024 * 1024, 4);
+  pool->prefill(100000, 6); // Only 4 fit in the class, the rest are dropped
+
+  auto stats = pool->get_stats();
+  BOOST_REQUIRE_EQUAL(stats.m_free_buffers, 4);
+  BOOST_REQUIRE_EQUAL(stats.m_free_bytes, 4 * 131072);
+  BOOST_REQUIRE_EQUAL(stats.m_dropped, 2);
+
+  for (int i = 0; i < 4; ++i) {
+    auto buffer = pool->acquire(100000);
+    BOOST_REQUIRE(buffer.capacity() >= 100000);
+  }
+  stats = pool->get_stats();
+  BOOST_REQUIRE_EQUAL(stats.m_hits, 4);
+  BOOST_REQUIRE_EQUAL(stats.m_misses, 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReleaseFromOtherThread)
+{
+  auto pool = make_response_pool(4096, 100);
+  std::vector<std::vector<char>> buffers;
+  for (int i = 0; i < 100; ++i) {
+    buffers.push_back(pool->acquire(4096));
+  }
+
+  std::thread releaser([&]() {
+    for (auto& buffer : buffers) {
+      pool->release(std::move(buffer));
+    }
+  });
+  releaser.join();
+
+  BOOST_REQUIRE_EQUAL(pool->get_stats().m_free_buffers, 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
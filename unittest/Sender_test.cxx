@@ -12,7 +12,12 @@
 
 #include "boost/test/unit_test.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace dunedaq::ipm;
@@ -33,20 +38,47 @@ public:
   bool can_send() const noexcept override { return m_can_send; }
   void make_me_ready_to_send() { m_can_send = true; }
   void sabotage_my_sending_ability() { m_can_send = false; }
+  void make_my_sends_time_out() { m_times_out = true; }
+  void stall_my_sends(bool stalled) { m_stalled = stalled; }
+  bool is_stalled() const { return m_is_stalled; }
+
+  int get_num_sends() const { return m_num_sends; }
+  const std::vector<char>& get_first_bytes() const { return m_first_bytes; }
 
 protected:
-  void send_(const void* /* message */,
+  void send_(const void* message,
              int /* N */,
              const duration_t& /* timeout */,
              const std::string& /* metadata */) override
   {
     // Pretty unexciting stub
+    while (m_stalled) {
+      m_is_stalled = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    m_is_stalled = false;
+    if (m_times_out) {
+      throw SendTimeoutExpired(ERS_HERE, 0);
+    }
+    m_first_bytes.push_back(*static_cast<const char*>(message));
+    ++m_num_sends;
   }
 
 private:
   bool m_can_send;
+  bool m_times_out{ false };
+  std::atomic<bool> m_stalled{ false };
+  std::atomic<bool> m_is_stalled{ false };
+  int m_num_sends{ 0 };
+  std::vector<char> m_first_bytes;
 };
 
+void
+count_releases(void* /* message */, void* hint)
+{
+  ++*static_cast<int*>(hint);
+}
+
 } // namespace ""
 
 BOOST_AUTO_TEST_CASE(CopyAndMoveSemantics)
@@ -88,4 +120,211 @@ BOOST_AUTO_TEST_CASE(BadInput)
                           [&](dunedaq::ipm::NullPointerPassedToSend) { return true; });
 }
 
+BOOST_AUTO_TEST_CASE(ZeroCopy)
+{
+  SenderImpl the_sender;
+  std::vector<char> random_data{ 'T', 'E', 'S', 'T' };
+  int num_releases = 0;
+
+  // Ownership passes to the Sender even when the send is refused
+  BOOST_REQUIRE_EXCEPTION(the_sender.send_zero_copy(
+                            random_data.data(), random_data.size(), &count_releases, &num_releases, Sender::s_no_block),
+                          dunedaq::ipm::KnownStateForbidsSend,
+                          [&](dunedaq::ipm::KnownStateForbidsSend) { return true; });
+  BOOST_REQUIRE_EQUAL(num_releases, 1);
+
+  the_sender.make_me_ready_to_send();
+  BOOST_REQUIRE_NO_THROW(the_sender.send_zero_copy(
+    random_data.data(), random_data.size(), &count_releases, &num_releases, Sender::s_no_block));
+  BOOST_REQUIRE_EQUAL(num_releases, 2);
+  BOOST_REQUIRE_EQUAL(the_sender.get_num_sends(), 1);
+
+  BOOST_REQUIRE_NO_THROW(the_sender.send_zero_copy(random_data.data(), 0, &count_releases, &num_releases, Sender::s_no_block));
+  BOOST_REQUIRE_EQUAL(num_releases, 3);
+  BOOST_REQUIRE_EQUAL(the_sender.get_num_sends(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(PooledBuffers)
+{
+  SenderImpl the_sender;
+  the_sender.make_me_ready_to_send();
+  auto pool = make_buffer_pool(8, 1);
+
+  auto buffer = pool->acquire();
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 0);
+  BOOST_REQUIRE_NO_THROW(the_sender.send(std::move(buffer), 8, Sender::s_no_block));
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 1);
+
+  buffer = pool->acquire();
+  BOOST_REQUIRE_EXCEPTION(the_sender.send(std::move(buffer), 9, Sender::s_no_block),
+                          dunedaq::ipm::MessageLargerThanBuffer,
+                          [&](dunedaq::ipm::MessageLargerThanBuffer) { return true; });
+}
+
+BOOST_AUTO_TEST_CASE(SendBatch)
+{
+  SenderImpl the_sender;
+  std::vector<char> random_data{ 'T', 'E', 'S', 'T' };
+  std::vector<Sender::BatchEntry> entries(5, Sender::BatchEntry{ random_data.data(), 4, "TOPIC" });
+  entries[2].m_size = 0;
+
+  BOOST_REQUIRE_EXCEPTION(the_sender.send_batch(entries.data(), entries.size(), Sender::s_no_block),
+                          dunedaq::ipm::KnownStateForbidsSend,
+                          [&](dunedaq::ipm::KnownStateForbidsSend) { return true; });
+
+  the_sender.make_me_ready_to_send();
+  BOOST_REQUIRE_EQUAL(the_sender.send_batch(entries.data(), entries.size(), Sender::s_no_block), entries.size());
+  BOOST_REQUIRE_EQUAL(the_sender.get_num_sends(), 4);
+
+  // Validation happens before anything is sent
+  entries[4].m_message = nullptr;
+  BOOST_REQUIRE_EXCEPTION(the_sender.send_batch(entries.data(), entries.size(), Sender::s_no_block),
+                          dunedaq::ipm::NullPointerPassedToSend,
+                          [&](dunedaq::ipm::NullPointerPassedToSend) { return true; });
+  BOOST_REQUIRE_EQUAL(the_sender.get_num_sends(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(GetInfo)
+{
+  SenderImpl the_sender;
+  the_sender.make_me_ready_to_send();
+  auto info = the_sender.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 0);
+  BOOST_REQUIRE_EQUAL(info.m_bytes, 0);
+
+  std::vector<char> random_data(100, 'T');
+  the_sender.send(random_data.data(), 10, Sender::s_no_block);
+  the_sender.send(random_data.data(), 0, Sender::s_no_block); // A no-op, so not counted
+  const void* parts[] = { random_data.data(), random_data.data() };
+  the_sender.send_multipart(parts, { 20, 30 }, Sender::s_no_block);
+  std::vector<Sender::BatchEntry> entries(3, Sender::BatchEntry{ random_data.data(), 5, "" });
+  the_sender.send_batch(entries.data(), entries.size(), Sender::s_no_block);
+
+  info = the_sender.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 5);
+  BOOST_REQUIRE_EQUAL(info.m_bytes, 10 + 50 + 15);
+  BOOST_REQUIRE_EQUAL(info.m_largest_message, 50);
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 0);
+  BOOST_REQUIRE_EQUAL(info.m_queue_depth, 0);
+
+  // A batch which runs out of time counts once, and only its accepted entries are counted as messages
+  the_sender.make_my_sends_time_out();
+  BOOST_REQUIRE_EXCEPTION(the_sender.send(random_data.data(), 10, Sender::s_no_block),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE_EQUAL(the_sender.send_batch(entries.data(), entries.size(), Sender::s_no_block), 0);
+  info = the_sender.get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, 5);
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 2);
+}
+
+BOOST_AUTO_TEST_CASE(AsyncSend)
+{
+  // Made as the plugin factory makes them, so that destruction waits for the IO thread
+  std::shared_ptr<SenderImpl> the_sender(new SenderImpl(), &Sender::destroy);
+  std::vector<char> random_data{ 'T', 'E', 'S', 'T' };
+  BOOST_REQUIRE_EXCEPTION(the_sender->send_async(random_data.data(), 4, Sender::s_block),
+                          dunedaq::ipm::KnownStateForbidsSend,
+                          [&](dunedaq::ipm::KnownStateForbidsSend) { return true; });
+  the_sender->make_me_ready_to_send();
+
+  // Sends happen in order, synchronous ones after any asynchronous ones before them
+  std::atomic<int> num_completed{ 0 };
+  for (char c = 'a'; c <= 'z'; ++c) {
+    the_sender->send_async(&c, 1, Sender::s_block, "", [&](std::exception_ptr error) {
+      BOOST_CHECK(!error);
+      ++num_completed;
+    });
+  }
+  auto future = the_sender->send_async(random_data.data(), 4, Sender::s_block);
+  the_sender->send(random_data.data() + 1, 1, Sender::s_block);
+  BOOST_REQUIRE_EQUAL(num_completed.load(), 26);
+  BOOST_REQUIRE_NO_THROW(future.get());
+  BOOST_REQUIRE_EQUAL(std::string(the_sender->get_first_bytes().begin(), the_sender->get_first_bytes().end()),
+                      "abcdefghijklmnopqrstuvwxyzTE");
+  BOOST_REQUIRE_EQUAL(the_sender->in_flight(), 0);
+  BOOST_REQUIRE_EQUAL(the_sender->get_info().m_messages, 28);
+
+  auto pool = make_buffer_pool(8, 1);
+  BOOST_REQUIRE_NO_THROW(the_sender->send_async(pool->acquire(), 8, Sender::s_block).get());
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 1);
+  BOOST_REQUIRE_NO_THROW(the_sender->send_async(random_data.data(), 0, Sender::s_block).get());
+
+  // Timeouts come back through the future
+  the_sender->make_my_sends_time_out();
+  future = the_sender->send_async(random_data.data(), 4, Sender::s_no_block);
+  BOOST_REQUIRE_EXCEPTION(future.get(),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE_EQUAL(the_sender->get_info().m_timeouts, 1);
+}
+
+BOOST_AUTO_TEST_CASE(AsyncQueueFull)
+{
+  std::shared_ptr<SenderImpl> the_sender(new SenderImpl(), &Sender::destroy);
+  the_sender->make_me_ready_to_send();
+  the_sender->set_async_queue_depth(2);
+  the_sender->stall_my_sends(true);
+
+  // One under way and two queued fill it (the third waits until the first
+  // is taken off the queue), so the next can't get in
+  std::vector<char> random_data{ 'T', 'E', 'S', 'T' };
+  std::vector<std::future<void>> futures;
+  for (int i = 0; i < 3; ++i) {
+    futures.push_back(the_sender->send_async(random_data.data(), 4, Sender::s_block));
+  }
+  BOOST_REQUIRE_EQUAL(the_sender->in_flight(), 3);
+  auto late = the_sender->send_async(random_data.data(), 4, std::chrono::milliseconds(10));
+  BOOST_REQUIRE(late.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+  BOOST_REQUIRE_EXCEPTION(late.get(),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+
+  // Synchronous sends wait for the queue to empty only as long as their own timeout
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(random_data.data(), 4, std::chrono::milliseconds(10)),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time < std::chrono::seconds(1));
+  Sender::BatchEntry entry{ random_data.data(), 4, "" };
+  BOOST_REQUIRE_EQUAL(the_sender->send_batch(&entry, 1, std::chrono::milliseconds(10)), 0);
+  BOOST_REQUIRE(!the_sender->try_send(random_data.data(), 4));
+  BOOST_REQUIRE_EQUAL(the_sender->get_info().m_timeouts, 3);
+
+  // Room is made as the IO thread catches up
+  std::thread unstaller([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    the_sender->stall_my_sends(false);
+  });
+  BOOST_REQUIRE_NO_THROW(the_sender->send_async(random_data.data(), 4, Sender::s_block).get());
+  unstaller.join();
+  for (auto& future : futures) {
+    BOOST_REQUIRE_NO_THROW(future.get());
+  }
+  BOOST_REQUIRE_EQUAL(the_sender->get_num_sends(), 4);
+
+  // Destroying the Sender finishes the send under way and abandons the rest
+  the_sender->stall_my_sends(true);
+  futures.clear();
+  for (int i = 0; i < 3; ++i) {
+    futures.push_back(the_sender->send_async(random_data.data(), 4, Sender::s_block));
+  }
+  // The IO thread takes the first off the queue before it starts sending it
+  while (!the_sender->is_stalled()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  // Outlives the reset, as the deleter waits for the send under way
+  auto raw_sender = the_sender.get();
+  std::thread destroyer([raw_sender] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    raw_sender->stall_my_sends(false);
+  });
+  the_sender.reset();
+  destroyer.join();
+  BOOST_REQUIRE_NO_THROW(futures[0].get());
+  BOOST_REQUIRE_EXCEPTION(futures[2].get(),
+                          dunedaq::ipm::AsyncSendAbandoned,
+                          [&](dunedaq::ipm::AsyncSendAbandoned) { return true; });
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,204 @@
+/**
+ * @file ShmReceiver_test.cxx ShmReceiver class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE ShmReceiver_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(ShmReceiver_test)
+
+namespace {
+
+// Unlinks a file left by the test, however the test ends
+struct RemoveOnExit
+{
+  explicit RemoveOnExit(std::string path)
+    : m_path(std::move(path))
+  {}
+  ~RemoveOnExit() { unlink(m_path.c_str()); }
+  std::string m_path;
+};
+
+nlohmann::json
+connection_info_for(const std::string& test_name)
+{
+  return { { "connection_string", "shm://ipm_ShmReceiver_test_" + test_name + "_" + std::to_string(getpid()) } };
+}
+
+// Messages per second through a sender/receiver pair, with the sender on its own thread
+double
+measure_throughput(std::shared_ptr<Sender> sender, std::shared_ptr<Receiver> receiver, size_t message_size)
+{
+  const int num_messages = 50000;
+  std::vector<char> message(message_size, 'M');
+
+  auto start_time = std::chrono::steady_clock::now();
+  std::thread sender_thread([&]() {
+    for (int i = 0; i < num_messages; ++i) {
+      sender->send(message.data(), message.size(), std::chrono::milliseconds(10000));
+    }
+  });
+  for (int i = 0; i < num_messages; ++i) {
+    receiver->receive(std::chrono::milliseconds(10000), message.size());
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time);
+  sender_thread.join();
+
+  return num_messages / elapsed.count();
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  BOOST_REQUIRE(the_receiver != nullptr);
+  BOOST_REQUIRE(!the_receiver->can_receive());
+
+  the_receiver->connect_for_receives(connection_info_for("BasicTests"));
+  BOOST_REQUIRE(the_receiver->can_receive());
+}
+
+BOOST_AUTO_TEST_CASE(SendReceive)
+{
+  auto connection_info = connection_info_for("SendReceive");
+  auto the_sender = make_ipm_sender("ShmSender");
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_receiver->connect_for_receives(connection_info);
+  the_sender->connect_for_sends(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block);
+
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000), test_data.size());
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "TOPIC");
+  BOOST_REQUIRE(response.m_data == test_data);
+
+  auto view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE(view.m_metadata.empty());
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), "TEST");
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveTimeout)
+{
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_receiver->connect_for_receives(connection_info_for("ReceiveTimeout"));
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(50)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  auto connection_info = connection_info_for("ReceiveInto");
+  auto the_sender = make_ipm_sender("ShmSender");
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_receiver->connect_for_receives(connection_info);
+  the_sender->connect_for_sends(connection_info);
+
+  std::string test_data("TESTDATA");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+
+  std::vector<char> buffer(4);
+  std::string metadata;
+  auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+
+  buffer.resize(result.m_size);
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(result.m_timed_out);
+}
+
+BOOST_AUTO_TEST_CASE(CrossProcess)
+{
+  auto connection_info = connection_info_for("CrossProcess");
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_receiver->connect_for_receives(connection_info);
+
+  const int num_messages = 1000;
+  pid_t child = fork();
+  BOOST_REQUIRE(child >= 0);
+  if (child == 0) {
+    // The child must never return into the test runner, whatever goes wrong
+    int exit_code = 1;
+    try {
+      auto the_sender = make_ipm_sender("ShmSender");
+      the_sender->connect_for_sends(connection_info);
+      for (int i = 0; i < num_messages; ++i) {
+        the_sender->send(&i, sizeof(i), std::chrono::milliseconds(5000), std::to_string(i));
+      }
+      exit_code = 0;
+    } catch (...) {
+    }
+    _exit(exit_code);
+  }
+
+  for (int i = 0; i < num_messages; ++i) {
+    auto response = the_receiver->receive(std::chrono::milliseconds(5000), sizeof(int));
+    BOOST_REQUIRE_EQUAL(response.m_metadata, std::to_string(i));
+    BOOST_REQUIRE_EQUAL(*reinterpret_cast<const int*>(response.m_data.data()), i);
+  }
+
+  int status = 0;
+  waitpid(child, &status, 0);
+  BOOST_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ThroughputComparedToZmq)
+{
+  auto shm_connection_info = connection_info_for("Throughput");
+  auto shm_sender = make_ipm_sender("ShmSender");
+  auto shm_receiver = make_ipm_receiver("ShmReceiver");
+  shm_receiver->connect_for_receives(shm_connection_info);
+  shm_sender->connect_for_sends(shm_connection_info);
+
+  const std::string zmq_path = "/tmp/ipm_ShmReceiver_test_Throughput_" + std::to_string(getpid());
+  RemoveOnExit remove_zmq_socket(zmq_path);
+  nlohmann::json zmq_connection_info{ { "connection_string", "ipc://" + zmq_path } };
+  auto zmq_sender = make_ipm_sender("ZmqSender");
+  auto zmq_receiver = make_ipm_receiver("ZmqReceiver");
+  zmq_sender->connect_for_sends(zmq_connection_info);
+  zmq_receiver->connect_for_receives(zmq_connection_info);
+
+  for (size_t message_size : { 64, 4096, 65536 }) {
+    auto shm_rate = measure_throughput(shm_sender, shm_receiver, message_size);
+    auto zmq_rate = measure_throughput(zmq_sender, zmq_receiver, message_size);
+    // Reported rather than checked, as the rates depend on the machine
+    BOOST_TEST_MESSAGE(message_size << "-byte messages: " << shm_rate << " msg/s through shm://, " << zmq_rate
+                                    << " msg/s through ZeroMQ ipc://");
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
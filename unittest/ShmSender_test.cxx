@@ -0,0 +1,151 @@
+/**
+ * @file ShmSender_test.cxx ShmSender class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE ShmSender_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(ShmSender_test)
+
+namespace {
+
+nlohmann::json
+connection_info_for(const std::string& test_name, size_t capacity = 4096)
+{
+  return { { "connection_string", "shm://ipm_ShmSender_test_" + test_name + "_" + std::to_string(getpid()) },
+           { "capacity", capacity } };
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_sender = make_ipm_sender("ShmSender");
+  BOOST_REQUIRE(the_sender != nullptr);
+  BOOST_REQUIRE(!the_sender->can_send());
+
+  // The shared memory issues are declared inside the plugin, so only their base class is visible here
+  BOOST_REQUIRE_THROW(the_sender->connect_for_sends({ { "connection_string", "tcp://127.0.0.1:12345" } }),
+                      ers::Issue);
+  BOOST_REQUIRE(!the_sender->can_send());
+}
+
+BOOST_AUTO_TEST_CASE(SendTimeout)
+{
+  // The sender may come up before the receiver; the ring holds what it can
+  auto connection_info = connection_info_for("SendTimeout");
+  auto the_sender = make_ipm_sender("ShmSender");
+  the_sender->connect_for_sends(connection_info);
+  BOOST_REQUIRE(the_sender->can_send());
+
+  std::vector<char> test_data(1000, 'T');
+  for (int i = 0; i < 4; ++i) {
+    the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block, "FILL");
+  }
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(50), "LOST"),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+
+  std::vector<char> too_big(4096, 'X');
+  BOOST_REQUIRE_THROW(the_sender->send(too_big.data(), too_big.size(), Sender::s_no_block), ers::Issue);
+
+  // A blocked sender carries on as soon as the receiver frees up space
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_receiver->connect_for_receives(connection_info);
+  std::thread receiver_thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    // Two, as the record has to wrap around to the start of the ring
+    the_receiver->receive(std::chrono::milliseconds(1000));
+    the_receiver->receive(std::chrono::milliseconds(1000));
+  });
+  the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000), "DELIVERED");
+  receiver_thread.join();
+
+  for (int i = 0; i < 2; ++i) {
+    BOOST_REQUIRE_EQUAL(the_receiver->receive(Receiver::s_no_block).m_metadata, "FILL");
+  }
+  auto response = the_receiver->receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "DELIVERED");
+  BOOST_REQUIRE(response.m_data == test_data);
+}
+
+BOOST_AUTO_TEST_CASE(Multipart)
+{
+  auto connection_info = connection_info_for("Multipart");
+  auto the_sender = make_ipm_sender("ShmSender");
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string header = "HEADER";
+  std::string fragment = "FRAGMENT";
+  const void* parts[] = { header.data(), fragment.data() };
+  std::vector<Sender::message_size_t> sizes{ static_cast<Sender::message_size_t>(header.size()),
+                                             static_cast<Sender::message_size_t>(fragment.size()) };
+
+  // The ring has no notion of parts, so they arrive concatenated
+  the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "EVENT");
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), header + fragment);
+}
+
+BOOST_AUTO_TEST_CASE(ManySenders)
+{
+  auto connection_info = connection_info_for("ManySenders", 16384);
+  auto the_receiver = make_ipm_receiver("ShmReceiver");
+  the_receiver->connect_for_receives(connection_info);
+
+  const int num_senders = 4;
+  const int num_messages = 10000;
+  std::vector<std::thread> sender_threads;
+  for (int sender = 0; sender < num_senders; ++sender) {
+    sender_threads.emplace_back([&, sender]() {
+      auto the_sender = make_ipm_sender("ShmSender");
+      the_sender->connect_for_sends(connection_info);
+      for (int i = 0; i < num_messages; ++i) {
+        // Varying sizes so that records wrap around the end of the ring at different offsets
+        std::vector<int> message(1 + i % 37, sender * num_messages + i);
+        the_sender->send(message.data(), message.size() * sizeof(int), std::chrono::milliseconds(5000));
+      }
+    });
+  }
+
+  std::vector<int> next_from_sender(num_senders, 0);
+  for (int i = 0; i < num_senders * num_messages; ++i) {
+    auto response = the_receiver->receive(std::chrono::milliseconds(5000));
+    auto* values = reinterpret_cast<const int*>(response.m_data.data());
+    int sender = values[0] / num_messages;
+    int index = values[0] % num_messages;
+
+    // Each sender's messages arrive whole and in order
+    BOOST_REQUIRE_EQUAL(index, next_from_sender[sender]++);
+    BOOST_REQUIRE_EQUAL(response.m_data.size(), (1 + index % 37) * sizeof(int));
+    BOOST_REQUIRE_EQUAL(values[response.m_data.size() / sizeof(int) - 1], values[0]);
+  }
+
+  for (auto& sender_thread : sender_threads) {
+    sender_thread.join();
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,218 @@
+/**
+ * @file TcpReceiver_test.cxx TcpReceiver class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE TcpReceiver_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(TcpReceiver_test)
+
+namespace {
+
+// A loopback port per test case, varied by process so that concurrent runs don't collide
+nlohmann::json
+connection_info_for(int test_number)
+{
+  int port = 40000 + (getpid() % 2000) * 10 + test_number;
+  return { { "connection_string", "tcp://127.0.0.1:" + std::to_string(port) } };
+}
+
+// Messages per second through a sender/receiver pair, with the sender on its own thread
+double
+measure_throughput(std::shared_ptr<Sender> sender, std::shared_ptr<Receiver> receiver, size_t message_size)
+{
+  const int num_messages = 50000;
+  std::vector<char> message(message_size, 'M');
+
+  auto start_time = std::chrono::steady_clock::now();
+  std::thread sender_thread([&]() {
+    for (int i = 0; i < num_messages; ++i) {
+      sender->send(message.data(), message.size(), std::chrono::milliseconds(10000));
+    }
+  });
+  for (int i = 0; i < num_messages; ++i) {
+    receiver->receive(std::chrono::milliseconds(10000), message.size());
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time);
+  sender_thread.join();
+
+  return num_messages / elapsed.count();
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  BOOST_REQUIRE(the_receiver != nullptr);
+  BOOST_REQUIRE(!the_receiver->can_receive());
+
+  the_receiver->connect_for_receives(connection_info_for(0));
+  BOOST_REQUIRE(the_receiver->can_receive());
+}
+
+BOOST_AUTO_TEST_CASE(SendReceive)
+{
+  auto connection_info = connection_info_for(1);
+  auto the_sender = make_ipm_sender("TcpSender");
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block);
+
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000), test_data.size());
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "TOPIC");
+  BOOST_REQUIRE(response.m_data == test_data);
+
+  auto view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE(view.m_metadata.empty());
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), "TEST");
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveTimeout)
+{
+  // Nothing is listening yet, so the receiver keeps trying to connect until the timeout
+  auto connection_info = connection_info_for(2);
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  the_receiver->connect_for_receives(connection_info);
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(50)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+
+  // A sender which starts later is picked up by the next receive
+  std::thread sender_thread([&]() {
+    auto the_sender = make_ipm_sender("TcpSender");
+    the_sender->connect_for_sends(connection_info);
+    std::string test_data("LATE");
+    the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000));
+  });
+  auto response = the_receiver->receive(std::chrono::milliseconds(5000));
+  sender_thread.join();
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), "LATE");
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  auto connection_info = connection_info_for(3);
+  auto the_sender = make_ipm_sender("TcpSender");
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string test_data("TESTDATA");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+
+  std::vector<char> buffer(4);
+  std::string metadata;
+  auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+
+  buffer.resize(result.m_size);
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(result.m_timed_out);
+
+  // A message kept for not fitting comes first from any kind of receive, and
+  // the ones behind it are intact
+  std::string long_data("TESTDATA_TOO_LONG");
+  the_sender->send(long_data.data(), long_data.size(), Sender::s_block, "LONG");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "NEXT");
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  auto kept = the_receiver->receive(Receiver::s_no_block);
+  BOOST_REQUIRE_EQUAL(kept.m_metadata, "LONG");
+  BOOST_REQUIRE_EQUAL(std::string(kept.m_data.begin(), kept.m_data.end()), long_data);
+  auto next = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(next.m_metadata, "NEXT");
+  BOOST_REQUIRE_EQUAL(std::string(next.m_data.begin(), next.m_data.end()), test_data);
+}
+
+BOOST_AUTO_TEST_CASE(LargeMessages)
+{
+  auto connection_info = connection_info_for(4);
+  auto the_sender = make_ipm_sender("TcpSender");
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  const int num_messages = 4;
+  std::vector<char> test_data(16 << 20);
+  for (size_t i = 0; i < test_data.size(); ++i) {
+    test_data[i] = static_cast<char>(i % 251);
+  }
+  std::thread sender_thread([&]() {
+    for (int i = 0; i < num_messages; ++i) {
+      the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(10000), std::to_string(i));
+    }
+  });
+
+  std::vector<char> buffer(test_data.size());
+  for (int i = 0; i < num_messages; ++i) {
+    std::string metadata;
+    auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(10000), &metadata);
+    BOOST_REQUIRE_EQUAL(metadata, std::to_string(i));
+    BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+    BOOST_REQUIRE(buffer == test_data);
+  }
+  sender_thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(ThroughputComparedToZmq)
+{
+  auto tcp_connection_info = connection_info_for(5);
+  auto tcp_sender = make_ipm_sender("TcpSender");
+  auto tcp_receiver = make_ipm_receiver("TcpReceiver");
+  tcp_sender->connect_for_sends(tcp_connection_info);
+  tcp_receiver->connect_for_receives(tcp_connection_info);
+
+  auto zmq_connection_info = connection_info_for(6);
+  auto zmq_sender = make_ipm_sender("ZmqSender");
+  auto zmq_receiver = make_ipm_receiver("ZmqReceiver");
+  zmq_sender->connect_for_sends(zmq_connection_info);
+  zmq_receiver->connect_for_receives(zmq_connection_info);
+
+  for (size_t message_size : { 64, 4096, 65536 }) {
+    auto tcp_rate = measure_throughput(tcp_sender, tcp_receiver, message_size);
+    auto zmq_rate = measure_throughput(zmq_sender, zmq_receiver, message_size);
+    BOOST_TEST_MESSAGE(message_size << "-byte messages: " << tcp_rate << " msg/s through TcpSender/TcpReceiver, "
+                                    << zmq_rate << " msg/s through ZeroMQ tcp://");
+    // ZeroMQ batches small messages into one write, so only larger ones are compared
+    if (message_size >= 4096) {
+      BOOST_CHECK_GT(tcp_rate, zmq_rate);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+/**
+ * @file TcpSender_test.cxx TcpSender class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE TcpSender_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <unistd.h>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(TcpSender_test)
+
+namespace {
+
+// A loopback port per test case, varied by process so that concurrent runs don't collide
+nlohmann::json
+connection_info_for(int test_number)
+{
+  int port = 20000 + (getpid() % 2000) * 10 + test_number;
+  return { { "connection_string", "tcp://127.0.0.1:" + std::to_string(port) } };
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_sender = make_ipm_sender("TcpSender");
+  BOOST_REQUIRE(the_sender != nullptr);
+  BOOST_REQUIRE(!the_sender->can_send());
+
+  the_sender->connect_for_sends(connection_info_for(0));
+  BOOST_REQUIRE(the_sender->can_send());
+}
+
+BOOST_AUTO_TEST_CASE(SendTimeout)
+{
+  auto connection_info = connection_info_for(1);
+  auto the_sender = make_ipm_sender("TcpSender");
+  the_sender->connect_for_sends(connection_info);
+
+  // With no receiver connected, the send waits for one until the timeout
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(50)),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+
+  // A blocked sender carries on as soon as a receiver connects
+  std::thread receiver_thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto the_receiver = make_ipm_receiver("TcpReceiver");
+    the_receiver->connect_for_receives(connection_info);
+    BOOST_CHECK_EQUAL(the_receiver->receive(std::chrono::milliseconds(1000)).m_metadata, "LATE");
+  });
+  the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000), "LATE");
+  receiver_thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(Multipart)
+{
+  auto connection_info = connection_info_for(2);
+  auto the_sender = make_ipm_sender("TcpSender");
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string header = "HEADER";
+  std::string fragment = "FRAGMENT";
+  const void* parts[] = { header.data(), fragment.data() };
+  std::vector<Sender::message_size_t> sizes{ static_cast<Sender::message_size_t>(header.size()),
+                                             static_cast<Sender::message_size_t>(fragment.size()) };
+
+  the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "EVENT");
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), header + fragment);
+}
+
+BOOST_AUTO_TEST_CASE(ReceiverReconnects)
+{
+  auto connection_info = connection_info_for(3);
+  auto the_sender = make_ipm_sender("TcpSender");
+  the_sender->connect_for_sends(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  {
+    auto first_receiver = make_ipm_receiver("TcpReceiver");
+    first_receiver->connect_for_receives(connection_info);
+    the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(1000), "FIRST");
+    BOOST_REQUIRE_EQUAL(first_receiver->receive(std::chrono::milliseconds(1000)).m_metadata, "FIRST");
+  }
+
+  // Once the first receiver has gone, the sender serves the next one to connect
+  auto second_receiver = make_ipm_receiver("TcpReceiver");
+  second_receiver->connect_for_receives(connection_info);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  for (int i = 0; i < 10; ++i) {
+    the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(1000), std::to_string(i));
+  }
+  for (int i = 0; i < 10; ++i) {
+    BOOST_REQUIRE_EQUAL(second_receiver->receive(std::chrono::milliseconds(1000)).m_metadata, std::to_string(i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SocketOptions)
+{
+  auto connection_info = connection_info_for(4);
+  connection_info["send_buffer_size"] = 4096;
+  connection_info["receive_buffer_size"] = 4096;
+  connection_info["tcp_nodelay"] = false;
+  auto the_sender = make_ipm_sender("TcpSender");
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  // A message many times the socket buffers still arrives whole
+  std::vector<char> test_data(1 << 20);
+  for (size_t i = 0; i < test_data.size(); ++i) {
+    test_data[i] = static_cast<char>(i % 251);
+  }
+  std::thread sender_thread(
+    [&]() { the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000), "BIG"); });
+  auto response = the_receiver->receive(std::chrono::milliseconds(5000), test_data.size());
+  sender_thread.join();
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "BIG");
+  BOOST_REQUIRE(response.m_data == test_data);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidSocketOptions)
+{
+  auto the_sender = make_ipm_sender("TcpSender");
+  auto the_receiver = make_ipm_receiver("TcpReceiver");
+  for (auto [key, value] : std::vector<std::pair<std::string, nlohmann::json>>{ { "send_buffer_size", "big" },
+                                                                                { "receive_buffer_size", -1 },
+                                                                                { "tcp_nodelay", 1 },
+                                                                                { "max_message_size", 1.5 } }) {
+    auto connection_info = connection_info_for(5);
+    connection_info[key] = value;
+    BOOST_REQUIRE_THROW(the_sender->connect_for_sends(connection_info), ers::Issue);
+    BOOST_REQUIRE_THROW(the_receiver->connect_for_receives(connection_info), ers::Issue);
+    BOOST_REQUIRE(!the_sender->can_send());
+    BOOST_REQUIRE(!the_receiver->can_receive());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,258 @@
+/**
+ * @file TypedSender_test.cxx TypedSender and TypedReceiver class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/TypedReceiver.hpp"
+#include "ipm/TypedSender.hpp"
+
+#define BOOST_TEST_MODULE TypedSender_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+namespace {
+
+struct TriggerPrimitive
+{
+  uint64_t m_time_start;
+  uint32_t m_channel;
+  uint16_t m_adc_peak;
+  char m_flags[2];
+};
+
+// Not trivially copyable, so sent with nlohmann::json's MessagePack
+struct RunInfo
+{
+  int m_run;
+  std::string m_detector;
+};
+
+void
+to_json(nlohmann::json& j, const RunInfo& info)
+{
+  j = nlohmann::json{ { "run", info.m_run }, { "detector", info.m_detector } };
+}
+
+void
+from_json(const nlohmann::json& j, RunInfo& info)
+{
+  j.at("run").get_to(info.m_run);
+  j.at("detector").get_to(info.m_detector);
+}
+
+// With a serializer of its own
+struct Label
+{
+  std::string m_text;
+};
+
+} // namespace ""
+
+template<>
+struct dunedaq::ipm::Serializer<Label>
+{
+  static void serialize(const Label& label, std::vector<char>& buffer)
+  {
+    buffer.assign(label.m_text.rbegin(), label.m_text.rend());
+  }
+  static Label deserialize(const char* data, size_t size)
+  {
+    std::string text(data, size);
+    return Label{ std::string(text.rbegin(), text.rend()) };
+  }
+};
+
+static_assert(is_bitwise_message_v<TriggerPrimitive>);
+static_assert(is_bitwise_message_v<std::array<int, 4>>);
+static_assert(is_contiguous_message_v<std::vector<TriggerPrimitive>>);
+static_assert(is_contiguous_message_v<std::string>);
+static_assert(!is_contiguous_message_v<std::vector<bool>>);
+static_assert(!is_contiguous_message_v<std::vector<std::string>>);
+static_assert(!is_bitwise_message_v<const char*>);
+
+BOOST_AUTO_TEST_SUITE(TypedSender_test)
+
+namespace {
+
+struct Endpoints
+{
+  explicit Endpoints(const std::string& name)
+  {
+    nlohmann::json connection_info{ { "connection_string", "inproc://TypedSender_test_" + name } };
+    m_sender = make_ipm_sender("InprocSender");
+    m_receiver = make_ipm_receiver("InprocReceiver");
+    m_sender->connect_for_sends(connection_info);
+    m_receiver->connect_for_receives(connection_info);
+  }
+
+  std::shared_ptr<Sender> m_sender;
+  std::shared_ptr<Receiver> m_receiver;
+};
+
+const std::chrono::milliseconds s_timeout(1000);
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(Bitwise)
+{
+  Endpoints endpoints("Bitwise");
+  TypedSender<TriggerPrimitive> sender(endpoints.m_sender);
+  TypedReceiver<TriggerPrimitive> receiver(endpoints.m_receiver);
+
+  sender.send(TriggerPrimitive{ 123456789, 42, 1000, { 'A', 'B' } }, s_timeout, "TP");
+  std::string metadata;
+  auto tp = receiver.receive(s_timeout, &metadata);
+  BOOST_REQUIRE_EQUAL(tp.m_time_start, 123456789);
+  BOOST_REQUIRE_EQUAL(tp.m_channel, 42);
+  BOOST_REQUIRE_EQUAL(tp.m_adc_peak, 1000);
+  BOOST_REQUIRE_EQUAL(tp.m_flags[1], 'B');
+  BOOST_REQUIRE_EQUAL(metadata, "TP");
+
+  sender.send(tp, s_timeout);
+  auto view = receiver.receive_view(s_timeout);
+  BOOST_REQUIRE_EQUAL(view.size(), 1);
+  BOOST_REQUIRE_EQUAL(view[0].m_channel, 42);
+
+  // A message of the wrong size is reported and dropped, too short or too long
+  for (size_t size : { sizeof(TriggerPrimitive) - 1, sizeof(TriggerPrimitive) + 1 }) {
+    std::vector<char> wrong(size);
+    endpoints.m_sender->send(wrong.data(), wrong.size(), s_timeout);
+    BOOST_REQUIRE_EXCEPTION(receiver.receive(s_timeout),
+                            dunedaq::ipm::UnexpectedNumberOfBytes,
+                            [&](dunedaq::ipm::UnexpectedNumberOfBytes) { return true; });
+  }
+
+  BOOST_REQUIRE(!receiver.receive_into(tp, std::chrono::milliseconds(10)));
+  BOOST_REQUIRE_EXCEPTION(receiver.receive(std::chrono::milliseconds(10)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+}
+
+BOOST_AUTO_TEST_CASE(Containers)
+{
+  Endpoints endpoints("Containers");
+  TypedSender<std::vector<int>> sender(endpoints.m_sender);
+  TypedReceiver<std::vector<int>> receiver(endpoints.m_receiver);
+
+  std::vector<int> sent{ -3, -2, -1, 0, 1, 2, 3, 4, 5, 6 };
+  sender.send(sent, s_timeout);
+  BOOST_REQUIRE(receiver.receive(s_timeout) == sent);
+
+  // Receiving into the same vector reuses its storage, growing and shrinking it to fit
+  std::vector<int> received;
+  sender.send(sent, s_timeout);
+  BOOST_REQUIRE(receiver.receive_into(received, s_timeout));
+  BOOST_REQUIRE(received == sent);
+  auto storage = received.data();
+  sender.send(std::vector<int>{ 7, 8, 9 }, s_timeout);
+  BOOST_REQUIRE(receiver.receive_into(received, s_timeout));
+  BOOST_REQUIRE(received == std::vector<int>({ 7, 8, 9 }));
+  BOOST_REQUIRE_EQUAL(received.data(), storage);
+
+  sender.send(sent, s_timeout);
+  auto view = receiver.receive_view(s_timeout);
+  BOOST_REQUIRE(std::vector<int>(view.begin(), view.end()) == sent);
+
+  // Not a whole number of ints
+  std::vector<char> ragged(7);
+  endpoints.m_sender->send(ragged.data(), ragged.size(), s_timeout);
+  BOOST_REQUIRE_EXCEPTION(receiver.receive(s_timeout),
+                          dunedaq::ipm::UnexpectedNumberOfBytes,
+                          [&](dunedaq::ipm::UnexpectedNumberOfBytes) { return true; });
+
+  Endpoints string_endpoints("Containers_string");
+  TypedSender<std::string> string_sender(string_endpoints.m_sender);
+  TypedReceiver<std::string> string_receiver(string_endpoints.m_receiver);
+  string_sender.send("Hello, DUNE", s_timeout);
+  BOOST_REQUIRE_EQUAL(string_receiver.receive(s_timeout), "Hello, DUNE");
+}
+
+BOOST_AUTO_TEST_CASE(Serialized)
+{
+  Endpoints endpoints("Serialized");
+  TypedSender<RunInfo> sender(endpoints.m_sender);
+  TypedReceiver<RunInfo> receiver(endpoints.m_receiver);
+  sender.send(RunInfo{ 1234, "ProtoDUNE-SP" }, s_timeout, "RUN");
+  std::string metadata;
+  auto info = receiver.receive(s_timeout, &metadata);
+  BOOST_REQUIRE_EQUAL(info.m_run, 1234);
+  BOOST_REQUIRE_EQUAL(info.m_detector, "ProtoDUNE-SP");
+  BOOST_REQUIRE_EQUAL(metadata, "RUN");
+
+  std::vector<char> garbage{ '\xc1' }; // Never used in MessagePack
+  endpoints.m_sender->send(garbage.data(), garbage.size(), s_timeout);
+  BOOST_REQUIRE_EXCEPTION(receiver.receive(s_timeout),
+                          dunedaq::ipm::DeserializationFailed,
+                          [&](dunedaq::ipm::DeserializationFailed) { return true; });
+
+  Endpoints map_endpoints("Serialized_map");
+  TypedSender<std::map<std::string, int>> map_sender(map_endpoints.m_sender);
+  TypedReceiver<std::map<std::string, int>> map_receiver(map_endpoints.m_receiver);
+  std::map<std::string, int> counts{ { "apa1", 10 }, { "apa2", 20 } };
+  map_sender.send(counts, s_timeout);
+  BOOST_REQUIRE(map_receiver.receive(s_timeout) == counts);
+
+  Endpoints label_endpoints("Serialized_label");
+  TypedSender<Label> label_sender(label_endpoints.m_sender);
+  TypedReceiver<Label> label_receiver(label_endpoints.m_receiver);
+  label_sender.send(Label{ "backwards" }, s_timeout);
+  std::vector<char> raw(9);
+  BOOST_REQUIRE_EQUAL(label_endpoints.m_receiver->receive_into(raw.data(), raw.size(), s_timeout).m_size, 9);
+  BOOST_REQUIRE_EQUAL(std::string(raw.begin(), raw.end()), "sdrawkcab");
+  label_sender.send(Label{ "backwards" }, s_timeout);
+  Label label;
+  BOOST_REQUIRE(label_receiver.receive_into(label, s_timeout));
+  BOOST_REQUIRE_EQUAL(label.m_text, "backwards");
+}
+
+
+BOOST_AUTO_TEST_CASE(Dispatch)
+{
+  Endpoints endpoints("Dispatch");
+  TypedSender<std::vector<TriggerPrimitive>> sender(endpoints.m_sender);
+  TypedReceiver<std::vector<TriggerPrimitive>> receiver(endpoints.m_receiver);
+
+  std::mutex mutex;
+  std::vector<size_t> sizes;
+  receiver.start_dispatch([&](std::vector<TriggerPrimitive>& tps) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sizes.push_back(tps.size());
+  });
+
+  // The odd-sized message in the middle is reported and skipped
+  sender.send(std::vector<TriggerPrimitive>(3), s_timeout);
+  std::vector<char> wrong(sizeof(TriggerPrimitive) + 1);
+  endpoints.m_sender->send(wrong.data(), wrong.size(), s_timeout);
+  sender.send(std::vector<TriggerPrimitive>(5), s_timeout);
+
+  auto deadline = std::chrono::steady_clock::now() + s_timeout;
+  while (std::chrono::steady_clock::now() < deadline) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (sizes.size() == 2) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  receiver.stop_dispatch();
+  BOOST_REQUIRE_EQUAL(sizes.size(), 2);
+  BOOST_REQUIRE_EQUAL(sizes[0], 3);
+  BOOST_REQUIRE_EQUAL(sizes[1], 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,220 @@
+/**
+ * @file UdsReceiver_test.cxx UdsReceiver class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE UdsReceiver_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(UdsReceiver_test)
+
+namespace {
+
+std::string
+socket_path_for(const std::string& test_name)
+{
+  return "/tmp/ipm_UdsReceiver_test_" + test_name + "_" + std::to_string(getpid());
+}
+
+nlohmann::json
+connection_info_for(const std::string& test_name)
+{
+  return { { "connection_string", "ipc://" + socket_path_for(test_name) } };
+}
+
+// ZeroMQ leaves its ipc:// socket files behind
+struct RemoveOnExit
+{
+  explicit RemoveOnExit(std::string path)
+    : m_path(std::move(path))
+  {}
+  ~RemoveOnExit() { unlink(m_path.c_str()); }
+  std::string m_path;
+};
+
+// Messages per second through a sender/receiver pair, with the sender on its own thread
+double
+measure_throughput(std::shared_ptr<Sender> sender, std::shared_ptr<Receiver> receiver, size_t message_size)
+{
+  const int num_messages = 50000;
+  std::vector<char> message(message_size, 'M');
+
+  auto start_time = std::chrono::steady_clock::now();
+  std::thread sender_thread([&]() {
+    for (int i = 0; i < num_messages; ++i) {
+      sender->send(message.data(), message.size(), std::chrono::milliseconds(10000));
+    }
+  });
+  for (int i = 0; i < num_messages; ++i) {
+    receiver->receive(std::chrono::milliseconds(10000), message.size());
+  }
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time);
+  sender_thread.join();
+
+  return num_messages / elapsed.count();
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  BOOST_REQUIRE(the_receiver != nullptr);
+  BOOST_REQUIRE(!the_receiver->can_receive());
+
+  the_receiver->connect_for_receives(connection_info_for("BasicTests"));
+  BOOST_REQUIRE(the_receiver->can_receive());
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  auto connection_info = connection_info_for("ReceiveInto");
+  auto the_sender = make_ipm_sender("UdsSender");
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string test_data("TESTDATA");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+
+  std::vector<char> buffer(4);
+  std::string metadata;
+  auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+
+  buffer.resize(result.m_size);
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(result.m_timed_out);
+}
+
+BOOST_AUTO_TEST_CASE(SenderRestarts)
+{
+  auto connection_info = connection_info_for("SenderRestarts");
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  for (int run = 0; run < 2; ++run) {
+    auto the_sender = make_ipm_sender("UdsSender");
+    the_sender->connect_for_sends(connection_info);
+    std::thread sender_thread([&]() {
+      the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000), std::to_string(run));
+    });
+    BOOST_REQUIRE_EQUAL(the_receiver->receive(std::chrono::milliseconds(5000)).m_metadata, std::to_string(run));
+    sender_thread.join();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MessageTooLarge)
+{
+  auto connection_info = connection_info_for("MessageTooLarge");
+  auto the_sender = make_ipm_sender("UdsSender");
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  the_sender->connect_for_sends(connection_info);
+  auto receiver_info = connection_info;
+  receiver_info["max_message_size"] = 16;
+  the_receiver->connect_for_receives(receiver_info);
+
+  // The limit covers the topic and payload together, and a frame over it drops the connection
+  std::vector<char> test_data(12, 'T');
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+  BOOST_REQUIRE_THROW(the_receiver->receive(std::chrono::milliseconds(1000)), ers::Issue);
+
+  // Once the sender notices, the next connection starts afresh
+  std::thread sender_thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    the_sender->send(test_data.data(), 4, std::chrono::milliseconds(5000), "OK");
+  });
+  BOOST_REQUIRE_EQUAL(the_receiver->receive(std::chrono::milliseconds(5000)).m_metadata, "OK");
+  sender_thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(SenderStallsMidFrame)
+{
+  // A bare socket stands in for a sender which stops part way through a frame
+  auto path = socket_path_for("SenderStallsMidFrame");
+  RemoveOnExit socket_file(path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  BOOST_REQUIRE_EQUAL(bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)), 0);
+  BOOST_REQUIRE_EQUAL(listen(listen_fd, 1), 0);
+
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  the_receiver->connect_for_receives(connection_info_for("SenderStallsMidFrame"));
+  int peer_fd = accept(listen_fd, nullptr, nullptr);
+  BOOST_REQUIRE_GE(peer_fd, 0);
+  uint32_t header[] = { htonl(0), htonl(100) };
+  BOOST_REQUIRE_EQUAL(write(peer_fd, header, sizeof(header)), static_cast<ssize_t>(sizeof(header)));
+  BOOST_REQUIRE_EQUAL(write(peer_fd, "PART", 4), 4);
+
+  // The receive keeps to its timeout, and drops the connection rather than leave it part way through a frame
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(200)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time < std::chrono::seconds(2));
+  char byte = 0;
+  BOOST_REQUIRE_EQUAL(read(peer_fd, &byte, 1), 0);
+
+  close(peer_fd);
+  close(listen_fd);
+}
+
+BOOST_AUTO_TEST_CASE(ThroughputComparedToZmq)
+{
+  auto uds_connection_info = connection_info_for("Throughput");
+  auto uds_sender = make_ipm_sender("UdsSender");
+  auto uds_receiver = make_ipm_receiver("UdsReceiver");
+  uds_sender->connect_for_sends(uds_connection_info);
+  uds_receiver->connect_for_receives(uds_connection_info);
+
+  auto zmq_connection_info = connection_info_for("ZmqThroughput");
+  RemoveOnExit zmq_socket_file(socket_path_for("ZmqThroughput"));
+  auto zmq_sender = make_ipm_sender("ZmqSender");
+  auto zmq_receiver = make_ipm_receiver("ZmqReceiver");
+  zmq_sender->connect_for_sends(zmq_connection_info);
+  zmq_receiver->connect_for_receives(zmq_connection_info);
+
+  for (size_t message_size : { 64, 4096, 65536 }) {
+    auto uds_rate = measure_throughput(uds_sender, uds_receiver, message_size);
+    auto zmq_rate = measure_throughput(zmq_sender, zmq_receiver, message_size);
+    BOOST_TEST_MESSAGE(message_size << "-byte messages: " << uds_rate << " msg/s through UdsSender/UdsReceiver, "
+                                    << zmq_rate << " msg/s through ZeroMQ ipc://");
+    // ZeroMQ batches small messages into one write, so only larger ones are compared
+    if (message_size >= 4096) {
+      BOOST_CHECK_GT(uds_rate, zmq_rate);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
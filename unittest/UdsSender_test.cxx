@@ -0,0 +1,153 @@
+/**
+ * @file UdsSender_test.cxx UdsSender class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE UdsSender_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(UdsSender_test)
+
+namespace {
+
+std::string
+socket_path_for(const std::string& test_name)
+{
+  return "/tmp/ipm_UdsSender_test_" + test_name + "_" + std::to_string(getpid());
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_sender = make_ipm_sender("UdsSender");
+  BOOST_REQUIRE(the_sender != nullptr);
+  BOOST_REQUIRE(!the_sender->can_send());
+
+  the_sender->connect_for_sends({ { "connection_string", "ipc://" + socket_path_for("BasicTests") } });
+  BOOST_REQUIRE(the_sender->can_send());
+
+  // Only ipc:// connection strings are understood
+  auto other_sender = make_ipm_sender("UdsSender");
+  BOOST_REQUIRE_THROW(other_sender->connect_for_sends({ { "connection_string", "tcp://127.0.0.1:5000" } }),
+                      ers::Issue); // SocketError is private to the plugin
+}
+
+BOOST_AUTO_TEST_CASE(SendReceive)
+{
+  // A socket file left behind by an earlier run is replaced, and ours is removed afterwards
+  auto path = socket_path_for("SendReceive");
+  std::ofstream(path) << "stale";
+  nlohmann::json connection_info{ { "connection_string", "ipc://" + path } };
+  {
+    auto the_sender = make_ipm_sender("UdsSender");
+    auto the_receiver = make_ipm_receiver("UdsReceiver");
+    the_sender->connect_for_sends(connection_info);
+    the_receiver->connect_for_receives(connection_info);
+
+    std::string header = "HEADER";
+    std::string fragment = "FRAGMENT";
+    const void* parts[] = { header.data(), fragment.data() };
+    std::vector<Sender::message_size_t> sizes{ static_cast<Sender::message_size_t>(header.size()),
+                                               static_cast<Sender::message_size_t>(fragment.size()) };
+    the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+    the_sender->send(fragment.data(), fragment.size(), Sender::s_block);
+
+    auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+    BOOST_REQUIRE_EQUAL(response.m_metadata, "EVENT");
+    BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), header + fragment);
+    response = the_receiver->receive(std::chrono::milliseconds(1000));
+    BOOST_REQUIRE(response.m_metadata.empty());
+    BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), fragment);
+  }
+  BOOST_REQUIRE_NE(access(path.c_str(), F_OK), 0);
+}
+
+BOOST_AUTO_TEST_CASE(SendTimeout)
+{
+  auto the_sender = make_ipm_sender("UdsSender");
+  the_sender->connect_for_sends({ { "connection_string", "ipc://" + socket_path_for("SendTimeout") } });
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(50)),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+}
+
+BOOST_AUTO_TEST_CASE(TimeoutPartWayThroughFrame)
+{
+  nlohmann::json connection_info{ { "connection_string", "ipc://" + socket_path_for("TimeoutPartWayThroughFrame") },
+                                  { "send_buffer_size", 4096 },
+                                  { "receive_buffer_size", 4096 } };
+  auto the_sender = make_ipm_sender("UdsSender");
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  // The receiver isn't reading, so the frame can't all go out; the deadline still holds once it has started
+  std::vector<char> test_data(8 * 1024 * 1024, 'T');
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(100)),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  BOOST_REQUIRE(elapsed >= std::chrono::milliseconds(100));
+  BOOST_REQUIRE(elapsed < std::chrono::milliseconds(2000));
+
+  // The torn frame shows up as the sender disconnecting, never as a message
+  BOOST_REQUIRE_THROW(the_receiver->receive(std::chrono::milliseconds(1000)), ers::Issue);
+}
+
+BOOST_AUTO_TEST_CASE(TryWithoutRoom)
+{
+  nlohmann::json connection_info{ { "connection_string", "ipc://" + socket_path_for("TryWithoutRoom") },
+                                  { "send_buffer_size", 4096 },
+                                  { "receive_buffer_size", 4096 } };
+  auto the_sender = make_ipm_sender("UdsSender");
+  auto the_receiver = make_ipm_receiver("UdsReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  // A frame bigger than the socket buffer is refused without any of it being written
+  std::vector<char> big_data(64 * 1024, 'B');
+  BOOST_REQUIRE(!the_sender->try_send(big_data.data(), big_data.size()));
+
+  // Small frames go out until the buffer fills, and then are refused whole
+  std::vector<char> test_data(100, 'T');
+  size_t num_sent = 0;
+  while (num_sent < 10000 && the_sender->try_send(test_data.data(), test_data.size())) {
+    ++num_sent;
+  }
+  BOOST_REQUIRE(num_sent > 0);
+  BOOST_REQUIRE(num_sent < 10000);
+
+  // The receiver was never dropped, and gets every frame which went out, intact
+  for (size_t i = 0; i < num_sent; ++i) {
+    auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+    BOOST_REQUIRE(response.m_data == test_data);
+  }
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(50)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(the_sender->try_send(test_data.data(), test_data.size()));
+  BOOST_REQUIRE(the_receiver->receive(std::chrono::milliseconds(1000)).m_data == test_data);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
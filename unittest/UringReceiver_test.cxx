@@ -0,0 +1,218 @@
+/**
+ * @file UringReceiver_test.cxx UringReceiver class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE UringReceiver_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(UringReceiver_test)
+
+namespace {
+
+// A loopback port per test case, varied by process so that concurrent runs don't collide
+nlohmann::json
+connection_info_for(int test_number, const std::string& backend = "io_uring")
+{
+  int port = 44000 + (getpid() % 800) * 25 + test_number;
+  return { { "connection_string", "tcp://127.0.0.1:" + std::to_string(port) }, { "backend", backend } };
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_receiver = make_ipm_receiver("UringReceiver");
+  BOOST_REQUIRE(the_receiver != nullptr);
+  BOOST_REQUIRE(!the_receiver->can_receive());
+
+  the_receiver->connect_for_receives(connection_info_for(0));
+  BOOST_REQUIRE(the_receiver->can_receive());
+}
+
+BOOST_AUTO_TEST_CASE(SendReceive)
+{
+  int test_number = 1;
+  for (std::string backend : { "io_uring", "epoll" }) {
+    auto connection_info = connection_info_for(test_number++, backend);
+    auto the_sender = make_ipm_sender("UringSender");
+    auto the_receiver = make_ipm_receiver("UringReceiver");
+    the_sender->connect_for_sends(connection_info);
+    the_receiver->connect_for_receives(connection_info);
+
+    std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+    the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(1000), "TOPIC");
+    the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(1000));
+
+    // The readiness descriptor is readable while messages are queued
+    pollfd item{ the_receiver->readiness_fd(), POLLIN, 0 };
+    BOOST_REQUIRE_EQUAL(poll(&item, 1, 1000), 1);
+    BOOST_REQUIRE(the_receiver->ready_to_receive());
+
+    auto response = the_receiver->receive(std::chrono::milliseconds(1000), test_data.size());
+    BOOST_REQUIRE_EQUAL(response.m_metadata, "TOPIC");
+    BOOST_REQUIRE(response.m_data == test_data);
+
+    auto view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+    BOOST_REQUIRE(view.m_metadata.empty());
+    BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), "TEST");
+    BOOST_REQUIRE_EQUAL(poll(&item, 1, 0), 0);
+    BOOST_REQUIRE(!the_receiver->ready_to_receive());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveTimeout)
+{
+  auto connection_info = connection_info_for(3);
+  auto the_receiver = make_ipm_receiver("UringReceiver");
+  the_receiver->connect_for_receives(connection_info);
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(50)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+
+  // The engine keeps trying to connect, and picks up a sender which starts later
+  auto the_sender = make_ipm_sender("UringSender");
+  the_sender->connect_for_sends(connection_info);
+  std::string test_data("LATE");
+  the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000));
+  auto response = the_receiver->receive(std::chrono::milliseconds(5000));
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), "LATE");
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  auto connection_info = connection_info_for(4);
+  auto the_sender = make_ipm_sender("UringSender");
+  auto the_receiver = make_ipm_receiver("UringReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string test_data("TESTDATA");
+  the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(1000), "TOPIC");
+
+  std::vector<char> buffer(4);
+  std::string metadata;
+  auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+
+  buffer.resize(result.m_size);
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(result.m_timed_out);
+}
+
+BOOST_AUTO_TEST_CASE(ManyConnections)
+{
+  // Every receiver is serviced by the one engine thread; a small queue capacity
+  // makes the engine pause and resume connections as their receivers fall behind
+  const int num_connections = 16;
+  const int num_messages = 2000;
+  std::vector<std::shared_ptr<Sender>> senders;
+  std::vector<std::shared_ptr<Receiver>> receivers;
+  for (int i = 0; i < num_connections; ++i) {
+    auto connection_info = connection_info_for(5 + i, i % 2 == 0 ? "io_uring" : "epoll");
+    connection_info["capacity"] = 8;
+    senders.push_back(make_ipm_sender("UringSender"));
+    receivers.push_back(make_ipm_receiver("UringReceiver"));
+    senders.back()->connect_for_sends(connection_info);
+    receivers.back()->connect_for_receives(connection_info);
+  }
+
+  std::vector<std::thread> sender_threads;
+  for (int i = 0; i < num_connections; ++i) {
+    sender_threads.emplace_back([&, i]() {
+      std::vector<char> message(1000 + i * 100);
+      for (int j = 0; j < num_messages; ++j) {
+        *reinterpret_cast<int*>(message.data()) = j;
+        senders[i]->send(message.data(), message.size(), std::chrono::milliseconds(10000));
+      }
+    });
+  }
+
+  for (int j = 0; j < num_messages; ++j) {
+    for (int i = 0; i < num_connections; ++i) {
+      auto response = receivers[i]->receive(std::chrono::milliseconds(10000));
+      BOOST_REQUIRE_EQUAL(response.m_data.size(), static_cast<size_t>(1000 + i * 100));
+      BOOST_REQUIRE_EQUAL(*reinterpret_cast<const int*>(response.m_data.data()), j);
+    }
+  }
+  for (auto& sender_thread : sender_threads) {
+    sender_thread.join();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SmallAndLargeMessages)
+{
+  // A quick check of batches of small messages and of messages bigger than a receive buffer; ipm_bench
+  // compares the rates with ZeroMQ's
+  auto connection_info = connection_info_for(21);
+  auto the_sender = make_ipm_sender("UringSender");
+  auto the_receiver = make_ipm_receiver("UringReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  for (size_t message_size : { size_t(64), size_t(1) << 20 }) {
+    std::vector<char> message(message_size, 'M');
+    std::vector<Sender::BatchEntry> batch(10, { message.data(), static_cast<Sender::message_size_t>(message.size()) });
+    std::thread sender_thread([&]() {
+      BOOST_CHECK_EQUAL(the_sender->send_batch(batch.data(), batch.size(), std::chrono::milliseconds(10000)),
+                        batch.size());
+    });
+    for (size_t i = 0; i < batch.size(); ++i) {
+      BOOST_REQUIRE(the_receiver->receive(std::chrono::milliseconds(10000)).m_data == message);
+    }
+    sender_thread.join();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MessageTooLarge)
+{
+  int test_number = 22;
+  for (std::string backend : { "io_uring", "epoll" }) {
+    auto connection_info = connection_info_for(test_number++, backend);
+    auto the_sender = make_ipm_sender("UringSender");
+    auto the_receiver = make_ipm_receiver("UringReceiver");
+    the_sender->connect_for_sends(connection_info);
+    auto receiver_info = connection_info;
+    receiver_info["max_message_size"] = 16;
+    the_receiver->connect_for_receives(receiver_info);
+
+    // A frame over the limit drops the connection rather than being allocated; the engine then connects again
+    std::vector<char> test_data(12, 'T');
+    the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(1000), "TOPIC");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    the_sender->send(test_data.data(), 4, std::chrono::milliseconds(5000), "OK");
+    BOOST_REQUIRE_EQUAL(the_receiver->receive(std::chrono::milliseconds(5000)).m_metadata, "OK");
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,152 @@
+/**
+ * @file UringSender_test.cxx UringSender class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+
+#define BOOST_TEST_MODULE UringSender_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(UringSender_test)
+
+namespace {
+
+// A loopback port per test case, varied by process so that concurrent runs don't collide
+nlohmann::json
+connection_info_for(int test_number, const std::string& backend = "io_uring")
+{
+  int port = 24000 + (getpid() % 1000) * 10 + test_number;
+  return { { "connection_string", "tcp://127.0.0.1:" + std::to_string(port) }, { "backend", backend } };
+}
+
+} // namespace ""
+
+BOOST_AUTO_TEST_CASE(BasicTests)
+{
+  auto the_sender = make_ipm_sender("UringSender");
+  BOOST_REQUIRE(the_sender != nullptr);
+  BOOST_REQUIRE(!the_sender->can_send());
+
+  the_sender->connect_for_sends(connection_info_for(0));
+  BOOST_REQUIRE(the_sender->can_send());
+}
+
+BOOST_AUTO_TEST_CASE(SendBatch)
+{
+  int test_number = 1;
+  for (std::string backend : { "io_uring", "epoll" }) {
+    auto connection_info = connection_info_for(test_number++, backend);
+    auto the_sender = make_ipm_sender("UringSender");
+    auto the_receiver = make_ipm_receiver("UringReceiver");
+    the_sender->connect_for_sends(connection_info);
+    the_receiver->connect_for_receives(connection_info);
+
+    // More entries than go into one chain, with some empty ones which are skipped
+    const int num_entries = 1000;
+    std::vector<int> values(num_entries);
+    std::vector<std::string> topics(num_entries);
+    std::vector<Sender::BatchEntry> entries(num_entries);
+    for (int i = 0; i < num_entries; ++i) {
+      values[i] = i;
+      topics[i] = std::to_string(i);
+      entries[i] = { &values[i], i % 10 == 9 ? 0 : static_cast<Sender::message_size_t>(sizeof(int)), topics[i] };
+    }
+    BOOST_REQUIRE_EQUAL(the_sender->send_batch(entries.data(), entries.size(), std::chrono::milliseconds(5000)),
+                        static_cast<size_t>(num_entries));
+
+    for (int i = 0; i < num_entries; ++i) {
+      if (i % 10 == 9) {
+        continue;
+      }
+      auto response = the_receiver->receive(std::chrono::milliseconds(5000), sizeof(int));
+      BOOST_REQUIRE_EQUAL(response.m_metadata, topics[i]);
+      BOOST_REQUIRE_EQUAL(*reinterpret_cast<const int*>(response.m_data.data()), i);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SendBatchTimeout)
+{
+  int test_number = 3;
+  for (std::string backend : { "io_uring", "epoll" }) {
+    auto connection_info = connection_info_for(test_number++, backend);
+    connection_info["capacity"] = 2;
+    connection_info["send_buffer_size"] = 4096;
+    connection_info["receive_buffer_size"] = 4096;
+    auto the_sender = make_ipm_sender("UringSender");
+    the_sender->connect_for_sends(connection_info);
+
+    // With no receiver, nothing is accepted
+    std::vector<char> message(64 * 1024, 'M');
+    std::vector<Sender::BatchEntry> entries(100,
+                                            { message.data(), static_cast<Sender::message_size_t>(message.size()) });
+    BOOST_REQUIRE_EQUAL(the_sender->send_batch(entries.data(), entries.size(), std::chrono::milliseconds(50)), 0);
+
+    // A receiver which stops reading accepts a few messages, and every message accepted arrives whole
+    auto the_receiver = make_ipm_receiver("UringReceiver");
+    the_receiver->connect_for_receives(connection_info);
+    size_t num_received = 0;
+    std::thread receiver_thread([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      try {
+        for (;;) {
+          auto response = the_receiver->receive(std::chrono::milliseconds(500));
+          BOOST_CHECK(response.m_data == message);
+          ++num_received;
+        }
+      } catch (dunedaq::ipm::ReceiveTimeoutExpired const&) {
+      }
+    });
+    // The deadline holds even part way through a frame: the send is over well before the receiver reads again
+    auto start_time = std::chrono::steady_clock::now();
+    size_t num_accepted = the_sender->send_batch(entries.data(), entries.size(), std::chrono::milliseconds(100));
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    BOOST_CHECK(elapsed >= std::chrono::milliseconds(100));
+    BOOST_CHECK(elapsed < std::chrono::milliseconds(300));
+    receiver_thread.join();
+
+    BOOST_TEST_MESSAGE(backend << ": " << num_accepted << " of " << entries.size() << " accepted");
+    BOOST_REQUIRE_GT(num_accepted, 0);
+    BOOST_REQUIRE_LT(num_accepted, entries.size());
+    BOOST_REQUIRE_EQUAL(num_received, num_accepted);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SingleSends)
+{
+  auto connection_info = connection_info_for(5);
+  auto the_sender = make_ipm_sender("UringSender");
+  auto the_receiver = make_ipm_receiver("UringReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string header = "HEADER";
+  std::string fragment = "FRAGMENT";
+  const void* parts[] = { header.data(), fragment.data() };
+  std::vector<Sender::message_size_t> sizes{ static_cast<Sender::message_size_t>(header.size()),
+                                             static_cast<Sender::message_size_t>(fragment.size()) };
+  the_sender->send_multipart(parts, sizes, std::chrono::milliseconds(1000), "EVENT");
+  the_sender->send(fragment.data(), fragment.size(), std::chrono::milliseconds(1000));
+
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "EVENT");
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), header + fragment);
+  response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), fragment);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+/**
+ * @file ZmqContext_test.cxx ZmqContext class Unit Tests
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+
+#include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
+#include "ipm/Subscriber.hpp"
+#include "ipm/ZmqContext.hpp"
+
+#define BOOST_TEST_MODULE ZmqContext_test // NOLINT
+
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::ipm;
+
+BOOST_AUTO_TEST_SUITE(ZmqContext_test)
+
+BOOST_AUTO_TEST_CASE(NamedContexts)
+{
+  auto& the_default = ZmqContext::instance().GetContext();
+  BOOST_REQUIRE_EQUAL(&the_default, &ZmqContext::instance().GetContext(ZmqContext::s_default_name));
+  BOOST_REQUIRE_EQUAL(&the_default, &ZmqContext::instance().context_for({ { "connection_string", "inproc://a" } }));
+
+  auto& bulk = ZmqContext::instance().GetContext("bulk");
+  BOOST_REQUIRE_NE(&the_default, &bulk);
+  BOOST_REQUIRE_EQUAL(&bulk, &ZmqContext::instance().context_for({ { "zmq_context", "bulk" } }));
+}
+
+BOOST_AUTO_TEST_CASE(Configure)
+{
+  nlohmann::json config{ { "io_threads", 2 }, { "max_sockets", 64 } };
+  ZmqContext::instance().configure("configured", config);
+  auto& context = ZmqContext::instance().GetContext("configured");
+  BOOST_REQUIRE_EQUAL(context.getctxopt(ZMQ_IO_THREADS), 2);
+  BOOST_REQUIRE_EQUAL(context.getctxopt(ZMQ_MAX_SOCKETS), 64);
+
+  // Once in use, only the same settings are accepted
+  ZmqContext::instance().configure("configured", config);
+  BOOST_REQUIRE_EXCEPTION(ZmqContext::instance().configure("configured", { { "io_threads", 4 } }),
+                          dunedaq::ipm::ZmqContextInUse,
+                          [&](dunedaq::ipm::ZmqContextInUse) { return true; });
+
+  // Before then, a new configuration replaces the old one rather than adding to it
+  ZmqContext::instance().configure("reconfigured", { { "io_threads", 4 }, { "max_sockets", 64 } });
+  ZmqContext::instance().configure("reconfigured", { { "io_threads", 2 } });
+  auto& reconfigured = ZmqContext::instance().GetContext("reconfigured");
+  BOOST_REQUIRE_EQUAL(reconfigured.getctxopt(ZMQ_IO_THREADS), 2);
+  BOOST_REQUIRE_EQUAL(reconfigured.getctxopt(ZMQ_MAX_SOCKETS), ZMQ_MAX_SOCKETS_DFLT);
+
+  BOOST_REQUIRE_EXCEPTION(ZmqContext::instance().configure("invalid", { { "io_threads", -1 } }),
+                          dunedaq::ipm::ZmqContextConfigurationFailed,
+                          [&](dunedaq::ipm::ZmqContextConfigurationFailed) { return true; });
+
+  // Unknown keys and values of the wrong type are refused, even for a context already in use
+  for (auto const& invalid : std::vector<nlohmann::json>{ { { "io_thread", 2 } },
+                                                          { { "io_threads", "2" } },
+                                                          { { "max_sockets", 1.5 } },
+                                                          { { "cpu_affinity", 2 } },
+                                                          { { "cpu_affinity", { "2" } } } }) {
+    BOOST_REQUIRE_EXCEPTION(ZmqContext::instance().configure("configured", invalid),
+                            dunedaq::ipm::ZmqContextConfigurationFailed,
+                            [&](dunedaq::ipm::ZmqContextConfigurationFailed) { return true; });
+  }
+  BOOST_REQUIRE_EXCEPTION(ZmqContext::instance().context_for({ { "zmq_context", { { "name", 1 } } } }),
+                          dunedaq::ipm::ZmqContextConfigurationFailed,
+                          [&](dunedaq::ipm::ZmqContextConfigurationFailed) { return true; });
+  BOOST_REQUIRE_EXCEPTION(ZmqContext::instance().context_for({ { "zmq_context", 3 } }),
+                          dunedaq::ipm::ZmqContextConfigurationFailed,
+                          [&](dunedaq::ipm::ZmqContextConfigurationFailed) { return true; });
+}
+
+BOOST_AUTO_TEST_CASE(SocketsOnNamedContext)
+{
+  // Every socket on the context carries the same settings, so either may create it
+  nlohmann::json context_info{ { "name", "data" }, { "io_threads", 2 }, { "cpu_affinity", { 0 } } };
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqContext_test_SocketsOnNamedContext" },
+                                  { "zmq_context", context_info } };
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+  BOOST_REQUIRE_EQUAL(ZmqContext::instance().GetContext("data").getctxopt(ZMQ_IO_THREADS), 2);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block);
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE(response.m_data == test_data);
+
+  // inproc:// endpoints are local to their context
+  nlohmann::json elsewhere{ { "connection_string", "inproc://ZmqContext_test_SocketsOnNamedContext" } };
+  auto other_receiver = make_ipm_receiver("ZmqReceiver");
+  other_receiver->connect_for_receives(elsewhere);
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block);
+  BOOST_REQUIRE_EXCEPTION(other_receiver->receive(std::chrono::milliseconds(100)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE(response.m_data == test_data);
+}
+
+BOOST_AUTO_TEST_CASE(SubscribeBeforeConnect)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqContext_test_SubscribeBeforeConnect" },
+                                  { "zmq_context", "control" } };
+  auto the_publisher = make_ipm_sender("ZmqPublisher");
+  auto the_subscriber = make_ipm_subscriber("ZmqSubscriber");
+  the_subscriber->subscribe("WANTED");
+  the_subscriber->subscribe("UNWANTED");
+  the_subscriber->unsubscribe("UNWANTED");
+  the_publisher->connect_for_sends(connection_info);
+  the_subscriber->connect_for_receives(connection_info);
+
+  std::string test_data("TEST");
+  the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "UNWANTED");
+  the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "WANTED");
+  auto response = the_subscriber->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "WANTED");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
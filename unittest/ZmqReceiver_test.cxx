@@ -7,18 +7,103 @@
  */
 
 #include "ipm/Receiver.hpp"
+#include "ipm/Sender.hpp"
 
 #define BOOST_TEST_MODULE ZmqReceiver_test // NOLINT
 
 #include "boost/test/unit_test.hpp"
+#include "zmq.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <utility>
 #include <vector>
 
 using namespace dunedaq::ipm;
 
 BOOST_AUTO_TEST_SUITE(ZmqReceiver_test)
 
+namespace {
+
+// Unlinks a file left by the test, however the test ends
+struct RemoveOnExit
+{
+  explicit RemoveOnExit(std::string path)
+    : m_path(std::move(path))
+  {}
+  ~RemoveOnExit() { unlink(m_path.c_str()); }
+  std::string m_path;
+};
+
+// The RCVTIMEO=1 ms + usleep(1000) loop ZmqReceiver used before it waited on
+// socket readiness, kept to compare wakeup latencies against
+bool
+legacy_receive(zmq::socket_t& socket, const std::chrono::milliseconds& timeout)
+{
+  zmq::message_t hdr, msg;
+  bool res = false;
+  auto start_time = std::chrono::steady_clock::now();
+  do {
+    res = socket.recv(&hdr);
+    if (res) {
+      res = socket.recv(&msg);
+    } else {
+      usleep(1000);
+    }
+  } while (std::chrono::steady_clock::now() - start_time < timeout && !res);
+  return res;
+}
+
+// Mean time from a send to the wakeup of a receiver that has been idle for a
+// while. The legacy loop only pays its penalty when a message lands during its
+// usleep, so the mean rather than the median shows the difference.
+template<typename ReceiveFunction>
+std::chrono::microseconds
+mean_wakeup_latency(std::shared_ptr<Sender> sender, ReceiveFunction receive_function)
+{
+  const int num_samples = 50;
+  std::chrono::microseconds total_latency(0);
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+
+  for (int i = 0; i < num_samples; ++i) {
+    std::chrono::steady_clock::time_point received_at;
+    std::thread receiver_thread([&]() {
+      BOOST_REQUIRE(receive_function());
+      received_at = std::chrono::steady_clock::now();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto sent_at = std::chrono::steady_clock::now();
+    sender->send(test_data.data(), test_data.size(), Sender::s_block);
+    receiver_thread.join();
+
+    total_latency += std::chrono::duration_cast<std::chrono::microseconds>(received_at - sent_at);
+  }
+
+  return total_latency / num_samples;
+}
+
+// Number of times the calling thread went to sleep while running receive_function
+template<typename ReceiveFunction>
+long
+count_voluntary_context_switches(ReceiveFunction receive_function)
+{
+  struct rusage before, after;
+  getrusage(RUSAGE_THREAD, &before);
+  receive_function();
+  getrusage(RUSAGE_THREAD, &after);
+  return after.ru_nvcsw - before.ru_nvcsw;
+}
+
+} // namespace ""
+
 BOOST_AUTO_TEST_CASE(BasicTests)
 {
   auto the_receiver = make_ipm_receiver("ZmqReceiver");
@@ -26,4 +111,299 @@ BOOST_AUTO_TEST_CASE(BasicTests)
   BOOST_REQUIRE(!the_receiver->can_receive());
 }
 
+BOOST_AUTO_TEST_CASE(ReceiveView)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqReceiver_test_ReceiveView" } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+
+  auto view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE(view.m_handle != nullptr);
+  BOOST_REQUIRE_EQUAL(view.m_metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), "TEST");
+
+  // The compatibility path still hands out an owning copy
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000), test_data.size());
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "TOPIC");
+  BOOST_REQUIRE(response.m_data == test_data);
+
+  // A view still held keeps its message while later ones are received
+  std::vector<char> other_data{ 'O', 'T', 'H', 'E', 'R' };
+  the_sender->send(other_data.data(), other_data.size(), Sender::s_block, "OTHER");
+  auto other_view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE(other_view.m_handle != view.m_handle);
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), "TEST");
+  BOOST_REQUIRE_EQUAL(std::string(other_view.m_data, other_view.m_size), "OTHER");
+
+  // Once released, a view's storage is reused for the next message
+  const void* released_handle = other_view.m_handle.get();
+  other_view = Receiver::ResponseView();
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+  auto reused_view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(reused_view.m_handle.get(), released_handle);
+  BOOST_REQUIRE_EQUAL(reused_view.m_metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(reused_view.m_data, reused_view.m_size), "TEST");
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveBatch)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqReceiver_test_ReceiveBatch" } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  BOOST_REQUIRE(the_receiver->receive_batch(10, std::chrono::milliseconds(10)).empty());
+
+  for (int i = 0; i < 10; ++i) {
+    the_sender->send(&i, sizeof(i), Sender::s_block, std::to_string(i));
+  }
+
+  auto batch = the_receiver->receive_batch(4, std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(batch.size(), 4);
+
+  auto rest = the_receiver->receive_batch(100, std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(rest.size(), 6);
+  batch.insert(batch.end(), rest.begin(), rest.end());
+
+  for (int i = 0; i < 10; ++i) {
+    BOOST_REQUIRE_EQUAL(batch[i].m_metadata, std::to_string(i));
+    BOOST_REQUIRE_EQUAL(batch[i].m_data.size(), sizeof(int));
+    BOOST_REQUIRE_EQUAL(*reinterpret_cast<const int*>(batch[i].m_data.data()), i);
+  }
+
+  BOOST_REQUIRE(the_receiver->receive_batch(100, Receiver::s_no_block).empty());
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveInto)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqReceiver_test_ReceiveInto" } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> buffer(4);
+  std::string metadata;
+
+  auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(10), &metadata);
+  BOOST_REQUIRE(result.m_timed_out);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+
+  std::string test_data("TESTDATA");
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "TOPIC");
+
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE(result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+  BOOST_REQUIRE(metadata.empty());
+
+  buffer.resize(result.m_size);
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+  BOOST_REQUIRE(!result.m_buffer_too_small);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+  BOOST_REQUIRE_EQUAL(metadata, "TOPIC");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  // Multipart messages land in the buffer back to back
+  const void* parts[] = { "TEST", "DATA" };
+  the_sender->send_multipart(parts, { 4, 4 }, Sender::s_block, "MULTI");
+  result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE_EQUAL(result.m_size, static_cast<int>(test_data.size()));
+  BOOST_REQUIRE_EQUAL(metadata, "MULTI");
+  BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), test_data);
+
+  // Whichever kind of receive comes next, a message kept for not fitting comes first
+  std::string long_data("TESTDATA_TOO_LONG");
+  for (int i = 0; i < 4; ++i) {
+    the_sender->send(long_data.data(), long_data.size(), Sender::s_block, "LONG");
+    the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "NEXT");
+    result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+    BOOST_REQUIRE(result.m_buffer_too_small);
+    BOOST_REQUIRE(the_receiver->ready_to_receive());
+
+    Receiver::Response kept;
+    if (i == 0) {
+      kept = the_receiver->receive(Receiver::s_no_block);
+    } else if (i == 1) {
+      auto view = the_receiver->receive_view(Receiver::s_no_block);
+      kept.m_metadata.assign(view.m_metadata);
+      kept.m_data.assign(view.m_data, view.m_data + view.m_size);
+    } else if (i == 2) {
+      BOOST_REQUIRE(the_receiver->try_receive(kept));
+    } else {
+      auto batch = the_receiver->receive_batch(2, std::chrono::milliseconds(1000));
+      BOOST_REQUIRE_EQUAL(batch.size(), 2);
+      kept = batch.front();
+      the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "NEXT");
+    }
+    BOOST_REQUIRE_EQUAL(kept.m_metadata, "LONG");
+    BOOST_REQUIRE_EQUAL(std::string(kept.m_data.begin(), kept.m_data.end()), long_data);
+
+    auto next = the_receiver->receive(std::chrono::milliseconds(1000));
+    BOOST_REQUIRE_EQUAL(next.m_metadata, "NEXT");
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ReceiveTimeout)
+{
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_receiver->connect_for_receives({ { "connection_string", "inproc://ZmqReceiver_test_ReceiveTimeout" } });
+
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(50)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+}
+
+BOOST_AUTO_TEST_CASE(WakeupLatency)
+{
+  const std::string path = "/tmp/ipm_ZmqReceiver_test_WakeupLatency_" + std::to_string(getpid());
+  const std::string connection_string = "ipc://" + path;
+  const std::string legacy_connection_string = connection_string + "_legacy";
+  // ZeroMQ leaves the socket files behind; the legacy socket has a context of
+  // its own, so inproc:// can't be used instead
+  RemoveOnExit remove_socket(path);
+  RemoveOnExit remove_legacy_socket(path + "_legacy");
+
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_sender->connect_for_sends({ { "connection_string", connection_string } });
+  the_receiver->connect_for_receives({ { "connection_string", connection_string } });
+
+  auto legacy_sender = make_ipm_sender("ZmqSender");
+  legacy_sender->connect_for_sends({ { "connection_string", legacy_connection_string } });
+  zmq::context_t legacy_context;
+  zmq::socket_t legacy_socket(legacy_context, zmq::socket_type::pull);
+  legacy_socket.setsockopt(ZMQ_RCVTIMEO, 1);
+  legacy_socket.connect(legacy_connection_string);
+
+  auto latency = mean_wakeup_latency(
+    the_sender, [&]() { return the_receiver->receive(std::chrono::milliseconds(1000)).m_data.size() == 4; });
+  auto legacy_latency =
+    mean_wakeup_latency(legacy_sender, [&]() { return legacy_receive(legacy_socket, std::chrono::milliseconds(1000)); });
+
+  BOOST_TEST_MESSAGE("Mean wakeup latency: " << latency.count() << " us with readiness polling, "
+                                             << legacy_latency.count() << " us with the legacy polling loop");
+  // Wakeup is driven by the message itself rather than by the legacy loop's 1 ms polling period
+  BOOST_CHECK_LT(latency.count(), 1000);
+
+  // An idle receiver sleeps once for the whole timeout instead of waking every millisecond
+  const std::chrono::milliseconds idle_time(100);
+  auto wakeups = count_voluntary_context_switches([&]() {
+    BOOST_REQUIRE_EXCEPTION(the_receiver->receive(idle_time),
+                            dunedaq::ipm::ReceiveTimeoutExpired,
+                            [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  });
+  auto legacy_wakeups =
+    count_voluntary_context_switches([&]() { BOOST_REQUIRE(!legacy_receive(legacy_socket, idle_time)); });
+
+  BOOST_TEST_MESSAGE("Wakeups while idle for " << idle_time.count() << " ms: " << wakeups
+                                               << " with readiness polling, " << legacy_wakeups
+                                               << " with the legacy polling loop");
+  BOOST_CHECK_LT(wakeups, legacy_wakeups / 10);
+}
+
+BOOST_AUTO_TEST_CASE(SocketOptions)
+{
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqReceiver_test_SocketOptions" },
+                                  { "receive_hwm", 10 },
+                                  { "receive_buffer_size", 1 << 20 },
+                                  { "affinity", 1 } };
+  the_receiver->connect_for_receives(connection_info);
+  auto options = the_receiver->effective_options();
+  BOOST_REQUIRE_EQUAL(options["receive_hwm"].get<int>(), 10);
+  BOOST_REQUIRE_EQUAL(options["receive_buffer_size"].get<int>(), 1 << 20);
+  BOOST_REQUIRE_EQUAL(options["affinity"].get<uint64_t>(), 1u);
+
+  // InvalidSocketOption is private to the plugins
+  BOOST_REQUIRE_THROW(make_ipm_receiver("ZmqReceiver")
+                        ->connect_for_receives({ { "connection_string", "inproc://ZmqReceiver_test_SocketOptions_bad" },
+                                                 { "receive_hwm", 1.5 } }),
+                      ers::Issue);
+}
+
+
+BOOST_AUTO_TEST_CASE(Dispatch)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqReceiver_test_Dispatch" } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::mutex mutex;
+  std::vector<int> received;
+  auto handler = [&](Receiver::Response& message) {
+    int value = -1;
+    memcpy(&value, message.m_data.data(), std::min(message.m_data.size(), sizeof(value)));
+    std::lock_guard<std::mutex> lock(mutex);
+    received.push_back(value);
+  };
+  auto wait_for = [&](size_t num_messages) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (received.size() >= num_messages) {
+          return;
+        }
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  };
+
+  // Several threads: every message is handled once, in whatever order
+  const int num_messages = 1000;
+  the_receiver->start_dispatch(handler, 3);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Idle, without timing out
+  for (int i = 0; i < num_messages; ++i) {
+    the_sender->send(&i, sizeof(i), Sender::s_block);
+  }
+  wait_for(num_messages);
+  the_receiver->stop_dispatch();
+  std::sort(received.begin(), received.end());
+  BOOST_REQUIRE_EQUAL(received.size(), num_messages);
+  for (int i = 0; i < num_messages; ++i) {
+    BOOST_REQUIRE_EQUAL(received[i], i);
+  }
+
+  // One thread: in order. An idle receiver stops as soon as it is told to.
+  received.clear();
+  the_receiver->start_dispatch(handler);
+  for (int i = 0; i < 100; ++i) {
+    the_sender->send(&i, sizeof(i), Sender::s_block);
+  }
+  wait_for(100);
+  auto start_time = std::chrono::steady_clock::now();
+  the_receiver->stop_dispatch();
+  BOOST_CHECK_LT(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time)
+                   .count(),
+                 50);
+  BOOST_REQUIRE_EQUAL(received.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    BOOST_REQUIRE_EQUAL(received[i], i);
+  }
+
+  auto info = the_receiver->get_info();
+  BOOST_REQUIRE_EQUAL(info.m_messages, num_messages + 100);
+  BOOST_REQUIRE_EQUAL(info.m_timeouts, 0);
+
+  // A receiver from make_ipm_receiver can be let go of while still dispatching
+  the_receiver->start_dispatch(handler);
+  the_receiver.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
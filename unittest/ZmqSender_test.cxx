@@ -6,19 +6,36 @@
  * received with this code.
  */
 
+#include "ipm/Receiver.hpp"
 #include "ipm/Sender.hpp"
+#include "ipm/Subscriber.hpp"
 
 #define BOOST_TEST_MODULE ZmqSender_test // NOLINT
 
 #include "boost/test/unit_test.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 using namespace dunedaq::ipm;
 
 BOOST_AUTO_TEST_SUITE(ZmqSender_test)
 
+namespace {
+
+void
+count_releases(void* /* message */, void* hint)
+{
+  ++*static_cast<std::atomic<int>*>(hint);
+}
+
+} // namespace ""
+
 BOOST_AUTO_TEST_CASE(BasicTests)
 {
   auto the_sender = make_ipm_sender("ZmqSender");
@@ -26,4 +43,535 @@ BOOST_AUTO_TEST_CASE(BasicTests)
   BOOST_REQUIRE(!the_sender->can_send());
 }
 
+BOOST_AUTO_TEST_CASE(ZeroCopy)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_ZeroCopy" } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+  std::atomic<int> num_releases{ 0 };
+  the_sender->send_zero_copy(test_data.data(), test_data.size(), &count_releases, &num_releases, Sender::s_block, "ZC");
+
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "ZC");
+  BOOST_REQUIRE(response.m_data == test_data);
+
+  // The IO thread releases the buffer asynchronously
+  for (int i = 0; i < 1000 && num_releases.load() == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_REQUIRE_EQUAL(num_releases.load(), 1);
+
+  auto pool = make_buffer_pool(test_data.size());
+  auto buffer = pool->acquire();
+  std::copy(test_data.begin(), test_data.end(), buffer.data());
+  the_sender->send(std::move(buffer), test_data.size(), Sender::s_block, "POOL");
+
+  response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "POOL");
+  BOOST_REQUIRE(response.m_data == test_data);
+  for (int i = 0; i < 1000 && pool->num_free() == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  BOOST_REQUIRE_EQUAL(pool->num_free(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(SendTimeout)
+{
+  // A PUSH socket with no peer has nowhere to queue messages
+  auto the_sender = make_ipm_sender("ZmqSender");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_SendTimeout" } };
+  the_sender->connect_for_sends(connection_info);
+  std::vector<char> test_data{ 'T', 'E', 'S', 'T' };
+
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), Sender::s_no_block),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EXCEPTION(the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(50), "LOST"),
+                          dunedaq::ipm::SendTimeoutExpired,
+                          [&](dunedaq::ipm::SendTimeoutExpired) { return true; });
+  BOOST_REQUIRE(std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds(50));
+
+  // A send blocked on a missing peer completes as soon as one shows up, and
+  // the timed-out attempts leave no stray frames behind
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  std::thread receiver_thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    the_receiver->connect_for_receives(connection_info);
+  });
+  the_sender->send(test_data.data(), test_data.size(), std::chrono::milliseconds(5000), "DELIVERED");
+  receiver_thread.join();
+
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "DELIVERED");
+  BOOST_REQUIRE(response.m_data == test_data);
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(Receiver::s_no_block),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+}
+
+BOOST_AUTO_TEST_CASE(SendBatch)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_SendBatch" } };
+  the_sender->connect_for_sends(connection_info);
+
+  std::vector<int> values{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  std::vector<std::string> topics;
+  for (auto value : values) {
+    topics.push_back(std::to_string(value));
+  }
+  std::vector<Sender::BatchEntry> entries;
+  for (size_t i = 0; i < values.size(); ++i) {
+    entries.push_back(Sender::BatchEntry{ &values[i], sizeof(int), topics[i] });
+  }
+
+  // With no peer, nothing is accepted and the whole batch shares one deadline
+  auto start_time = std::chrono::steady_clock::now();
+  BOOST_REQUIRE_EQUAL(the_sender->send_batch(entries.data(), entries.size(), std::chrono::milliseconds(20)), 0);
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  BOOST_REQUIRE(elapsed >= std::chrono::milliseconds(20));
+  BOOST_REQUIRE(elapsed < std::chrono::milliseconds(20 * entries.size()));
+
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_receiver->connect_for_receives(connection_info);
+  BOOST_REQUIRE_EQUAL(the_sender->send_batch(entries.data(), entries.size(), std::chrono::milliseconds(1000)),
+                      entries.size());
+
+  for (auto value : values) {
+    auto response = the_receiver->receive(std::chrono::milliseconds(1000), sizeof(int));
+    BOOST_REQUIRE_EQUAL(response.m_metadata, std::to_string(value));
+    BOOST_REQUIRE_EQUAL(*reinterpret_cast<const int*>(response.m_data.data()), value);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Multipart)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_Multipart" } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  std::string header = "HEADER";
+  std::string fragment1 = "FRAGMENT1";
+  std::string fragment2 = "FRAGMENT2";
+  const void* parts[] = { header.data(), fragment1.data(), fragment2.data() };
+  std::vector<Sender::message_size_t> sizes{ static_cast<Sender::message_size_t>(header.size()),
+                                             static_cast<Sender::message_size_t>(fragment1.size()),
+                                             static_cast<Sender::message_size_t>(fragment2.size()) };
+
+  the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+  auto multipart = the_receiver->receive_multipart(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(multipart.m_metadata, "EVENT");
+  BOOST_REQUIRE_EQUAL(multipart.m_parts.size(), 3);
+  BOOST_REQUIRE_EQUAL(std::string(multipart.m_parts[0].m_data, multipart.m_parts[0].m_size), header);
+  BOOST_REQUIRE_EQUAL(std::string(multipart.m_parts[1].m_data, multipart.m_parts[1].m_size), fragment1);
+  BOOST_REQUIRE_EQUAL(std::string(multipart.m_parts[2].m_data, multipart.m_parts[2].m_size), fragment2);
+
+  // Receivers that don't care about the parts get them concatenated
+  const std::string concatenated = header + fragment1 + fragment2;
+  the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000), concatenated.size());
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), concatenated);
+
+  the_sender->send_multipart(parts, sizes, Sender::s_block, "EVENT");
+  auto view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), concatenated);
+
+  // Single-part messages come back as one part
+  the_sender->send(header.data(), header.size(), Sender::s_block, "SINGLE");
+  multipart = the_receiver->receive_multipart(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(multipart.m_metadata, "SINGLE");
+  BOOST_REQUIRE_EQUAL(multipart.m_parts.size(), 1);
+
+  const void* bad_parts[] = { header.data(), nullptr };
+  std::vector<Sender::message_size_t> bad_sizes{ 1, 1 };
+  BOOST_REQUIRE_EXCEPTION(the_sender->send_multipart(bad_parts, bad_sizes, Sender::s_block),
+                          dunedaq::ipm::NullPointerPassedToSend,
+                          [&](dunedaq::ipm::NullPointerPassedToSend) { return true; });
+}
+
+BOOST_AUTO_TEST_CASE(SocketOptions)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  BOOST_REQUIRE(the_sender->effective_options().empty());
+
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_SocketOptions" },
+                                  { "send_hwm", 50 },
+                                  { "send_buffer_size", 1 << 20 },
+                                  { "immediate", true },
+                                  { "linger", 0 },
+                                  { "tcp_keepalive", true },
+                                  { "tcp_keepalive_idle", 30 } };
+  the_sender->connect_for_sends(connection_info);
+  auto options = the_sender->effective_options();
+  BOOST_REQUIRE_EQUAL(options["send_hwm"].get<int>(), 50);
+  BOOST_REQUIRE_EQUAL(options["send_buffer_size"].get<int>(), 1 << 20);
+  BOOST_REQUIRE(options["immediate"].get<bool>());
+  BOOST_REQUIRE_EQUAL(options["linger"].get<int>(), 0);
+  BOOST_REQUIRE(options["tcp_keepalive"].get<bool>());
+  BOOST_REQUIRE_EQUAL(options["tcp_keepalive_idle"].get<int>(), 30);
+  // Keys which weren't given report ZeroMQ's defaults
+  BOOST_REQUIRE(!options["conflate"].get<bool>());
+  BOOST_REQUIRE_EQUAL(options["receive_hwm"].get<int>(), 1000);
+
+  // InvalidSocketOption is private to the plugins
+  for (auto const& bad_option : { nlohmann::json{ { "send_hwm", -1 } },
+                                  nlohmann::json{ { "send_hwm", "lots" } },
+                                  nlohmann::json{ { "immediate", 1 } },
+                                  nlohmann::json{ { "affinity", -1 } } }) {
+    auto bad_connection_info = bad_option;
+    bad_connection_info["connection_string"] = "inproc://ZmqSender_test_SocketOptions_bad";
+    BOOST_REQUIRE_THROW(make_ipm_sender("ZmqSender")->connect_for_sends(bad_connection_info), ers::Issue);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Conflate)
+{
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_Conflate" }, { "conflate", true } };
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+
+  for (std::string value : { "1", "2", "3" }) {
+    the_sender->send(value.data(), value.size(), Sender::s_block);
+  }
+  auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), "3");
+  BOOST_REQUIRE_EXCEPTION(the_receiver->receive(std::chrono::milliseconds(10)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  // Only single-frame messages can be conflated
+  std::string value("4");
+  BOOST_REQUIRE_THROW(the_sender->send(value.data(), value.size(), Sender::s_block, "TOPIC"), ers::Issue);
+  const void* parts[] = { value.data(), value.data() };
+  BOOST_REQUIRE_THROW(the_sender->send_multipart(parts, { 1, 1 }, Sender::s_block), ers::Issue);
+}
+
+BOOST_AUTO_TEST_CASE(Timestamps)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_Timestamps" },
+                                  { "timestamps", true },
+                                  { "send_hwm", 1 },
+                                  { "receive_hwm", 1 } };
+  auto the_publisher = make_ipm_sender("ZmqPublisher");
+  auto the_subscriber = make_ipm_subscriber("ZmqSubscriber");
+  the_publisher->connect_for_sends(connection_info);
+  the_subscriber->connect_for_receives(connection_info);
+  the_subscriber->subscribe("");
+  BOOST_REQUIRE(the_publisher->effective_options()["timestamps"].get<bool>());
+
+  // Messages published before the subscription takes hold are dropped
+  std::string test_data("TEST");
+  bool subscribed = false;
+  while (!subscribed) {
+    the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "WARMUP");
+    subscribed = !the_subscriber->receive_batch(1, std::chrono::milliseconds(10)).empty();
+  }
+  while (!the_subscriber->receive_batch(1, std::chrono::milliseconds(10)).empty()) {
+  }
+
+  // Overrunning the high-water marks makes the publisher drop messages, which
+  // the subscriber counts from the gaps in the sequence numbers
+  constexpr size_t num_sends = 100;
+  for (size_t i = 0; i < num_sends; ++i) {
+    the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "DATA");
+  }
+  size_t num_received = 0;
+  for (auto batch = the_subscriber->receive_batch(num_sends, std::chrono::milliseconds(100)); !batch.empty();
+       batch = the_subscriber->receive_batch(num_sends, std::chrono::milliseconds(100))) {
+    for (auto const& response : batch) {
+      // The stamp never reaches the caller
+      BOOST_REQUIRE_EQUAL(response.m_metadata, "DATA");
+      BOOST_REQUIRE(response.m_data == std::vector<char>(test_data.begin(), test_data.end()));
+    }
+    num_received += batch.size();
+  }
+  BOOST_REQUIRE_LT(num_received, num_sends);
+  the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "DATA");
+  std::string metadata;
+  std::vector<char> buffer(test_data.size());
+  auto into = the_subscriber->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE_EQUAL(into.m_size, test_data.size());
+  BOOST_REQUIRE_EQUAL(metadata, "DATA");
+  ++num_received;
+
+  auto info = the_subscriber->get_info();
+  BOOST_REQUIRE_EQUAL(info.m_sequence_gaps, num_sends + 1 - num_received);
+  BOOST_REQUIRE_EQUAL(info.m_latency_samples, info.m_messages);
+  BOOST_REQUIRE_GT(info.m_latency_max_ns, 0);
+  BOOST_REQUIRE_LE(info.m_latency_p50_ns, info.m_latency_p99_ns);
+  BOOST_REQUIRE_LE(info.m_latency_p99_ns, info.m_latency_p999_ns);
+  BOOST_REQUIRE_LE(info.m_latency_p999_ns, info.m_latency_max_ns);
+
+  // Without timestamps there is nothing to measure
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  nlohmann::json plain_info{ { "connection_string", "inproc://ZmqSender_test_Timestamps_plain" } };
+  the_sender->connect_for_sends(plain_info);
+  the_receiver->connect_for_receives(plain_info);
+  the_sender->send(test_data.data(), test_data.size(), Sender::s_block, "PLAIN");
+  BOOST_REQUIRE_EQUAL(the_receiver->receive(std::chrono::milliseconds(1000)).m_metadata, "PLAIN");
+  BOOST_REQUIRE_EQUAL(the_receiver->get_info().m_latency_samples, 0);
+
+  // A sender deals its messages out among its receivers, which mustn't take the ones the others got as missing
+  nlohmann::json shared_info{ { "connection_string", "inproc://ZmqSender_test_Timestamps_shared" },
+                              { "timestamps", true } };
+  auto shared_sender = make_ipm_sender("ZmqSender");
+  shared_sender->connect_for_sends(shared_info);
+  std::vector<std::shared_ptr<Receiver>> shared_receivers{ make_ipm_receiver("ZmqReceiver"),
+                                                           make_ipm_receiver("ZmqReceiver") };
+  for (auto& shared_receiver : shared_receivers) {
+    shared_receiver->connect_for_receives(shared_info);
+  }
+  for (size_t i = 0; i < num_sends; ++i) {
+    shared_sender->send(test_data.data(), test_data.size(), Sender::s_block, "SHARED");
+  }
+  size_t num_shared = 0;
+  for (auto& shared_receiver : shared_receivers) {
+    size_t num_here = 0;
+    for (auto batch = shared_receiver->receive_batch(num_sends, std::chrono::milliseconds(100)); !batch.empty();
+         batch = shared_receiver->receive_batch(num_sends, std::chrono::milliseconds(100))) {
+      num_here += batch.size();
+    }
+    BOOST_REQUIRE_GT(num_here, 0);
+    BOOST_REQUIRE_EQUAL(shared_receiver->get_info().m_sequence_gaps, 0);
+    num_shared += num_here;
+  }
+  BOOST_REQUIRE_EQUAL(num_shared, num_sends);
+
+  // The stamp travels in the topic frame, which conflate leaves out
+  BOOST_REQUIRE_THROW(make_ipm_sender("ZmqSender")
+                        ->connect_for_sends({ { "connection_string", "inproc://ZmqSender_test_Timestamps_bad" },
+                                              { "timestamps", true },
+                                              { "conflate", true } }),
+                      ers::Issue);
+}
+
+BOOST_AUTO_TEST_CASE(BinaryHeaders)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_BinaryHeaders" },
+                                  { "topics", { "TP_APA1", "TP_APA2", "HB" } } };
+  auto the_publisher = make_ipm_sender("ZmqPublisher");
+  auto the_subscriber = make_ipm_subscriber("ZmqSubscriber");
+  // Prefix subscriptions still work, before or after connecting
+  the_subscriber->subscribe("TP_");
+  the_publisher->connect_for_sends(connection_info);
+  the_subscriber->connect_for_receives(connection_info);
+  the_subscriber->subscribe("UNLISTED");
+
+  std::string test_data("TEST");
+  std::vector<char> expected(test_data.begin(), test_data.end());
+  bool subscribed = false;
+  while (!subscribed) {
+    the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "UNLISTED");
+    subscribed = !the_subscriber->receive_batch(1, std::chrono::milliseconds(10)).empty();
+  }
+  while (!the_subscriber->receive_batch(1, std::chrono::milliseconds(10)).empty()) {
+  }
+
+  for (std::string topic : { "HB", "TP_APA1", "TP_APA2", "UNLISTED" }) {
+    the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, topic);
+  }
+  auto response = the_subscriber->receive(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(response.m_metadata, "TP_APA1");
+  BOOST_REQUIRE(response.m_data == expected);
+  auto view = the_subscriber->receive_view(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(view.m_metadata, "TP_APA2");
+  // Topics not in the list go as strings
+  std::string metadata;
+  std::vector<char> buffer(test_data.size());
+  the_subscriber->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000), &metadata);
+  BOOST_REQUIRE_EQUAL(metadata, "UNLISTED");
+  BOOST_REQUIRE_EXCEPTION(the_subscriber->receive(std::chrono::milliseconds(10)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+
+  the_subscriber->unsubscribe("TP_");
+  the_publisher->send(test_data.data(), test_data.size(), Sender::s_block, "TP_APA1");
+  BOOST_REQUIRE_EXCEPTION(the_subscriber->receive(std::chrono::milliseconds(100)),
+                          dunedaq::ipm::ReceiveTimeoutExpired,
+                          [&](dunedaq::ipm::ReceiveTimeoutExpired) { return true; });
+  BOOST_REQUIRE_EQUAL(the_subscriber->get_info().m_sequence_gaps, 0);
+
+  // Timestamps and explicit topic IDs
+  nlohmann::json stamped_info{ { "connection_string", "inproc://ZmqSender_test_BinaryHeaders_stamped" },
+                               { "topics", { { "HB", 7 }, { "TP", 1000000 } } },
+                               { "timestamps", true } };
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_sender->connect_for_sends(stamped_info);
+  the_receiver->connect_for_receives(stamped_info);
+  const void* parts[] = { test_data.data(), test_data.data() };
+  the_sender->send_multipart(parts, { 2, 2 }, Sender::s_block, "TP");
+  auto multipart = the_receiver->receive_multipart(std::chrono::milliseconds(1000));
+  BOOST_REQUIRE_EQUAL(multipart.m_metadata, "TP");
+  BOOST_REQUIRE_EQUAL(multipart.m_parts.size(), 2);
+  BOOST_REQUIRE_EQUAL(the_receiver->get_info().m_latency_samples, 1);
+
+  // InvalidTopicTable is private to the plugins
+  for (auto const& bad_topics : { nlohmann::json{ "A", "A" },
+                                  nlohmann::json{ { "A", 1 }, { "B", 1 } },
+                                  nlohmann::json{ { "A", -1 } },
+                                  nlohmann::json{ "" },
+                                  nlohmann::json("A") }) {
+    nlohmann::json bad_info{ { "connection_string", "inproc://ZmqSender_test_BinaryHeaders_bad" },
+                             { "topics", bad_topics } };
+    BOOST_REQUIRE_THROW(make_ipm_sender("ZmqSender")->connect_for_sends(bad_info), ers::Issue);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Coalescing)
+{
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_Coalescing" },
+                                  { "coalesce_bytes", 1024 },
+                                  { "coalesce_delay_us", 10000 } };
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+  BOOST_REQUIRE_EQUAL(the_sender->effective_options()["coalesce_bytes"].get<int>(), 1024);
+
+  // 24 bytes each in the frame, so the first 42 go out together when the
+  // 43rd arrives, and the rest when the delay runs out
+  const int num_messages = 100;
+  for (int i = 0; i < num_messages; ++i) {
+    std::string message = "Message " + std::to_string(i) + std::string(20, '.');
+    the_sender->send(message.data(), 20, Sender::s_block, "TP");
+  }
+  for (int i = 0; i < num_messages; ++i) {
+    std::string expected = ("Message " + std::to_string(i) + std::string(20, '.')).substr(0, 20);
+    if (i % 3 == 0) {
+      auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+      BOOST_REQUIRE_EQUAL(response.m_metadata, "TP");
+      BOOST_REQUIRE_EQUAL(std::string(response.m_data.begin(), response.m_data.end()), expected);
+    } else if (i % 3 == 1) {
+      auto view = the_receiver->receive_view(std::chrono::milliseconds(1000));
+      BOOST_REQUIRE_EQUAL(view.m_metadata, "TP");
+      BOOST_REQUIRE_EQUAL(std::string(view.m_data, view.m_size), expected);
+    } else {
+      // Too small at first, so the message is kept for the next call
+      std::string metadata;
+      std::vector<char> buffer(10);
+      auto result = the_receiver->receive_into(buffer.data(), buffer.size(), std::chrono::milliseconds(1000));
+      BOOST_REQUIRE(result.m_buffer_too_small);
+      buffer.resize(result.m_size);
+      the_receiver->receive_into(buffer.data(), buffer.size(), Receiver::s_no_block, &metadata);
+      BOOST_REQUIRE_EQUAL(metadata, "TP");
+      BOOST_REQUIRE_EQUAL(std::string(buffer.begin(), buffer.end()), expected);
+    }
+  }
+  BOOST_REQUIRE_EQUAL(the_receiver->get_info().m_messages, num_messages);
+
+  // Other topics, messages too big to coalesce, and multipart messages all
+  // keep their place in the order
+  std::string small("SMALL");
+  std::string big(2000, 'B');
+  const void* parts[] = { small.data(), small.data() };
+  the_sender->send(small.data(), small.size(), Sender::s_block, "A");
+  the_sender->send(small.data(), small.size(), Sender::s_block, "B");
+  the_sender->send(big.data(), big.size(), Sender::s_block, "B");
+  the_sender->send_multipart(parts, { 2, 3 }, Sender::s_block, "C");
+  Sender::BatchEntry batch[] = { { small.data(), 1, "D" }, { small.data(), 2, "D" } };
+  BOOST_REQUIRE_EQUAL(the_sender->send_batch(batch, 2, Sender::s_block), 2);
+  for (auto [topic, size] : std::vector<std::pair<std::string, size_t>>{
+         { "A", small.size() }, { "B", small.size() }, { "B", big.size() }, { "C", 5 }, { "D", 1 }, { "D", 2 } }) {
+    auto response = the_receiver->receive(std::chrono::milliseconds(1000));
+    BOOST_REQUIRE_EQUAL(response.m_metadata, topic);
+    BOOST_REQUIRE_EQUAL(response.m_data.size(), size);
+  }
+
+  // Subscriptions still match the topic of a coalesced frame
+  nlohmann::json pubsub_info{ { "connection_string", "inproc://ZmqSender_test_Coalescing_pubsub" },
+                              { "coalesce_bytes", 256 },
+                              { "topics", { "LISTED" } } };
+  auto the_publisher = make_ipm_sender("ZmqPublisher");
+  auto the_subscriber = make_ipm_subscriber("ZmqSubscriber");
+  the_publisher->connect_for_sends(pubsub_info);
+  the_subscriber->connect_for_receives(pubsub_info);
+  the_subscriber->subscribe("LISTED");
+  the_subscriber->subscribe("STRING");
+  bool subscribed = false;
+  while (!subscribed) {
+    the_publisher->send(small.data(), small.size(), Sender::s_block, "STRING");
+    subscribed = !the_subscriber->receive_batch(1, std::chrono::milliseconds(10)).empty();
+  }
+  while (!the_subscriber->receive_batch(1, std::chrono::milliseconds(10)).empty()) {
+  }
+  for (std::string topic : { "LISTED", "LISTED", "OTHER", "OTHER", "STRING", "STRING" }) {
+    the_publisher->send(small.data(), small.size(), Sender::s_block, topic);
+  }
+  auto received = the_subscriber->receive_batch(10, std::chrono::milliseconds(1000));
+  while (received.size() < 4) {
+    auto more = the_subscriber->receive_batch(10, std::chrono::milliseconds(1000));
+    BOOST_REQUIRE(!more.empty());
+    received.insert(received.end(), more.begin(), more.end());
+  }
+  BOOST_REQUIRE_EQUAL(received.size(), 4);
+  BOOST_REQUIRE_EQUAL(received[1].m_metadata, "LISTED");
+  BOOST_REQUIRE_EQUAL(received[2].m_metadata, "STRING");
+
+  // InvalidSocketOption is private to the plugins
+  for (auto const& [key, value] : std::vector<std::pair<std::string, nlohmann::json>>{
+         { "coalesce_bytes", -1 }, { "coalesce_bytes", "1024" }, { "coalesce_delay_us", 0 } }) {
+    nlohmann::json bad_info{ { "connection_string", "inproc://ZmqSender_test_Coalescing_bad" },
+                             { "coalesce_bytes", 1024 } };
+    bad_info[key] = value;
+    BOOST_REQUIRE_THROW(make_ipm_sender("ZmqSender")->connect_for_sends(bad_info), ers::Issue);
+  }
+  for (auto const& option : { "conflate", "timestamps" }) {
+    nlohmann::json bad_info{ { "connection_string", "inproc://ZmqSender_test_Coalescing_bad" },
+                             { "coalesce_bytes", 1024 },
+                             { option, true } };
+    BOOST_REQUIRE_THROW(make_ipm_sender("ZmqSender")->connect_for_sends(bad_info), ers::Issue);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CoalescedFrames)
+{
+  // 24 bytes each in the frame, so two fill it, and go without waiting out the delay
+  nlohmann::json connection_info{ { "connection_string", "inproc://ZmqSender_test_CoalescedFrames" },
+                                  { "coalesce_bytes", 48 },
+                                  { "coalesce_delay_us", 10000000 } };
+  auto the_sender = make_ipm_sender("ZmqSender");
+  auto the_receiver = make_ipm_receiver("ZmqReceiver");
+  the_sender->connect_for_sends(connection_info);
+  the_receiver->connect_for_receives(connection_info);
+  std::string message(20, 'M');
+  for (int i = 0; i < 2; ++i) {
+    the_sender->send(message.data(), message.size(), Sender::s_block, "TP");
+  }
+  for (int i = 0; i < 2; ++i) {
+    BOOST_REQUIRE_EQUAL(the_receiver->receive(std::chrono::milliseconds(1000)).m_data.size(), message.size());
+  }
+
+  // With no receiver, the frame can't go; connecting again drops it, and says so
+  nlohmann::json unread_info{ { "connection_string", "inproc://ZmqSender_test_CoalescedFrames_unread" },
+                              { "coalesce_bytes", 1024 },
+                              { "coalesce_delay_us", 1000 } };
+  auto unread_sender = make_ipm_sender("ZmqSender");
+  unread_sender->connect_for_sends(unread_info);
+  for (int i = 0; i < 3; ++i) {
+    unread_sender->send(message.data(), message.size(), Sender::s_block, "TP");
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  unread_info["connection_string"] = "inproc://ZmqSender_test_CoalescedFrames_again";
+  unread_sender->connect_for_sends(unread_info);
+  BOOST_REQUIRE_EQUAL(unread_sender->get_info().m_dropped, 3);
+
+  // The sender coalesces as before on its new socket
+  auto new_receiver = make_ipm_receiver("ZmqReceiver");
+  new_receiver->connect_for_receives(unread_info);
+  unread_sender->send(message.data(), message.size(), Sender::s_block, "TP");
+  BOOST_REQUIRE_EQUAL(new_receiver->receive(std::chrono::milliseconds(1000)).m_metadata, "TP");
+}
+
 BOOST_AUTO_TEST_SUITE_END()